@@ -0,0 +1,196 @@
+#include "Json.h"
+#include <cctype>
+#include <cstdio>
+#include <cstdlib>
+
+namespace apex::bench {
+
+namespace {
+
+class Parser {
+public:
+    explicit Parser(const std::string& text) : text_(text) {}
+
+    bool parse(JsonValue& value, std::string& error) {
+        if (!parse_value(value)) {
+            error = error_ + " at offset " + std::to_string(pos_);
+            return false;
+        }
+        skip_space();
+        if (pos_ != text_.size()) {
+            error = "trailing characters at offset " + std::to_string(pos_);
+            return false;
+        }
+        return true;
+    }
+
+private:
+    const std::string& text_;
+    size_t pos_{0};
+    std::string error_;
+
+    void skip_space() {
+        while (pos_ < text_.size() && std::isspace(static_cast<unsigned char>(text_[pos_]))) pos_++;
+    }
+
+    bool fail(const std::string& message) {
+        error_ = message;
+        return false;
+    }
+
+    bool consume(const char* word) {
+        size_t length = std::char_traits<char>::length(word);
+        if (text_.compare(pos_, length, word) != 0) return false;
+        pos_ += length;
+        return true;
+    }
+
+    bool parse_value(JsonValue& value) {
+        skip_space();
+        if (pos_ >= text_.size()) return fail("unexpected end");
+        char c = text_[pos_];
+        if (c == '{') return parse_object(value);
+        if (c == '[') return parse_array(value);
+        if (c == '"') {
+            value.kind = JsonValue::Kind::String;
+            return parse_string(value.string);
+        }
+        if (consume("true")) {
+            value.kind = JsonValue::Kind::Bool;
+            value.boolean = true;
+            return true;
+        }
+        if (consume("false")) {
+            value.kind = JsonValue::Kind::Bool;
+            return true;
+        }
+        if (consume("null")) {
+            value.kind = JsonValue::Kind::Null;
+            return true;
+        }
+        const char* start = text_.c_str() + pos_;
+        char* end = nullptr;
+        value.number = std::strtod(start, &end);
+        if (end == start) return fail("unexpected character");
+        value.kind = JsonValue::Kind::Number;
+        pos_ += end - start;
+        return true;
+    }
+
+    bool parse_string(std::string& out) {
+        pos_++;     // Opening quote
+        while (pos_ < text_.size() && text_[pos_] != '"') {
+            char c = text_[pos_++];
+            if (c != '\\') {
+                out += c;
+                continue;
+            }
+            if (pos_ >= text_.size()) break;
+            char escape = text_[pos_++];
+            switch (escape) {
+                case 'n': out += '\n'; break;
+                case 't': out += '\t'; break;
+                case 'r': out += '\r'; break;
+                case 'b': out += '\b'; break;
+                case 'f': out += '\f'; break;
+                case 'u': {
+                    if (pos_ + 4 > text_.size()) return fail("bad \\u escape");
+                    unsigned code = static_cast<unsigned>(std::strtoul(text_.substr(pos_, 4).c_str(), nullptr, 16));
+                    pos_ += 4;
+                    // Only what the writers here produce: ASCII control characters
+                    out += code < 0x80 ? static_cast<char>(code) : '?';
+                    break;
+                }
+                default: out += escape; break;
+            }
+        }
+        if (pos_ >= text_.size()) return fail("unterminated string");
+        pos_++;     // Closing quote
+        return true;
+    }
+
+    bool parse_array(JsonValue& value) {
+        value.kind = JsonValue::Kind::Array;
+        pos_++;
+        skip_space();
+        if (pos_ < text_.size() && text_[pos_] == ']') {
+            pos_++;
+            return true;
+        }
+        for (;;) {
+            value.array.emplace_back();
+            if (!parse_value(value.array.back())) return false;
+            skip_space();
+            if (pos_ < text_.size() && text_[pos_] == ',') {
+                pos_++;
+            } else if (pos_ < text_.size() && text_[pos_] == ']') {
+                pos_++;
+                return true;
+            } else {
+                return fail("expected ',' or ']'");
+            }
+        }
+    }
+
+    bool parse_object(JsonValue& value) {
+        value.kind = JsonValue::Kind::Object;
+        pos_++;
+        skip_space();
+        if (pos_ < text_.size() && text_[pos_] == '}') {
+            pos_++;
+            return true;
+        }
+        for (;;) {
+            skip_space();
+            if (pos_ >= text_.size() || text_[pos_] != '"') return fail("expected a key");
+            std::string key;
+            if (!parse_string(key)) return false;
+            skip_space();
+            if (pos_ >= text_.size() || text_[pos_] != ':') return fail("expected ':'");
+            pos_++;
+            if (!parse_value(value.object[key])) return false;
+            skip_space();
+            if (pos_ < text_.size() && text_[pos_] == ',') {
+                pos_++;
+            } else if (pos_ < text_.size() && text_[pos_] == '}') {
+                pos_++;
+                return true;
+            } else {
+                return fail("expected ',' or '}'");
+            }
+        }
+    }
+};
+
+} // namespace
+
+const JsonValue& JsonValue::operator[](const std::string& key) const {
+    static const JsonValue null_value;
+    if (kind != Kind::Object) return null_value;
+    auto it = object.find(key);
+    return it == object.end() ? null_value : it->second;
+}
+
+bool parse_json(const std::string& text, JsonValue& value, std::string& error) {
+    value = JsonValue();
+    return Parser(text).parse(value, error);
+}
+
+std::string json_quote(const std::string& text) {
+    std::string quoted = "\"";
+    for (char c : text) {
+        if (c == '"' || c == '\\') {
+            quoted += '\\';
+            quoted += c;
+        } else if (static_cast<unsigned char>(c) < 0x20) {
+            char buffer[8];
+            std::snprintf(buffer, sizeof(buffer), "\\u%04x", c);
+            quoted += buffer;
+        } else {
+            quoted += c;
+        }
+    }
+    return quoted + "\"";
+}
+
+} // namespace apex::bench
@@ -0,0 +1,32 @@
+#pragma once
+
+#include <map>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace apex::bench {
+
+// Just enough JSON to read apexc's reports and the benchmark baselines
+struct JsonValue {
+    enum class Kind { Null, Bool, Number, String, Array, Object };
+
+    Kind kind{Kind::Null};
+    bool boolean{false};
+    double number{0};
+    std::string string;
+    std::vector<JsonValue> array;
+    std::map<std::string, JsonValue> object;
+
+    // Member lookup on objects; null for anything missing
+    const JsonValue& operator[](const std::string& key) const;
+    double number_or(double fallback) const { return kind == Kind::Number ? number : fallback; }
+};
+
+// False, with `error` set, if `text` isn't one JSON value
+bool parse_json(const std::string& text, JsonValue& value, std::string& error);
+
+// `text` as a JSON string literal, quotes included
+std::string json_quote(const std::string& text);
+
+} // namespace apex::bench
@@ -0,0 +1,17 @@
+#pragma once
+
+#include <string>
+
+namespace apex::bench {
+
+// `arg` quoted for /bin/sh
+std::string shell_quote(const std::string& arg);
+
+// Runs `command` through the shell; its stdout and stderr land in `output`.
+// Returns the exit status, or -1 if it didn't exit normally.
+int run_command(const std::string& command, std::string& output);
+
+bool read_file(const std::string& path, std::string& contents);
+bool write_file(const std::string& path, const std::string& contents);
+
+} // namespace apex::bench
@@ -0,0 +1,180 @@
+#include "Generator.h"
+#include <algorithm>
+#include <sstream>
+#include <vector>
+
+namespace apex::bench {
+
+namespace {
+
+// splitmix64: tiny, and the same sequence everywhere
+class Rng {
+public:
+    explicit Rng(uint64_t seed) : state_(seed) {}
+
+    uint64_t next() {
+        uint64_t z = (state_ += 0x9e3779b97f4a7c15ULL);
+        z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+        z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+        return z ^ (z >> 31);
+    }
+
+    // In [0, bound)
+    unsigned below(unsigned bound) { return bound ? static_cast<unsigned>(next() % bound) : 0; }
+    bool chance(unsigned percent) { return below(100) < percent; }
+
+private:
+    uint64_t state_;
+};
+
+struct StructShape {
+    unsigned fields{0};                 // i32 fields f0..fN-1
+    int inner{-1};                      // Index of a nested struct field `inner`, if any
+};
+
+class Generator {
+public:
+    explicit Generator(const GeneratorOptions& opts) : opts_(opts), rng_(opts.seed) {}
+
+    std::string run() {
+        unsigned num_structs = opts_.structs ? opts_.structs : std::max(1u, opts_.functions / 4);
+        for (unsigned i = 0; i < num_structs; i++) emit_struct(i);
+        for (unsigned i = 0; i < opts_.functions; i++) emit_function(i);
+        emit_main();
+        return out_.str();
+    }
+
+private:
+    const GeneratorOptions& opts_;
+    Rng rng_;
+    std::ostringstream out_;
+    std::vector<StructShape> structs_;
+
+    void emit_struct(unsigned index) {
+        StructShape shape;
+        shape.fields = 2 + rng_.below(5);
+        if (index > 0 && rng_.chance(40)) shape.inner = static_cast<int>(rng_.below(index));
+        structs_.push_back(shape);
+
+        out_ << "struct S" << index << " {\n";
+        for (unsigned f = 0; f < shape.fields; f++) out_ << "    f" << f << ": i32,\n";
+        if (shape.inner >= 0) out_ << "    inner: S" << shape.inner << ",\n";
+        out_ << "}\n\n";
+    }
+
+    void struct_literal(unsigned index) {
+        const StructShape& shape = structs_[index];
+        out_ << "S" << index << " { ";
+        for (unsigned f = 0; f < shape.fields; f++) {
+            out_ << (f ? ", " : "") << "f" << f << ": ";
+            leaf();
+        }
+        if (shape.inner >= 0) {
+            out_ << ", inner: ";
+            struct_literal(static_cast<unsigned>(shape.inner));
+        }
+        out_ << " }";
+    }
+
+    void leaf() {
+        switch (rng_.below(4)) {
+            case 0: out_ << "a"; break;
+            case 1: out_ << "b"; break;
+            case 2: out_ << "acc"; break;
+            default: out_ << 1 + rng_.below(9); break;
+        }
+    }
+
+    // A chain of `depth` parenthesized operations, nesting on either side
+    void deep_expr(unsigned depth) {
+        if (depth == 0) {
+            leaf();
+            return;
+        }
+        static const char* ops[] = {" + ", " - ", " * "};
+        const char* op = ops[rng_.below(3)];
+        out_ << "(";
+        if (rng_.chance(50)) {
+            deep_expr(depth - 1);
+            out_ << op;
+            leaf();
+        } else {
+            leaf();
+            out_ << op;
+            deep_expr(depth - 1);
+        }
+        out_ << ")";
+    }
+
+    void emit_function(unsigned index) {
+        unsigned s = rng_.below(static_cast<unsigned>(structs_.size()));
+        const StructShape& shape = structs_[s];
+
+        out_ << "pub fn work" << index << "(a: i32, b: i32) -> i32 {\n"
+             << "    let mut acc: i32 = a;\n"
+             << "    let s: S" << s << " = ";
+        struct_literal(s);
+        out_ << ";\n    acc = acc + s.f0 * s.f" << shape.fields - 1;
+        if (shape.inner >= 0) out_ << " - s.inner.f0";
+        out_ << ";\n";
+
+        out_ << "    let e: i32 = ";
+        deep_expr(opts_.expr_depth);
+        out_ << ";\n";
+
+        out_ << "    let m: i32 = match e {\n";
+        for (unsigned arm = 0; arm < opts_.match_arms; arm++) {
+            out_ << "        " << arm << " => ";
+            if (rng_.chance(50)) {
+                out_ << rng_.below(1000);
+            } else {
+                out_ << "acc + " << rng_.below(100);
+            }
+            out_ << ",\n";
+        }
+        out_ << "        _ => b,\n    };\n";
+
+        out_ << "    let mut i: i32 = 0;\n"
+             << "    while i < " << 2 + rng_.below(6) << " {\n"
+             << "        acc = acc + i * b;\n"
+             << "        i = i + 1;\n"
+             << "    }\n"
+             << "    for j in 0.." << 2 + rng_.below(6) << " {\n"
+             << "        acc = acc + j;\n"
+             << "    }\n"
+             << "    if acc > " << rng_.below(200) << " {\n"
+             << "        acc = acc - e;\n"
+             << "    } else {\n"
+             << "        acc = acc + m;\n"
+             << "    }\n";
+
+        if (index > 0 && rng_.chance(60)) {
+            out_ << "    return acc + work" << rng_.below(index) << "(b, m);\n";
+        } else {
+            out_ << "    return acc + m;\n";
+        }
+        out_ << "}\n\n";
+    }
+
+    void emit_main() {
+        out_ << "fn main() -> i32 {\n    let mut total: i32 = 0;\n";
+        unsigned stride = std::max(1u, opts_.functions / 64);
+        for (unsigned i = 0; i < opts_.functions; i += stride) {
+            out_ << "    total = total + work" << i << "(" << rng_.below(10) << ", " << rng_.below(10) << ");\n";
+        }
+        out_ << "    return total;\n}\n";
+    }
+};
+
+} // namespace
+
+GeneratedProgram generate_program(const GeneratorOptions& opts) {
+    GeneratedProgram program;
+    std::ostringstream header;
+    header << "// Generated by apex-bench-gen: " << opts.functions << " functions, seed " << opts.seed << "\n\n";
+    program.source = header.str() + Generator(opts).run();
+    program.lines = static_cast<unsigned>(std::count(program.source.begin(), program.source.end(), '\n'));
+    return program;
+}
+
+} // namespace apex::bench
@@ -0,0 +1,29 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+
+namespace apex::bench {
+
+struct GeneratorOptions {
+    unsigned functions{100};
+    unsigned structs{0};                // 0: one per four functions
+    unsigned expr_depth{24};            // Nesting of the parenthesized expression in each function
+    unsigned match_arms{16};            // Literal arms per match, plus `_`
+    uint64_t seed{1};
+};
+
+struct GeneratedProgram {
+    std::string source;
+    unsigned lines{0};
+};
+
+// A valid Apex program of the given shape: structs (some nesting earlier
+// ones), then `pub` functions built from struct literals and field access,
+// a deep arithmetic expression, a wide match, loops and calls to earlier
+// functions, then `main`. The same options always give the same program, on
+// every platform: the generator uses its own PRNG, not <random>'s
+// distributions.
+GeneratedProgram generate_program(const GeneratorOptions& opts);
+
+} // namespace apex::bench
@@ -0,0 +1,332 @@
+// apex-bench: front-end and codegen throughput of apexc on generated
+// programs of growing size, compared against a stored baseline
+#include "Generator.h"
+#include "../common/Json.h"
+#include "../common/Process.h"
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <filesystem>
+#include <iomanip>
+#include <iostream>
+#include <limits>
+#include <map>
+#include <sstream>
+#include <string>
+#include <vector>
+
+namespace {
+
+namespace fs = std::filesystem;
+using apex::bench::JsonValue;
+
+struct BenchOptions {
+    std::string apexc{"./build/src/apexc/apexc"};
+    std::vector<unsigned> sizes{100, 1000, 5000};
+    unsigned repeat{3};
+    unsigned opt_level{0};
+    apex::bench::GeneratorOptions generator;
+    std::string work_dir{"bench-work"};
+    std::string output_file;
+    std::string baseline_file;
+    double threshold{10};               // Percent
+};
+
+// What is reported: the report's phases, grouped
+struct PhaseGroup {
+    const char* name;
+    std::vector<std::string> phases;
+};
+
+const std::vector<PhaseGroup>& phase_groups() {
+    static const std::vector<PhaseGroup> groups = {
+        {"lex", {"lex"}},
+        {"parse", {"parse"}},
+        {"sema", {"sema"}},
+        {"mir", {"mir build", "mir checks", "mir opt"}},
+        {"codegen", {"codegen", "verify", "optimize", "emit"}},
+    };
+    return groups;
+}
+
+// Phases shorter than this in the baseline are too noisy to judge
+constexpr double MIN_JUDGED_MS = 5;
+
+struct SizeResult {
+    unsigned functions{0};
+    unsigned lines{0};
+    uint64_t tokens{0};
+    uint64_t peak_rss_bytes{std::numeric_limits<uint64_t>::max()};
+    std::vector<double> group_ms;       // Fastest of the repetitions, per phase group
+    double total_ms{std::numeric_limits<double>::max()};
+};
+
+void print_usage(const char* program_name) {
+    std::cout << "Usage: " << program_name << " [options]\n"
+              << "\nOptions:\n"
+              << "  --apexc <path>     Compiler to measure (default ./build/src/apexc/apexc)\n"
+              << "  --sizes <n,...>    Program sizes in functions (default 100,1000,5000)\n"
+              << "  --repeat <n>       Compiles per size; the fastest counts (default 3)\n"
+              << "  -O<level>          Optimization level passed to apexc (default 0)\n"
+              << "  --seed <n>, --depth <n>, --arms <n>\n"
+              << "                     Generator settings, as for apex-bench-gen\n"
+              << "  --work-dir <dir>   Where programs and objects are written (default bench-work)\n"
+              << "  -o <file>          Write the results as JSON (e.g. to update the baseline)\n"
+              << "  --baseline <file>  Compare against earlier results; exit 1 on a regression\n"
+              << "  --threshold <pct>  Allowed throughput loss or RSS growth (default 10)\n";
+}
+
+bool parse_unsigned(const std::string& value, unsigned& number) {
+    char* end = nullptr;
+    unsigned long parsed = std::strtoul(value.c_str(), &end, 10);
+    if (value.empty() || *end != '\0') {
+        std::cerr << "Invalid number: " << value << std::endl;
+        return false;
+    }
+    number = static_cast<unsigned>(parsed);
+    return true;
+}
+
+bool parse_args(int argc, char** argv, BenchOptions& opts, bool& help) {
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        if (arg == "-h" || arg == "--help") {
+            help = true;
+            return true;
+        } else if (arg == "--apexc" && i + 1 < argc) {
+            opts.apexc = argv[++i];
+        } else if (arg == "--sizes" && i + 1 < argc) {
+            opts.sizes.clear();
+            std::stringstream list(argv[++i]);
+            for (std::string item; std::getline(list, item, ',');) {
+                unsigned size = 0;
+                if (!parse_unsigned(item, size) || size == 0) return false;
+                opts.sizes.push_back(size);
+            }
+        } else if (arg == "--repeat" && i + 1 < argc) {
+            if (!parse_unsigned(argv[++i], opts.repeat) || opts.repeat == 0) return false;
+        } else if (arg.size() == 3 && arg[0] == '-' && arg[1] == 'O' && arg[2] >= '0' && arg[2] <= '3') {
+            opts.opt_level = arg[2] - '0';
+        } else if (arg == "--seed" && i + 1 < argc) {
+            char* end = nullptr;
+            opts.generator.seed = std::strtoull(argv[++i], &end, 10);
+        } else if (arg == "--depth" && i + 1 < argc) {
+            if (!parse_unsigned(argv[++i], opts.generator.expr_depth)) return false;
+        } else if (arg == "--arms" && i + 1 < argc) {
+            if (!parse_unsigned(argv[++i], opts.generator.match_arms)) return false;
+        } else if (arg == "--work-dir" && i + 1 < argc) {
+            opts.work_dir = argv[++i];
+        } else if (arg == "-o" && i + 1 < argc) {
+            opts.output_file = argv[++i];
+        } else if (arg == "--baseline" && i + 1 < argc) {
+            opts.baseline_file = argv[++i];
+        } else if (arg == "--threshold" && i + 1 < argc) {
+            opts.threshold = std::strtod(argv[++i], nullptr);
+        } else {
+            std::cerr << "Unknown option: " << arg << std::endl;
+            return false;
+        }
+    }
+    return true;
+}
+
+// apexc prints the -ftime-report/-fmem-report JSON last, after any warnings
+bool extract_report(const std::string& output, JsonValue& report, std::string& error) {
+    size_t start = output.rfind("{\n  \"file\":");
+    if (start == std::string::npos) {
+        error = "no report in the compiler's output";
+        return false;
+    }
+    return apex::bench::parse_json(output.substr(start), report, error);
+}
+
+bool measure(const BenchOptions& opts, unsigned functions, SizeResult& result) {
+    apex::bench::GeneratorOptions generator = opts.generator;
+    generator.functions = functions;
+    auto program = apex::bench::generate_program(generator);
+
+    std::string stem = (fs::path(opts.work_dir) / ("bench_" + std::to_string(functions))).string();
+    if (!apex::bench::write_file(stem + ".apx", program.source)) {
+        std::cerr << "Failed to write output file: " << stem << ".apx" << std::endl;
+        return false;
+    }
+    result.functions = functions;
+    result.lines = program.lines;
+    result.group_ms.assign(phase_groups().size(), std::numeric_limits<double>::max());
+
+    std::string command = apex::bench::shell_quote(opts.apexc) + " -O" + std::to_string(opts.opt_level) +
+                          " -ftime-report=json -fmem-report=json -o " + apex::bench::shell_quote(stem + ".o") +
+                          " " + apex::bench::shell_quote(stem + ".apx");
+    for (unsigned run = 0; run < opts.repeat; run++) {
+        std::string output;
+        int status = apex::bench::run_command(command, output);
+        if (status != 0) {
+            std::cerr << "Compiling " << stem << ".apx failed (status " << status << "):\n" << output;
+            return false;
+        }
+        JsonValue report;
+        std::string error;
+        if (!extract_report(output, report, error)) {
+            std::cerr << "Unreadable report for " << stem << ".apx: " << error << std::endl;
+            return false;
+        }
+
+        std::map<std::string, const JsonValue*> phases;
+        uint64_t peak_rss = 0;
+        for (const auto& phase : report["phases"].array) {
+            phases[phase["name"].string] = &phase;
+            peak_rss = std::max(peak_rss, static_cast<uint64_t>(phase["peak_rss_bytes"].number_or(0)));
+        }
+        for (size_t g = 0; g < phase_groups().size(); g++) {
+            double ms = 0;
+            for (const auto& name : phase_groups()[g].phases) {
+                if (phases.count(name)) ms += (*phases[name])["wall_ms"].number_or(0);
+            }
+            result.group_ms[g] = std::min(result.group_ms[g], ms);
+        }
+        result.total_ms = std::min(result.total_ms, report["total_ms"].number_or(0));
+        result.peak_rss_bytes = std::min(result.peak_rss_bytes, peak_rss);
+        result.tokens = static_cast<uint64_t>(report["counts"]["tokens"].number_or(0));
+    }
+    return true;
+}
+
+double per_second(double amount, double ms) {
+    return ms > 0 ? amount * 1000 / ms : 0;
+}
+
+// Percent change from `base` to `value`, rounded to the 0.1 shown so noise doesn't print as -0.0
+double percent_change(double value, double base) {
+    return std::round((value / base - 1) * 1000) / 10 + 0.0;
+}
+
+std::string results_json(const BenchOptions& opts, const std::vector<SizeResult>& results) {
+    std::ostringstream json;
+    json << std::fixed << std::setprecision(3);
+    json << "{\n  \"benchmark\": \"apexc-compile\",\n"
+         << "  \"generator\": {\"seed\": " << opts.generator.seed << ", \"depth\": " << opts.generator.expr_depth
+         << ", \"arms\": " << opts.generator.match_arms << "},\n"
+         << "  \"opt_level\": " << opts.opt_level << ",\n  \"sizes\": [";
+    for (size_t i = 0; i < results.size(); i++) {
+        const SizeResult& r = results[i];
+        json << (i ? ",\n" : "\n") << "    {\"functions\": " << r.functions << ", \"lines\": " << r.lines
+             << ", \"tokens\": " << r.tokens << ", \"peak_rss_bytes\": " << r.peak_rss_bytes
+             << ", \"total_ms\": " << r.total_ms << ",\n     \"phases\": {";
+        for (size_t g = 0; g < phase_groups().size(); g++) {
+            double ms = r.group_ms[g];
+            json << (g ? ", " : "") << "\"" << phase_groups()[g].name << "\": {\"ms\": " << ms
+                 << ", \"lines_per_s\": " << per_second(r.lines, ms) << ", \"tokens_per_s\": "
+                 << per_second(static_cast<double>(r.tokens), ms) << "}";
+        }
+        json << "}}";
+    }
+    json << "\n  ]\n}\n";
+    return json.str();
+}
+
+void print_table(const std::vector<SizeResult>& results) {
+    std::cout << std::fixed << std::setprecision(1);
+    std::cout << std::left << std::setw(10) << "functions" << std::right << std::setw(9) << "lines"
+              << std::setw(10) << "tokens" << std::setw(10) << "RSS MiB" << std::setw(11) << "total ms";
+    for (const auto& group : phase_groups()) std::cout << std::setw(13) << (std::string(group.name) + " kl/s");
+    std::cout << "\n";
+    for (const auto& r : results) {
+        std::cout << std::left << std::setw(10) << r.functions << std::right << std::setw(9) << r.lines
+                  << std::setw(10) << r.tokens << std::setw(10) << r.peak_rss_bytes / (1024.0 * 1024.0)
+                  << std::setw(11) << r.total_ms;
+        for (double ms : r.group_ms) std::cout << std::setw(13) << per_second(r.lines, ms) / 1000;
+        std::cout << "\n";
+    }
+}
+
+// Throughput may drop, and peak RSS grow, by the threshold before it counts
+// as a regression. Sizes whose generated program differs from the
+// baseline's aren't compared.
+bool compare_with_baseline(const BenchOptions& opts, const std::vector<SizeResult>& results) {
+    std::string text;
+    if (!apex::bench::read_file(opts.baseline_file, text)) {
+        std::cout << "\nNo baseline at " << opts.baseline_file << "; write one with -o" << std::endl;
+        return true;
+    }
+    JsonValue baseline;
+    std::string error;
+    if (!apex::bench::parse_json(text, baseline, error)) {
+        std::cerr << "Unreadable baseline " << opts.baseline_file << ": " << error << std::endl;
+        return false;
+    }
+    if (baseline["opt_level"].number_or(-1) != opts.opt_level) {
+        std::cout << "\nBaseline was measured at another -O level; not compared" << std::endl;
+        return true;
+    }
+
+    bool ok = true;
+    double allowed = opts.threshold / 100;
+    std::cout << "\nAgainst " << opts.baseline_file << " (threshold " << opts.threshold << "%):\n";
+    for (const auto& r : results) {
+        const JsonValue* base = nullptr;
+        for (const auto& entry : baseline["sizes"].array) {
+            if (entry["functions"].number_or(0) == r.functions) base = &entry;
+        }
+        if (!base) continue;
+        if ((*base)["lines"].number_or(0) != r.lines || (*base)["tokens"].number_or(0) != r.tokens) {
+            std::cout << "  " << r.functions << " functions: generated program changed; not compared\n";
+            continue;
+        }
+
+        std::cout << "  " << r.functions << " functions:";
+        for (size_t g = 0; g < phase_groups().size(); g++) {
+            const JsonValue& phase = (*base)["phases"][phase_groups()[g].name];
+            double base_rate = phase["lines_per_s"].number_or(0);
+            double rate = per_second(r.lines, r.group_ms[g]);
+            if (base_rate <= 0) continue;
+            double change = percent_change(rate, base_rate);
+            bool judged = phase["ms"].number_or(0) >= MIN_JUDGED_MS;
+            bool regressed = judged && rate < base_rate * (1 - allowed);
+            std::cout << " " << phase_groups()[g].name << " " << std::showpos << change << std::noshowpos << "%"
+                      << (regressed ? " REGRESSION" : judged ? "" : " (too short)");
+            ok &= !regressed;
+        }
+        double base_rss = (*base)["peak_rss_bytes"].number_or(0);
+        if (base_rss > 0) {
+            double change = percent_change(r.peak_rss_bytes, base_rss);
+            bool regressed = r.peak_rss_bytes > base_rss * (1 + allowed);
+            std::cout << ", RSS " << std::showpos << change << std::noshowpos << "%" << (regressed ? " REGRESSION" : "");
+            ok &= !regressed;
+        }
+        std::cout << "\n";
+    }
+    return ok;
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+    BenchOptions opts;
+    bool help = false;
+    if (!parse_args(argc, argv, opts, help) || help) {
+        print_usage(argv[0]);
+        return help ? 0 : 1;
+    }
+
+    std::error_code ec;
+    fs::create_directories(opts.work_dir, ec);
+    if (ec) {
+        std::cerr << "Error: Could not create work directory: " << opts.work_dir << std::endl;
+        return 1;
+    }
+
+    std::vector<SizeResult> results;
+    for (unsigned size : opts.sizes) {
+        SizeResult result;
+        if (!measure(opts, size, result)) return 1;
+        results.push_back(result);
+    }
+    print_table(results);
+
+    if (!opts.output_file.empty() && !apex::bench::write_file(opts.output_file, results_json(opts, results))) {
+        std::cerr << "Failed to write output file: " << opts.output_file << std::endl;
+        return 1;
+    }
+    if (!opts.baseline_file.empty() && !compare_with_baseline(opts, results)) return 1;
+    return 0;
+}
@@ -0,0 +1,73 @@
+// apex-bench-gen: writes one generated benchmark program
+#include "Generator.h"
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <string>
+
+namespace {
+
+void print_usage(const char* program_name) {
+    std::cout << "Usage: " << program_name << " [options]\n"
+              << "\nOptions:\n"
+              << "  --functions <n>    Number of functions (default 100)\n"
+              << "  --structs <n>      Number of structs (default: functions / 4)\n"
+              << "  --depth <n>        Expression nesting per function (default 24)\n"
+              << "  --arms <n>         Match arms per function (default 16)\n"
+              << "  --seed <n>         PRNG seed (default 1)\n"
+              << "  -o <file>          Write the program to <file> instead of stdout\n";
+}
+
+bool parse_number(const char* value, uint64_t& number) {
+    char* end = nullptr;
+    number = std::strtoull(value, &end, 10);
+    if (*value == '\0' || *end != '\0') {
+        std::cerr << "Invalid number: " << value << std::endl;
+        return false;
+    }
+    return true;
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+    apex::bench::GeneratorOptions opts;
+    std::string output_file;
+
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        uint64_t number = 0;
+        if (arg == "-h" || arg == "--help") {
+            print_usage(argv[0]);
+            return 0;
+        } else if (arg == "-o" && i + 1 < argc) {
+            output_file = argv[++i];
+        } else if ((arg == "--functions" || arg == "--structs" || arg == "--depth" || arg == "--arms" ||
+                    arg == "--seed") && i + 1 < argc) {
+            if (!parse_number(argv[++i], number)) return 1;
+            if (arg == "--functions") opts.functions = static_cast<unsigned>(number);
+            else if (arg == "--structs") opts.structs = static_cast<unsigned>(number);
+            else if (arg == "--depth") opts.expr_depth = static_cast<unsigned>(number);
+            else if (arg == "--arms") opts.match_arms = static_cast<unsigned>(number);
+            else opts.seed = number;
+        } else {
+            std::cerr << "Unknown option: " << arg << std::endl;
+            print_usage(argv[0]);
+            return 1;
+        }
+    }
+
+    auto program = apex::bench::generate_program(opts);
+    if (output_file.empty()) {
+        std::cout << program.source;
+        return 0;
+    }
+    std::ofstream out(output_file);
+    out << program.source;
+    if (!out) {
+        std::cerr << "Failed to write output file: " << output_file << std::endl;
+        return 1;
+    }
+    return 0;
+}
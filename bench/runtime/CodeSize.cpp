@@ -0,0 +1,40 @@
+#include "CodeSize.h"
+#include "../common/Process.h"
+#include <cstring>
+#include <elf.h>
+
+namespace apex::bench {
+
+bool code_size(const std::string& path, uint64_t& bytes, std::string& error) {
+    std::string contents;
+    if (!read_file(path, contents)) {
+        error = "could not read " + path;
+        return false;
+    }
+    Elf64_Ehdr header;
+    if (contents.size() < sizeof(header)) {
+        error = path + " is not an ELF file";
+        return false;
+    }
+    std::memcpy(&header, contents.data(), sizeof(header));
+    if (std::memcmp(header.e_ident, ELFMAG, SELFMAG) != 0 || header.e_ident[EI_CLASS] != ELFCLASS64 ||
+        header.e_ident[EI_DATA] != ELFDATA2LSB) {
+        error = path + " is not a little-endian ELF64 file";
+        return false;
+    }
+    if (header.e_shentsize != sizeof(Elf64_Shdr) ||
+        header.e_shoff + static_cast<uint64_t>(header.e_shnum) * sizeof(Elf64_Shdr) > contents.size()) {
+        error = path + " has a malformed section table";
+        return false;
+    }
+
+    bytes = 0;
+    for (unsigned i = 0; i < header.e_shnum; i++) {
+        Elf64_Shdr section;
+        std::memcpy(&section, contents.data() + header.e_shoff + i * sizeof(Elf64_Shdr), sizeof(section));
+        if (section.sh_flags & SHF_EXECINSTR) bytes += section.sh_size;
+    }
+    return true;
+}
+
+} // namespace apex::bench
@@ -0,0 +1,13 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+
+namespace apex::bench {
+
+// Bytes in the executable sections of the ELF64 object at `path`: the
+// generated code, without symbols, relocations, data or debug info.
+// False, with `error` set, if it isn't a little-endian ELF64 file.
+bool code_size(const std::string& path, uint64_t& bytes, std::string& error);
+
+} // namespace apex::bench
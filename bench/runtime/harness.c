@@ -0,0 +1,92 @@
+// Times one kernel. Linked once against each Apex kernel and once against its
+// C reference, so both are called and measured the same way.
+//
+//   usage: harness <n> <runs>
+//
+// Prints one JSON object: the kernel's result, and the fastest run's time and
+// user-space instructions retired (-1 when perf events aren't available).
+#define _GNU_SOURCE
+#include <inttypes.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#ifdef __linux__
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+int64_t apex_kernel(int64_t n);
+
+static int open_instruction_counter(void) {
+#ifdef __linux__
+    struct perf_event_attr attr;
+    memset(&attr, 0, sizeof(attr));
+    attr.type = PERF_TYPE_HARDWARE;
+    attr.size = sizeof(attr);
+    attr.config = PERF_COUNT_HW_INSTRUCTIONS;
+    attr.disabled = 1;
+    attr.exclude_kernel = 1;
+    attr.exclude_hv = 1;
+    return (int)syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0);
+#else
+    return -1;
+#endif
+}
+
+static int64_t now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (int64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+int main(int argc, char** argv) {
+    if (argc != 3) {
+        fprintf(stderr, "usage: %s <n> <runs>\n", argv[0]);
+        return 2;
+    }
+    int64_t n = strtoll(argv[1], NULL, 10);
+    int runs = atoi(argv[2]);
+    if (runs < 1) runs = 1;
+
+    int counter = open_instruction_counter();
+    int64_t result = apex_kernel(n);     // Warm-up; also the result every run must match
+    int64_t best_ns = INT64_MAX;
+    int64_t best_instructions = -1;
+
+    for (int run = 0; run < runs; run++) {
+#ifdef __linux__
+        if (counter >= 0) {
+            ioctl(counter, PERF_EVENT_IOC_RESET, 0);
+            ioctl(counter, PERF_EVENT_IOC_ENABLE, 0);
+        }
+#endif
+        int64_t start = now_ns();
+        int64_t value = apex_kernel(n);
+        int64_t elapsed = now_ns() - start;
+        int64_t instructions = -1;
+#ifdef __linux__
+        if (counter >= 0) {
+            ioctl(counter, PERF_EVENT_IOC_DISABLE, 0);
+            uint64_t count = 0;
+            if (read(counter, &count, sizeof(count)) == (ssize_t)sizeof(count)) instructions = (int64_t)count;
+        }
+#endif
+        if (value != result) {
+            fprintf(stderr, "run %d returned %" PRId64 ", expected %" PRId64 "\n", run, value, result);
+            return 1;
+        }
+        if (elapsed < best_ns) best_ns = elapsed;
+        if (instructions >= 0 && (best_instructions < 0 || instructions < best_instructions)) {
+            best_instructions = instructions;
+        }
+    }
+
+    printf("{\"result\": %" PRId64 ", \"ns\": %" PRId64 ", \"instructions\": %" PRId64 "}\n",
+           result, best_ns, best_instructions);
+    return 0;
+}
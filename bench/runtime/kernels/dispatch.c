@@ -0,0 +1,25 @@
+// Kernel: switch dispatch over a pseudo-random instruction stream
+#include <stdint.h>
+
+static int64_t exec(int64_t op, int64_t acc, int64_t x) {
+    switch (op) {
+        case 0: return acc + x;
+        case 1: return acc - x;
+        case 2: return acc ^ x;
+        case 3: return acc * 3;
+        case 4: return acc >> 1;
+        case 5: return acc | (x & 255);
+        case 6: return acc + (x >> 4);
+        default: return acc + 1;
+    }
+}
+
+int64_t apex_kernel(int64_t n) {
+    int64_t state = 12345;
+    int64_t acc = 0;
+    for (int64_t i = 0; i < n; i++) {
+        state = (state * 1103515245 + 12345) & 2147483647;
+        acc = exec((state >> 16) & 7, acc, i) & 4294967295;
+    }
+    return acc;
+}
@@ -0,0 +1,12 @@
+// Kernel: nested counted loops over integer arithmetic
+#include <stdint.h>
+
+int64_t apex_kernel(int64_t n) {
+    int64_t acc = 0;
+    for (int64_t i = 0; i < n; i++) {
+        for (int64_t j = 0; j < n; j++) {
+            acc = acc + ((i * j) ^ (i + j)) % 7;
+        }
+    }
+    return acc;
+}
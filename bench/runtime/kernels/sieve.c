@@ -0,0 +1,21 @@
+// Kernel: sieve of Eratosthenes over a heap buffer
+#include <stdint.h>
+#include <stdlib.h>
+
+int64_t apex_kernel(int64_t n) {
+    uint8_t* flags = malloc((uint64_t)n);
+    for (int64_t i = 0; i < n; i++) {
+        flags[i] = 1;
+    }
+    int64_t sum = 0;
+    for (int64_t i = 2; i < n; i++) {
+        if (flags[i] == 1) {
+            sum = sum + i;
+            for (int64_t j = i * i; j < n; j += i) {
+                flags[j] = 0;
+            }
+        }
+    }
+    free(flags);
+    return sum;
+}
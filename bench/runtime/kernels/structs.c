@@ -0,0 +1,33 @@
+// Kernel: struct values passed, returned and updated through pointers
+#include <stdint.h>
+
+typedef struct { int64_t x, y; } Vec2;
+typedef struct { Vec2 pos, vel; } Body;
+
+static Vec2 add(Vec2 a, Vec2 b) {
+    return (Vec2){ a.x + b.x, a.y + b.y };
+}
+
+static void step(Body* b, int64_t bound) {
+    b->pos = add(b->pos, b->vel);
+    if (b->pos.x < 0 || b->pos.x > bound) {
+        b->vel.x = 0 - b->vel.x;
+    }
+    if (b->pos.y < 0 || b->pos.y > bound) {
+        b->vel.y = 0 - b->vel.y;
+    }
+}
+
+int64_t apex_kernel(int64_t n) {
+    Body a = { { 1, 2 }, { 3, 5 } };
+    Body b = { { 500, 700 }, { -7, 2 } };
+    int64_t hits = 0;
+    for (int64_t i = 0; i < n; i++) {
+        step(&a, 1000);
+        step(&b, 1000);
+        if (a.pos.x == b.pos.x) {
+            hits = hits + i;
+        }
+    }
+    return hits + a.pos.x + a.pos.y * 3 + b.pos.x * 5 + b.pos.y * 7;
+}
@@ -0,0 +1,409 @@
+// apex-bench-runtime: speed and code size of Apex kernels against their C
+// references, at each optimization level, compared against a stored baseline
+#include "CodeSize.h"
+#include "../common/Json.h"
+#include "../common/Process.h"
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <filesystem>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+namespace {
+
+namespace fs = std::filesystem;
+using apex::bench::JsonValue;
+using apex::bench::shell_quote;
+
+struct RuntimeOptions {
+    std::string apexc{"./build/src/apexc/apexc"};
+    std::string cc{"clang"};
+    std::string kernel_dir{"bench/runtime/kernels"};
+    std::string harness{"bench/runtime/harness.c"};
+    std::vector<std::string> only;      // Kernel names; empty runs them all
+    std::vector<unsigned> levels{0, 1, 2, 3};
+    unsigned runs{5};
+    std::string work_dir{"bench-work/runtime"};
+    std::string output_file;
+    std::string baseline_file;
+    double threshold{10};               // Percent
+};
+
+struct Kernel {
+    std::string name;
+    std::string apex_source;
+    std::string c_source;
+    int64_t n{0};                       // From the `// N:` line
+};
+
+// One build of a kernel, by apexc or by the C compiler
+struct Measurement {
+    double ms{0};                       // Fastest run
+    int64_t instructions{-1};           // Of that run; -1 without perf events
+    uint64_t code_bytes{0};
+};
+
+struct KernelResult {
+    std::string name;
+    int64_t n{0};
+    unsigned level{0};
+    int64_t result{0};
+    Measurement apex;
+    Measurement c;
+};
+
+// Runs shorter than this in the baseline are too noisy to judge by time
+constexpr double MIN_JUDGED_MS = 5;
+
+void print_usage(const char* program_name) {
+    std::cout << "Usage: " << program_name << " [options]\n"
+              << "\nOptions:\n"
+              << "  --apexc <path>     Compiler to measure (default ./build/src/apexc/apexc)\n"
+              << "  --cc <path>        C compiler for the references and the harness (default clang)\n"
+              << "  --kernels <dir>    Directory of kernel.apx/kernel.c pairs (default bench/runtime/kernels)\n"
+              << "  --harness <file>   Timing harness linked with every build (default bench/runtime/harness.c)\n"
+              << "  --only <name,...>  Run just these kernels\n"
+              << "  --levels <n,...>   Optimization levels (default 0,1,2,3)\n"
+              << "  --runs <n>         Timed runs per build; the fastest counts (default 5)\n"
+              << "  --work-dir <dir>   Where objects and executables are written (default bench-work/runtime)\n"
+              << "  -o <file>          Write the results as JSON (e.g. to update the baseline)\n"
+              << "  --baseline <file>  Compare against earlier results; exit 1 on a regression\n"
+              << "  --threshold <pct>  Allowed growth in time, instructions or code size (default 10)\n";
+}
+
+bool parse_unsigned(const std::string& value, unsigned& number) {
+    char* end = nullptr;
+    unsigned long parsed = std::strtoul(value.c_str(), &end, 10);
+    if (value.empty() || *end != '\0') {
+        std::cerr << "Invalid number: " << value << std::endl;
+        return false;
+    }
+    number = static_cast<unsigned>(parsed);
+    return true;
+}
+
+std::vector<std::string> split_list(const std::string& text) {
+    std::vector<std::string> items;
+    std::stringstream list(text);
+    for (std::string item; std::getline(list, item, ',');) {
+        if (!item.empty()) items.push_back(item);
+    }
+    return items;
+}
+
+bool parse_args(int argc, char** argv, RuntimeOptions& opts, bool& help) {
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        if (arg == "-h" || arg == "--help") {
+            help = true;
+            return true;
+        } else if (arg == "--apexc" && i + 1 < argc) {
+            opts.apexc = argv[++i];
+        } else if (arg == "--cc" && i + 1 < argc) {
+            opts.cc = argv[++i];
+        } else if (arg == "--kernels" && i + 1 < argc) {
+            opts.kernel_dir = argv[++i];
+        } else if (arg == "--harness" && i + 1 < argc) {
+            opts.harness = argv[++i];
+        } else if (arg == "--only" && i + 1 < argc) {
+            opts.only = split_list(argv[++i]);
+        } else if (arg == "--levels" && i + 1 < argc) {
+            opts.levels.clear();
+            for (const auto& item : split_list(argv[++i])) {
+                unsigned level = 0;
+                if (!parse_unsigned(item, level) || level > 3) return false;
+                opts.levels.push_back(level);
+            }
+        } else if (arg == "--runs" && i + 1 < argc) {
+            if (!parse_unsigned(argv[++i], opts.runs) || opts.runs == 0) return false;
+        } else if (arg == "--work-dir" && i + 1 < argc) {
+            opts.work_dir = argv[++i];
+        } else if (arg == "-o" && i + 1 < argc) {
+            opts.output_file = argv[++i];
+        } else if (arg == "--baseline" && i + 1 < argc) {
+            opts.baseline_file = argv[++i];
+        } else if (arg == "--threshold" && i + 1 < argc) {
+            opts.threshold = std::strtod(argv[++i], nullptr);
+        } else {
+            std::cerr << "Unknown option: " << arg << std::endl;
+            return false;
+        }
+    }
+    return true;
+}
+
+// Every kernel.apx with a kernel.c beside it, by name
+bool find_kernels(const RuntimeOptions& opts, std::vector<Kernel>& kernels) {
+    std::error_code ec;
+    for (const auto& entry : fs::directory_iterator(opts.kernel_dir, ec)) {
+        if (entry.path().extension() != ".apx") continue;
+        Kernel kernel;
+        kernel.name = entry.path().stem().string();
+        if (!opts.only.empty() && std::find(opts.only.begin(), opts.only.end(), kernel.name) == opts.only.end()) {
+            continue;
+        }
+        kernel.apex_source = entry.path().string();
+        kernel.c_source = fs::path(entry.path()).replace_extension(".c").string();
+        if (!fs::exists(kernel.c_source)) {
+            std::cerr << "Error: " << kernel.name << " has no C reference at " << kernel.c_source << std::endl;
+            return false;
+        }
+
+        std::string source;
+        apex::bench::read_file(kernel.apex_source, source);
+        size_t marker = source.find("// N:");
+        if (marker == std::string::npos) {
+            std::cerr << "Error: " << kernel.apex_source << " has no '// N:' line" << std::endl;
+            return false;
+        }
+        kernel.n = std::strtoll(source.c_str() + marker + 5, nullptr, 10);
+        kernels.push_back(kernel);
+    }
+    if (ec) {
+        std::cerr << "Error: Could not read kernel directory: " << opts.kernel_dir << std::endl;
+        return false;
+    }
+    std::sort(kernels.begin(), kernels.end(), [](const Kernel& a, const Kernel& b) { return a.name < b.name; });
+    return true;
+}
+
+bool run_step(const std::string& what, const std::string& command) {
+    std::string output;
+    int status = apex::bench::run_command(command, output);
+    if (status != 0) {
+        std::cerr << what << " failed (status " << status << "):\n" << output;
+        return false;
+    }
+    return true;
+}
+
+// Links `object` with the harness, runs it and reads back what it measured
+bool run_kernel(const RuntimeOptions& opts, const Kernel& kernel, const std::string& harness,
+                const std::string& object, Measurement& measurement, int64_t& result) {
+    std::string error;
+    if (!apex::bench::code_size(object, measurement.code_bytes, error)) {
+        std::cerr << "Error: " << error << std::endl;
+        return false;
+    }
+
+    std::string executable = fs::path(object).replace_extension("").string();
+    if (!run_step("Linking " + executable,
+                  shell_quote(opts.cc) + " " + shell_quote(harness) + " " + shell_quote(object) + " -o " +
+                      shell_quote(executable))) {
+        return false;
+    }
+
+    std::string output;
+    std::string command = shell_quote(executable) + " " + std::to_string(kernel.n) + " " + std::to_string(opts.runs);
+    int status = apex::bench::run_command(command, output);
+    JsonValue report;
+    if (status != 0 || !apex::bench::parse_json(output, report, error)) {
+        std::cerr << "Running " << executable << " failed (status " << status << "):\n" << output;
+        return false;
+    }
+    result = static_cast<int64_t>(report["result"].number_or(0));
+    measurement.ms = report["ns"].number_or(0) / 1e6;
+    measurement.instructions = static_cast<int64_t>(report["instructions"].number_or(-1));
+    return true;
+}
+
+bool measure(const RuntimeOptions& opts, const Kernel& kernel, unsigned level, const std::string& harness,
+             KernelResult& result) {
+    std::string level_flag = "-O" + std::to_string(level);
+    std::string stem = (fs::path(opts.work_dir) / (kernel.name + level_flag)).string();
+    std::string apex_object = stem + "-apex.o";
+    std::string c_object = stem + "-c.o";
+    if (!run_step("Compiling " + kernel.apex_source + " at " + level_flag,
+                  shell_quote(opts.apexc) + " " + level_flag + " -o " + shell_quote(apex_object) + " " +
+                      shell_quote(kernel.apex_source)) ||
+        !run_step("Compiling " + kernel.c_source + " at " + level_flag,
+                  shell_quote(opts.cc) + " " + level_flag + " -c -o " + shell_quote(c_object) + " " +
+                      shell_quote(kernel.c_source))) {
+        return false;
+    }
+
+    result.name = kernel.name;
+    result.n = kernel.n;
+    result.level = level;
+    int64_t c_result = 0;
+    if (!run_kernel(opts, kernel, harness, apex_object, result.apex, result.result) ||
+        !run_kernel(opts, kernel, harness, c_object, result.c, c_result)) {
+        return false;
+    }
+    if (result.result != c_result) {
+        std::cerr << "Error: " << kernel.name << " at " << level_flag << " returned " << result.result
+                  << ", but the C reference returned " << c_result << std::endl;
+        return false;
+    }
+    return true;
+}
+
+// Percent change from `base` to `value`, rounded to the 0.1 shown so noise doesn't print as -0.0
+double percent_change(double value, double base) {
+    return std::round((value / base - 1) * 1000) / 10 + 0.0;
+}
+
+std::string measurement_json(const Measurement& m) {
+    std::ostringstream json;
+    json << std::fixed << std::setprecision(3) << "{\"ms\": " << m.ms << ", \"instructions\": " << m.instructions
+         << ", \"code_bytes\": " << m.code_bytes << "}";
+    return json.str();
+}
+
+std::string results_json(const RuntimeOptions& opts, const std::vector<KernelResult>& results) {
+    std::ostringstream json;
+    json << "{\n  \"benchmark\": \"apex-runtime\",\n  \"runs\": " << opts.runs << ",\n  \"kernels\": [";
+    for (size_t i = 0; i < results.size(); i++) {
+        const KernelResult& r = results[i];
+        json << (i ? ",\n" : "\n") << "    {\"name\": " << apex::bench::json_quote(r.name) << ", \"n\": " << r.n
+             << ", \"opt_level\": " << r.level << ", \"result\": " << r.result
+             << ",\n     \"apex\": " << measurement_json(r.apex) << ",\n     \"c\": " << measurement_json(r.c) << "}";
+    }
+    json << "\n  ]\n}\n";
+    return json.str();
+}
+
+// "1.23x", or "-" when either side is missing
+std::string ratio(double apex, double c) {
+    if (apex <= 0 || c <= 0) return "-";
+    std::ostringstream text;
+    text << std::fixed << std::setprecision(2) << apex / c << "x";
+    return text.str();
+}
+
+void print_table(const std::vector<KernelResult>& results) {
+    std::cout << std::fixed << std::setprecision(2);
+    std::cout << std::left << std::setw(12) << "kernel" << std::setw(5) << "opt" << std::right << std::setw(11)
+              << "apex ms" << std::setw(11) << "c ms" << std::setw(8) << "time" << std::setw(12) << "apex Minst"
+              << std::setw(12) << "c Minst" << std::setw(8) << "inst" << std::setw(11) << "apex code" << std::setw(9)
+              << "c code" << std::setw(8) << "code" << "\n";
+    for (const auto& r : results) {
+        auto minst = [](int64_t instructions) {
+            if (instructions < 0) return std::string("-");
+            std::ostringstream text;
+            text << std::fixed << std::setprecision(1) << instructions / 1e6;
+            return text.str();
+        };
+        std::cout << std::left << std::setw(12) << r.name << std::setw(5) << ("-O" + std::to_string(r.level))
+                  << std::right << std::setw(11) << r.apex.ms << std::setw(11) << r.c.ms << std::setw(8)
+                  << ratio(r.apex.ms, r.c.ms) << std::setw(12) << minst(r.apex.instructions) << std::setw(12)
+                  << minst(r.c.instructions) << std::setw(8)
+                  << ratio(static_cast<double>(r.apex.instructions), static_cast<double>(r.c.instructions))
+                  << std::setw(11) << r.apex.code_bytes << std::setw(9) << r.c.code_bytes << std::setw(8)
+                  << ratio(static_cast<double>(r.apex.code_bytes), static_cast<double>(r.c.code_bytes)) << "\n";
+    }
+}
+
+// The Apex side of each kernel may get slower, or its code bigger, by the
+// threshold before it counts as a regression. Instructions retired are
+// judged when both runs counted them, since they hardly vary between runs;
+// otherwise wall time is. Kernels whose N changed aren't compared.
+bool compare_with_baseline(const RuntimeOptions& opts, const std::vector<KernelResult>& results) {
+    std::string text;
+    if (!apex::bench::read_file(opts.baseline_file, text)) {
+        std::cout << "\nNo baseline at " << opts.baseline_file << "; write one with -o" << std::endl;
+        return true;
+    }
+    JsonValue baseline;
+    std::string error;
+    if (!apex::bench::parse_json(text, baseline, error)) {
+        std::cerr << "Unreadable baseline " << opts.baseline_file << ": " << error << std::endl;
+        return false;
+    }
+
+    bool ok = true;
+    double allowed = opts.threshold / 100;
+    std::cout << std::setprecision(1) << "\nAgainst " << opts.baseline_file << " (threshold " << opts.threshold << "%):\n";
+    for (const auto& r : results) {
+        const JsonValue* base = nullptr;
+        for (const auto& entry : baseline["kernels"].array) {
+            if (entry["name"].string == r.name && entry["opt_level"].number_or(-1) == r.level) base = &entry;
+        }
+        if (!base) continue;
+        std::cout << "  " << std::left << std::setw(12) << r.name << std::setw(4) << ("-O" + std::to_string(r.level))
+                  << std::right;
+        if ((*base)["n"].number_or(0) != r.n) {
+            std::cout << " N changed; not compared\n";
+            continue;
+        }
+
+        const JsonValue& apex = (*base)["apex"];
+        double base_instructions = apex["instructions"].number_or(-1);
+        if (base_instructions > 0 && r.apex.instructions > 0) {
+            bool regressed = r.apex.instructions > base_instructions * (1 + allowed);
+            std::cout << " instructions " << std::showpos
+                      << percent_change(static_cast<double>(r.apex.instructions), base_instructions)
+                      << std::noshowpos << "%" << (regressed ? " REGRESSION" : "");
+            ok &= !regressed;
+        } else if (apex["ms"].number_or(0) > 0) {
+            double base_ms = apex["ms"].number_or(0);
+            bool judged = base_ms >= MIN_JUDGED_MS;
+            bool regressed = judged && r.apex.ms > base_ms * (1 + allowed);
+            std::cout << " time " << std::showpos << percent_change(r.apex.ms, base_ms) << std::noshowpos << "%"
+                      << (regressed ? " REGRESSION" : judged ? "" : " (too short)");
+            ok &= !regressed;
+        }
+        double base_code = apex["code_bytes"].number_or(0);
+        if (base_code > 0) {
+            bool regressed = r.apex.code_bytes > base_code * (1 + allowed);
+            std::cout << ", code " << std::showpos << percent_change(static_cast<double>(r.apex.code_bytes), base_code)
+                      << std::noshowpos << "%" << (regressed ? " REGRESSION" : "");
+            ok &= !regressed;
+        }
+        std::cout << "\n";
+    }
+    return ok;
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+    RuntimeOptions opts;
+    bool help = false;
+    if (!parse_args(argc, argv, opts, help) || help) {
+        print_usage(argv[0]);
+        return help ? 0 : 1;
+    }
+
+    std::error_code ec;
+    fs::create_directories(opts.work_dir, ec);
+    if (ec) {
+        std::cerr << "Error: Could not create work directory: " << opts.work_dir << std::endl;
+        return 1;
+    }
+
+    std::vector<Kernel> kernels;
+    if (!find_kernels(opts, kernels)) return 1;
+    if (kernels.empty()) {
+        std::cerr << "Error: No kernels found in " << opts.kernel_dir << std::endl;
+        return 1;
+    }
+
+    // The harness is the same for every build, so it is compiled once
+    std::string harness = (fs::path(opts.work_dir) / "harness.o").string();
+    if (!run_step("Compiling " + opts.harness,
+                  shell_quote(opts.cc) + " -O2 -c -o " + shell_quote(harness) + " " + shell_quote(opts.harness))) {
+        return 1;
+    }
+
+    std::vector<KernelResult> results;
+    for (const auto& kernel : kernels) {
+        for (unsigned level : opts.levels) {
+            KernelResult result;
+            if (!measure(opts, kernel, level, harness, result)) return 1;
+            results.push_back(result);
+        }
+    }
+    print_table(results);
+
+    if (!opts.output_file.empty() && !apex::bench::write_file(opts.output_file, results_json(opts, results))) {
+        std::cerr << "Failed to write output file: " << opts.output_file << std::endl;
+        return 1;
+    }
+    if (!opts.baseline_file.empty() && !compare_with_baseline(opts, results)) return 1;
+    return 0;
+}
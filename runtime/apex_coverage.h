@@ -0,0 +1,27 @@
+// Counters for programs built with -fcoverage. The program counts every
+// block and branch outcome it runs; libapex_coverage appends the counts to
+// a raw profile when it exits, which `apexc cov report <program> <profile>`
+// turns into line and branch coverage. Appending means repeated runs, and
+// runs of different programs, add up in one file; delete it to start over.
+//
+//   APEX_COVERAGE_FILE   Where the counts go (default apex-coverage.raw); %p
+//                        is replaced with the process ID
+//
+// Counters are plain adds, not atomic: threads running the same code at
+// once can lose counts. Only ELF targets are supported.
+#ifndef APEX_COVERAGE_H
+#define APEX_COVERAGE_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Appends the counts so far to `path` (APEX_COVERAGE_FILE if null) and
+// zeroes them, e.g. for a server that never exits. 0 on success.
+int apex_coverage_dump(const char* path);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,35 @@
+// Hooks that code compiled with -finstrument-functions calls on entry to
+// and return from every function. libapex_profile defines them (weakly) and
+// prints a flat profile when the program exits; a program can define its
+// own instead, in C or in an Apex `extern` block.
+#ifndef APEX_PROFILE_H
+#define APEX_PROFILE_H
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// One per instrumented function, emitted by apexc; its address is the
+// function's ID. The compiler fills in the first three fields and zeroes
+// the rest, which belong to the runtime.
+struct apex_function {
+    const char* name;
+    const char* file;
+    uint32_t line;
+    uint32_t active;                // Calls in progress
+    uint64_t calls;
+    uint64_t self;                  // Cycles in the function itself
+    uint64_t total;                 // Cycles including callees, outermost calls only
+    struct apex_function* next;     // Functions called so far, newest first
+};
+
+void __apex_enter(struct apex_function* fn);
+void __apex_exit(struct apex_function* fn);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,33 @@
+// Live tracing for programs built with -fxray-instrument. Instrumented
+// functions start and end with sleds of NOPs, so tracing costs nothing until
+// libapex_xray patches them. Once patched, every call and return records an
+// event in a per-thread ring buffer; unpatching turns the sleds back into
+// NOPs. The buffers are written out in Chrome trace format (chrome://tracing,
+// ui.perfetto.dev). Patching is only implemented for x86-64 Linux.
+//
+// Turned on and off without recompiling through the environment:
+//   APEX_XRAY=on       Trace from startup
+//   APEX_XRAY=signal   Start and stop tracing on each SIGUSR1
+//   APEX_XRAY_FILE     Where the trace is written at exit (default apex-xray.json)
+// or by the program itself, with the functions below declared in an Apex
+// `extern` block.
+#ifndef APEX_XRAY_H
+#define APEX_XRAY_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// 0 on success; -1 if there are no sleds or they can't be patched. Once
+// started, the trace is also written to APEX_XRAY_FILE at exit.
+int apex_xray_start(void);
+int apex_xray_stop(void);
+
+// Writes the events recorded so far as a Chrome trace; 0 on success
+int apex_xray_dump(const char* path);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,91 @@
+// Writes the -fcoverage counters out. LLVM's InstrProfiling pass puts each
+// function's counters in __llvm_prf_cnts and a record describing them (name
+// hash, function hash, where its counters are) in __llvm_prf_data; the
+// linker gathers both sections from every object. A dump is those two
+// sections as they are, after a header with the addresses they were at, so
+// this file knows nothing of the record layout; apexc, which comes with the
+// LLVM that chose it, decodes them.
+#define _POSIX_C_SOURCE 200809L
+#include "apex_coverage.h"
+
+#include <fcntl.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+extern char __start___llvm_prf_data[] __attribute__((weak, visibility("hidden")));
+extern char __stop___llvm_prf_data[] __attribute__((weak, visibility("hidden")));
+extern char __start___llvm_prf_cnts[] __attribute__((weak, visibility("hidden")));
+extern char __stop___llvm_prf_cnts[] __attribute__((weak, visibility("hidden")));
+
+// Read back by the coverage report (src/apexc/driver/Coverage.cpp)
+struct dump_header {
+    char magic[8];              // "APEXCOV1"
+    uint64_t data_begin;
+    uint64_t data_size;
+    uint64_t counters_begin;
+    uint64_t counters_size;
+};
+
+#define DEFAULT_FILE "apex-coverage.raw"
+
+// `pattern` with %p replaced by the process ID
+static char* expand_path(const char* pattern) {
+    size_t length = strlen(pattern);
+    char* path = malloc(length * 8 + 1);
+    if (!path) return NULL;
+    char* out = path;
+    for (const char* in = pattern; *in; in++) {
+        if (in[0] == '%' && in[1] == 'p') {
+            out += sprintf(out, "%ld", (long)getpid());
+            in++;
+        } else {
+            *out++ = *in;
+        }
+    }
+    *out = '\0';
+    return path;
+}
+
+int apex_coverage_dump(const char* path) {
+    if (!__start___llvm_prf_data || !__start___llvm_prf_cnts) return -1;
+    if (!path) path = getenv("APEX_COVERAGE_FILE");
+    if (!path || !*path) path = DEFAULT_FILE;
+
+    struct dump_header header;
+    memcpy(header.magic, "APEXCOV1", sizeof(header.magic));
+    header.data_begin = (uint64_t)(uintptr_t)__start___llvm_prf_data;
+    header.data_size = (uint64_t)(__stop___llvm_prf_data - __start___llvm_prf_data);
+    header.counters_begin = (uint64_t)(uintptr_t)__start___llvm_prf_cnts;
+    header.counters_size = (uint64_t)(__stop___llvm_prf_cnts - __start___llvm_prf_cnts);
+
+    // One write with O_APPEND, so programs finishing at the same time don't
+    // interleave their dumps
+    size_t size = sizeof(header) + header.data_size + header.counters_size;
+    char* buffer = malloc(size);
+    char* file = expand_path(path);
+    int status = -1;
+    if (buffer && file) {
+        memcpy(buffer, &header, sizeof(header));
+        memcpy(buffer + sizeof(header), __start___llvm_prf_data, header.data_size);
+        memcpy(buffer + sizeof(header) + header.data_size, __start___llvm_prf_cnts, header.counters_size);
+        int fd = open(file, O_WRONLY | O_CREAT | O_APPEND, 0644);
+        if (fd >= 0) {
+            if (write(fd, buffer, size) == (ssize_t)size) status = 0;
+            if (close(fd) != 0) status = -1;
+        }
+        if (status == 0) memset(__start___llvm_prf_cnts, 0, header.counters_size);
+    }
+    if (status != 0) fprintf(stderr, "apex coverage: could not write %s\n", file ? file : path);
+    free(file);
+    free(buffer);
+    return status;
+}
+
+static void dump_at_exit(void) { apex_coverage_dump(NULL); }
+
+__attribute__((constructor)) static void apex_coverage_init(void) {
+    if (__start___llvm_prf_data) atexit(dump_at_exit);
+}
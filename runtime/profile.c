@@ -0,0 +1,123 @@
+// Flat profile for programs built with -finstrument-functions: per function,
+// the calls made and the cycles spent in it, with and without its callees.
+// Counters live in the descriptors apexc emits, so a call costs two counter
+// reads and a few atomic adds; a function joins the report on its first
+// call. The report goes to stderr when the program exits, or to the file
+// named by APEX_PROFILE.
+#include "apex_profile.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#define UNIT "cycles"
+static inline uint64_t now(void) { return __rdtsc(); }
+#elif defined(__aarch64__)
+#define UNIT "ticks"
+static inline uint64_t now(void) {
+    uint64_t ticks;
+    __asm__ volatile("mrs %0, cntvct_el0" : "=r"(ticks));
+    return ticks;
+}
+#else
+#include <time.h>
+#define UNIT "ns"
+static inline uint64_t now(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000u + (uint64_t)ts.tv_nsec;
+}
+#endif
+
+// Calls nested deeper than this on one thread are counted but not timed
+#define MAX_DEPTH 1024
+
+struct frame {
+    struct apex_function* fn;
+    uint64_t start;
+    uint64_t callees;       // Cycles spent in calls made from this one
+    int outermost;          // Not a recursive call, so it adds to `total`
+};
+
+static _Thread_local struct frame stack[MAX_DEPTH];
+static _Thread_local unsigned depth;
+
+static struct apex_function* functions;
+static int report_registered;
+
+static int by_self(const void* a, const void* b) {
+    const struct apex_function* x = *(struct apex_function* const*)a;
+    const struct apex_function* y = *(struct apex_function* const*)b;
+    if (x->self != y->self) return x->self < y->self ? 1 : -1;
+    return strcmp(x->name, y->name);
+}
+
+static void report(void) {
+    size_t count = 0;
+    uint64_t grand_total = 0;
+    for (struct apex_function* fn = functions; fn; fn = fn->next) {
+        count++;
+        grand_total += fn->self;
+    }
+    struct apex_function** sorted = malloc(count * sizeof(*sorted));
+    if (!sorted) return;
+    size_t i = 0;
+    for (struct apex_function* fn = functions; fn; fn = fn->next) sorted[i++] = fn;
+    qsort(sorted, count, sizeof(*sorted), by_self);
+
+    const char* path = getenv("APEX_PROFILE");
+    FILE* out = path && *path ? fopen(path, "w") : stderr;
+    if (!out) {
+        fprintf(stderr, "apex profile: could not open %s\n", path);
+        out = stderr;
+    }
+    fprintf(out, "Apex profile: %zu functions, %llu %s\n", count, (unsigned long long)grand_total, UNIT);
+    fprintf(out, "%7s %18s %18s %12s %12s  %s\n", "self%", "self " UNIT, "total " UNIT, "calls", "self/call",
+            "function");
+    for (i = 0; i < count; i++) {
+        const struct apex_function* fn = sorted[i];
+        double share = grand_total ? 100.0 * (double)fn->self / (double)grand_total : 0.0;
+        fprintf(out, "%6.1f%% %18llu %18llu %12llu %12llu  %s (%s:%u)\n", share, (unsigned long long)fn->self,
+                (unsigned long long)fn->total, (unsigned long long)fn->calls,
+                (unsigned long long)(fn->calls ? fn->self / fn->calls : 0), fn->name, fn->file, fn->line);
+    }
+    if (out != stderr) fclose(out);
+    free(sorted);
+}
+
+static void register_function(struct apex_function* fn) {
+    struct apex_function* head = __atomic_load_n(&functions, __ATOMIC_RELAXED);
+    do {
+        fn->next = head;
+    } while (!__atomic_compare_exchange_n(&functions, &head, fn, 1, __ATOMIC_RELEASE, __ATOMIC_RELAXED));
+    if (!__atomic_exchange_n(&report_registered, 1, __ATOMIC_RELAXED)) atexit(report);
+}
+
+__attribute__((weak)) void __apex_enter(struct apex_function* fn) {
+    if (__atomic_fetch_add(&fn->calls, 1, __ATOMIC_RELAXED) == 0) register_function(fn);
+    uint32_t active = __atomic_fetch_add(&fn->active, 1, __ATOMIC_RELAXED);
+    if (depth < MAX_DEPTH) {
+        struct frame* frame = &stack[depth];
+        frame->fn = fn;
+        frame->callees = 0;
+        frame->outermost = active == 0;
+        frame->start = now();
+    }
+    depth++;
+}
+
+__attribute__((weak)) void __apex_exit(struct apex_function* fn) {
+    uint64_t end = now();
+    __atomic_fetch_sub(&fn->active, 1, __ATOMIC_RELAXED);
+    if (depth == 0) return;     // No matching enter, e.g. the hooks were replaced halfway
+    depth--;
+    if (depth >= MAX_DEPTH) return;
+
+    struct frame* frame = &stack[depth];
+    uint64_t elapsed = end - frame->start;
+    __atomic_fetch_add(&fn->self, elapsed - frame->callees, __ATOMIC_RELAXED);
+    if (frame->outermost) __atomic_fetch_add(&fn->total, elapsed, __ATOMIC_RELAXED);
+    if (depth > 0) stack[depth - 1].callees += elapsed;
+}
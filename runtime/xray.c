@@ -0,0 +1,504 @@
+// Patches the XRay sleds LLVM emits for -fxray-instrument and records what
+// they report. The sleds are listed in the xray_instr_map section, one
+// entry per sled, grouped by function. Functions get IDs from 1 in that
+// order. A patched entry sled reads `mov $id, %r10d; call entry_trampoline`,
+// and a patched exit sled `mov $id, %r10d; jmp exit_trampoline`. The
+// trampolines save the registers the function still needs and hand the ID
+// to record(), which appends to the calling thread's ring buffer. Only the
+// thread owning a ring writes to it, so recording takes no locks.
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE
+#endif
+#include "apex_xray.h"
+
+#include <elf.h>
+#include <link.h>
+#include <signal.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <time.h>
+#include <unistd.h>
+
+#if defined(__x86_64__) && defined(__linux__)
+#define APEX_XRAY_PATCHING 1
+#include <x86intrin.h>
+#else
+#define APEX_XRAY_PATCHING 0
+#endif
+
+// One xray_instr_map entry. From version 2 on, both addresses are relative
+// to the field holding them.
+struct sled {
+    uint64_t address;
+    uint64_t function;
+    uint8_t kind;
+    uint8_t always_instrument;
+    uint8_t version;
+    uint8_t padding[13];
+};
+
+enum { SLED_ENTRY = 0, SLED_EXIT = 1, SLED_TAIL = 2 };
+
+extern const struct sled __start_xray_instr_map[] __attribute__((weak, visibility("hidden")));
+extern const struct sled __stop_xray_instr_map[] __attribute__((weak, visibility("hidden")));
+
+struct event {
+    uint64_t time;
+    uint32_t function;      // ID
+    uint32_t kind;          // SLED_ENTRY or SLED_EXIT
+};
+
+// Events per thread, a power of two; older ones are overwritten
+#define RING_SIZE 65536
+
+struct ring {
+    struct event events[RING_SIZE];
+    uint64_t head;          // Events written so far
+    unsigned thread;        // Numbered from 1 in order of first event
+    struct ring* next;
+};
+
+static _Thread_local struct ring* thread_ring;
+static struct ring* rings;
+static unsigned thread_count;
+
+// Function start address per ID (index 0 unused), from the sleds
+static uintptr_t* functions;
+static uint32_t function_count;
+static int tracing;
+
+// Time stamp and clock when tracing first started; the dump converts time
+// stamps to microseconds from the ticks that passed since
+static uint64_t start_ticks;
+static uint64_t start_ns;
+
+static uint64_t ns_now(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000u + (uint64_t)ts.tv_nsec;
+}
+
+static inline uint64_t ticks_now(void) {
+#if APEX_XRAY_PATCHING
+    return __rdtsc();
+#else
+    return ns_now();
+#endif
+}
+
+static uintptr_t sled_address(const struct sled* sled) {
+    return sled->version >= 2 ? (uintptr_t)&sled->address + (uintptr_t)sled->address : (uintptr_t)sled->address;
+}
+
+static uintptr_t sled_function(const struct sled* sled) {
+    return sled->version >= 2 ? (uintptr_t)&sled->function + (uintptr_t)sled->function : (uintptr_t)sled->function;
+}
+
+static struct ring* new_ring(void) {
+    struct ring* ring = calloc(1, sizeof(*ring));
+    if (!ring) return NULL;
+    ring->thread = __atomic_add_fetch(&thread_count, 1, __ATOMIC_RELAXED);
+    struct ring* head = __atomic_load_n(&rings, __ATOMIC_RELAXED);
+    do {
+        ring->next = head;
+    } while (!__atomic_compare_exchange_n(&rings, &head, ring, 1, __ATOMIC_RELEASE, __ATOMIC_RELAXED));
+    thread_ring = ring;
+    return ring;
+}
+
+// Called by the trampolines
+__attribute__((visibility("hidden"), used)) void apex_xray_record(uint32_t function, uint32_t kind) {
+    struct ring* ring = thread_ring;
+    if (!ring && !(ring = new_ring())) return;
+    uint64_t head = ring->head;
+    struct event* event = &ring->events[head & (RING_SIZE - 1)];
+    event->time = ticks_now();
+    event->function = function;
+    event->kind = kind;
+    __atomic_store_n(&ring->head, head + 1, __ATOMIC_RELEASE);
+}
+
+#if APEX_XRAY_PATCHING
+
+// Entry and tail sleds are reached by `call` at a function boundary, where
+// any argument register may be live, and a tail call's target may be in
+// r11. Exit sleds are reached by `jmp` in place of the `ret`, with the
+// return value live. Each trampoline realigns the stack for the call.
+#define CALL_TRAMPOLINE(name, kind)              \
+    ".p2align 4\n"                               \
+    ".hidden " name "\n"                         \
+    ".type " name ", @function\n"                \
+    name ":\n"                                   \
+    "    pushq %rbp\n"                           \
+    "    movq %rsp, %rbp\n"                      \
+    "    andq $-16, %rsp\n"                      \
+    "    subq $208, %rsp\n"                      \
+    "    movdqu %xmm0, 0(%rsp)\n"                \
+    "    movdqu %xmm1, 16(%rsp)\n"               \
+    "    movdqu %xmm2, 32(%rsp)\n"               \
+    "    movdqu %xmm3, 48(%rsp)\n"               \
+    "    movdqu %xmm4, 64(%rsp)\n"               \
+    "    movdqu %xmm5, 80(%rsp)\n"               \
+    "    movdqu %xmm6, 96(%rsp)\n"               \
+    "    movdqu %xmm7, 112(%rsp)\n"              \
+    "    movq %rdi, 128(%rsp)\n"                 \
+    "    movq %rsi, 136(%rsp)\n"                 \
+    "    movq %rdx, 144(%rsp)\n"                 \
+    "    movq %rcx, 152(%rsp)\n"                 \
+    "    movq %r8, 160(%rsp)\n"                  \
+    "    movq %r9, 168(%rsp)\n"                  \
+    "    movq %rax, 176(%rsp)\n"                 \
+    "    movq %r10, 184(%rsp)\n"                 \
+    "    movq %r11, 192(%rsp)\n"                 \
+    "    movl %r10d, %edi\n"                     \
+    "    movl $" kind ", %esi\n"                 \
+    "    call apex_xray_record\n"                \
+    "    movdqu 0(%rsp), %xmm0\n"                \
+    "    movdqu 16(%rsp), %xmm1\n"               \
+    "    movdqu 32(%rsp), %xmm2\n"               \
+    "    movdqu 48(%rsp), %xmm3\n"               \
+    "    movdqu 64(%rsp), %xmm4\n"               \
+    "    movdqu 80(%rsp), %xmm5\n"               \
+    "    movdqu 96(%rsp), %xmm6\n"               \
+    "    movdqu 112(%rsp), %xmm7\n"              \
+    "    movq 128(%rsp), %rdi\n"                 \
+    "    movq 136(%rsp), %rsi\n"                 \
+    "    movq 144(%rsp), %rdx\n"                 \
+    "    movq 152(%rsp), %rcx\n"                 \
+    "    movq 160(%rsp), %r8\n"                  \
+    "    movq 168(%rsp), %r9\n"                  \
+    "    movq 176(%rsp), %rax\n"                 \
+    "    movq 184(%rsp), %r10\n"                 \
+    "    movq 192(%rsp), %r11\n"                 \
+    "    movq %rbp, %rsp\n"                      \
+    "    popq %rbp\n"                            \
+    "    ret\n"                                  \
+    ".size " name ", .-" name "\n"
+
+__asm__(
+    ".text\n"
+    CALL_TRAMPOLINE("apex_xray_entry_trampoline", "0")
+    CALL_TRAMPOLINE("apex_xray_tail_trampoline", "1")
+    ".p2align 4\n"
+    ".hidden apex_xray_exit_trampoline\n"
+    ".type apex_xray_exit_trampoline, @function\n"
+    "apex_xray_exit_trampoline:\n"
+    "    pushq %rbp\n"
+    "    movq %rsp, %rbp\n"
+    "    andq $-16, %rsp\n"
+    "    subq $48, %rsp\n"
+    "    movdqu %xmm0, 0(%rsp)\n"
+    "    movdqu %xmm1, 16(%rsp)\n"
+    "    movq %rax, 32(%rsp)\n"
+    "    movq %rdx, 40(%rsp)\n"
+    "    movl %r10d, %edi\n"
+    "    movl $1, %esi\n"
+    "    call apex_xray_record\n"
+    "    movdqu 0(%rsp), %xmm0\n"
+    "    movdqu 16(%rsp), %xmm1\n"
+    "    movq 32(%rsp), %rax\n"
+    "    movq 40(%rsp), %rdx\n"
+    "    movq %rbp, %rsp\n"
+    "    popq %rbp\n"
+    "    ret\n"
+    ".size apex_xray_exit_trampoline, .-apex_xray_exit_trampoline\n");
+
+void apex_xray_entry_trampoline(void);
+void apex_xray_tail_trampoline(void);
+void apex_xray_exit_trampoline(void);
+
+// What the first two bytes of an unpatched sled hold: `jmp .+11` for entry
+// and tail sleds, `ret` and a NOP for exit sleds
+#define UNPATCHED_JUMP 0x09eb
+#define UNPATCHED_RET 0x90c3
+#define PATCHED 0xba41      // mov $imm32, %r10d
+
+// The sled is 11 bytes and 2-byte aligned. Its tail is written first and its
+// first two bytes last, in one store, so a thread running through it sees
+// either the old sled or the new one.
+static int patch_sled(uintptr_t at, uint32_t function, int kind, int on) {
+    uint8_t* code = (uint8_t*)at;
+    uint16_t first = *(volatile uint16_t*)code;
+    int exit = kind == SLED_EXIT;
+    if (first != PATCHED && (exit ? code[0] != 0xc3 : first != UNPATCHED_JUMP)) return -1;
+    if (!on) {
+        __atomic_store_n((uint16_t*)code, exit ? UNPATCHED_RET : UNPATCHED_JUMP, __ATOMIC_RELEASE);
+        return 0;
+    }
+    uintptr_t target = exit ? (uintptr_t)&apex_xray_exit_trampoline
+                            : kind == SLED_TAIL ? (uintptr_t)&apex_xray_tail_trampoline
+                                                : (uintptr_t)&apex_xray_entry_trampoline;
+    int64_t offset = (int64_t)(target - (at + 11));
+    if (offset != (int32_t)offset) return -1;
+    int32_t rel = (int32_t)offset;
+    memcpy(code + 2, &function, 4);
+    code[6] = exit ? 0xe9 : 0xe8;           // jmp or call, rel32
+    memcpy(code + 7, &rel, 4);
+    __atomic_store_n((uint16_t*)code, (uint16_t)PATCHED, __ATOMIC_RELEASE);
+    return 0;
+}
+
+#endif
+
+// Numbers the functions in sled order
+static int load_functions(void) {
+    if (functions) return 0;
+    const struct sled* begin = __start_xray_instr_map;
+    const struct sled* end = __stop_xray_instr_map;
+    if (!begin || begin == end) return -1;
+    uintptr_t* table = calloc((size_t)(end - begin) + 1, sizeof(*table));
+    if (!table) return -1;
+    uint32_t count = 0;
+    for (const struct sled* sled = begin; sled != end; sled++) {
+        if (count == 0 || table[count] != sled_function(sled)) table[++count] = sled_function(sled);
+    }
+    function_count = count;
+    functions = table;
+    return 0;
+}
+
+static int patch_all(int on) {
+#if APEX_XRAY_PATCHING
+    if (load_functions() != 0) return -1;
+    const struct sled* begin = __start_xray_instr_map;
+    const struct sled* end = __stop_xray_instr_map;
+    uintptr_t lo = UINTPTR_MAX, hi = 0;
+    for (const struct sled* sled = begin; sled != end; sled++) {
+        uintptr_t at = sled_address(sled);
+        if (at < lo) lo = at;
+        if (at + 11 > hi) hi = at + 11;
+    }
+    uintptr_t page = (uintptr_t)sysconf(_SC_PAGESIZE);
+    lo &= ~(page - 1);
+    hi = (hi + page - 1) & ~(page - 1);
+    if (mprotect((void*)lo, hi - lo, PROT_READ | PROT_WRITE | PROT_EXEC) != 0) return -1;
+
+    int result = 0;
+    uint32_t function = 0;
+    for (const struct sled* sled = begin; sled != end; sled++) {
+        if (function == 0 || functions[function] != sled_function(sled)) function++;
+        if (sled->kind > SLED_TAIL) continue;   // Custom and typed events aren't emitted for Apex
+        if (patch_sled(sled_address(sled), function, sled->kind, on) != 0) result = -1;
+    }
+    mprotect((void*)lo, hi - lo, PROT_READ | PROT_EXEC);
+    return result;
+#else
+    (void)on;
+    return -1;
+#endif
+}
+
+static void dump_at_exit(void);
+static int dump_registered;
+
+// The trace is written at exit once tracing has been started, whether by
+// APEX_XRAY or by the program. In signal mode the constructor registers the
+// dump, so the handler never gets here to call atexit itself.
+int apex_xray_start(void) {
+    if (!__atomic_exchange_n(&dump_registered, 1, __ATOMIC_RELAXED)) atexit(dump_at_exit);
+    if (start_ns == 0) {
+        start_ticks = ticks_now();
+        start_ns = ns_now();
+    }
+    if (patch_all(1) != 0) return -1;
+    __atomic_store_n(&tracing, 1, __ATOMIC_RELAXED);
+    return 0;
+}
+
+int apex_xray_stop(void) {
+    __atomic_store_n(&tracing, 0, __ATOMIC_RELAXED);
+    return patch_all(0);
+}
+
+// Function names, from the executable's symbol table
+struct symbol {
+    uintptr_t address;
+    const char* name;
+};
+
+struct symbols {
+    char* image;
+    struct symbol* entries;
+    size_t count;
+};
+
+static int main_program_bias(struct dl_phdr_info* info, size_t size, void* data) {
+    (void)size;
+    *(uintptr_t*)data = (uintptr_t)info->dlpi_addr;
+    return 1;   // The main program comes first
+}
+
+static int by_address(const void* a, const void* b) {
+    uintptr_t x = ((const struct symbol*)a)->address;
+    uintptr_t y = ((const struct symbol*)b)->address;
+    return x < y ? -1 : x > y;
+}
+
+static void load_symbols(struct symbols* symbols) {
+    memset(symbols, 0, sizeof(*symbols));
+    FILE* file = fopen("/proc/self/exe", "rb");
+    if (!file) return;
+    fseek(file, 0, SEEK_END);
+    long size = ftell(file);
+    fseek(file, 0, SEEK_SET);
+    char* image = size > 0 ? malloc((size_t)size) : NULL;
+    if (!image || fread(image, 1, (size_t)size, file) != (size_t)size) {
+        free(image);
+        fclose(file);
+        return;
+    }
+    fclose(file);
+
+    const Elf64_Ehdr* header = (const Elf64_Ehdr*)image;
+    if ((size_t)size < sizeof(*header) || memcmp(header->e_ident, ELFMAG, SELFMAG) != 0 ||
+        header->e_ident[EI_CLASS] != ELFCLASS64 ||
+        header->e_shoff + (uint64_t)header->e_shnum * sizeof(Elf64_Shdr) > (uint64_t)size) {
+        free(image);
+        return;
+    }
+    uintptr_t bias = 0;
+    dl_iterate_phdr(main_program_bias, &bias);
+
+    const Elf64_Shdr* sections = (const Elf64_Shdr*)(image + header->e_shoff);
+    const Elf64_Shdr* table = NULL;
+    for (unsigned i = 0; i < header->e_shnum; i++) {
+        if (sections[i].sh_type == SHT_SYMTAB) table = &sections[i];
+    }
+    if (!table) {
+        for (unsigned i = 0; i < header->e_shnum; i++) {
+            if (sections[i].sh_type == SHT_DYNSYM) table = &sections[i];
+        }
+    }
+    if (!table || table->sh_link >= header->e_shnum) {
+        free(image);
+        return;
+    }
+    const Elf64_Shdr* strings = &sections[table->sh_link];
+    const Elf64_Sym* entries = (const Elf64_Sym*)(image + table->sh_offset);
+    size_t count = table->sh_size / sizeof(Elf64_Sym);
+    symbols->entries = malloc(count * sizeof(struct symbol));
+    if (!symbols->entries) {
+        free(image);
+        return;
+    }
+    for (size_t i = 0; i < count; i++) {
+        if (ELF64_ST_TYPE(entries[i].st_info) != STT_FUNC || entries[i].st_value == 0) continue;
+        if (entries[i].st_name >= strings->sh_size) continue;
+        symbols->entries[symbols->count].address = (uintptr_t)entries[i].st_value + bias;
+        symbols->entries[symbols->count].name = image + strings->sh_offset + entries[i].st_name;
+        symbols->count++;
+    }
+    qsort(symbols->entries, symbols->count, sizeof(struct symbol), by_address);
+    symbols->image = image;
+}
+
+static void write_name(FILE* out, const struct symbols* symbols, uint32_t function) {
+    uintptr_t address = function <= function_count ? functions[function] : 0;
+    struct symbol key = {address, NULL};
+    const struct symbol* found =
+        symbols->count ? bsearch(&key, symbols->entries, symbols->count, sizeof(key), by_address) : NULL;
+    if (!found) {
+        fprintf(out, "0x%llx", (unsigned long long)address);
+        return;
+    }
+    for (const char* c = found->name; *c; c++) {
+        if (*c == '"' || *c == '\\') fputc('\\', out);
+        if ((unsigned char)*c >= 0x20) fputc(*c, out);
+    }
+}
+
+struct open_call {
+    uint32_t function;
+    uint64_t time;
+};
+
+// Calls become complete ("X") events. A return without its call (overwritten,
+// or recorded before tracing started) is dropped, and so is a call that
+// hasn't returned yet.
+static void write_thread(FILE* out, const struct ring* ring, const struct symbols* symbols, double ticks_per_us,
+                         int* first) {
+    uint64_t head = __atomic_load_n(&ring->head, __ATOMIC_ACQUIRE);
+    uint64_t begin = head > RING_SIZE ? head - RING_SIZE : 0;
+    struct open_call* stack = malloc(sizeof(*stack) * (size_t)(head - begin + 1));
+    if (!stack) return;
+    size_t depth = 0;
+    for (uint64_t i = begin; i < head; i++) {
+        const struct event* event = &ring->events[i & (RING_SIZE - 1)];
+        if (event->kind == SLED_ENTRY) {
+            stack[depth].function = event->function;
+            stack[depth].time = event->time;
+            depth++;
+            continue;
+        }
+        size_t match = depth;
+        while (match > 0 && stack[match - 1].function != event->function) match--;
+        if (match == 0) continue;
+        depth = match - 1;
+        double ts = (double)(stack[depth].time - start_ticks) / ticks_per_us;
+        double dur = (double)(event->time - stack[depth].time) / ticks_per_us;
+        fprintf(out, "%s\n{\"name\":\"", *first ? "" : ",");
+        write_name(out, symbols, event->function);
+        fprintf(out, "\",\"ph\":\"X\",\"ts\":%.3f,\"dur\":%.3f,\"pid\":1,\"tid\":%u}", ts, dur, ring->thread);
+        *first = 0;
+    }
+    free(stack);
+}
+
+int apex_xray_dump(const char* path) {
+    FILE* out = fopen(path, "w");
+    if (!out) return -1;
+    uint64_t elapsed_ns = ns_now() - start_ns;
+    double ticks_per_us = elapsed_ns ? (double)(ticks_now() - start_ticks) * 1000.0 / (double)elapsed_ns : 1.0;
+    if (ticks_per_us <= 0) ticks_per_us = 1.0;
+
+    struct symbols symbols;
+    load_symbols(&symbols);
+    fprintf(out, "{\"traceEvents\":[");
+    int first = 1;
+    for (struct ring* ring = __atomic_load_n(&rings, __ATOMIC_ACQUIRE); ring; ring = ring->next) {
+        write_thread(out, ring, &symbols, ticks_per_us, &first);
+    }
+    fprintf(out, "\n],\"displayTimeUnit\":\"ns\"}\n");
+    free(symbols.entries);
+    free(symbols.image);
+    return fclose(out) == 0 ? 0 : -1;
+}
+
+static void dump_at_exit(void) {
+    if (!__atomic_load_n(&rings, __ATOMIC_ACQUIRE)) return;
+    apex_xray_stop();
+    const char* path = getenv("APEX_XRAY_FILE");
+    if (!path || !*path) path = "apex-xray.json";
+    if (apex_xray_dump(path) != 0) fprintf(stderr, "apex xray: could not write %s\n", path);
+}
+
+// Patching only makes system calls once the function table exists, so it is
+// safe in a signal handler
+static void toggle(int signal) {
+    (void)signal;
+    if (__atomic_load_n(&tracing, __ATOMIC_RELAXED)) {
+        apex_xray_stop();
+    } else {
+        apex_xray_start();
+    }
+}
+
+__attribute__((constructor)) static void apex_xray_init(void) {
+    const char* mode = getenv("APEX_XRAY");
+    if (!mode) return;
+    if (!__atomic_exchange_n(&dump_registered, 1, __ATOMIC_RELAXED)) atexit(dump_at_exit);
+    if (strcmp(mode, "on") == 0) {
+        if (apex_xray_start() != 0) fprintf(stderr, "apex xray: no patchable sleds in this program\n");
+    } else if (strcmp(mode, "signal") == 0) {
+        if (load_functions() != 0) {
+            fprintf(stderr, "apex xray: no patchable sleds in this program\n");
+            return;
+        }
+        start_ticks = ticks_now();
+        start_ns = ns_now();
+        signal(SIGUSR1, toggle);
+    }
+}
@@ -91,8 +91,9 @@ struct Expr {
     // Literal
     std::optional<std::variant<int64_t, uint64_t, double, std::string, bool>> literal_value;
     
-    // Identifier
+    // Identifier; `path` keeps the full name when it is qualified (m::f)
     std::optional<std::string> identifier;
+    std::vector<std::string> path;
     
     // Binary operation
     BinaryOp binary_op;
@@ -205,7 +206,7 @@ struct Pattern {
 
 // Statements
 enum class StmtKind {
-    Let, Expr, Item
+    Let, Expr, Item, Defer
 };
 
 struct Stmt {
@@ -224,9 +225,19 @@ struct Stmt {
     // Item statement (function, struct, etc.)
     std::unique_ptr<Item> item;
     
+    // Defer statement: runs when the enclosing block is exited
+    std::unique_ptr<Expr> defer_body;
+    
     Stmt(StmtKind k, SourceLocation loc) : kind(k), location(std::move(loc)) {}
 };
 
+// Attributes: #[name] or #[name(arg, ...)]
+struct Attribute {
+    std::string name;
+    std::vector<std::string> args;
+    SourceLocation location;
+};
+
 // Items (top-level declarations)
 enum class ItemKind {
     Function, Struct, Enum, Trait, Impl, TypeAlias, Module, Import, Extern
@@ -270,6 +281,7 @@ struct Item {
     
     std::string name;
     std::vector<GenericParam> generic_params;
+    std::vector<Attribute> attributes;
     
     // Function
     std::vector<FunctionParam> params;
@@ -302,7 +314,17 @@ struct Item {
     std::vector<std::string> import_path;
     std::optional<std::string> import_alias;
     
+    // Declarations copied in from another module's interface
+    std::optional<std::string> imported_from;
+    
     Item(ItemKind k, SourceLocation loc) : kind(k), visibility(Visibility::Private), location(std::move(loc)) {}
+    
+    const Attribute* find_attribute(const std::string& attr_name) const {
+        for (const auto& attr : attributes) {
+            if (attr.name == attr_name) return &attr;
+        }
+        return nullptr;
+    }
 };
 
 // Module (compilation unit)
@@ -0,0 +1,41 @@
+#pragma once
+
+namespace apex::codegen {
+
+// DWARF to emit: none (-g0), line tables only (-gline-tables-only), or line
+// tables plus types, parameters and local variables (-g)
+enum class DebugInfo { None, LineTablesOnly, Full };
+
+// Code for profiling without debug info: frame pointers, so sampling
+// profilers can walk the stack (-fno-omit-frame-pointer), and calls to
+// __apex_enter/__apex_exit on entry to and return from every function
+// (-finstrument-functions; see runtime/apex_profile.h). With xray, LLVM
+// puts patchable NOP sleds at the entry and exits of every function of at
+// least `xray_threshold` machine instructions, or with a loop
+// (-fxray-instrument; see runtime/apex_xray.h). Coverage counts every
+// block and branch outcome in LLVM's profile counters, for
+// `apexc cov report` (-fcoverage; see runtime/apex_coverage.h).
+struct ProfilingOptions {
+    bool frame_pointers{false};
+    bool instrument_functions{false};
+    bool xray{false};
+    unsigned xray_threshold{200};
+    bool coverage{false};
+};
+
+// Sanitizers (-fsanitize=address,undefined,thread). Address and thread set
+// the sanitize_address / sanitize_thread attributes on every function
+// defined here and run LLVM's instrumentation passes after the optimizer.
+// Undefined adds checks for the operations Apex leaves undefined: integer
+// division by zero or of the minimum by -1, shifts by the operand's width
+// or more, and float to integer casts out of range. The runtimes come from
+// the system compiler-rt, linked by passing the same flag to cc.
+struct SanitizerOptions {
+    bool address{false};
+    bool undefined{false};
+    bool thread{false};
+
+    bool any() const { return address || undefined || thread; }
+};
+
+} // namespace apex::codegen
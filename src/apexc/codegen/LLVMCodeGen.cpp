@@ -1,76 +1,275 @@
 #include "LLVMCodeGen.h"
+#include "../support/TimeTrace.h"
+#include <llvm/ADT/APSInt.h>
+#include <llvm/IR/DIBuilder.h>
+#include <llvm/IR/DebugInfo.h>
+#include <llvm/IR/DiagnosticInfo.h>
+#include <llvm/IR/Intrinsics.h>
+#include <llvm/IR/LLVMRemarkStreamer.h>
+#include <llvm/IR/MDBuilder.h>
 #include <llvm/IR/Verifier.h>
 #include <llvm/IR/LegacyPassManager.h>
+#include <llvm/Passes/PassBuilder.h>
+#include <llvm/ProfileData/InstrProf.h>
 #include <llvm/Support/FileSystem.h>
+#include <llvm/Support/MD5.h>
+#include <llvm/Support/Regex.h>
+#include <llvm/Support/ToolOutputFile.h>
+#include <llvm/Support/raw_os_ostream.h>
 #include <llvm/Support/TargetSelect.h>
 #include <llvm/MC/TargetRegistry.h>
 #include <llvm/Target/TargetMachine.h>
 #include <llvm/Target/TargetOptions.h>
 #include <llvm/TargetParser/Host.h>
+#include <llvm/Transforms/Instrumentation.h>
+#include <llvm/Transforms/Instrumentation/AddressSanitizer.h>
+#include <llvm/Transforms/Instrumentation/InstrProfiling.h>
+#include <llvm/Transforms/Instrumentation/ThreadSanitizer.h>
+#include <llvm/Transforms/Utils/ModuleUtils.h>
+#include <algorithm>
+#include <chrono>
 #include <iostream>
+#include <mutex>
 #include <optional>
+#include <sstream>
 
 namespace apex::codegen {
 
-LLVMCodeGen::LLVMCodeGen(const std::string& module_name) {
+namespace {
+
+// Target machines are costly to create and can't be shared by two threads,
+// so code generators borrow one from this free list and hand it back when
+// they are destroyed. A long-lived process (`apexc --server`) creates only
+// as many as it ever runs code generators at once. Leaked on purpose, so
+// nothing is destroyed after LLVM's own statics.
+std::mutex& machines_mutex() {
+    static auto* mutex = new std::mutex;
+    return *mutex;
+}
+
+std::vector<std::unique_ptr<llvm::TargetMachine>>& free_machines() {
+    static auto* machines = new std::vector<std::unique_ptr<llvm::TargetMachine>>;
+    return *machines;
+}
+
+std::unique_ptr<llvm::TargetMachine> acquire_target_machine(const std::string& target_triple, std::ostream& err) {
+    {
+        std::lock_guard<std::mutex> lock(machines_mutex());
+        auto& machines = free_machines();
+        if (!machines.empty()) {
+            auto machine = std::move(machines.back());
+            machines.pop_back();
+            return machine;
+        }
+    }
+
+    std::string error;
+    auto target = llvm::TargetRegistry::lookupTarget(target_triple, error);
+    if (!target) {
+        err << "Warning: Could not find target: " << error << std::endl;
+        return nullptr;
+    }
+    llvm::TargetOptions opt;
+    // PIC so switch jump tables link into the default PIE executables
+    auto RM = std::optional<llvm::Reloc::Model>(llvm::Reloc::PIC_);
+    return std::unique_ptr<llvm::TargetMachine>(
+        target->createTargetMachine(target_triple, "generic", "", opt, RM));
+}
+
+// Decides which remarks LLVM's passes build at all (an unmatched pass name
+// costs nothing) and prints them the way apexc prints its own diagnostics.
+// The YAML record gets every remark whether it is printed or not.
+class RemarkHandler : public llvm::DiagnosticHandler {
+public:
+    RemarkHandler(const RemarkOptions& options, std::ostream& out) : out_(out) {
+        if (!options.passed.empty()) passed_.emplace(options.passed);
+        if (!options.missed.empty()) missed_.emplace(options.missed);
+        if (!options.analysis.empty()) analysis_.emplace(options.analysis);
+    }
+
+    bool isPassedOptRemarkEnabled(llvm::StringRef pass) const override { return matches(passed_, pass); }
+    bool isMissedOptRemarkEnabled(llvm::StringRef pass) const override { return matches(missed_, pass); }
+    bool isAnalysisRemarkEnabled(llvm::StringRef pass) const override { return matches(analysis_, pass); }
+    bool isAnyRemarkEnabled() const override { return passed_ || missed_ || analysis_; }
+
+    bool handleDiagnostics(const llvm::DiagnosticInfo& info) override {
+        const char* flag = nullptr;
+        switch (info.getKind()) {
+            case llvm::DK_OptimizationRemark:
+            case llvm::DK_MachineOptimizationRemark:
+                flag = "-Rpass";
+                break;
+            case llvm::DK_OptimizationRemarkMissed:
+            case llvm::DK_MachineOptimizationRemarkMissed:
+                flag = "-Rpass-missed";
+                break;
+            case llvm::DK_OptimizationRemarkAnalysis:
+            case llvm::DK_OptimizationRemarkAnalysisFPCommute:
+            case llvm::DK_OptimizationRemarkAnalysisAliasing:
+            case llvm::DK_MachineOptimizationRemarkAnalysis:
+                flag = "-Rpass-analysis";
+                break;
+            default:
+                return false;           // Not a remark: LLVM prints it as usual
+        }
+        const auto& remark = llvm::cast<llvm::DiagnosticInfoOptimizationBase>(info);
+        if (!remark.isEnabled()) return true;
+
+        // Line 0 marks code with no source line of its own
+        std::ostringstream line;
+        if (remark.isLocationAvailable() && remark.getLocation().getLine() != 0) {
+            llvm::DiagnosticLocation loc = remark.getLocation();
+            line << loc.getRelativePath().str() << ":" << loc.getLine() << ":" << loc.getColumn() << ": remark: ";
+        } else {
+            const llvm::Function& func = remark.getFunction();
+            line << func.getParent()->getName().str() << ": remark: in function '" << func.getName().str() << "': ";
+        }
+        line << remark.getMsg() << " [" << flag << "=" << remark.getPassName().str() << "]\n";
+        out_ << line.str();
+        return true;
+    }
+
+private:
+    std::ostream& out_;
+    std::optional<llvm::Regex> passed_;
+    std::optional<llvm::Regex> missed_;
+    std::optional<llvm::Regex> analysis_;
+
+    static bool matches(const std::optional<llvm::Regex>& regex, llvm::StringRef pass) {
+        return regex && regex->match(pass);
+    }
+};
+
+} // namespace
+
+LLVMCodeGen::LLVMCodeGen(const std::string& module_name, std::ostream& err) : err_(err) {
     context_ = std::make_unique<llvm::LLVMContext>();
     module_ = std::make_unique<llvm::Module>(module_name, *context_);
     builder_ = std::make_unique<llvm::IRBuilder<>>(*context_);
     
-    // Initialize only native target for faster compile times and smaller binary
-    llvm::InitializeNativeTarget();
-    llvm::InitializeNativeTargetAsmParser();
-    llvm::InitializeNativeTargetAsmPrinter();
+    // Initialize only native target for faster compile times and smaller binary.
+    // Once per process: `apexc build` creates code generators on several threads.
+    static std::once_flag targets_initialized;
+    std::call_once(targets_initialized, [] {
+        llvm::InitializeNativeTarget();
+        llvm::InitializeNativeTargetAsmParser();
+        llvm::InitializeNativeTargetAsmPrinter();
+    });
     
     // Set up data layout for the native target
     auto target_triple = llvm::sys::getDefaultTargetTriple();
     module_->setTargetTriple(target_triple);
     
-    std::string error;
-    auto target = llvm::TargetRegistry::lookupTarget(target_triple, error);
-    if (!target) {
-        std::cerr << "Warning: Could not find target: " << error << std::endl;
-    } else {
-        llvm::TargetOptions opt;
-        auto target_machine = target->createTargetMachine(
-            target_triple, "generic", "", opt, std::nullopt);
-        if (target_machine) {
-            module_->setDataLayout(target_machine->createDataLayout());
+    target_machine_ = acquire_target_machine(target_triple, err_);
+    if (target_machine_) {
+        module_->setDataLayout(target_machine_->createDataLayout());
+    }
+}
+
+LLVMCodeGen::~LLVMCodeGen() {
+    if (!target_machine_) return;
+    std::lock_guard<std::mutex> lock(machines_mutex());
+    free_machines().push_back(std::move(target_machine_));
+}
+
+bool LLVMCodeGen::generate(mir::Module* module) {
+    bool success = lower(module);
+    return verify() && success;
+}
+
+bool LLVMCodeGen::enable_remarks(const RemarkOptions& options, std::ostream& out, std::string& error) {
+    for (const std::string* regex : {&options.passed, &options.missed, &options.analysis}) {
+        if (!regex->empty() && !llvm::Regex(*regex).isValid(error)) {
+            error = "Invalid remark regex '" + *regex + "': " + error;
+            return false;
+        }
+    }
+    if (!options.record_file.empty()) {
+        auto file = llvm::setupLLVMOptimizationRemarks(*context_, options.record_file, "", "yaml", false);
+        if (!file) {
+            error = "Could not open " + options.record_file + ": " + llvm::toString(file.takeError());
+            return false;
         }
+        remark_file_ = std::move(*file);
+        remark_file_->keep();
     }
+    context_->setDiagnosticHandler(std::make_unique<RemarkHandler>(options, out));
+    remark_locations_ = true;
+    return true;
+}
+
+void LLVMCodeGen::set_debug_info(DebugInfo kind, bool optimized) {
+    debug_info_ = kind;
+    debug_optimized_ = optimized;
+}
+
+void LLVMCodeGen::set_profiling(const ProfilingOptions& options) {
+    profiling_ = options;
 }
 
-bool LLVMCodeGen::generate(ast::Module* module) {
+void LLVMCodeGen::set_sanitizers(const SanitizerOptions& options) {
+    sanitizers_ = options;
+}
+
+bool LLVMCodeGen::lower(mir::Module* module) {
     if (!module) return false;
-    
-    // Generate code for all items
-    for (auto& item : module->items) {
-        switch (item->kind) {
-            case ast::ItemKind::Function:
-                codegen_function(item.get());
-                break;
-            case ast::ItemKind::Struct:
-                codegen_struct(item.get());
-                break;
-            default:
-                // TODO: Handle other item kinds
-                break;
+
+    mir_module_ = module;
+    failed_ = false;
+    declare_struct_types();
+
+    // Remarks alone only need a line and column, not types or variables
+    DebugInfo kind = debug_info_;
+    if (kind == DebugInfo::None && remark_locations_) kind = DebugInfo::LineTablesOnly;
+    if (kind != DebugInfo::None) {
+        di_builder_ = std::make_unique<llvm::DIBuilder>(*module_);
+        di_file_ = debug_file(module_->getName().str());
+        di_builder_->createCompileUnit(llvm::dwarf::DW_LANG_C, di_file_, "apexc", debug_optimized_, "", 0, "",
+                                       kind == DebugInfo::Full ? llvm::DICompileUnit::FullDebug
+                                                               : llvm::DICompileUnit::LineTablesOnly);
+        module_->addModuleFlag(llvm::Module::Warning, "Dwarf Version", 5);
+        module_->addModuleFlag(llvm::Module::Warning, "Debug Info Version", llvm::DEBUG_METADATA_VERSION);
+        if (kind == DebugInfo::Full) declare_debug_types();
+    }
+
+    // Declare every function up front so calls don't depend on definition order
+    for (auto& func : module->functions) {
+        declare_function(func.get());
+    }
+    if (profiling_.frame_pointers) module_->setFramePointer(llvm::FramePointerKind::All);
+    if (profiling_.instrument_functions) declare_profiling_hooks();
+
+    // Imported bodies were only there to inline; the defining module emits them
+    bool success = true;
+    for (auto& func : module->functions) {
+        if (!func->is_extern && !func->is_imported) {
+            success &= codegen_function(func.get());
         }
     }
-    
-    // Verify the module
+    if (profiling_.coverage) emit_coverage_map();
+    if (di_builder_) di_builder_->finalize();
+    return success && !failed_;
+}
+
+bool LLVMCodeGen::verify() {
     std::string error;
     llvm::raw_string_ostream error_stream(error);
     if (llvm::verifyModule(*module_, &error_stream)) {
-        std::cerr << "Module verification failed:\n" << error << std::endl;
+        err_ << "Module verification failed:\n" << error << std::endl;
         return false;
     }
-    
     return true;
 }
 
-void LLVMCodeGen::dump_ir() {
-    module_->print(llvm::outs(), nullptr);
+void LLVMCodeGen::release(std::unique_ptr<llvm::LLVMContext>& context, std::unique_ptr<llvm::Module>& module) {
+    builder_.reset();
+    module = std::move(module_);
+    context = std::move(context_);
+}
+
+void LLVMCodeGen::dump_ir(std::ostream& out) {
+    llvm::raw_os_ostream stream(out);
+    module_->print(stream, nullptr);
 }
 
 bool LLVMCodeGen::emit_llvm_ir(const std::string& filename) {
@@ -78,48 +277,137 @@ bool LLVMCodeGen::emit_llvm_ir(const std::string& filename) {
     llvm::raw_fd_ostream dest(filename, EC, llvm::sys::fs::OF_None);
     
     if (EC) {
-        std::cerr << "Could not open file: " << EC.message() << std::endl;
+        err_ << "Could not open " << filename << ": " << EC.message() << std::endl;
         return false;
     }
     
+    if (di_builder_ && debug_info_ == DebugInfo::None) llvm::StripDebugInfo(*module_);
     module_->print(dest, nullptr);
     return true;
 }
 
-bool LLVMCodeGen::emit_object_file(const std::string& filename) {
-    auto target_triple = llvm::sys::getDefaultTargetTriple();
-    module_->setTargetTriple(target_triple);
+void LLVMCodeGen::optimize(unsigned opt_level, std::vector<PassTiming>* passes) {
+    if (opt_level == 0 && !profiling_.coverage && !sanitizers_.address && !sanitizers_.thread) return;
     
-    std::string error;
-    auto target = llvm::TargetRegistry::lookupTarget(target_triple, error);
+    llvm::LoopAnalysisManager lam;
+    llvm::FunctionAnalysisManager fam;
+    llvm::CGSCCAnalysisManager cgam;
+    llvm::ModuleAnalysisManager mam;
     
-    if (!target) {
-        std::cerr << "Failed to lookup target: " << error << std::endl;
-        return false;
+    // Pass managers and adaptors only run other passes; their own time is
+    // charged to the pass that runs them. A pass running nested passes
+    // (the inliner wrapper, say) pauses while they run. -ftime-trace gets a
+    // span per pass run.
+    llvm::PassInstrumentationCallbacks callbacks;
+    using Clock = std::chrono::steady_clock;
+    struct Running {
+        size_t index;
+        Clock::time_point resumed;
+    };
+    std::vector<Running> running;
+    std::unordered_map<std::string, size_t> pass_index;
+    auto is_wrapper = [](llvm::StringRef name) {
+        return name.contains("PassManager") || name.contains("PassAdaptor");
+    };
+    auto pause_innermost = [&](Clock::time_point now) {
+        if (running.empty()) return;
+        (*passes)[running.back().index].wall_ms +=
+            std::chrono::duration<double, std::milli>(now - running.back().resumed).count();
+    };
+    bool tracing = APEX_TIME_TRACE && trace::enabled();
+    auto after = [&](llvm::StringRef name) {
+        if (is_wrapper(name)) return;
+        if (tracing) trace::end();
+        if (!passes || running.empty()) return;
+        auto now = Clock::now();
+        pause_innermost(now);
+        running.pop_back();
+        if (!running.empty()) running.back().resumed = now;
+    };
+    if (passes || tracing) {
+        if (passes) {
+            for (size_t i = 0; i < passes->size(); i++) pass_index.emplace((*passes)[i].name, i);
+        }
+        callbacks.registerBeforeNonSkippedPassCallback([&](llvm::StringRef name, llvm::Any ir) {
+            if (is_wrapper(name)) return;
+            if (tracing) {
+                // Function passes say which function they ran on
+                const auto* func = llvm::any_cast<const llvm::Function*>(&ir);
+                trace::begin(name.str(), func ? (*func)->getName().str() : std::string());
+            }
+            if (!passes) return;
+            auto now = Clock::now();
+            pause_innermost(now);
+            auto [it, inserted] = pass_index.try_emplace(name.str(), passes->size());
+            if (inserted) passes->push_back({name.str(), 0, 0});
+            (*passes)[it->second].runs++;
+            running.push_back({it->second, now});
+        });
+        callbacks.registerAfterPassCallback(
+            [&](llvm::StringRef name, llvm::Any, const llvm::PreservedAnalyses&) { after(name); });
+        callbacks.registerAfterPassInvalidatedCallback(
+            [&](llvm::StringRef name, const llvm::PreservedAnalyses&) { after(name); });
     }
     
-    auto CPU = "generic";
-    auto features = "";
-    
-    llvm::TargetOptions opt;
-    auto RM = std::optional<llvm::Reloc::Model>();
-    auto target_machine = target->createTargetMachine(target_triple, CPU, features, opt, RM);
+    llvm::PassBuilder pass_builder(target_machine_.get(), llvm::PipelineTuningOptions(), std::nullopt,
+                                   passes || tracing ? &callbacks : nullptr);
+    pass_builder.registerModuleAnalyses(mam);
+    pass_builder.registerCGSCCAnalyses(cgam);
+    pass_builder.registerFunctionAnalyses(fam);
+    pass_builder.registerLoopAnalyses(lam);
+    pass_builder.crossRegisterProxies(lam, fam, cgam, mam);
     
-    module_->setDataLayout(target_machine->createDataLayout());
+    // Coverage counters are lowered after everything else has run, so the
+    // increments in a loop have been through the loop passes and can be
+    // promoted to a register that is stored once on exit. The sanitizers
+    // then instrument only the loads and stores the optimizer left.
+    llvm::InstrProfOptions counters;
+    counters.DoCounterPromotion = opt_level > 0;
+    auto add_instrumentation = [&](llvm::ModulePassManager& mpm) {
+        if (profiling_.coverage) mpm.addPass(llvm::InstrProfilingLoweringPass(counters));
+        if (sanitizers_.address) mpm.addPass(llvm::AddressSanitizerPass(llvm::AddressSanitizerOptions()));
+        if (sanitizers_.thread) {
+            mpm.addPass(llvm::ModuleThreadSanitizerPass());
+            mpm.addPass(llvm::createModuleToFunctionPassAdaptor(llvm::ThreadSanitizerPass()));
+        }
+    };
+    if (opt_level == 0) {
+        llvm::ModulePassManager mpm;
+        add_instrumentation(mpm);
+        mpm.run(*module_, mam);
+        return;
+    }
+    pass_builder.registerOptimizerLastEPCallback(
+        [&](llvm::ModulePassManager& mpm, llvm::OptimizationLevel) { add_instrumentation(mpm); });
+
+    llvm::OptimizationLevel level = opt_level == 1 ? llvm::OptimizationLevel::O1
+                                  : opt_level == 2 ? llvm::OptimizationLevel::O2
+                                  : llvm::OptimizationLevel::O3;
+    llvm::ModulePassManager mpm = pass_builder.buildPerModuleDefaultPipeline(level);
+    mpm.run(*module_, mam);
+}
+
+bool LLVMCodeGen::emit_object_file(const std::string& filename) {
+    if (!target_machine_) {
+        err_ << "No target machine available for " << module_->getTargetTriple() << std::endl;
+        return false;
+    }
     
     std::error_code EC;
     llvm::raw_fd_ostream dest(filename, EC, llvm::sys::fs::OF_None);
     
     if (EC) {
-        std::cerr << "Could not open file: " << EC.message() << std::endl;
+        err_ << "Could not open " << filename << ": " << EC.message() << std::endl;
         return false;
     }
     
+    // Codegen passes' remarks still print, just without a line
+    if (di_builder_ && debug_info_ == DebugInfo::None) llvm::StripDebugInfo(*module_);
     llvm::legacy::PassManager pass;
     auto file_type = llvm::CodeGenFileType::ObjectFile;
     
-    if (target_machine->addPassesToEmitFile(pass, dest, nullptr, file_type)) {
-        std::cerr << "TargetMachine can't emit a file of this type" << std::endl;
+    if (target_machine_->addPassesToEmitFile(pass, dest, nullptr, file_type)) {
+        err_ << "TargetMachine can't emit a file of this type" << std::endl;
         return false;
     }
     
@@ -129,698 +417,1083 @@ bool LLVMCodeGen::emit_object_file(const std::string& filename) {
     return true;
 }
 
-llvm::Type* LLVMCodeGen::get_primitive_type(const std::string& name) {
-    if (name == "void") return llvm::Type::getVoidTy(*context_);
-    if (name == "bool") return llvm::Type::getInt1Ty(*context_);
-    if (name == "i8" || name == "u8" || name == "byte") return llvm::Type::getInt8Ty(*context_);
-    if (name == "i16" || name == "u16") return llvm::Type::getInt16Ty(*context_);
-    if (name == "i32" || name == "u32") return llvm::Type::getInt32Ty(*context_);
-    if (name == "i64" || name == "u64") return llvm::Type::getInt64Ty(*context_);
-    if (name == "i128" || name == "u128") return llvm::Type::getInt128Ty(*context_);
-    if (name == "isize" || name == "usize") return llvm::Type::getInt64Ty(*context_); // Assume 64-bit
-    if (name == "f32") return llvm::Type::getFloatTy(*context_);
-    if (name == "f64") return llvm::Type::getDoubleTy(*context_);
-    if (name == "char") return llvm::Type::getInt32Ty(*context_);
-    
-    return nullptr;
-}
-
-llvm::Type* LLVMCodeGen::codegen_type(ast::Type* type) {
-    if (!type) return llvm::Type::getVoidTy(*context_);
-    
-    switch (type->kind) {
-        case ast::TypeKind::Primitive:
-            if (type->primitive_name) {
-                return get_primitive_type(*type->primitive_name);
-            }
-            break;
-            
-        case ast::TypeKind::Pointer:
-            if (type->pointee_type) {
-                auto pointee = codegen_type(type->pointee_type.get());
-                return llvm::PointerType::get(pointee, 0);
-            }
-            break;
-            
-        case ast::TypeKind::Array:
-            if (type->element_type && type->array_size) {
-                auto elem = codegen_type(type->element_type.get());
-                return llvm::ArrayType::get(elem, *type->array_size);
-            }
-            break;
-            
-        case ast::TypeKind::Named:
-            // Check if it's a primitive type name
-            if (type->primitive_name) {
-                return get_primitive_type(*type->primitive_name);
-            }
-            // Otherwise look up user-defined types
-            if (!type->path_segments.empty()) {
-                auto it = structs_.find(type->path_segments[0]);
-                if (it != structs_.end()) {
-                    return it->second;
-                }
-            }
-            break;
-            
-        default:
-            // TODO: Handle other type kinds
+llvm::Type* LLVMCodeGen::codegen_type(const mir::Type& type) {
+    switch (type.kind) {
+        case mir::TypeKind::Void:
+            return llvm::Type::getVoidTy(*context_);
+        case mir::TypeKind::Bool:
+            return llvm::Type::getInt1Ty(*context_);
+        case mir::TypeKind::Int:
+            return llvm::Type::getIntNTy(*context_, type.bits);
+        case mir::TypeKind::Float:
+            return type.bits == 32 ? llvm::Type::getFloatTy(*context_) : llvm::Type::getDoubleTy(*context_);
+        case mir::TypeKind::Struct: {
+            auto it = structs_.find(type.struct_name);
+            if (it != structs_.end()) return it->second;
             break;
+        }
+        case mir::TypeKind::Ref:
+        case mir::TypeKind::Ptr:
+            return llvm::PointerType::get(*context_, 0);
+        case mir::TypeKind::Array:
+            return llvm::ArrayType::get(codegen_type(*type.pointee), type.length);
     }
-    
+
     return llvm::Type::getVoidTy(*context_);
 }
 
-llvm::Function* LLVMCodeGen::codegen_function(ast::Item* func) {
-    // Create function type
+void LLVMCodeGen::declare_struct_types() {
+    // Create all struct types first so fields can refer to any of them
+    for (const auto& def : mir_module_->structs) {
+        structs_[def.name] = llvm::StructType::create(*context_, def.name);
+    }
+    for (const auto& def : mir_module_->structs) {
+        std::vector<llvm::Type*> field_types;
+        for (const auto& field : def.fields) {
+            field_types.push_back(codegen_type(field.second));
+        }
+        structs_[def.name]->setBody(field_types);
+    }
+}
+
+llvm::Function* LLVMCodeGen::declare_function(mir::Function* func) {
     std::vector<llvm::Type*> param_types;
-    for (auto& param : func->params) {
-        param_types.push_back(codegen_type(param.type.get()));
+    for (size_t i = 1; i <= func->arg_count; i++) {
+        param_types.push_back(codegen_type(func->locals[i].type));
     }
-    
-    llvm::Type* return_type = codegen_type(func->return_type.get());
+
+    llvm::Type* return_type = codegen_type(func->return_type);
     llvm::FunctionType* func_type = llvm::FunctionType::get(return_type, param_types, false);
-    
-    // Create function
+
+    // Private functions can't be named from other modules. Destructors stay
+    // visible: dependents drop values of this module's structs themselves.
+    bool is_local = !func->is_public && !func->is_exported && !func->is_extern && !func->is_destructor &&
+                    func->name != "main";
     llvm::Function* llvm_func = llvm::Function::Create(
         func_type,
-        llvm::Function::ExternalLinkage,
+        is_local ? llvm::Function::InternalLinkage : llvm::Function::ExternalLinkage,
         func->name,
         module_.get()
     );
-    
-    functions_[func->name] = llvm_func;
-    
-    // Set parameter names
-    size_t idx = 0;
+
+    // Set parameter names. The borrow checker guarantees a `&mut` argument
+    // is the only way to reach its target during the call, and that nothing
+    // writes through a `&` one, not even once cast to a raw pointer.
+    size_t idx = 1;
     for (auto& arg : llvm_func->args()) {
-        arg.setName(func->params[idx].name);
+        const mir::Type& type = func->locals[idx].type;
+        arg.setName(func->locals[idx].name);
+        if (type.kind == mir::TypeKind::Ref && !func->is_extern) {
+            arg.addAttr(type.is_mutable ? llvm::Attribute::NoAlias : llvm::Attribute::ReadOnly);
+        }
         idx++;
     }
-    
-    // Generate function body
-    if (func->body) {
-        llvm::BasicBlock* entry = llvm::BasicBlock::Create(*context_, "entry", llvm_func);
-        builder_->SetInsertPoint(entry);
-        
-        // Add parameters to symbol table
-        named_values_.clear();
-        named_allocas_.clear();  // Clear allocas for new function
-        
-        // Handle function parameters (mutable params need allocas)
-        idx = 0;
-        for (auto& arg : llvm_func->args()) {
-            std::string param_name = std::string(arg.getName());
-            if (func->params[idx].is_mutable) {
-                // Mutable parameters: create alloca, store argument, use alloca
-                llvm::AllocaInst* alloca = builder_->CreateAlloca(arg.getType(), nullptr, param_name);
-                builder_->CreateStore(&arg, alloca);
-                named_allocas_[param_name] = alloca;
-            } else {
-                // Immutable parameters: use SSA value directly
-                named_values_[param_name] = &arg;
-            }
-            idx++;
-        }
-        
-        llvm::Value* ret_val = codegen_expr(func->body.get());
-        
-        // Only add return if block doesn't already have a terminator
-        if (!builder_->GetInsertBlock()->getTerminator()) {
-            if (ret_val) {
-                if (return_type->isVoidTy()) {
-                    builder_->CreateRetVoid();
-                } else {
-                    builder_->CreateRet(ret_val);
-                }
-            } else if (return_type->isVoidTy()) {
-                builder_->CreateRetVoid();
+
+    // Keep LLVM's inliner consistent with the MIR inliner's decisions
+    switch (func->inline_hint) {
+        case mir::InlineHint::Hint: llvm_func->addFnAttr(llvm::Attribute::InlineHint); break;
+        case mir::InlineHint::Always: llvm_func->addFnAttr(llvm::Attribute::AlwaysInline); break;
+        case mir::InlineHint::Never: llvm_func->addFnAttr(llvm::Attribute::NoInline); break;
+        case mir::InlineHint::None: break;
+    }
+
+    // Effects inferred over the MIR call graph, so LLVM can CSE and hoist
+    // calls. Calls to the profiling hooks, coverage counters and sanitizer
+    // runtimes write memory the MIR doesn't see.
+    if (!func->is_extern) {
+        const mir::Effects& effects = func->effects;
+        if (!profiling_.instrument_functions && !profiling_.coverage && !sanitizers_.any()) {
+            if (effects.is_pure()) {
+                llvm_func->setDoesNotAccessMemory();
+            } else if (!effects.writes_memory) {
+                llvm_func->setOnlyReadsMemory();
             }
+            if (effects.args_only && !effects.is_pure()) llvm_func->setOnlyAccessesArgMemory();
         }
-        
-        // Verify function
-        std::string error;
-        llvm::raw_string_ostream error_stream(error);
-        if (llvm::verifyFunction(*llvm_func, &error_stream)) {
-            std::cerr << "Function verification failed: " << error << std::endl;
-            llvm_func->eraseFromParent();
-            return nullptr;
+        if (effects.will_return) llvm_func->setWillReturn();
+        if (effects.no_unwind) llvm_func->setDoesNotThrow();
+        if (!func->locals.empty() && func->locals[mir::RETURN_LOCAL].range) {
+            return_ranges_[func->name] = *func->locals[mir::RETURN_LOCAL].range;
         }
     }
-    
-    return llvm_func;
-}
 
-llvm::StructType* LLVMCodeGen::codegen_struct(ast::Item* struct_item) {
-    std::vector<llvm::Type*> field_types;
-    std::unordered_map<std::string, unsigned> field_indices;
-    
-    unsigned idx = 0;
-    for (auto& field : struct_item->struct_fields) {
-        field_types.push_back(codegen_type(field.type.get()));
-        field_indices[field.name] = idx++;
+    // Profiling without debug info, on every function defined here
+    if (!func->is_extern) {
+        if (profiling_.frame_pointers) llvm_func->addFnAttr("frame-pointer", "all");
+        if (profiling_.xray) {
+            llvm_func->addFnAttr("xray-instruction-threshold", std::to_string(profiling_.xray_threshold));
+        }
+        if (sanitizers_.address) llvm_func->addFnAttr(llvm::Attribute::SanitizeAddress);
+        if (sanitizers_.thread) llvm_func->addFnAttr(llvm::Attribute::SanitizeThread);
     }
-    
-    llvm::StructType* struct_type = llvm::StructType::create(*context_, field_types, struct_item->name);
-    structs_[struct_item->name] = struct_type;
-    struct_fields_[struct_item->name] = field_indices;
-    
-    return struct_type;
+
+    functions_[func->name] = llvm_func;
+    return llvm_func;
 }
 
-llvm::Value* LLVMCodeGen::codegen_expr(ast::Expr* expr) {
-    if (!expr) return nullptr;
-    
-    switch (expr->kind) {
-        case ast::ExprKind::Literal:
-            if (expr->literal_value) {
-                if (std::holds_alternative<int64_t>(*expr->literal_value)) {
-                    int64_t val = std::get<int64_t>(*expr->literal_value);
-                    // Default to 32-bit integers for now (TODO: use type inference)
-                    return llvm::ConstantInt::get(*context_, llvm::APInt(32, val, true));
-                } else if (std::holds_alternative<double>(*expr->literal_value)) {
-                    return llvm::ConstantFP::get(*context_, llvm::APFloat(std::get<double>(*expr->literal_value)));
-                } else if (std::holds_alternative<bool>(*expr->literal_value)) {
-                    return llvm::ConstantInt::get(*context_, llvm::APInt(1, std::get<bool>(*expr->literal_value)));
-                }
-            }
-            return llvm::ConstantInt::get(*context_, llvm::APInt(32, 0));
-            
-        case ast::ExprKind::Identifier:
-            if (expr->identifier) {
-                const std::string& name = *expr->identifier;
-                
-                // Check for mutable variables (allocas) first
-                auto alloca_it = named_allocas_.find(name);
-                if (alloca_it != named_allocas_.end()) {
-                    return builder_->CreateLoad(alloca_it->second->getAllocatedType(), 
-                                               alloca_it->second, name.c_str());
-                }
-                
-                // Check immutable variables
-                auto it = named_values_.find(name);
-                if (it != named_values_.end()) {
-                    return it->second;
-                }
-                
-                // Check functions
-                auto func_it = functions_.find(name);
-                if (func_it != functions_.end()) {
-                    return func_it->second;
-                }
+// A local can live in an SSA register when it is assigned exactly once, is
+// never borrowed or partially written, and every read comes after the
+// definition in the same block (or, for call results, in the call's only
+// successor). Parameters that are never reassigned use the incoming argument.
+void LLVMCodeGen::analyze_locals(mir::Function* func) {
+    struct DefSite {
+        mir::BlockId block;
+        size_t index;
+        bool is_call;
+    };
+    struct UseSite {
+        mir::BlockId block;
+        size_t index;
+    };
+
+    size_t num_locals = func->locals.size();
+    std::vector<std::vector<DefSite>> defs(num_locals);
+    std::vector<std::vector<UseSite>> uses(num_locals);
+    std::vector<bool> address_taken(num_locals, false);
+
+    auto has_deref = [](const mir::Place& place) {
+        for (const auto& elem : place.projection) {
+            if (elem.kind == mir::ProjectionKind::Deref) return true;
+        }
+        return false;
+    };
+    auto read = [&](const mir::Place& place, mir::BlockId b, size_t i) {
+        uses[place.local].push_back({b, i});
+    };
+    auto write = [&](const mir::Place& place, mir::BlockId b, size_t i, bool is_call) {
+        if (has_deref(place)) {
+            read(place, b, i);           // Writes through a pointer read the pointer
+        } else if (place.is_local()) {
+            defs[place.local].push_back({b, i, is_call});
+        } else {
+            address_taken[place.local] = true;
+        }
+    };
+    auto read_operand = [&](const mir::Operand& op, mir::BlockId b, size_t i) {
+        if (op.is_place()) read(op.place, b, i);
+    };
+
+    for (mir::BlockId b = 0; b < func->blocks.size(); b++) {
+        const auto& block = func->blocks[b];
+        for (size_t i = 0; i < block.statements.size(); i++) {
+            const auto& stmt = block.statements[i];
+            if (stmt.kind != mir::StatementKind::Assign) continue;
+            for (const auto& op : stmt.rvalue.operands) {
+                read_operand(op, b, i);
             }
-            return nullptr;
-            
-        case ast::ExprKind::Binary: {
-            // Handle assignment separately
-            if (expr->binary_op == ast::BinaryOp::Assign) {
-                // Left side must be an identifier
-                if (expr->left && expr->left->kind == ast::ExprKind::Identifier && expr->left->identifier) {
-                    const std::string& var_name = *expr->left->identifier;
-                    
-                    // Look up the alloca
-                    auto alloca_it = named_allocas_.find(var_name);
-                    if (alloca_it != named_allocas_.end()) {
-                        llvm::Value* right_val = codegen_expr(expr->right.get());
-                        if (right_val) {
-                            builder_->CreateStore(right_val, alloca_it->second);
-                            return right_val;
-                        }
-                    }
+            if (stmt.rvalue.kind == mir::RvalueKind::Ref) {
+                if (has_deref(stmt.rvalue.place)) {
+                    read(stmt.rvalue.place, b, i);
+                } else {
+                    address_taken[stmt.rvalue.place.local] = true;
                 }
-                return nullptr;
-            }
-            
-            llvm::Value* left = codegen_expr(expr->left.get());
-            llvm::Value* right = codegen_expr(expr->right.get());
-            
-            if (!left || !right) return nullptr;
-            
-            switch (expr->binary_op) {
-                case ast::BinaryOp::Add:
-                    return builder_->CreateAdd(left, right, "addtmp");
-                case ast::BinaryOp::Sub:
-                    return builder_->CreateSub(left, right, "subtmp");
-                case ast::BinaryOp::Mul:
-                    return builder_->CreateMul(left, right, "multmp");
-                case ast::BinaryOp::Div:
-                    return builder_->CreateSDiv(left, right, "divtmp");
-                case ast::BinaryOp::Mod:
-                    return builder_->CreateSRem(left, right, "modtmp");
-                case ast::BinaryOp::Eq:
-                    return builder_->CreateICmpEQ(left, right, "eqtmp");
-                case ast::BinaryOp::Ne:
-                    return builder_->CreateICmpNE(left, right, "netmp");
-                case ast::BinaryOp::Lt:
-                    return builder_->CreateICmpSLT(left, right, "lttmp");
-                case ast::BinaryOp::Le:
-                    return builder_->CreateICmpSLE(left, right, "letmp");
-                case ast::BinaryOp::Gt:
-                    return builder_->CreateICmpSGT(left, right, "gttmp");
-                case ast::BinaryOp::Ge:
-                    return builder_->CreateICmpSGE(left, right, "getmp");
-                case ast::BinaryOp::And:
-                    return builder_->CreateAnd(left, right, "andtmp");
-                case ast::BinaryOp::Or:
-                    return builder_->CreateOr(left, right, "ortmp");
-                case ast::BinaryOp::BitAnd:
-                    return builder_->CreateAnd(left, right, "bitandtmp");
-                case ast::BinaryOp::BitOr:
-                    return builder_->CreateOr(left, right, "bitortmp");
-                case ast::BinaryOp::BitXor:
-                    return builder_->CreateXor(left, right, "bitxortmp");
-                case ast::BinaryOp::Shl:
-                    return builder_->CreateShl(left, right, "shltmp");
-                case ast::BinaryOp::Shr:
-                    return builder_->CreateAShr(left, right, "shrtmp");
-                default:
-                    return nullptr;
             }
+            write(stmt.place, b, i, false);
         }
-            
-        case ast::ExprKind::Call: {
-            llvm::Value* callee = codegen_expr(expr->callee.get());
-            if (!callee) return nullptr;
-            
-            std::vector<llvm::Value*> args;
-            for (auto& arg : expr->arguments) {
-                llvm::Value* arg_val = codegen_expr(arg.get());
-                if (!arg_val) return nullptr;
-                args.push_back(arg_val);
-            }
-            
-            return builder_->CreateCall(llvm::cast<llvm::Function>(callee), args, "calltmp");
-        }
-            
-        case ast::ExprKind::Block: {
-            llvm::Value* result = nullptr;
-            for (auto& stmt : expr->block_stmts) {
-                codegen_stmt(stmt.get());
-            }
-            if (expr->block_expr) {
-                result = codegen_expr(expr->block_expr.get());
-            }
-            return result;
-        }
-            
-        case ast::ExprKind::If: {
-            // Evaluate condition
-            llvm::Value* cond_val = codegen_expr(expr->condition.get());
-            if (!cond_val) return nullptr;
-            
-            llvm::Function* func = builder_->GetInsertBlock()->getParent();
-            if (!func) return nullptr;
-            
-            // Create result storage (using proven match-expression pattern)
-            llvm::AllocaInst* result_alloca = builder_->CreateAlloca(
-                llvm::Type::getInt32Ty(*context_), nullptr, "if.result");
-            
-            // Create basic blocks (then_bb inserted immediately, others added later)
-            llvm::BasicBlock* then_bb = llvm::BasicBlock::Create(*context_, "then", func);
-            llvm::BasicBlock* else_bb = llvm::BasicBlock::Create(*context_, "else");
-            llvm::BasicBlock* merge_bb = llvm::BasicBlock::Create(*context_, "ifcont");
-            
-            // Branch on condition
-            builder_->CreateCondBr(cond_val, then_bb, else_bb);
-            
-            // Then branch
-            builder_->SetInsertPoint(then_bb);
-            if (!expr->then_branch) return nullptr;
-            llvm::Value* then_val = codegen_expr(expr->then_branch.get());
-            bool then_returns = builder_->GetInsertBlock()->getTerminator() != nullptr;
-            if (then_val && !then_returns) {
-                builder_->CreateStore(then_val, result_alloca);
-            }
-            if (!then_returns) {
-                builder_->CreateBr(merge_bb);
-            }
-            
-            // Else branch  
-            func->insert(func->end(), else_bb);
-            builder_->SetInsertPoint(else_bb);
-            bool else_returns = false;
-            if (expr->else_branch) {
-                llvm::Value* else_val = codegen_expr(expr->else_branch.get());
-                else_returns = builder_->GetInsertBlock()->getTerminator() != nullptr;
-                if (else_val && !else_returns) {
-                    builder_->CreateStore(else_val, result_alloca);
+
+        if (!block.terminator) continue;
+        const auto& term = *block.terminator;
+        size_t i = block.statements.size();
+        switch (term.kind) {
+            case mir::TerminatorKind::SwitchInt:
+                read_operand(term.discriminant, b, i);
+                break;
+            case mir::TerminatorKind::Call:
+                for (const auto& arg : term.args) {
+                    read_operand(arg, b, i);
                 }
-            }
-            if (!else_returns) {
-                builder_->CreateBr(merge_bb);
-            }
-            
-            // Merge and load result (only if at least one branch doesn't return)
-            if (!then_returns || !else_returns) {
-                func->insert(func->end(), merge_bb);
-                builder_->SetInsertPoint(merge_bb);
-                return builder_->CreateLoad(llvm::Type::getInt32Ty(*context_), 
-                                           result_alloca, "if.value");
+                write(term.destination, b, i, true);
+                break;
+            case mir::TerminatorKind::Drop:
+                read(term.place, b, i);
+                break;
+            default:
+                break;
+        }
+    }
+
+    auto preds = func->predecessors();
+
+    // At -O0 nothing keeps an SSA value alive for the debugger past its last
+    // use, so with -g every variable gets a stack slot, as clang does
+    bool slots_for_variables = debug_info_ == DebugInfo::Full && !debug_optimized_;
+
+    is_ssa_.assign(num_locals, false);
+    for (mir::LocalId local = 1; local < num_locals; local++) {
+        if (address_taken[local]) continue;
+        if (slots_for_variables && !func->locals[local].name.empty() && !func->locals[local].inlined) continue;
+
+        if (func->is_arg(local)) {
+            is_ssa_[local] = defs[local].empty();
+            continue;
+        }
+        if (defs[local].size() != 1) continue;
+
+        const DefSite& def = defs[local][0];
+        bool dominated = true;
+        for (const auto& use : uses[local]) {
+            if (def.is_call) {
+                mir::BlockId succ = func->blocks[def.block].terminator->target;
+                dominated &= use.block == succ && preds[succ].size() == 1 && succ != def.block;
             } else {
-                // Both branches return - merge block is unreachable, delete it
-                delete merge_bb;
+                dominated &= use.block == def.block && use.index > def.index;
             }
-            
-            // Both branches return - no merge needed
-            return nullptr;
         }
-            
-        case ast::ExprKind::Return:
-            if (expr->return_value) {
-                llvm::Value* ret_val = codegen_expr(expr->return_value.get());
-                if (ret_val) {
-                    builder_->CreateRet(ret_val);
-                    return ret_val;
-                }
+        is_ssa_[local] = dominated;
+    }
+}
+
+bool LLVMCodeGen::codegen_function(mir::Function* func) {
+    APEX_TIME_SCOPE_DETAIL("codegen_function", func->name);
+    llvm::Function* llvm_func = functions_[func->name];
+    mir_func_ = func;
+
+    analyze_locals(func);
+
+    // Stack slots live in a dedicated entry block so they're allocated once
+    // per call, even when the MIR entry block is a loop header.
+    llvm::BasicBlock* entry = llvm::BasicBlock::Create(*context_, "entry", llvm_func);
+    builder_->SetInsertPoint(entry);
+
+    if (di_builder_) {
+        unsigned line = static_cast<unsigned>(func->location.line);
+        llvm::DIFile* file = func->location.filename.empty() ? di_file_ : debug_file(func->location.filename);
+        auto flags = llvm::DISubprogram::SPFlagDefinition;
+        if (llvm_func->hasLocalLinkage()) flags |= llvm::DISubprogram::SPFlagLocalToUnit;
+        if (debug_optimized_) flags |= llvm::DISubprogram::SPFlagOptimized;
+        std::vector<llvm::Metadata*> signature;
+        if (debug_info_ == DebugInfo::Full) {
+            signature.push_back(debug_type(func->return_type));
+            for (size_t i = 1; i <= func->arg_count; i++) signature.push_back(debug_type(func->locals[i].type));
+        }
+        di_subprogram_ = di_builder_->createFunction(
+            file, func->name, llvm_func->getName(), file, line,
+            di_builder_->createSubroutineType(di_builder_->getOrCreateTypeArray(signature)), line,
+            llvm::DINode::FlagPrototyped, flags);
+        llvm_func->setSubprogram(di_subprogram_);
+        set_debug_location(func->location);
+    }
+
+    size_t num_locals = func->locals.size();
+    local_slots_.assign(num_locals, nullptr);
+    ssa_values_.assign(num_locals, nullptr);
+
+    for (mir::LocalId local = 0; local < num_locals; local++) {
+        const mir::LocalDecl& decl = func->locals[local];
+        if (decl.type.is_void()) continue;
+
+        if (func->is_arg(local)) {
+            llvm::Argument* arg = llvm_func->getArg(local - 1);
+            if (is_ssa_[local]) {
+                ssa_values_[local] = arg;
             } else {
-                builder_->CreateRetVoid();
+                local_slots_[local] = builder_->CreateAlloca(arg->getType(), nullptr, decl.name);
+                builder_->CreateStore(arg, local_slots_[local]);
             }
+        } else if (!is_ssa_[local]) {
+            std::string name = local == mir::RETURN_LOCAL ? "retval" : decl.name;
+            llvm::AllocaInst* slot = builder_->CreateAlloca(codegen_type(decl.type), nullptr, name);
+            if (decl.align > slot->getAlign().value()) slot->setAlignment(llvm::Align(decl.align));
+            local_slots_[local] = slot;
+        }
+    }
+    if (di_subprogram_) declare_debug_variables(func);
+    if (enter_hook_ && func->name != "__apex_enter" && func->name != "__apex_exit") {
+        descriptor_ = create_descriptor(func);
+        builder_->CreateCall(enter_hook_, {descriptor_});
+    }
+
+    if (profiling_.coverage) map_coverage(func, llvm_func);
+
+    blocks_.clear();
+    for (mir::BlockId b = 0; b < func->blocks.size(); b++) {
+        blocks_.push_back(llvm::BasicBlock::Create(*context_, "bb" + std::to_string(b), llvm_func));
+    }
+    builder_->CreateBr(blocks_[mir::ENTRY_BLOCK]);
+
+    for (mir::BlockId b = 0; b < func->blocks.size(); b++) {
+        builder_->SetInsertPoint(blocks_[b]);
+        current_block_ = b;
+        if (coverage_name_) increment_counter(b);
+        for (const auto& stmt : func->blocks[b].statements) {
+            location_ = stmt.location;
+            set_debug_location(stmt.location);
+            codegen_statement(stmt);
+        }
+        if (func->blocks[b].terminator) {
+            location_ = func->blocks[b].terminator->location;
+            set_debug_location(func->blocks[b].terminator->location);
+            codegen_terminator(*func->blocks[b].terminator);
+        } else {
+            builder_->CreateUnreachable();
+        }
+    }
+
+    if (di_subprogram_) {
+        di_builder_->finalizeSubprogram(di_subprogram_);
+        builder_->SetCurrentDebugLocation(llvm::DebugLoc());
+        di_subprogram_ = nullptr;
+        di_variables_.clear();
+    }
+    descriptor_ = nullptr;
+    coverage_name_ = nullptr;
+    edge_counters_.clear();
+    mir_func_ = nullptr;
+
+    std::string error;
+    llvm::raw_string_ostream error_stream(error);
+    if (llvm::verifyFunction(*llvm_func, &error_stream)) {
+        err_ << "Function verification failed for '" << func->name << "':\n"
+                  << error_stream.str() << std::endl;
+        return false;
+    }
+    return true;
+}
+
+// Statements the MIR inliner brought in from another file, and ones the
+// compiler made up, get line 0: debuggers step over them and profilers
+// don't charge them to an unrelated line
+void LLVMCodeGen::set_debug_location(const SourceLocation& loc) {
+    if (!di_subprogram_) return;
+    bool own = loc.filename == mir_func_->location.filename;
+    builder_->SetCurrentDebugLocation(llvm::DILocation::get(*context_, own ? static_cast<unsigned>(loc.line) : 0,
+                                                            own ? static_cast<unsigned>(loc.column) : 0,
+                                                            di_subprogram_));
+}
+
+// `struct apex_function` in runtime/apex_profile.h: name, file, line, then
+// counters the runtime owns
+void LLVMCodeGen::declare_profiling_hooks() {
+    llvm::Type* ptr = llvm::PointerType::get(*context_, 0);
+    llvm::Type* i32 = llvm::Type::getInt32Ty(*context_);
+    llvm::Type* i64 = llvm::Type::getInt64Ty(*context_);
+    descriptor_type_ = llvm::StructType::create(*context_, {ptr, ptr, i32, i32, i64, i64, i64, ptr},
+                                                "apex.function");
+
+    llvm::AttributeList attrs = llvm::AttributeList::get(
+        *context_, llvm::AttributeList::FunctionIndex, {llvm::Attribute::NoUnwind});
+    auto* hook_type = llvm::FunctionType::get(llvm::Type::getVoidTy(*context_), {ptr}, false);
+    enter_hook_ = module_->getOrInsertFunction("__apex_enter", hook_type, attrs);
+    exit_hook_ = module_->getOrInsertFunction("__apex_exit", hook_type, attrs);
+}
+
+// The function's ID for the hooks: a private, writable descriptor
+llvm::GlobalVariable* LLVMCodeGen::create_descriptor(mir::Function* func) {
+    llvm::Type* i32 = llvm::Type::getInt32Ty(*context_);
+    llvm::Constant* fields[] = {
+        builder_->CreateGlobalString(func->name, ".apex.name"),
+        builder_->CreateGlobalString(func->location.filename, ".apex.file"),
+        llvm::ConstantInt::get(i32, static_cast<uint64_t>(func->location.line)),
+        llvm::ConstantInt::get(i32, 0),
+        llvm::ConstantInt::get(llvm::Type::getInt64Ty(*context_), 0),
+        llvm::ConstantInt::get(llvm::Type::getInt64Ty(*context_), 0),
+        llvm::ConstantInt::get(llvm::Type::getInt64Ty(*context_), 0),
+        llvm::ConstantPointerNull::get(llvm::PointerType::get(*context_, 0)),
+    };
+    auto* descriptor = new llvm::GlobalVariable(*module_, descriptor_type_, false, llvm::GlobalValue::PrivateLinkage,
+                                                llvm::ConstantStruct::get(descriptor_type_, fields),
+                                                "__apex_fn." + func->name);
+    descriptor->setAlignment(llvm::Align(8));
+    return descriptor;
+}
+
+constexpr uint32_t NO_COUNTER = UINT32_MAX;
+
+// A counter per block, plus one per SwitchInt edge into a block that is
+// also entered some other way, so every branch outcome has a count. The
+// function's part of the coverage map (see emit_coverage_map()) names the
+// lines each block has code on and the outcomes of each source-level
+// branch; its hash tells a profile of an older build apart.
+void LLVMCodeGen::map_coverage(mir::Function* func, llvm::Function* llvm_func) {
+    size_t num_blocks = func->blocks.size();
+    std::vector<unsigned> incoming(num_blocks, 0);
+    incoming[mir::ENTRY_BLOCK]++;   // From the function's entry
+    for (const auto& block : func->blocks) {
+        if (!block.terminator) continue;
+        for (mir::BlockId succ : block.terminator->successors()) incoming[succ]++;
+    }
+
+    coverage_counters_ = static_cast<uint32_t>(num_blocks);
+    edge_counters_.assign(num_blocks, {});
+    std::ostringstream records;
+    for (mir::BlockId b = 0; b < num_blocks; b++) {
+        const mir::BasicBlock& block = func->blocks[b];
+
+        // Lines with code in the block; storage markers and jumps sit on
+        // braces and loop heads, where they would only add noise
+        std::vector<std::pair<unsigned, size_t>> lines;
+        auto add_line = [&](const SourceLocation& loc) {
+            if (loc.filename.empty()) return;
+            std::pair<unsigned, size_t> line{coverage_file(loc.filename), loc.line};
+            if (std::find(lines.begin(), lines.end(), line) == lines.end()) lines.push_back(line);
+        };
+        for (const auto& stmt : block.statements) {
+            if (stmt.kind == mir::StatementKind::Assign) add_line(stmt.location);
+        }
+        const auto& term = block.terminator;
+        if (term && (term->kind == mir::TerminatorKind::SwitchInt || term->kind == mir::TerminatorKind::Call ||
+                     term->kind == mir::TerminatorKind::Return)) {
+            add_line(term->location);
+        }
+        for (const auto& [file, line] : lines) records << "line " << b << ' ' << file << ' ' << line << '\n';
+
+        if (!term || term->kind != mir::TerminatorKind::SwitchInt) continue;
+        const mir::Terminator& branch = *term;
+        std::vector<uint32_t> outcomes;
+        for (mir::BlockId target : branch.targets) {
+            bool shared = incoming[target] > 1 || std::count(branch.targets.begin(), branch.targets.end(), target) > 1;
+            uint32_t counter = shared ? coverage_counters_++ : NO_COUNTER;
+            edge_counters_[b].push_back(counter);
+            outcomes.push_back(counter == NO_COUNTER ? target : counter);
+        }
+        if (!branch.source_branch || branch.location.filename.empty()) continue;
+        records << "branch " << coverage_file(branch.location.filename) << ' ' << branch.location.line << ' '
+                << branch.location.column;
+        bool is_bool = mir_module_->operand_type(*func, branch.discriminant).kind == mir::TypeKind::Bool &&
+                       branch.values.size() == 1 && branch.values[0] == 0;
+        if (is_bool) {
+            records << " true=" << outcomes[1] << " false=" << outcomes[0];
+        } else {
+            for (size_t i = 0; i < branch.values.size(); i++) records << ' ' << branch.values[i] << '=' << outcomes[i];
+            records << " _=" << outcomes.back();
+        }
+        records << '\n';
+    }
+
+    std::string name = llvm::getPGOFuncName(*llvm_func);
+    coverage_hash_ = llvm::MD5Hash(records.str());
+    coverage_map_ += "fn " + std::to_string(coverage_hash_) + ' ' + std::to_string(coverage_counters_) + ' ' + name +
+                     '\n' + records.str();
+    coverage_name_ = llvm::createPGOFuncNameVar(*llvm_func, name);
+}
+
+// Files are numbered in the order the module's map first names them
+unsigned LLVMCodeGen::coverage_file(const std::string& filename) {
+    auto [it, inserted] = coverage_files_.try_emplace(filename, static_cast<unsigned>(coverage_files_.size()));
+    if (inserted) {
+        llvm::SmallString<256> path(filename);
+        llvm::sys::fs::make_absolute(path);
+        coverage_map_ += "file " + std::to_string(it->second) + ' ' + path.str().str() + '\n';
+    }
+    return it->second;
+}
+
+// Lowered to an add to the function's counter array by InstrProfiling,
+// which runs last in optimize()
+void LLVMCodeGen::increment_counter(uint32_t counter) {
+    llvm::Function* increment = llvm::Intrinsic::getDeclaration(module_.get(), llvm::Intrinsic::instrprof_increment);
+    builder_->CreateCall(increment, {coverage_name_, builder_->getInt64(coverage_hash_),
+                                     builder_->getInt32(coverage_counters_), builder_->getInt32(counter)});
+}
+
+// Where the current block's SwitchInt jumps for `term.targets[index]`: the
+// target block itself, or a block counting the edge on the way there
+llvm::BasicBlock* LLVMCodeGen::branch_target(const mir::Terminator& term, size_t index) {
+    llvm::BasicBlock* target = blocks_[term.targets[index]];
+    if (edge_counters_.empty() || edge_counters_[current_block_][index] == NO_COUNTER) return target;
+
+    llvm::BasicBlock* from = builder_->GetInsertBlock();
+    llvm::BasicBlock* edge = llvm::BasicBlock::Create(*context_, from->getName() + ".edge", from->getParent());
+    builder_->SetInsertPoint(edge);
+    increment_counter(edge_counters_[current_block_][index]);
+    builder_->CreateBr(target);
+    builder_->SetInsertPoint(from);
+    return edge;
+}
+
+// The map goes into the object as text, in a section of its own that the
+// linker concatenates across modules. A module's part starts with
+// `apexcov <version>` (the version of LLVM's profile data layout), then
+// `file <n> <path>` and each function's records:
+//   fn <hash> <counters> <name>            name as in the profile data
+//   line <counter> <file> <line>
+//   branch <file> <line> <column> <outcome>=<counter>...
+// where an outcome is true/false, or a match value with _ for the rest.
+void LLVMCodeGen::emit_coverage_map() {
+    if (coverage_map_.empty()) return;
+    std::string text = "apexcov " + std::to_string(llvm::RawInstrProf::Version) + '\n' + coverage_map_;
+    auto* data = llvm::ConstantDataArray::getString(*context_, text, false);
+    auto* map = new llvm::GlobalVariable(*module_, data->getType(), true, llvm::GlobalValue::PrivateLinkage, data,
+                                         "__apex_covmap");
+    map->setSection("__apex_covmap");
+    map->setAlignment(llvm::Align(1));
+    llvm::appendToCompilerUsed(*module_, {map});
+}
+
+// Integer division traps on zero, and signed division overflows for the
+// minimum divided by -1
+void LLVMCodeGen::check_division(const mir::Type& type, llvm::Value* lhs, llvm::Value* rhs) {
+    auto* divisor = llvm::dyn_cast<llvm::ConstantInt>(rhs);
+    if (divisor && !divisor->isZero() && !(type.is_signed && divisor->isMinusOne())) return;
+    auto* int_type = llvm::cast<llvm::IntegerType>(rhs->getType());
+    llvm::Value* ok = builder_->CreateICmpNE(rhs, llvm::ConstantInt::get(int_type, 0));
+    if (type.is_signed) {
+        llvm::Value* not_min = builder_->CreateICmpNE(
+            lhs, llvm::ConstantInt::get(int_type, llvm::APInt::getSignedMinValue(int_type->getBitWidth())));
+        llvm::Value* not_minus_one = builder_->CreateICmpNE(rhs, llvm::ConstantInt::getSigned(int_type, -1));
+        ok = builder_->CreateAnd(ok, builder_->CreateOr(not_min, not_minus_one));
+    }
+    ubsan_check(ok, "__ubsan_handle_divrem_overflow", {&type}, {lhs, rhs});
+}
+
+// A shift by the operand's width or more (or a negative amount, which
+// compares as a large unsigned one) gives poison
+void LLVMCodeGen::check_shift(const mir::Type& type, llvm::Value* lhs, llvm::Value* rhs) {
+    auto* int_type = llvm::cast<llvm::IntegerType>(rhs->getType());
+    llvm::Value* ok = builder_->CreateICmpULT(rhs, llvm::ConstantInt::get(int_type, int_type->getBitWidth()));
+    ubsan_check(ok, "__ubsan_handle_shift_out_of_bounds", {&type, &type}, {lhs, rhs});
+}
+
+// fptosi/fptoui give poison for NaN and for values whose integer part
+// doesn't fit. The bounds are exclusive, one past the integer type's range
+// and rounded outwards, so every float strictly between them fits.
+void LLVMCodeGen::check_float_cast(llvm::Value* value, const mir::Type& from, const mir::Type& to) {
+    const llvm::fltSemantics& semantics = value->getType()->getFltSemantics();
+    unsigned bits = codegen_type(to)->getIntegerBitWidth();
+    bool is_unsigned = !to.is_signed;
+
+    llvm::APFloat lower(semantics, llvm::APFloat::uninitialized);
+    if (lower.convertFromAPInt(llvm::APSInt::getMinValue(bits, is_unsigned), !is_unsigned,
+                               llvm::APFloat::rmTowardZero) & llvm::APFloat::opOverflow) {
+        lower = llvm::APFloat::getInf(semantics, true);
+    } else {
+        lower.subtract(llvm::APFloat(semantics, 1), llvm::APFloat::rmTowardNegative);
+    }
+    llvm::APFloat upper(semantics, llvm::APFloat::uninitialized);
+    if (upper.convertFromAPInt(llvm::APSInt::getMaxValue(bits, is_unsigned), !is_unsigned,
+                               llvm::APFloat::rmTowardZero) & llvm::APFloat::opOverflow) {
+        upper = llvm::APFloat::getInf(semantics, false);
+    } else {
+        upper.add(llvm::APFloat(semantics, 1), llvm::APFloat::rmTowardPositive);
+    }
+
+    llvm::Value* ok = builder_->CreateAnd(
+        builder_->CreateFCmpOGT(value, llvm::ConstantFP::get(value->getType(), lower)),
+        builder_->CreateFCmpOLT(value, llvm::ConstantFP::get(value->getType(), upper)));
+    ubsan_check(ok, "__ubsan_handle_float_cast_overflow", {&from, &to}, {value});
+}
+
+// Unless `ok`, calls compiler-rt's `handler`, which reports the error and
+// returns, so the program carries on as it would have without the check.
+// Its data is the source location, left writable for the runtime to mark
+// as reported so each check reports once, and a descriptor per type in
+// `types`; `values` follow as pointer-sized integers.
+void LLVMCodeGen::ubsan_check(llvm::Value* ok, const char* handler, const std::vector<const mir::Type*>& types,
+                              const std::vector<llvm::Value*>& values) {
+    if (auto* known = llvm::dyn_cast<llvm::ConstantInt>(ok); known && known->isOne()) return;
+
+    llvm::PointerType* ptr = llvm::PointerType::get(*context_, 0);
+    llvm::Type* i32 = builder_->getInt32Ty();
+
+    // Compiler-made statements have no file; the runtime prints <unknown>
+    llvm::Constant* file = llvm::ConstantPointerNull::get(ptr);
+    if (!location_.filename.empty()) {
+        auto [it, inserted] = ubsan_files_.try_emplace(location_.filename, nullptr);
+        if (inserted) it->second = builder_->CreateGlobalStringPtr(location_.filename, "ubsan.file");
+        file = it->second;
+    }
+    std::vector<llvm::Constant*> fields{llvm::ConstantStruct::getAnon(
+        {file, llvm::ConstantInt::get(i32, location_.line), llvm::ConstantInt::get(i32, location_.column)})};
+    for (const mir::Type* type : types) fields.push_back(ubsan_type(*type));
+    llvm::Constant* init = llvm::ConstantStruct::getAnon(fields);
+    auto* data = new llvm::GlobalVariable(*module_, init->getType(), false, llvm::GlobalValue::PrivateLinkage,
+                                          init, "ubsan.data");
+
+    llvm::BasicBlock* current = builder_->GetInsertBlock();
+    llvm::Function* llvm_func = current->getParent();
+    auto* fail = llvm::BasicBlock::Create(*context_, current->getName() + ".ubsan", llvm_func,
+                                          current->getNextNode());
+    auto* cont = llvm::BasicBlock::Create(*context_, current->getName() + ".cont", llvm_func, fail->getNextNode());
+    builder_->CreateCondBr(ok, cont, fail, llvm::MDBuilder(*context_).createBranchWeights((1u << 20) - 1, 1));
+
+    builder_->SetInsertPoint(fail);
+    std::vector<llvm::Type*> params{ptr};
+    std::vector<llvm::Value*> args{data};
+    for (llvm::Value* value : values) {
+        args.push_back(ubsan_value(value));
+        params.push_back(args.back()->getType());
+    }
+    llvm::AttributeList attrs = llvm::AttributeList::get(
+        *context_, llvm::AttributeList::FunctionIndex, {llvm::Attribute::NoUnwind});
+    auto callee = module_->getOrInsertFunction(
+        handler, llvm::FunctionType::get(builder_->getVoidTy(), params, false), attrs);
+    builder_->CreateCall(callee, args);
+    builder_->CreateBr(cont);
+    builder_->SetInsertPoint(cont);
+}
+
+// compiler-rt's TypeDescriptor: a kind (0 integer, 1 float), then for
+// integers log2 of the width shifted left once and or'ed with signedness,
+// for floats the width, then the quoted name
+llvm::Constant* LLVMCodeGen::ubsan_type(const mir::Type& type) {
+    std::string name = "'" + type.to_string() + "'";
+    auto [it, inserted] = ubsan_types_.try_emplace(name, nullptr);
+    if (!inserted) return it->second;
+
+    unsigned bits = codegen_type(type)->getPrimitiveSizeInBits();
+    bool is_float = type.kind == mir::TypeKind::Float;
+    uint16_t info = is_float ? bits : (llvm::Log2_32(bits) << 1) | (type.is_signed ? 1 : 0);
+    llvm::Constant* init = llvm::ConstantStruct::getAnon(
+        {builder_->getInt16(is_float ? 1 : 0), builder_->getInt16(info),
+         llvm::ConstantDataArray::getString(*context_, name)});
+    auto* descriptor = new llvm::GlobalVariable(*module_, init->getType(), true, llvm::GlobalValue::PrivateLinkage,
+                                                init, "ubsan.type");
+    descriptor->setUnnamedAddr(llvm::GlobalValue::UnnamedAddr::Global);
+    it->second = descriptor;
+    return descriptor;
+}
+
+// Values as the handlers take them: zero-extended bits if they fit in a
+// pointer (the descriptor says how to read them), the address of a copy if
+// they don't
+llvm::Value* LLVMCodeGen::ubsan_value(llvm::Value* value) {
+    llvm::Type* intptr = module_->getDataLayout().getIntPtrType(*context_);
+    llvm::Type* type = value->getType();
+    unsigned bits = type->getPrimitiveSizeInBits();
+    if (bits <= intptr->getIntegerBitWidth()) {
+        if (type->isFloatingPointTy()) value = builder_->CreateBitCast(value, builder_->getIntNTy(bits));
+        return builder_->CreateZExt(value, intptr);
+    }
+    llvm::BasicBlock& entry = builder_->GetInsertBlock()->getParent()->getEntryBlock();
+    llvm::IRBuilder<> at_entry(&entry, entry.begin());
+    llvm::AllocaInst* copy = at_entry.CreateAlloca(type);
+    builder_->CreateStore(value, copy);
+    return builder_->CreatePtrToInt(copy, intptr);
+}
+
+llvm::DIFile* LLVMCodeGen::debug_file(const std::string& filename) {
+    auto it = di_files_.find(filename);
+    if (it != di_files_.end()) return it->second;
+    llvm::SmallString<256> directory;
+    llvm::sys::fs::current_path(directory);
+    llvm::DIFile* file = di_builder_->createFile(filename, directory);
+    di_files_[filename] = file;
+    return file;
+}
+
+// Like declare_struct_types(): every struct exists, without members, before
+// any member's type is looked up
+void LLVMCodeGen::declare_debug_types() {
+    const llvm::DataLayout& layout = module_->getDataLayout();
+    for (const auto& def : mir_module_->structs) {
+        llvm::StructType* type = structs_[def.name];
+        llvm::DIFile* file = def.location.filename.empty() ? di_file_ : debug_file(def.location.filename);
+        di_structs_[def.name] = di_builder_->createStructType(
+            file, def.name, file, static_cast<unsigned>(def.location.line), layout.getTypeAllocSizeInBits(type),
+            layout.getABITypeAlign(type).value() * 8, llvm::DINode::FlagZero, nullptr,
+            di_builder_->getOrCreateArray({}));
+    }
+    for (const auto& def : mir_module_->structs) {
+        llvm::StructType* type = structs_[def.name];
+        const llvm::StructLayout* fields = layout.getStructLayout(type);
+        llvm::DICompositeType* composite = di_structs_[def.name];
+        std::vector<llvm::Metadata*> members;
+        for (unsigned i = 0; i < def.fields.size(); i++) {
+            llvm::Type* field_type = type->getElementType(i);
+            members.push_back(di_builder_->createMemberType(
+                composite, def.fields[i].first, composite->getFile(), composite->getLine(),
+                layout.getTypeAllocSizeInBits(field_type), layout.getABITypeAlign(field_type).value() * 8,
+                fields->getElementOffsetInBits(i), llvm::DINode::FlagZero, debug_type(def.fields[i].second)));
+        }
+        di_builder_->replaceArrays(composite, di_builder_->getOrCreateArray(members));
+        di_structs_[def.name] = composite;
+    }
+}
+
+// Null for void, which DWARF spells as a missing type
+llvm::DIType* LLVMCodeGen::debug_type(const mir::Type& type) {
+    const llvm::DataLayout& layout = module_->getDataLayout();
+    switch (type.kind) {
+        case mir::TypeKind::Void:
             return nullptr;
-            
-        case ast::ExprKind::While: {
-            llvm::Function* function = builder_->GetInsertBlock()->getParent();
-            
-            llvm::BasicBlock* loop_cond = llvm::BasicBlock::Create(*context_, "loop.cond", function);
-            llvm::BasicBlock* loop_body = llvm::BasicBlock::Create(*context_, "loop.body", function);
-            llvm::BasicBlock* loop_end = llvm::BasicBlock::Create(*context_, "loop.end", function);
-            
-            // Jump to condition check
-            builder_->CreateBr(loop_cond);
-            
-            // Generate condition
-            builder_->SetInsertPoint(loop_cond);
-            llvm::Value* cond = codegen_expr(expr->while_condition.get());
-            if (!cond) return nullptr;
-            builder_->CreateCondBr(cond, loop_body, loop_end);
-            
-            // Generate body
-            builder_->SetInsertPoint(loop_body);
-            codegen_expr(expr->while_body.get());
-            
-            // Jump back to condition (if block not already terminated)
-            if (!builder_->GetInsertBlock()->getTerminator()) {
-                builder_->CreateBr(loop_cond);
+        case mir::TypeKind::Bool:
+            return di_builder_->createBasicType("bool", 8, llvm::dwarf::DW_ATE_boolean);
+        case mir::TypeKind::Int:
+            return di_builder_->createBasicType(type.to_string(), type.bits,
+                                                type.is_signed ? llvm::dwarf::DW_ATE_signed
+                                                               : llvm::dwarf::DW_ATE_unsigned);
+        case mir::TypeKind::Float:
+            return di_builder_->createBasicType(type.to_string(), type.bits, llvm::dwarf::DW_ATE_float);
+        case mir::TypeKind::Struct: {
+            auto it = di_structs_.find(type.struct_name);
+            return it != di_structs_.end() ? it->second : nullptr;
+        }
+        case mir::TypeKind::Ref:
+            return di_builder_->createReferenceType(llvm::dwarf::DW_TAG_reference_type, debug_type(*type.pointee),
+                                                    layout.getPointerSizeInBits());
+        case mir::TypeKind::Ptr:
+            return di_builder_->createPointerType(debug_type(*type.pointee), layout.getPointerSizeInBits());
+        case mir::TypeKind::Array: {
+            llvm::Type* array = codegen_type(type);
+            llvm::Metadata* range = di_builder_->getOrCreateSubrange(0, static_cast<int64_t>(type.length));
+            return di_builder_->createArrayType(layout.getTypeAllocSizeInBits(array),
+                                                layout.getABITypeAlign(array).value() * 8,
+                                                debug_type(*type.pointee), di_builder_->getOrCreateArray({range}));
+        }
+    }
+    return nullptr;
+}
+
+// Parameters and named locals (-g). One in a stack slot is declared once, at
+// its slot; an SSA one is described again by every value it takes, so the
+// description survives the optimizer moving or dropping the stores. Locals
+// the inliner copied in keep the callee's names, so they're left out rather
+// than shown as the caller's own.
+void LLVMCodeGen::declare_debug_variables(mir::Function* func) {
+    di_variables_.assign(func->locals.size(), nullptr);
+    if (debug_info_ != DebugInfo::Full) return;
+
+    llvm::BasicBlock* entry = builder_->GetInsertBlock();
+    for (mir::LocalId local = 0; local < func->locals.size(); local++) {
+        const mir::LocalDecl& decl = func->locals[local];
+        if (decl.name.empty() || decl.inlined || decl.type.is_void()) continue;
+
+        const SourceLocation& at = decl.location.filename == func->location.filename ? decl.location : func->location;
+        unsigned line = static_cast<unsigned>(at.line);
+        llvm::DIType* type = debug_type(decl.type);
+        llvm::DILocalVariable* variable =
+            func->is_arg(local)
+                ? di_builder_->createParameterVariable(di_subprogram_, decl.name, static_cast<unsigned>(local),
+                                                       di_subprogram_->getFile(), line, type, !debug_optimized_)
+                : di_builder_->createAutoVariable(di_subprogram_, decl.name, di_subprogram_->getFile(), line,
+                                                  type, !debug_optimized_);
+        di_variables_[local] = variable;
+
+        if (local_slots_[local]) {
+            auto* loc = llvm::DILocation::get(*context_, line, static_cast<unsigned>(at.column), di_subprogram_);
+            di_builder_->insertDeclare(local_slots_[local], variable, di_builder_->createExpression(), loc, entry);
+        } else if (ssa_values_[local]) {
+            describe_value(local, ssa_values_[local]);
+        }
+    }
+}
+
+void LLVMCodeGen::describe_value(mir::LocalId local, llvm::Value* value) {
+    if (local >= di_variables_.size() || !di_variables_[local]) return;
+    di_builder_->insertDbgValueIntrinsic(value, di_variables_[local], di_builder_->createExpression(),
+                                         builder_->getCurrentDebugLocation().get(), builder_->GetInsertBlock());
+}
+
+void LLVMCodeGen::codegen_statement(const mir::Statement& stmt) {
+    switch (stmt.kind) {
+        case mir::StatementKind::Assign: {
+            mir::Type type = mir_module_->place_type(*mir_func_, stmt.place);
+            if (type.is_void()) return;
+
+            // Aggregates headed for memory are stored field by field
+            if (stmt.rvalue.kind == mir::RvalueKind::Aggregate &&
+                !(stmt.place.is_local() && is_ssa_[stmt.place.local])) {
+                llvm::Value* addr = place_address(stmt.place);
+                llvm::Type* struct_type = codegen_type(stmt.rvalue.type);
+                for (unsigned i = 0; i < stmt.rvalue.operands.size(); i++) {
+                    llvm::Value* field_addr = builder_->CreateStructGEP(struct_type, addr, i);
+                    builder_->CreateStore(codegen_operand(stmt.rvalue.operands[i]), field_addr);
+                }
+                return;
             }
-            
-            // Continue with code after loop
-            builder_->SetInsertPoint(loop_end);
-            return nullptr;
+
+            store_place(stmt.place, codegen_rvalue(stmt.rvalue));
+            break;
         }
-        
-        case ast::ExprKind::For: {
-            // For now, implement simple range-based for loops
-            // for i in 0..10 { ... }
-            
-            llvm::Function* function = builder_->GetInsertBlock()->getParent();
-            
-            llvm::BasicBlock* loop_cond = llvm::BasicBlock::Create(*context_, "for.cond", function);
-            llvm::BasicBlock* loop_body = llvm::BasicBlock::Create(*context_, "for.body", function);
-            llvm::BasicBlock* loop_inc = llvm::BasicBlock::Create(*context_, "for.inc", function);
-            llvm::BasicBlock* loop_end = llvm::BasicBlock::Create(*context_, "for.end", function);
-            
-            // Get iterator variable name from pattern
-            std::string var_name = "i";
-            if (expr->for_pattern && 
-                expr->for_pattern->kind == ast::PatternKind::Identifier &&
-                expr->for_pattern->binding_name) {
-                var_name = *expr->for_pattern->binding_name;
+        case mir::StatementKind::StorageLive:
+        case mir::StatementKind::StorageDead:
+        case mir::StatementKind::Nop:
+            break;
+    }
+}
+
+void LLVMCodeGen::codegen_terminator(const mir::Terminator& term) {
+    switch (term.kind) {
+        case mir::TerminatorKind::Goto:
+        case mir::TerminatorKind::Drop:
+            builder_->CreateBr(blocks_[term.target]);
+            break;
+
+        case mir::TerminatorKind::SwitchInt: {
+            llvm::Value* disc = codegen_operand(term.discriminant);
+            if (disc->getType()->isIntegerTy(1) && term.values.size() == 1 && term.values[0] == 0) {
+                builder_->CreateCondBr(disc, branch_target(term, 1), branch_target(term, 0));
+                break;
             }
-            
-            // For Range expressions: 0..10
-            if (expr->for_iterator && expr->for_iterator->kind == ast::ExprKind::Range) {
-                llvm::Value* start_val = codegen_expr(expr->for_iterator->range_start.get());
-                llvm::Value* end_val = codegen_expr(expr->for_iterator->range_end.get());
-                if (!start_val || !end_val) return nullptr;
-                
-                // Create alloca for loop counter
-                llvm::AllocaInst* counter = builder_->CreateAlloca(
-                    llvm::Type::getInt32Ty(*context_), nullptr, var_name);
-                builder_->CreateStore(start_val, counter);
-                
-                // Jump to condition
-                builder_->CreateBr(loop_cond);
-                
-                // Condition: counter < end
-                builder_->SetInsertPoint(loop_cond);
-                llvm::Value* current = builder_->CreateLoad(llvm::Type::getInt32Ty(*context_), counter, var_name);
-                llvm::Value* cond = builder_->CreateICmpSLT(current, end_val, "for.cond");
-                builder_->CreateCondBr(cond, loop_body, loop_end);
-                
-                // Body
-                builder_->SetInsertPoint(loop_body);
-                // Make counter available as immutable variable in loop body
-                // Save any existing binding
-                llvm::AllocaInst* saved_alloca = nullptr;
-                llvm::Value* saved_value = nullptr;
-                auto alloca_it = named_allocas_.find(var_name);
-                if (alloca_it != named_allocas_.end()) {
-                    saved_alloca = alloca_it->second;
-                    named_allocas_.erase(alloca_it);
-                }
-                auto val_it = named_values_.find(var_name);
-                if (val_it != named_values_.end()) {
-                    saved_value = val_it->second;
-                }
-                
-                // Make counter alloca available
-                named_allocas_[var_name] = counter;
-                
-                codegen_expr(expr->for_body.get());
-                
-                // Restore previous bindings
-                named_allocas_.erase(var_name);
-                if (saved_alloca) {
-                    named_allocas_[var_name] = saved_alloca;
-                }
-                if (saved_value) {
-                    named_values_[var_name] = saved_value;
-                }
-                
-                // Jump to increment (if not already terminated)
-                if (!builder_->GetInsertBlock()->getTerminator()) {
-                    builder_->CreateBr(loop_inc);
-                }
-                
-                // Increment: counter++
-                builder_->SetInsertPoint(loop_inc);
-                llvm::Value* current_inc = builder_->CreateLoad(llvm::Type::getInt32Ty(*context_), counter, var_name);
-                llvm::Value* next = builder_->CreateAdd(current_inc, 
-                    llvm::ConstantInt::get(llvm::Type::getInt32Ty(*context_), 1), "for.inc");
-                builder_->CreateStore(next, counter);
-                builder_->CreateBr(loop_cond);
-                
-                // Continue after loop
-                builder_->SetInsertPoint(loop_end);
-                return nullptr;
+            auto* int_type = llvm::cast<llvm::IntegerType>(disc->getType());
+            llvm::SwitchInst* sw = builder_->CreateSwitch(disc, branch_target(term, term.targets.size() - 1),
+                                                          term.values.size());
+            for (size_t i = 0; i < term.values.size(); i++) {
+                sw->addCase(llvm::ConstantInt::get(int_type, term.values[i], true), branch_target(term, i));
             }
-            
-            // TODO: Handle general iterators
-            return nullptr;
+            break;
         }
-        
-        case ast::ExprKind::StructLiteral: {
-            // Get the struct type
-            std::string struct_name = expr->struct_path.empty() ? "" : expr->struct_path[0];
-            auto struct_it = structs_.find(struct_name);
-            if (struct_it == structs_.end()) {
-                return nullptr; // Struct type not found
+
+        case mir::TerminatorKind::Return:
+            if (mir_func_->return_type.is_void()) {
+                if (descriptor_) builder_->CreateCall(exit_hook_, {descriptor_});
+                builder_->CreateRetVoid();
+            } else {
+                llvm::Value* value = load_place(mir::Place(mir::RETURN_LOCAL));
+                if (descriptor_) builder_->CreateCall(exit_hook_, {descriptor_});
+                builder_->CreateRet(value);
             }
-            
-            llvm::StructType* struct_type = struct_it->second;
-            auto& field_map = struct_fields_[struct_name];
-            
-            // Create alloca for the struct
-            llvm::AllocaInst* struct_alloca = builder_->CreateAlloca(struct_type, nullptr, "struct.tmp");
-            
-            // Initialize fields
-            for (auto& field_init : expr->fields) {
-                auto field_it = field_map.find(field_init.name);
-                if (field_it == field_map.end()) continue;
-                
-                unsigned field_idx = field_it->second;
-                llvm::Value* field_value = codegen_expr(field_init.value.get());
-                if (!field_value) continue;
-                
-                // Get pointer to field using GEP
-                llvm::Value* field_ptr = builder_->CreateStructGEP(struct_type, struct_alloca, field_idx, field_init.name);
-                builder_->CreateStore(field_value, field_ptr);
+            break;
+
+        case mir::TerminatorKind::Unreachable:
+            builder_->CreateUnreachable();
+            break;
+
+        case mir::TerminatorKind::Call: {
+            llvm::Function* callee = functions_[term.callee];
+            std::vector<llvm::Value*> args;
+            for (const auto& arg : term.args) {
+                args.push_back(codegen_operand(arg));
             }
-            
-            // Load and return the complete struct
-            return builder_->CreateLoad(struct_type, struct_alloca, "struct.val");
-        }
-        
-        case ast::ExprKind::FieldAccess: {
-            // Get the object value
-            llvm::Value* obj_val = codegen_expr(expr->object.get());
-            if (!obj_val) return nullptr;
-            
-            // Get the struct type
-            llvm::Type* obj_type = obj_val->getType();
-            if (!obj_type->isStructTy()) {
-                return nullptr; // Not a struct
+            if (callee->getReturnType()->isVoidTy()) {
+                builder_->CreateCall(callee, args);
+            } else {
+                llvm::CallInst* result = builder_->CreateCall(callee, args, "call");
+                auto range = return_ranges_.find(term.callee);
+                if (range != return_ranges_.end()) attach_range(result, range->second);
+                store_place(term.destination, result);
             }
-            
-            llvm::StructType* struct_type = llvm::cast<llvm::StructType>(obj_type);
-            std::string struct_name = struct_type->getName().str();
-            
-            // Find field index
-            auto fields_it = struct_fields_.find(struct_name);
-            if (fields_it == struct_fields_.end()) {
-                return nullptr;
+            builder_->CreateBr(blocks_[term.target]);
+            break;
+        }
+    }
+}
+
+llvm::Value* LLVMCodeGen::codegen_rvalue(const mir::Rvalue& rvalue) {
+    switch (rvalue.kind) {
+        case mir::RvalueKind::Use:
+            return codegen_operand(rvalue.operands[0]);
+
+        case mir::RvalueKind::BinaryOp: {
+            mir::Type operand_type = mir_module_->operand_type(*mir_func_, rvalue.operands[0]);
+            llvm::Value* lhs = codegen_operand(rvalue.operands[0]);
+            llvm::Value* rhs = codegen_operand(rvalue.operands[1]);
+            return codegen_binary(rvalue.bin_op, operand_type, lhs, rhs, rvalue.no_overflow);
+        }
+
+        case mir::RvalueKind::UnaryOp: {
+            llvm::Value* operand = codegen_operand(rvalue.operands[0]);
+            if (rvalue.un_op == mir::UnOp::Not) {
+                return builder_->CreateNot(operand, "not");
             }
-            
-            auto field_it = fields_it->second.find(expr->field_name);
-            if (field_it == fields_it->second.end()) {
-                return nullptr; // Field not found
+            if (operand->getType()->isFloatingPointTy()) {
+                return builder_->CreateFNeg(operand, "neg");
             }
-            
-            unsigned field_idx = field_it->second;
-            
-            // Extract field value
-            return builder_->CreateExtractValue(obj_val, field_idx, expr->field_name);
-        }
-        
-        case ast::ExprKind::Break:
-            // TODO: Implement break with proper loop context tracking
-            return nullptr;
-            
-        case ast::ExprKind::Continue:
-            // TODO: Implement continue with proper loop context tracking
-            return nullptr;
-        
-        case ast::ExprKind::Match: {
-            // match expr { pattern => value, ... }
-            // Simple implementation for integer/wildcard patterns
-            
-            if (!expr->match_expr) return nullptr;
-            
-            llvm::Value* match_value = codegen_expr(expr->match_expr.get());
-            if (!match_value) return nullptr;
-            
-            llvm::Function* function = builder_->GetInsertBlock()->getParent();
-            
-            // Create a variable to store the result
-            // IMPORTANT: Create alloca at entry block to avoid stack issues in loops
-            llvm::IRBuilder<> tmp_builder(&function->getEntryBlock(), function->getEntryBlock().begin());
-            llvm::AllocaInst* result_alloca = tmp_builder.CreateAlloca(
-                llvm::Type::getInt32Ty(*context_), nullptr, "match.result");
-            
-            // Create end block
-            llvm::BasicBlock* match_end = llvm::BasicBlock::Create(*context_, "match.end", function);
-            
-            llvm::BasicBlock* current_block = builder_->GetInsertBlock();
-            
-            // Generate code for each arm
-            for (size_t i = 0; i < expr->match_arms.size(); ++i) {
-                const auto& arm = expr->match_arms[i];
-                
-                llvm::BasicBlock* arm_body = llvm::BasicBlock::Create(*context_, "match.arm", function);
-                llvm::BasicBlock* arm_next = (i == expr->match_arms.size() - 1) 
-                    ? match_end 
-                    : llvm::BasicBlock::Create(*context_, "match.next", function);
-                
-                builder_->SetInsertPoint(current_block);
-                
-                // Pattern matching - simple version for wildcards, identifiers, and literals
-                if (arm.pattern && arm.pattern->kind == ast::PatternKind::Wildcard) {
-                    // Wildcard (_) always matches
-                    builder_->CreateBr(arm_body);
-                } else if (arm.pattern && arm.pattern->kind == ast::PatternKind::Identifier) {
-                    // Identifier pattern binds the value
-                    if (arm.pattern->binding_name) {
-                        named_values_[*arm.pattern->binding_name] = match_value;
-                    }
-                    builder_->CreateBr(arm_body);
-                } else if (arm.pattern && arm.pattern->kind == ast::PatternKind::Literal) {
-                    // Literal pattern - compare match value with literal
-                    if (arm.pattern->literal_value) {
-                        auto& lit_val = *arm.pattern->literal_value;
-                        if (std::holds_alternative<int64_t>(lit_val)) {
-                            llvm::Value* pattern_val = llvm::ConstantInt::get(
-                                llvm::Type::getInt32Ty(*context_), 
-                                std::get<int64_t>(lit_val));
-                            llvm::Value* cmp = builder_->CreateICmpEQ(match_value, pattern_val, "match.cmp");
-                            builder_->CreateCondBr(cmp, arm_body, arm_next);
-                        } else {
-                            // Non-integer literals not yet supported
-                            builder_->CreateBr(arm_next);
-                        }
-                    } else {
-                        builder_->CreateBr(arm_next);
-                    }
-                } else {
-                    // Unknown pattern, skip to next arm
-                    builder_->CreateBr(arm_next);
-                }
-                
-                // Generate arm body
-                builder_->SetInsertPoint(arm_body);
-                llvm::Value* arm_result = codegen_expr(arm.body.get());
-                if (arm_result) {
-                    builder_->CreateStore(arm_result, result_alloca);
-                }
-                
-                // Jump to end (if not already terminated)
-                if (!builder_->GetInsertBlock()->getTerminator()) {
-                    builder_->CreateBr(match_end);
-                }
-                
-                current_block = arm_next;
+            return builder_->CreateNeg(operand, "neg");
+        }
+
+        case mir::RvalueKind::Ref:
+            return place_address(rvalue.place);
+
+        case mir::RvalueKind::Aggregate: {
+            llvm::Value* agg = llvm::UndefValue::get(codegen_type(rvalue.type));
+            for (unsigned i = 0; i < rvalue.operands.size(); i++) {
+                agg = builder_->CreateInsertValue(agg, codegen_operand(rvalue.operands[i]), i);
             }
-            
-            // Continue after match
-            builder_->SetInsertPoint(match_end);
-            return builder_->CreateLoad(llvm::Type::getInt32Ty(*context_), result_alloca, "match.value");
-        }
-            
-        default:
-            // TODO: Handle other expression kinds
-            return nullptr;
+            return agg;
+        }
+
+        case mir::RvalueKind::Cast: {
+            mir::Type from = mir_module_->operand_type(*mir_func_, rvalue.operands[0]);
+            return codegen_cast(codegen_operand(rvalue.operands[0]), from, rvalue.type);
+        }
+    }
+
+    return nullptr;
+}
+
+llvm::Value* LLVMCodeGen::codegen_operand(const mir::Operand& operand) {
+    if (operand.is_place()) {
+        return load_place(operand.place);
+    }
+
+    const mir::Constant& c = operand.constant;
+    llvm::Type* type = codegen_type(c.type);
+    if (std::holds_alternative<double>(c.value)) {
+        return llvm::ConstantFP::get(type, std::get<double>(c.value));
     }
+    if (std::holds_alternative<bool>(c.value)) {
+        return llvm::ConstantInt::get(type, std::get<bool>(c.value) ? 1 : 0);
+    }
+    return llvm::ConstantInt::get(type, std::get<int64_t>(c.value), c.type.is_signed);
 }
 
-llvm::Value* LLVMCodeGen::codegen_stmt(ast::Stmt* stmt) {
-    if (!stmt) return nullptr;
-    
-    switch (stmt->kind) {
-        case ast::StmtKind::Expr:
-            return codegen_expr(stmt->expr.get());
-        case ast::StmtKind::Let: {
-            // Get variable name from pattern
-            if (stmt->let_pattern && 
-                stmt->let_pattern->kind == ast::PatternKind::Identifier &&
-                stmt->let_pattern->binding_name) {
-                const std::string& var_name = *stmt->let_pattern->binding_name;
-                bool is_mutable = stmt->let_pattern->is_mutable;
-                
-                if (is_mutable) {
-                    // Create alloca for mutable variables
-                    llvm::Type* var_type = llvm::Type::getInt32Ty(*context_); // Default to i32 for now
-                    llvm::AllocaInst* alloca = builder_->CreateAlloca(var_type, nullptr, var_name);
-                    named_allocas_[var_name] = alloca;
-                    
-                    if (stmt->let_initializer) {
-                        llvm::Value* init_val = codegen_expr(stmt->let_initializer.get());
-                        if (init_val) {
-                            builder_->CreateStore(init_val, alloca);
-                        }
-                    }
-                } else {
-                    // Immutable variables use SSA
-                    if (stmt->let_initializer) {
-                        llvm::Value* init_val = codegen_expr(stmt->let_initializer.get());
-                        if (init_val) {
-                            named_values_[var_name] = init_val;
-                        }
-                    }
-                }
+llvm::Value* LLVMCodeGen::codegen_binary(mir::BinOp op, const mir::Type& operand_type,
+                                         llvm::Value* lhs, llvm::Value* rhs, bool no_overflow) {
+    if (operand_type.kind == mir::TypeKind::Float) {
+        switch (op) {
+            case mir::BinOp::Add: return builder_->CreateFAdd(lhs, rhs, "add");
+            case mir::BinOp::Sub: return builder_->CreateFSub(lhs, rhs, "sub");
+            case mir::BinOp::Mul: return builder_->CreateFMul(lhs, rhs, "mul");
+            case mir::BinOp::Div: return builder_->CreateFDiv(lhs, rhs, "div");
+            case mir::BinOp::Rem: return builder_->CreateFRem(lhs, rhs, "rem");
+            case mir::BinOp::Eq: return builder_->CreateFCmpOEQ(lhs, rhs, "eq");
+            case mir::BinOp::Ne: return builder_->CreateFCmpUNE(lhs, rhs, "ne");
+            case mir::BinOp::Lt: return builder_->CreateFCmpOLT(lhs, rhs, "lt");
+            case mir::BinOp::Le: return builder_->CreateFCmpOLE(lhs, rhs, "le");
+            case mir::BinOp::Gt: return builder_->CreateFCmpOGT(lhs, rhs, "gt");
+            case mir::BinOp::Ge: return builder_->CreateFCmpOGE(lhs, rhs, "ge");
+            default:
+                err_ << "Invalid operator for floating-point operands" << std::endl;
+                failed_ = true;
+                return llvm::UndefValue::get(lhs->getType());
+        }
+    }
+
+    // Range analysis proved these can't wrap in the operands' signedness
+    bool is_signed = operand_type.is_signed;
+    bool nuw = no_overflow && !is_signed;
+    bool nsw = no_overflow && is_signed;
+    switch (op) {
+        case mir::BinOp::Add: return builder_->CreateAdd(lhs, rhs, "add", nuw, nsw);
+        case mir::BinOp::Sub: return builder_->CreateSub(lhs, rhs, "sub", nuw, nsw);
+        case mir::BinOp::Mul: return builder_->CreateMul(lhs, rhs, "mul", nuw, nsw);
+        case mir::BinOp::Div:
+            if (sanitizers_.undefined) check_division(operand_type, lhs, rhs);
+            return is_signed ? builder_->CreateSDiv(lhs, rhs, "div") : builder_->CreateUDiv(lhs, rhs, "div");
+        case mir::BinOp::Rem:
+            if (sanitizers_.undefined) check_division(operand_type, lhs, rhs);
+            return is_signed ? builder_->CreateSRem(lhs, rhs, "rem") : builder_->CreateURem(lhs, rhs, "rem");
+        case mir::BinOp::BitAnd: return builder_->CreateAnd(lhs, rhs, "and");
+        case mir::BinOp::BitOr: return builder_->CreateOr(lhs, rhs, "or");
+        case mir::BinOp::BitXor: return builder_->CreateXor(lhs, rhs, "xor");
+        case mir::BinOp::Shl:
+            if (sanitizers_.undefined) check_shift(operand_type, lhs, rhs);
+            return builder_->CreateShl(lhs, rhs, "shl");
+        case mir::BinOp::Shr:
+            if (sanitizers_.undefined) check_shift(operand_type, lhs, rhs);
+            return is_signed ? builder_->CreateAShr(lhs, rhs, "shr") : builder_->CreateLShr(lhs, rhs, "shr");
+        case mir::BinOp::Eq: return builder_->CreateICmpEQ(lhs, rhs, "eq");
+        case mir::BinOp::Ne: return builder_->CreateICmpNE(lhs, rhs, "ne");
+        case mir::BinOp::Lt:
+            return is_signed ? builder_->CreateICmpSLT(lhs, rhs, "lt") : builder_->CreateICmpULT(lhs, rhs, "lt");
+        case mir::BinOp::Le:
+            return is_signed ? builder_->CreateICmpSLE(lhs, rhs, "le") : builder_->CreateICmpULE(lhs, rhs, "le");
+        case mir::BinOp::Gt:
+            return is_signed ? builder_->CreateICmpSGT(lhs, rhs, "gt") : builder_->CreateICmpUGT(lhs, rhs, "gt");
+        case mir::BinOp::Ge:
+            return is_signed ? builder_->CreateICmpSGE(lhs, rhs, "ge") : builder_->CreateICmpUGE(lhs, rhs, "ge");
+    }
+
+    return nullptr;
+}
+
+llvm::Value* LLVMCodeGen::codegen_cast(llvm::Value* value, const mir::Type& from, const mir::Type& to) {
+    llvm::Type* dest = codegen_type(to);
+    bool from_int = from.kind == mir::TypeKind::Int || from.kind == mir::TypeKind::Bool;
+    bool to_int = to.kind == mir::TypeKind::Int || to.kind == mir::TypeKind::Bool;
+    bool from_ptr = from.kind == mir::TypeKind::Ref || from.kind == mir::TypeKind::Ptr;
+    bool to_ptr = to.kind == mir::TypeKind::Ref || to.kind == mir::TypeKind::Ptr;
+
+    if (from_int && to_int) {
+        if (to.kind == mir::TypeKind::Bool) {
+            return builder_->CreateICmpNE(value, llvm::Constant::getNullValue(value->getType()), "cast");
+        }
+        return builder_->CreateIntCast(value, dest, from.is_signed, "cast");
+    }
+    if (from_int && to.kind == mir::TypeKind::Float) {
+        return from.is_signed ? builder_->CreateSIToFP(value, dest, "cast")
+                              : builder_->CreateUIToFP(value, dest, "cast");
+    }
+    if (from.kind == mir::TypeKind::Float && to_int) {
+        if (sanitizers_.undefined) check_float_cast(value, from, to);
+        return to.is_signed ? builder_->CreateFPToSI(value, dest, "cast")
+                            : builder_->CreateFPToUI(value, dest, "cast");
+    }
+    if (from.kind == mir::TypeKind::Float && to.kind == mir::TypeKind::Float) {
+        return builder_->CreateFPCast(value, dest, "cast");
+    }
+    if (from_ptr && to_int) {
+        return builder_->CreatePtrToInt(value, dest, "cast");
+    }
+    if (from_int && to_ptr) {
+        return builder_->CreateIntToPtr(value, dest, "cast");
+    }
+    if (from_ptr && to_ptr) {
+        return value;
+    }
+
+    err_ << "Invalid cast from " << from.to_string() << " to " << to.to_string() << std::endl;
+    failed_ = true;
+    return llvm::UndefValue::get(dest);
+}
+
+// Walks a place's projections. While the place is still held in a register
+// (SSA local or by-value parameter) fields are extracted from the value;
+// once a Deref or stack slot provides an address, fields become GEPs.
+// Returns the final address, or nullptr with `value` set to the projected
+// value if the place never touched memory.
+llvm::Value* LLVMCodeGen::project_place(const mir::Place& place, llvm::Value*& value) {
+    mir::Type type = mir_func_->locals[place.local].type;
+    llvm::Value* addr = local_slots_[place.local];
+    value = ssa_values_[place.local];
+
+    for (const auto& elem : place.projection) {
+        if (elem.kind == mir::ProjectionKind::Deref) {
+            addr = addr ? builder_->CreateLoad(codegen_type(type), addr) : value;
+            value = nullptr;
+            type = type.pointee ? *type.pointee : mir::Type::void_type();
+        } else {
+            if (addr) {
+                addr = builder_->CreateStructGEP(codegen_type(type), addr, elem.field_index);
+            } else if (value) {
+                value = builder_->CreateExtractValue(value, elem.field_index);
             }
-            return nullptr;
+            const mir::StructDef* def = mir_module_->find_struct(type.struct_name);
+            type = def ? def->fields[elem.field_index].second : mir::Type::void_type();
         }
-        default:
-            return nullptr;
     }
+
+    return addr;
+}
+
+llvm::Value* LLVMCodeGen::place_address(const mir::Place& place) {
+    llvm::Value* value = nullptr;
+    llvm::Value* addr = project_place(place, value);
+    if (!addr) {
+        err_ << "Place " << mir::to_string(place) << " has no address" << std::endl;
+        failed_ = true;
+        return llvm::UndefValue::get(llvm::PointerType::get(*context_, 0));
+    }
+    return addr;
+}
+
+llvm::Value* LLVMCodeGen::load_place(const mir::Place& place) {
+    llvm::Value* value = nullptr;
+    llvm::Value* addr = project_place(place, value);
+    llvm::Type* type = codegen_type(mir_module_->place_type(*mir_func_, place));
+    if (addr) {
+        llvm::LoadInst* load = builder_->CreateLoad(type, addr);
+        const auto& range = mir_func_->locals[place.local].range;
+        if (place.is_local() && range) attach_range(load, *range);
+        return load;
+    }
+    if (!value) {
+        // Read of an SSA local before its definition (only in dead code)
+        return llvm::UndefValue::get(type);
+    }
+    return value;
+}
+
+void LLVMCodeGen::store_place(const mir::Place& place, llvm::Value* value) {
+    if (place.is_local() && is_ssa_[place.local]) {
+        const std::string& name = mir_func_->locals[place.local].name;
+        if (!name.empty() && !llvm::isa<llvm::Constant>(value)) {
+            value->setName(name);
+        }
+        ssa_values_[place.local] = value;
+        describe_value(place.local, value);
+        return;
+    }
+    builder_->CreateStore(value, place_address(place));
+}
+
+// `!range` metadata takes a half-open [lo, hi + 1) in the value's own width
+void LLVMCodeGen::attach_range(llvm::Instruction* inst, const mir::ValueRange& range) {
+    unsigned bits = inst->getType()->getIntegerBitWidth();
+    llvm::APInt lo = llvm::APInt(64, static_cast<uint64_t>(range.lo)).zextOrTrunc(bits);
+    llvm::APInt hi = llvm::APInt(64, static_cast<uint64_t>(range.hi) + 1).zextOrTrunc(bits);
+    inst->setMetadata(llvm::LLVMContext::MD_range, llvm::MDBuilder(*context_).createRange(lo, hi));
 }
 
 } // namespace apex::codegen
@@ -1,46 +1,216 @@
 #pragma once
 
-#include "../ast/AST.h"
+#include "CodeGenOptions.h"
+#include "../mir/MIR.h"
 #include <llvm/IR/LLVMContext.h>
 #include <llvm/IR/Module.h>
 #include <llvm/IR/IRBuilder.h>
+#include <llvm/Target/TargetMachine.h>
 #include <memory>
+#include <ostream>
 #include <unordered_map>
+#include <vector>
+
+namespace llvm {
+class DIBuilder;
+class DICompositeType;
+class DIFile;
+class DILocalVariable;
+class DISubprogram;
+class DIType;
+class ToolOutputFile;
+} // namespace llvm
 
 namespace apex::codegen {
 
+// Time spent in one LLVM pass over a whole pipeline run, excluding the passes
+// it ran itself (-ftime-report)
+struct PassTiming {
+    std::string name;
+    double wall_ms{0};
+    unsigned runs{0};
+};
+
+// Optimization remarks to report: regexes over LLVM pass names for
+// -Rpass (optimizations done), -Rpass-missed (not done) and -Rpass-analysis
+// (why), plus a file that records every remark as YAML
+// (-fsave-optimization-record). Empty strings turn each one off.
+struct RemarkOptions {
+    std::string passed;
+    std::string missed;
+    std::string analysis;
+    std::string record_file;
+
+    bool any() const { return !passed.empty() || !missed.empty() || !analysis.empty() || !record_file.empty(); }
+};
+
+// Lowers MIR to LLVM IR. Every MIR basic block maps to one LLVM basic block;
+// locals that are defined exactly once and only used later in the defining
+// block stay in SSA registers, everything else gets a stack slot.
 class LLVMCodeGen {
 public:
-    LLVMCodeGen(const std::string& module_name);
-    
-    bool generate(ast::Module* module);
-    
+    // Errors and warnings go to `err`, so a batch compile can buffer them
+    // with the rest of the file's diagnostics
+    LLVMCodeGen(const std::string& module_name, std::ostream& err);
+    ~LLVMCodeGen();
+
+    LLVMCodeGen(const LLVMCodeGen&) = delete;
+    LLVMCodeGen& operator=(const LLVMCodeGen&) = delete;
+
+    // lower() and then verify()
+    bool generate(mir::Module* module);
+    bool lower(mir::Module* module);
+    bool verify();
+
     llvm::Module* get_module() { return module_.get(); }
-    
-    void dump_ir();
+
+    // Emits debug info of the given kind. Must come before lower().
+    // `optimized` marks it as describing optimized code, so debuggers expect
+    // variables to be unavailable in places.
+    void set_debug_info(DebugInfo kind, bool optimized);
+
+    // Frame pointers and entry/exit hooks. Must come before lower().
+    void set_profiling(const ProfilingOptions& options);
+
+    // Sanitizer attributes, passes and checks. Must come before lower().
+    void set_sanitizers(const SanitizerOptions& options);
+
+    // Prints the remarks `options` asks for to `out` as `file:line:col:
+    // remark: ...`, and opens the YAML record. Must come before lower(),
+    // which then attaches source locations for the remarks to point at;
+    // without set_debug_info() they are stripped again before the output is
+    // written. False, with `error` set, for a bad regex or an unwritable
+    // record file.
+    bool enable_remarks(const RemarkOptions& options, std::ostream& out, std::string& error);
+
+    // Hands the module and the context it lives in over, e.g. to a JIT. The
+    // generator can't be used afterwards.
+    void release(std::unique_ptr<llvm::LLVMContext>& context, std::unique_ptr<llvm::Module>& module);
+
+    // Runs LLVM's default pipeline for -O1..-O3; -O0 leaves the IR as generated,
+    // but for lowering coverage counters and the sanitizers' instrumentation.
+    // With `passes`, the time each pass took is added to it.
+    void optimize(unsigned opt_level, std::vector<PassTiming>* passes = nullptr);
+
+    void dump_ir(std::ostream& out);
     bool emit_object_file(const std::string& filename);
     bool emit_llvm_ir(const std::string& filename);
 
 private:
+    std::ostream& err_;
+
+    // Before the context, so the context's remark streamer goes first
+    std::unique_ptr<llvm::ToolOutputFile> remark_file_;
     std::unique_ptr<llvm::LLVMContext> context_;
     std::unique_ptr<llvm::Module> module_;
     std::unique_ptr<llvm::IRBuilder<>> builder_;
-    
-    // Symbol tables
-    std::unordered_map<std::string, llvm::Value*> named_values_; // SSA values (immutable)
-    std::unordered_map<std::string, llvm::AllocaInst*> named_allocas_; // Mutable variables
+    std::unique_ptr<llvm::TargetMachine> target_machine_;   // Borrowed from a per-process free list
+
+    mir::Module* mir_module_{nullptr};
+    bool failed_{false};   // Some MIR could not be lowered (reported on stderr)
     std::unordered_map<std::string, llvm::Function*> functions_;
     std::unordered_map<std::string, llvm::StructType*> structs_;
-    std::unordered_map<std::string, std::unordered_map<std::string, unsigned>> struct_fields_; // struct_name -> {field_name -> index}
-    
-    // Code generation
-    llvm::Value* codegen_expr(ast::Expr* expr);
-    llvm::Value* codegen_stmt(ast::Stmt* stmt);
-    llvm::Function* codegen_function(ast::Item* func);
-    llvm::StructType* codegen_struct(ast::Item* struct_item);
-    
-    llvm::Type* codegen_type(ast::Type* type);
-    llvm::Type* get_primitive_type(const std::string& name);
+    std::unordered_map<std::string, mir::ValueRange> return_ranges_;
+
+    // Per-function state, indexed by LocalId / BlockId
+    mir::Function* mir_func_{nullptr};
+    std::vector<llvm::BasicBlock*> blocks_;
+    std::vector<llvm::AllocaInst*> local_slots_;
+    std::vector<llvm::Value*> ssa_values_;
+    std::vector<bool> is_ssa_;
+
+    // Debug info, also built (line tables only) when remarks need locations
+    DebugInfo debug_info_{DebugInfo::None};
+    bool debug_optimized_{false};
+    bool remark_locations_{false};
+    std::unique_ptr<llvm::DIBuilder> di_builder_;
+    llvm::DIFile* di_file_{nullptr};
+    std::unordered_map<std::string, llvm::DIFile*> di_files_;
+    std::unordered_map<std::string, llvm::DICompositeType*> di_structs_;
+    llvm::DISubprogram* di_subprogram_{nullptr};
+    std::vector<llvm::DILocalVariable*> di_variables_;   // Per LocalId; null if not described
+
+    // -finstrument-functions: the hooks, and the current function's
+    // descriptor that is passed to them (null if it isn't instrumented)
+    ProfilingOptions profiling_;
+    llvm::FunctionCallee enter_hook_;
+    llvm::FunctionCallee exit_hook_;
+    llvm::StructType* descriptor_type_{nullptr};
+    llvm::GlobalVariable* descriptor_{nullptr};
+
+    // -fcoverage: the module's coverage map so far and the files it names,
+    // and the current function's counters. edge_counters_ holds, per block
+    // and SwitchInt target, the counter of a branch edge that has its own
+    // (NO_COUNTER if the target block's counter counts it).
+    std::string coverage_map_;
+    std::unordered_map<std::string, unsigned> coverage_files_;
+    llvm::GlobalVariable* coverage_name_{nullptr};
+    uint64_t coverage_hash_{0};
+    uint32_t coverage_counters_{0};
+    std::vector<std::vector<uint32_t>> edge_counters_;
+    mir::BlockId current_block_{0};
+
+    // -fsanitize: the location of the statement being lowered, which
+    // -fsanitize=undefined reports, and the type descriptors and file names
+    // its checks have used so far
+    SanitizerOptions sanitizers_;
+    SourceLocation location_;
+    std::unordered_map<std::string, llvm::Constant*> ubsan_types_;
+    std::unordered_map<std::string, llvm::Constant*> ubsan_files_;
+
+    // Declarations
+    void declare_struct_types();
+    llvm::Function* declare_function(mir::Function* func);
+    bool codegen_function(mir::Function* func);
+    void analyze_locals(mir::Function* func);
+    void set_debug_location(const SourceLocation& loc);
+
+    // Debug info types and variables (-g)
+    void declare_debug_types();
+    llvm::DIFile* debug_file(const std::string& filename);
+    llvm::DIType* debug_type(const mir::Type& type);
+    void declare_debug_variables(mir::Function* func);
+    void describe_value(mir::LocalId local, llvm::Value* value);
+
+    // Profiling (-finstrument-functions)
+    void declare_profiling_hooks();
+    llvm::GlobalVariable* create_descriptor(mir::Function* func);
+
+    // Coverage (-fcoverage)
+    void map_coverage(mir::Function* func, llvm::Function* llvm_func);
+    unsigned coverage_file(const std::string& filename);
+    void increment_counter(uint32_t counter);
+    llvm::BasicBlock* branch_target(const mir::Terminator& term, size_t index);
+    void emit_coverage_map();
+
+    // Undefined behaviour checks (-fsanitize=undefined)
+    void check_division(const mir::Type& type, llvm::Value* lhs, llvm::Value* rhs);
+    void check_shift(const mir::Type& type, llvm::Value* lhs, llvm::Value* rhs);
+    void check_float_cast(llvm::Value* value, const mir::Type& from, const mir::Type& to);
+    void ubsan_check(llvm::Value* ok, const char* handler, const std::vector<const mir::Type*>& types,
+                     const std::vector<llvm::Value*>& values);
+    llvm::Constant* ubsan_type(const mir::Type& type);
+    llvm::Value* ubsan_value(llvm::Value* value);
+
+    // Statements and terminators
+    void codegen_statement(const mir::Statement& stmt);
+    void codegen_terminator(const mir::Terminator& term);
+
+    // Values
+    llvm::Value* codegen_rvalue(const mir::Rvalue& rvalue);
+    llvm::Value* codegen_operand(const mir::Operand& operand);
+    llvm::Value* codegen_binary(mir::BinOp op, const mir::Type& operand_type, llvm::Value* lhs, llvm::Value* rhs,
+                                bool no_overflow);
+    llvm::Value* codegen_cast(llvm::Value* value, const mir::Type& from, const mir::Type& to);
+
+    // Places
+    llvm::Value* project_place(const mir::Place& place, llvm::Value*& value);
+    llvm::Value* place_address(const mir::Place& place);
+    llvm::Value* load_place(const mir::Place& place);
+    void store_place(const mir::Place& place, llvm::Value* value);
+    void attach_range(llvm::Instruction* inst, const mir::ValueRange& range);
+
+    llvm::Type* codegen_type(const mir::Type& type);
 };
 
 } // namespace apex::codegen
@@ -0,0 +1,383 @@
+#include "Build.h"
+#include "ModuleGraph.h"
+#include "Interface.h"
+#include "ModuleFile.h"
+#include "Pipeline.h"
+#include "ThreadPool.h"
+#include "../mir/Passes.h"
+#include "../codegen/LLVMCodeGen.h"
+#include "../support/TimeTrace.h"
+#include <llvm/Support/FileSystem.h>
+#include <algorithm>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <set>
+#include <sstream>
+#include <thread>
+
+// Where the build tree puts runtime/'s libraries; set by CMake
+#ifndef APEX_RUNTIME_DIR
+#define APEX_RUNTIME_DIR "lib"
+#endif
+
+namespace apex::driver {
+
+namespace fs = std::filesystem;
+
+namespace {
+
+struct ModuleResult {
+    bool ok{false};
+    std::string module_file;    // Encoded .apxmod, what importers compile against
+    std::string object_file;
+    std::string diagnostics;
+    std::string log;
+};
+
+std::string shell_quote(const std::string& arg) {
+    std::string quoted = "'";
+    for (char c : arg) {
+        if (c == '\'') {
+            quoted += "'\\''";
+        } else {
+            quoted += c;
+        }
+    }
+    return quoted + "'";
+}
+
+// A library from runtime/: next to an installed apexc (<prefix>/lib), or
+// in the build tree apexc was built in. Empty if neither has it.
+std::string find_runtime_library(const std::string& file) {
+    std::string exe = llvm::sys::fs::getMainExecutable(nullptr, reinterpret_cast<void*>(&find_runtime_library));
+    std::vector<fs::path> candidates;
+    if (!exe.empty()) candidates.push_back(fs::path(exe).parent_path().parent_path() / "lib" / file);
+    candidates.push_back(fs::path(APEX_RUNTIME_DIR) / file);
+    for (const auto& candidate : candidates) {
+        if (fs::exists(candidate)) return candidate.string();
+    }
+    return "";
+}
+
+uint64_t hash_value(uint64_t value, uint64_t seed) {
+    return hash_bytes(std::string(reinterpret_cast<const char*>(&value), sizeof(value)), seed);
+}
+
+// Struct types a function's locals mention, through pointers and arrays
+void local_structs(const mir::Type& type, std::vector<std::string>& names) {
+    if (type.kind == mir::TypeKind::Struct) names.push_back(type.struct_name);
+    if (type.pointee) local_structs(*type.pointee, names);
+}
+
+// The public functions small enough to inline into importers, plus
+// declarations of what they call. A body only qualifies when everything it
+// names can be named from another module: struct types from an interface,
+// and callees with external linkage.
+std::vector<std::unique_ptr<mir::Function>> inlinable_functions(const mir::Module& module,
+                                                                const std::vector<const ast::Item*>& interface,
+                                                                const ast::Module& ast, unsigned opt_level) {
+    std::set<std::string> visible_structs;
+    for (const ast::Item* item : interface) {
+        if (item->kind == ast::ItemKind::Struct) visible_structs.insert(item->name);
+    }
+    for (const auto& item : ast.items) {
+        if (item->imported_from && item->kind == ast::ItemKind::Struct) visible_structs.insert(item->name);
+    }
+
+    std::vector<std::unique_ptr<mir::Function>> bodies;
+    std::set<std::string> declared;
+    std::vector<const mir::Function*> callees;
+    for (const auto& func : module.functions) {
+        if (!func->is_public || func->is_imported || func->is_destructor || !mir::is_inline_candidate(*func, opt_level)) {
+            continue;
+        }
+        std::vector<std::string> structs;
+        for (const auto& decl : func->locals) local_structs(decl.type, structs);
+        bool visible = std::all_of(structs.begin(), structs.end(),
+                                   [&](const std::string& name) { return visible_structs.count(name) > 0; });
+
+        std::vector<const mir::Function*> calls;
+        for (const auto& block : func->blocks) {
+            if (!visible || !block.terminator || block.terminator->kind != mir::TerminatorKind::Call) continue;
+            const mir::Function* callee = module.find_function(block.terminator->callee);
+            if (!callee || callee == func.get() ||
+                !(callee->is_public || callee->is_extern || callee->is_exported || callee->is_destructor)) {
+                visible = false;
+            } else {
+                calls.push_back(callee);
+            }
+        }
+        if (!visible) continue;
+
+        auto body = std::make_unique<mir::Function>(*func);
+        body->effects = mir::Effects();
+        declared.insert(body->name);
+        bodies.push_back(std::move(body));
+        callees.insert(callees.end(), calls.begin(), calls.end());
+    }
+
+    for (const mir::Function* callee : callees) {
+        if (!declared.insert(callee->name).second) continue;
+        auto decl = std::make_unique<mir::Function>(*callee);
+        decl->is_extern = true;
+        decl->is_imported = false;
+        decl->effects = mir::Effects();
+        decl->blocks.clear();
+        decl->locals.resize(decl->arg_count + 1);
+        bodies.push_back(std::move(decl));
+    }
+    return bodies;
+}
+
+// Bodies of imported functions replace the declarations MIR was built with,
+// so the inliner can see through them; anything they call that the module
+// doesn't know yet is added as a declaration
+void attach_imported(mir::Module& module, std::vector<std::unique_ptr<mir::Function>>& imported) {
+    for (auto& func : imported) {
+        mir::Function* existing = module.find_function(func->name);
+        if (!existing) {
+            module.functions.push_back(std::move(func));
+        } else if (existing->is_extern && !func->is_extern) {
+            existing->locals = std::move(func->locals);
+            existing->blocks = std::move(func->blocks);
+            existing->inline_hint = func->inline_hint;
+            existing->is_extern = false;
+            existing->is_imported = true;
+        }
+    }
+}
+
+// Runs on a worker thread. Only reads the results of earlier waves.
+bool compile_module(ModuleGraph& graph, size_t index, uint64_t fingerprint, std::vector<ModuleResult>& results,
+                    const BuildOptions& opts, std::ostream& diag, std::ostream* log) {
+    ModuleNode& node = graph.node(index);
+    APEX_TIME_SCOPE_DETAIL("compile_module", node.name);
+    std::string object_file = (fs::path(opts.build_dir) / (artifact_name(node.name) + ".o")).string();
+    std::string interface_file = (fs::path(opts.build_dir) / (artifact_name(node.name) + ".apxmod")).string();
+
+    if (node.cached && node.cached->fingerprint == fingerprint && fs::exists(object_file)) {
+        if (log) *log << node.name << " is up to date" << std::endl;
+        results[index].module_file = std::move(node.cached_data);
+        results[index].object_file = object_file;
+        return true;
+    }
+    if (log) *log << "Compiling " << node.name << " (" << node.path << ")" << std::endl;
+
+    if (!node.ast) {
+        APEX_TIME_SCOPE("parse");
+        std::vector<std::string> errors;
+        node.ast = parse_source(node.source, node.path, errors);
+        for (const auto& error : errors) diag << error << "\n";
+        if (!node.ast) return false;
+        node.ast->name = node.name;
+    }
+
+    // Interfaces of everything imported directly or not: MIR needs the
+    // layout of every struct the module can reach
+    sema::SemanticAnalyzer analyzer;
+    std::vector<std::unique_ptr<ast::Item>> imported;
+    std::vector<std::unique_ptr<mir::Function>> imported_bodies;
+    for (size_t dep : graph.dependencies(index)) {
+        const ModuleNode& dep_node = *graph.nodes()[dep];
+        ModuleFile file;
+        if (!decode_module_file(results[dep].module_file, file)) {
+            diag << dep_node.path << ": error: Malformed module interface for '" << dep_node.name << "'\n";
+            return false;
+        }
+        std::move(file.interface.begin(), file.interface.end(), std::back_inserter(imported));
+        std::move(file.functions.begin(), file.functions.end(), std::back_inserter(imported_bodies));
+        analyzer.add_module(dep_node.name);
+    }
+    auto& items = node.ast->items;
+    items.insert(items.begin(), std::make_move_iterator(imported.begin()), std::make_move_iterator(imported.end()));
+
+    auto mir_module = check_module(node.ast.get(), analyzer, diag, log);
+    if (!mir_module) return false;
+
+    attach_imported(*mir_module, imported_bodies);
+    {
+        APEX_TIME_SCOPE("mir opt");
+        mir::optimize_module(*mir_module, opts.opt_level);
+    }
+
+    // Bodies are taken optimized, with their own private helpers already
+    // inlined. The interface is taken after sema, so qualified type names
+    // are already reduced to bare ones.
+    ModuleHeader header;
+    header.name = node.name;
+    header.path = node.path;
+    header.source_hash = node.source_hash;
+    header.fingerprint = fingerprint;
+    for (size_t dep : node.imports) header.imports.push_back(graph.nodes()[dep]->name);
+    auto interface = collect_interface(*node.ast);
+    auto bodies = inlinable_functions(*mir_module, interface, *node.ast, opts.opt_level);
+    std::vector<const mir::Function*> functions;
+    for (const auto& body : bodies) functions.push_back(body.get());
+    results[index].module_file = encode_module_file(header, interface, functions);
+
+    std::ofstream out(interface_file, std::ios::binary);
+    out << results[index].module_file;
+    if (!out) {
+        diag << "Failed to write output file: " << interface_file << "\n";
+        return false;
+    }
+
+    if (log) *log << "Starting code generation..." << std::endl;
+    codegen::LLVMCodeGen codegen(node.path, diag);
+    codegen.set_debug_info(opts.debug_info, opts.opt_level > 0);
+    codegen.set_profiling(opts.profiling);
+    codegen.set_sanitizers(opts.sanitizers);
+    bool generated;
+    {
+        APEX_TIME_SCOPE("codegen");
+        generated = codegen.generate(mir_module.get());
+    }
+    if (!generated) {
+        diag << node.path << ": error: Code generation failed\n";
+        return false;
+    }
+    {
+        APEX_TIME_SCOPE("optimize");
+        codegen.optimize(opts.opt_level);
+    }
+
+    bool emitted;
+    {
+        APEX_TIME_SCOPE("emit");
+        emitted = codegen.emit_object_file(object_file);
+    }
+    if (!emitted) {
+        diag << "Failed to write output file: " << object_file << "\n";
+        return false;
+    }
+    if (log) *log << "Output written to: " << object_file << std::endl;
+    results[index].object_file = object_file;
+    return true;
+}
+
+} // namespace
+
+int build(const BuildOptions& opts) {
+    APEX_TIME_SCOPE_DETAIL("build", opts.entry_file);
+    std::error_code ec;
+    fs::create_directories(opts.build_dir, ec);
+    if (ec) {
+        std::cerr << "Error: Could not create build directory: " << opts.build_dir << std::endl;
+        return 1;
+    }
+
+    ModuleGraph graph;
+    if (!graph.load(opts.entry_file, opts.build_dir)) {
+        for (const auto& error : graph.get_errors()) {
+            std::cerr << error << std::endl;
+        }
+        return 1;
+    }
+
+    auto waves = graph.waves();
+
+    // A module is rebuilt when its source, the options or anything it
+    // imports changed; its object and .apxmod are reused otherwise
+    std::vector<uint64_t> fingerprints(graph.nodes().size());
+    for (const auto& wave : waves) {
+        for (size_t index : wave) {
+            const ModuleNode& node = *graph.nodes()[index];
+            uint64_t hash = hash_value(opts.opt_level, hash_value(node.source_hash, hash_bytes(node.name)));
+            hash = hash_value(static_cast<uint64_t>(opts.debug_info), hash);
+            hash = hash_value(opts.profiling.frame_pointers + 2 * opts.profiling.instrument_functions +
+                                  4 * opts.profiling.coverage, hash);
+            hash = hash_value(opts.profiling.xray ? opts.profiling.xray_threshold + 1ull : 0, hash);
+            hash = hash_value(opts.sanitizers.address + 2 * opts.sanitizers.undefined + 4 * opts.sanitizers.thread,
+                              hash);
+            for (size_t dep : node.imports) hash = hash_value(fingerprints[dep], hash);
+            fingerprints[index] = hash;
+        }
+    }
+    size_t widest = 0;
+    for (const auto& wave : waves) widest = std::max(widest, wave.size());
+    unsigned jobs = opts.jobs ? opts.jobs : std::max(1u, std::thread::hardware_concurrency());
+    jobs = static_cast<unsigned>(std::min<size_t>(jobs, widest));
+    if (opts.verbose) {
+        std::cout << "Building " << graph.nodes().size() << " module(s) in " << waves.size()
+                  << " wave(s) with " << jobs << " job(s)" << std::endl;
+    }
+
+    // Diagnostics are buffered per module and printed in module order after
+    // each wave, so the output doesn't depend on scheduling
+    std::vector<ModuleResult> results(graph.nodes().size());
+    ThreadPool pool(jobs);
+    for (size_t w = 0; w < waves.size(); w++) {
+        for (size_t index : waves[w]) {
+            pool.submit([&, index] {
+                std::ostringstream diag;
+                std::ostringstream log;
+                results[index].ok = compile_module(graph, index, fingerprints[index], results, opts, diag,
+                                                   opts.verbose ? &log : nullptr);
+                results[index].diagnostics = diag.str();
+                results[index].log = log.str();
+            });
+        }
+        pool.wait();
+
+        bool failed = false;
+        for (size_t index : waves[w]) {
+            std::cout << results[index].log;
+            std::cerr << results[index].diagnostics;
+            failed |= !results[index].ok;
+        }
+        if (failed) return 1;
+    }
+
+    if (opts.compile_only) return 0;
+
+    std::string output_file = opts.output_file;
+    if (output_file.empty()) {
+        output_file = (fs::path(opts.build_dir) / graph.nodes()[0]->name).string();
+    }
+    const char* cc = std::getenv("CC");
+    std::string command = std::string(cc && *cc ? cc : "cc") + " -o " + shell_quote(output_file);
+    for (const auto& result : results) {
+        command += " " + shell_quote(result.object_file);
+    }
+    // Nothing in the program refers to libapex_xray or libapex_coverage;
+    // their constructors have to be pulled in with the whole archive
+    std::vector<std::pair<std::string, bool>> runtimes;
+    if (opts.profiling.instrument_functions) runtimes.emplace_back("libapex_profile.a", false);
+    if (opts.profiling.xray) runtimes.emplace_back("libapex_xray.a", true);
+    if (opts.profiling.coverage) runtimes.emplace_back("libapex_coverage.a", true);
+    for (const auto& [library, whole_archive] : runtimes) {
+        std::string runtime = find_runtime_library(library);
+        if (runtime.empty()) {
+            std::cerr << "Error: " << library << " not found next to apexc or in " << APEX_RUNTIME_DIR << std::endl;
+            return 1;
+        }
+        if (whole_archive) {
+            command += " -Wl,--whole-archive " + shell_quote(runtime) + " -Wl,--no-whole-archive";
+        } else {
+            command += " " + shell_quote(runtime);
+        }
+    }
+    // The sanitizer runtimes come with the C compiler (compiler-rt for clang)
+    std::string sanitizers;
+    if (opts.sanitizers.address) sanitizers += ",address";
+    if (opts.sanitizers.undefined) sanitizers += ",undefined";
+    if (opts.sanitizers.thread) sanitizers += ",thread";
+    if (!sanitizers.empty()) command += " -fsanitize=" + sanitizers.substr(1);
+    if (opts.verbose) std::cout << "Linking: " << command << std::endl;
+    int link_status;
+    {
+        APEX_TIME_SCOPE("link");
+        link_status = std::system(command.c_str());
+    }
+    if (link_status != 0) {
+        std::cerr << "Error: Linking failed: " << command << std::endl;
+        return 1;
+    }
+    if (opts.verbose) std::cout << "Output written to: " << output_file << std::endl;
+    return 0;
+}
+
+} // namespace apex::driver
@@ -0,0 +1,31 @@
+#pragma once
+
+#include "../codegen/CodeGenOptions.h"
+#include <string>
+
+namespace apex::driver {
+
+struct BuildOptions {
+    std::string entry_file;
+    std::string output_file;            // Executable; defaults to <build_dir>/<entry name>
+    std::string build_dir{"build"};     // Object and .apxmod files, one of each per module
+    unsigned opt_level{0};
+    codegen::DebugInfo debug_info{codegen::DebugInfo::None};
+    codegen::ProfilingOptions profiling;
+    codegen::SanitizerOptions sanitizers;   // Also passed to cc, which links their runtimes
+    unsigned jobs{0};                   // 0: one per hardware thread
+    bool compile_only{false};           // Stop after writing the object files
+    std::string time_trace;             // -ftime-trace output, empty if not requested
+    unsigned time_trace_granularity{0}; // Microseconds
+    bool verbose{false};
+};
+
+// `apexc build`: compiles the module graph rooted at the entry file in
+// waves. Modules in a wave only import modules of earlier waves, so they are
+// compiled in parallel; each one writes a .apxmod that the modules importing
+// it compile against instead of its source. Modules whose source, options
+// and imports are unchanged since the last build aren't recompiled. Returns
+// the process exit code.
+int build(const BuildOptions& opts);
+
+} // namespace apex::driver
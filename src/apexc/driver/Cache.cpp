@@ -0,0 +1,75 @@
+#include "Cache.h"
+#include <filesystem>
+#include <fstream>
+#include <sstream>
+
+namespace apex::driver {
+
+namespace fs = std::filesystem;
+
+FileCache& FileCache::instance() {
+    static FileCache cache;
+    return cache;
+}
+
+bool FileCache::read(const std::string& path, std::string& contents) {
+    std::error_code ec;
+    long long mtime = 0;
+    unsigned long long size = 0;
+    if (enabled_) {
+        mtime = fs::last_write_time(path, ec).time_since_epoch().count();
+        if (!ec) size = fs::file_size(path, ec);
+        if (!ec) {
+            std::lock_guard<std::mutex> lock(mutex_);
+            auto it = entries_.find(path);
+            if (it != entries_.end() && it->second.mtime == mtime && it->second.size == size) {
+                contents = it->second.contents;
+                return true;
+            }
+        }
+    }
+
+    std::ifstream file(path, std::ios::binary);
+    if (!file) return false;
+    std::stringstream buffer;
+    buffer << file.rdbuf();
+    contents = buffer.str();
+
+    if (enabled_ && !ec) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        entries_[path] = Entry{mtime, size, contents};
+    }
+    return true;
+}
+
+ObjectCache& ObjectCache::instance() {
+    static ObjectCache cache;
+    return cache;
+}
+
+bool ObjectCache::lookup(const std::string& key, Entry& entry) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto it = entries_.find(key);
+    if (it == entries_.end()) return false;
+    entry = it->second;
+    return true;
+}
+
+void ObjectCache::insert(const std::string& key, Entry entry) {
+    size_t size = key.size() + entry.output.size() + entry.diagnostics.size();
+    if (!enabled() || size > budget_) return;
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (entries_.count(key)) return;
+    while (used_ + size > budget_ && !order_.empty()) {
+        auto it = entries_.find(order_.front());
+        used_ -= it->first.size() + it->second.output.size() + it->second.diagnostics.size();
+        entries_.erase(it);
+        order_.pop_front();
+    }
+    entries_.emplace(key, std::move(entry));
+    order_.push_back(key);
+    used_ += size;
+}
+
+} // namespace apex::driver
@@ -0,0 +1,62 @@
+#pragma once
+
+#include <cstddef>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+
+namespace apex::driver {
+
+// Contents of the files the driver reads (sources and .apxmod files), kept
+// while their size and modification time are unchanged. Off by default: a
+// one-shot compile reads each file once anyway. The compiler server turns it
+// on so repeated compiles of the same tree don't go back to the disk.
+class FileCache {
+public:
+    static FileCache& instance();
+
+    void enable() { enabled_ = true; }
+
+    // False if the file can't be read
+    bool read(const std::string& path, std::string& contents);
+
+private:
+    struct Entry {
+        long long mtime{0};
+        unsigned long long size{0};
+        std::string contents;
+    };
+
+    bool enabled_{false};
+    std::mutex mutex_;
+    std::unordered_map<std::string, Entry> entries_;
+};
+
+// Results of single-file compiles, keyed by everything that determines them
+// (input path, source, options). Also only enabled by the compiler server;
+// the oldest entries are evicted once the outputs exceed the budget.
+class ObjectCache {
+public:
+    struct Entry {
+        std::string output;         // Object file or LLVM IR
+        std::string diagnostics;    // Warnings printed while compiling
+    };
+
+    static ObjectCache& instance();
+
+    void enable(size_t budget_bytes) { budget_ = budget_bytes; }
+    bool enabled() const { return budget_ > 0; }
+
+    bool lookup(const std::string& key, Entry& entry);
+    void insert(const std::string& key, Entry entry);
+
+private:
+    size_t budget_{0};
+    size_t used_{0};
+    std::mutex mutex_;
+    std::unordered_map<std::string, Entry> entries_;
+    std::deque<std::string> order_;    // Insertion order, for eviction
+};
+
+} // namespace apex::driver
@@ -0,0 +1,401 @@
+#include "Coverage.h"
+#include <llvm/Object/ObjectFile.h>
+#include <llvm/ProfileData/InstrProf.h>
+#include <llvm/Support/Error.h>
+#include <algorithm>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <map>
+#include <memory>
+#include <sstream>
+#include <unordered_map>
+
+namespace apex::driver {
+
+namespace {
+
+namespace fs = std::filesystem;
+
+// One `branch` record of the coverage map: an outcome label and its counter
+struct Branch {
+    size_t file;
+    size_t line;
+    size_t column;
+    std::vector<std::pair<std::string, uint32_t>> outcomes;
+};
+
+// One function's part of the coverage map, with the counts of every dump
+// of it added up
+struct MappedFunction {
+    std::string name;
+    uint64_t hash{0};
+    uint32_t num_counters{0};
+    std::vector<std::tuple<uint32_t, size_t, size_t>> lines;    // Counter, file, line
+    std::vector<Branch> branches;
+    std::vector<uint64_t> counts;
+    bool stale{false};
+};
+
+struct CoverageMap {
+    std::vector<std::string> files;
+    std::vector<std::unique_ptr<MappedFunction>> functions;
+    std::unordered_multimap<uint64_t, MappedFunction*> by_name_hash;   // Profile data's NameRef
+};
+
+// Mirrors struct dump_header in runtime/coverage.c
+struct DumpHeader {
+    char magic[8];
+    uint64_t data_begin;
+    uint64_t data_size;
+    uint64_t counters_begin;
+    uint64_t counters_size;
+};
+
+using ProfileRecord = llvm::RawInstrProf::ProfileData<uint64_t>;
+
+bool parse_map(llvm::StringRef text, CoverageMap& map, std::string& error) {
+    std::vector<size_t> module_files;   // Module's file numbers to indices into map.files
+    std::unordered_map<std::string, size_t> file_index;
+    MappedFunction* func = nullptr;
+    std::istringstream in(text.str());
+    for (std::string line; std::getline(in, line);) {
+        line.erase(0, line.find_first_not_of('\0'));
+        if (line.empty()) continue;
+        std::istringstream fields(line);
+        std::string kind;
+        fields >> kind;
+        if (kind == "apexcov") {
+            uint64_t version = 0;
+            fields >> version;
+            if (version != llvm::RawInstrProf::Version) {
+                error = "program was built by an apexc with a different LLVM";
+                return false;
+            }
+            module_files.clear();
+            func = nullptr;
+        } else if (kind == "file") {
+            size_t number;
+            std::string path;
+            fields >> number >> std::ws;
+            std::getline(fields, path);
+            auto [it, inserted] = file_index.try_emplace(path, map.files.size());
+            if (inserted) map.files.push_back(path);
+            if (module_files.size() <= number) module_files.resize(number + 1);
+            module_files[number] = it->second;
+        } else if (kind == "fn") {
+            auto mapped = std::make_unique<MappedFunction>();
+            fields >> mapped->hash >> mapped->num_counters >> std::ws;
+            std::getline(fields, mapped->name);
+            mapped->counts.assign(mapped->num_counters, 0);
+            func = mapped.get();
+            map.by_name_hash.emplace(llvm::IndexedInstrProf::ComputeHash(mapped->name), func);
+            map.functions.push_back(std::move(mapped));
+        } else if (kind == "line" && func) {
+            uint32_t counter;
+            size_t file, number;
+            fields >> counter >> file >> number;
+            if (!fields || counter >= func->num_counters || file >= module_files.size()) {
+                error = "damaged coverage map";
+                return false;
+            }
+            func->lines.emplace_back(counter, module_files[file], number);
+        } else if (kind == "branch" && func) {
+            Branch branch;
+            size_t file;
+            fields >> file >> branch.line >> branch.column;
+            bool valid = fields && file < module_files.size();
+            for (std::string outcome; valid && fields >> outcome;) {
+                size_t equals = outcome.rfind('=');
+                uint32_t counter = equals == std::string::npos ? func->num_counters
+                                 : static_cast<uint32_t>(std::strtoul(outcome.c_str() + equals + 1, nullptr, 10));
+                valid = counter < func->num_counters;
+                if (valid) branch.outcomes.emplace_back(outcome.substr(0, equals), counter);
+            }
+            if (!valid) {
+                error = "damaged coverage map";
+                return false;
+            }
+            branch.file = module_files[file];
+            func->branches.push_back(std::move(branch));
+        } else {
+            error = "damaged coverage map";
+            return false;
+        }
+    }
+    return true;
+}
+
+bool read_map(const std::string& program, CoverageMap& map) {
+    auto binary = llvm::object::ObjectFile::createObjectFile(program);
+    if (!binary) {
+        std::cerr << "Error: " << program << ": " << llvm::toString(binary.takeError()) << std::endl;
+        return false;
+    }
+    bool found = false;
+    for (const auto& section : binary->getBinary()->sections()) {
+        auto name = section.getName();
+        if (!name || *name != "__apex_covmap") {
+            if (!name) llvm::consumeError(name.takeError());
+            continue;
+        }
+        auto contents = section.getContents();
+        if (!contents) {
+            std::cerr << "Error: " << program << ": " << llvm::toString(contents.takeError()) << std::endl;
+            return false;
+        }
+        std::string error;
+        if (!parse_map(*contents, map, error)) {
+            std::cerr << "Error: " << program << ": " << error << std::endl;
+            return false;
+        }
+        found = true;
+    }
+    if (!found) {
+        std::cerr << "Error: " << program << " was not built with -fcoverage" << std::endl;
+        return false;
+    }
+    return true;
+}
+
+// Adds every dump in `path` to the map's counts. A record's counters are
+// found the way LLVM's own reader finds them: CounterPtr is relative to
+// the record's address in the run that wrote it.
+bool read_profile(const std::string& path, CoverageMap& map) {
+    // Read into words, so the records and counters are aligned
+    std::ifstream file(path, std::ios::binary);
+    std::vector<uint64_t> words;
+    size_t size = 0;
+    if (file) {
+        file.seekg(0, std::ios::end);
+        size = static_cast<size_t>(file.tellg());
+        file.seekg(0);
+        words.resize((size + sizeof(uint64_t) - 1) / sizeof(uint64_t));
+        file.read(reinterpret_cast<char*>(words.data()), static_cast<std::streamsize>(size));
+    }
+    if (!file) {
+        std::cerr << "Error: Could not read profile: " << path << std::endl;
+        return false;
+    }
+
+    const char* bytes = reinterpret_cast<const char*>(words.data());
+    size_t offset = 0;
+    while (offset < size) {
+        DumpHeader header;
+        if (size - offset < sizeof(header)) break;
+        std::memcpy(&header, bytes + offset, sizeof(header));
+        offset += sizeof(header);
+        if (std::memcmp(header.magic, "APEXCOV1", sizeof(header.magic)) != 0 ||
+            header.data_size % sizeof(ProfileRecord) != 0 || header.counters_size % sizeof(uint64_t) != 0 ||
+            header.data_size > size - offset || header.counters_size > size - offset - header.data_size) {
+            break;
+        }
+        const auto* records = reinterpret_cast<const ProfileRecord*>(bytes + offset);
+        const auto* counters = reinterpret_cast<const uint64_t*>(bytes + offset + header.data_size);
+        size_t num_records = header.data_size / sizeof(ProfileRecord);
+        size_t num_counters = header.counters_size / sizeof(uint64_t);
+        offset += header.data_size + header.counters_size;
+
+        for (size_t i = 0; i < num_records; i++) {
+            const ProfileRecord& record = records[i];
+            uint64_t at = header.data_begin + i * sizeof(ProfileRecord) + record.CounterPtr - header.counters_begin;
+            auto [first, last] = map.by_name_hash.equal_range(record.NameRef);
+            MappedFunction* func = nullptr;
+            for (auto it = first; it != last; ++it) {
+                if (it->second->hash == record.FuncHash) func = it->second;
+            }
+            if (!func && first != last) first->second->stale = true;
+            if (!func || record.NumCounters != func->num_counters || at % sizeof(uint64_t) != 0 ||
+                at / sizeof(uint64_t) + record.NumCounters > num_counters) {
+                continue;
+            }
+            for (uint32_t c = 0; c < record.NumCounters; c++) func->counts[c] += counters[at / sizeof(uint64_t) + c];
+        }
+    }
+    if (offset != size) {
+        std::cerr << "Error: " << path << " is not a coverage profile, or is damaged" << std::endl;
+        return false;
+    }
+    return true;
+}
+
+// Per file: the count of each line with code, and each branch's outcome
+// counts, in source order
+struct FileCoverage {
+    std::map<size_t, uint64_t> lines;
+    std::map<std::pair<size_t, size_t>, std::vector<std::pair<std::string, uint64_t>>> branches;
+};
+
+// Within a function a line's count is the most any of its blocks ran;
+// copies of the line inlined into other functions ran on top of that
+std::vector<FileCoverage> collect(const CoverageMap& map) {
+    std::vector<FileCoverage> files(map.files.size());
+    for (const auto& func : map.functions) {
+        std::map<std::pair<size_t, size_t>, uint64_t> lines;
+        for (const auto& [counter, file, line] : func->lines) {
+            uint64_t& count = lines[{file, line}];
+            count = std::max(count, func->counts[counter]);
+        }
+        for (const auto& [line, count] : lines) files[line.first].lines[line.second] += count;
+
+        for (const auto& branch : func->branches) {
+            auto& outcomes = files[branch.file].branches[{branch.line, branch.column}];
+            for (const auto& [label, counter] : branch.outcomes) {
+                auto it = std::find_if(outcomes.begin(), outcomes.end(),
+                                       [&](const auto& outcome) { return outcome.first == label; });
+                if (it == outcomes.end()) it = outcomes.insert(outcomes.end(), {label, 0});
+                it->second += func->counts[counter];
+            }
+        }
+    }
+    return files;
+}
+
+// Paths under the current directory are shown relative to it
+std::string display_path(const std::string& path) {
+    std::error_code ec;
+    fs::path relative = fs::path(path).lexically_relative(fs::current_path(ec));
+    if (ec || relative.empty() || *relative.begin() == "..") return path;
+    return relative.string();
+}
+
+struct Totals {
+    size_t lines{0};
+    size_t lines_hit{0};
+    size_t outcomes{0};
+    size_t outcomes_hit{0};
+
+    void add(const FileCoverage& file) {
+        for (const auto& [line, count] : file.lines) {
+            lines++;
+            lines_hit += count > 0;
+        }
+        for (const auto& [location, outcomes_of] : file.branches) {
+            for (const auto& [label, count] : outcomes_of) {
+                outcomes++;
+                outcomes_hit += count > 0;
+            }
+        }
+    }
+};
+
+std::string percent(size_t hit, size_t total) {
+    if (total == 0) return "-";
+    std::ostringstream out;
+    out << std::fixed << std::setprecision(2) << 100.0 * static_cast<double>(hit) / static_cast<double>(total)
+        << "%";
+    return out.str();
+}
+
+void report_lines(std::ostream& out, const std::string& path, const FileCoverage& file) {
+    out << "\n" << display_path(path) << ":\n";
+    std::ifstream source(path);
+    std::vector<std::string> text;
+    for (std::string line; std::getline(source, line);) text.push_back(line);
+    size_t last = std::max(text.size(), file.lines.empty() ? 0 : file.lines.rbegin()->first);
+    auto branch = file.branches.begin();
+    for (size_t number = 1; number <= last; number++) {
+        auto count = file.lines.find(number);
+        out << std::setw(10) << (count == file.lines.end() ? "" : std::to_string(count->second)) << "|"
+            << std::setw(6) << number << "|" << (number <= text.size() ? text[number - 1] : "") << "\n";
+        for (; branch != file.branches.end() && branch->first.first == number; ++branch) {
+            out << std::setw(11) << "|" << std::setw(7) << "|" << "  Branch (" << number << ":"
+                << branch->first.second << "):";
+            const char* separator = " ";
+            for (const auto& [label, taken] : branch->second) {
+                out << separator << label << " " << taken;
+                separator = ", ";
+            }
+            out << "\n";
+        }
+    }
+}
+
+void report_text(std::ostream& out, const CoverageMap& map, const std::vector<FileCoverage>& files,
+                 bool show_lines) {
+    size_t width = 5;
+    for (const auto& path : map.files) width = std::max(width, display_path(path).size());
+    auto row = [&](const std::string& name, const Totals& totals) {
+        out << std::left << std::setw(static_cast<int>(width)) << name << std::right << std::setw(10)
+            << totals.lines << std::setw(10) << totals.lines - totals.lines_hit << std::setw(9)
+            << percent(totals.lines_hit, totals.lines) << std::setw(10) << totals.outcomes << std::setw(10)
+            << totals.outcomes - totals.outcomes_hit << std::setw(9) << percent(totals.outcomes_hit, totals.outcomes)
+            << "\n";
+    };
+    out << std::left << std::setw(static_cast<int>(width)) << "File" << std::right << std::setw(10) << "Lines"
+        << std::setw(10) << "Missed" << std::setw(9) << "Cover" << std::setw(10) << "Branches" << std::setw(10)
+        << "Missed" << std::setw(9) << "Cover" << "\n";
+    Totals all;
+    for (size_t i = 0; i < files.size(); i++) {
+        Totals totals;
+        totals.add(files[i]);
+        all.add(files[i]);
+        row(display_path(map.files[i]), totals);
+    }
+    row("TOTAL", all);
+    if (!show_lines) return;
+    for (size_t i = 0; i < files.size(); i++) report_lines(out, map.files[i], files[i]);
+}
+
+// The lcov tracefile format, for genhtml and editors. Branches on a line
+// are numbered as lcov blocks in column order.
+void report_lcov(std::ostream& out, const CoverageMap& map, const std::vector<FileCoverage>& files) {
+    for (size_t i = 0; i < files.size(); i++) {
+        Totals totals;
+        totals.add(files[i]);
+        out << "SF:" << map.files[i] << "\n";
+        size_t line = 0, block = 0;
+        for (const auto& [location, outcomes] : files[i].branches) {
+            block = location.first == line ? block + 1 : 0;
+            line = location.first;
+            auto count = files[i].lines.find(line);
+            bool ran = count != files[i].lines.end() && count->second > 0;
+            for (size_t o = 0; o < outcomes.size(); o++) {
+                out << "BRDA:" << line << "," << block << "," << o << ","
+                    << (ran ? std::to_string(outcomes[o].second) : "-") << "\n";
+            }
+        }
+        out << "BRF:" << totals.outcomes << "\nBRH:" << totals.outcomes_hit << "\n";
+        for (const auto& [number, count] : files[i].lines) out << "DA:" << number << "," << count << "\n";
+        out << "LF:" << totals.lines << "\nLH:" << totals.lines_hit << "\nend_of_record\n";
+    }
+}
+
+} // namespace
+
+int coverage_report(const CoverageOptions& opts) {
+    CoverageMap map;
+    if (!read_map(opts.program, map)) return 1;
+    std::vector<std::string> profiles = opts.profiles;
+    if (profiles.empty()) profiles.push_back("apex-coverage.raw");
+    for (const auto& profile : profiles) {
+        if (!read_profile(profile, map)) return 1;
+    }
+    for (const auto& func : map.functions) {
+        if (func->stale) {
+            std::cerr << "Warning: profile data for " << func->name << " is from a different build; left out"
+                      << std::endl;
+        }
+    }
+
+    std::ofstream file;
+    if (!opts.report_file.empty()) {
+        file.open(opts.report_file);
+        if (!file) {
+            std::cerr << "Failed to write output file: " << opts.report_file << std::endl;
+            return 1;
+        }
+    }
+    std::ostream& out = opts.report_file.empty() ? std::cout : file;
+    std::vector<FileCoverage> files = collect(map);
+    if (opts.format == "lcov") {
+        report_lcov(out, map, files);
+    } else {
+        report_text(out, map, files, opts.show_lines);
+    }
+    return 0;
+}
+
+} // namespace apex::driver
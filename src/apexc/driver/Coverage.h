@@ -0,0 +1,25 @@
+#pragma once
+
+#include <string>
+#include <vector>
+
+namespace apex::driver {
+
+struct CoverageOptions {
+    std::string program;                // Executable built with -fcoverage
+    std::vector<std::string> profiles;  // Raw profiles; apex-coverage.raw if empty
+    std::string format{"text"};         // text or lcov
+    bool show_lines{false};             // Text: also list each file with a count per line
+    std::string report_file;            // Report destination; stdout if empty
+};
+
+// `apexc cov report`: reads the coverage map apexc embedded in the program
+// (the __apex_covmap section) and adds up the counters of every dump in the
+// profiles that libapex_coverage wrote. A line's count is the number of
+// times code on it ran; a branch has a count per outcome. Functions whose
+// counters don't match the map, from a profile of an older build, are
+// reported and left out. Returns 0 unless the program or a profile can't be
+// read.
+int coverage_report(const CoverageOptions& opts);
+
+} // namespace apex::driver
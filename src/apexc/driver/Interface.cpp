@@ -0,0 +1,76 @@
+#include "Interface.h"
+#include <set>
+#include <string>
+#include <unordered_map>
+
+namespace apex::driver {
+
+namespace {
+
+// Struct names a type mentions. MIR has no opaque structs, so even those
+// behind a pointer need their full definition.
+void referenced_structs(const ast::Type* type, std::vector<std::string>& names) {
+    if (!type) return;
+    if (type->kind == ast::TypeKind::Named && type->path_segments.size() == 1) {
+        names.push_back(type->path_segments[0]);
+    }
+    referenced_structs(type->pointee_type.get(), names);
+    referenced_structs(type->element_type.get(), names);
+    referenced_structs(type->return_type.get(), names);
+    for (const auto& elem : type->tuple_types) referenced_structs(elem.get(), names);
+    for (const auto& param : type->param_types) referenced_structs(param.get(), names);
+}
+
+const ast::Type* destructor_target(const ast::Item& item) {
+    if (item.kind != ast::ItemKind::Function || !item.find_attribute("drop") || item.params.size() != 1) return nullptr;
+    const ast::Type* param = item.params[0].type.get();
+    if (!param || !param->pointee_type || param->pointee_type->path_segments.size() != 1) return nullptr;
+    return param->pointee_type.get();
+}
+
+bool is_public_function(const ast::Item& item) {
+    return item.kind == ast::ItemKind::Function && item.visibility == ast::Visibility::Public &&
+           item.generic_params.empty();
+}
+
+} // namespace
+
+std::vector<const ast::Item*> collect_interface(const ast::Module& module) {
+    std::unordered_map<std::string, const ast::Item*> structs;
+    for (const auto& item : module.items) {
+        if (!item->imported_from && item->kind == ast::ItemKind::Struct) structs[item->name] = item.get();
+    }
+
+    // Public structs and functions, plus every struct they need the layout of
+    std::vector<std::string> pending;
+    for (const auto& item : module.items) {
+        if (item->imported_from || item->visibility != ast::Visibility::Public) continue;
+        if (item->kind == ast::ItemKind::Struct) {
+            pending.push_back(item->name);
+        } else if (is_public_function(*item)) {
+            referenced_structs(item->return_type.get(), pending);
+            for (const auto& param : item->params) referenced_structs(param.type.get(), pending);
+        }
+    }
+    std::set<std::string> needed;
+    while (!pending.empty()) {
+        std::string name = pending.back();
+        pending.pop_back();
+        auto it = structs.find(name);
+        if (it == structs.end() || !needed.insert(name).second) continue;
+        for (const auto& field : it->second->struct_fields) referenced_structs(field.type.get(), pending);
+    }
+
+    std::vector<const ast::Item*> interface;
+    for (const auto& item : module.items) {
+        if (item->imported_from) continue;
+        const ast::Type* target = destructor_target(*item);
+        if ((item->kind == ast::ItemKind::Struct && needed.count(item->name)) || is_public_function(*item) ||
+            (target && needed.count(target->path_segments[0]))) {
+            interface.push_back(item.get());
+        }
+    }
+    return interface;
+}
+
+} // namespace apex::driver
@@ -0,0 +1,14 @@
+#pragma once
+
+#include "../ast/AST.h"
+#include <vector>
+
+namespace apex::driver {
+
+// The declarations a module's dependents compile against: public functions
+// (used as body-less declarations), public structs, the private structs
+// those lay out with, and the destructors of all of them, in source order.
+// Taken after sema, so every type name is already bare.
+std::vector<const ast::Item*> collect_interface(const ast::Module& module);
+
+} // namespace apex::driver
@@ -0,0 +1,555 @@
+#include "ModuleFile.h"
+#include <cstring>
+
+namespace apex::driver {
+
+namespace {
+
+constexpr char MAGIC[] = "APXMOD";
+constexpr uint64_t FORMAT_VERSION = 3;
+
+// Integers are LEB128 varints (signed ones zigzag-encoded), strings are a
+// length followed by the bytes
+class Writer {
+public:
+    std::string data;
+
+    void u64(uint64_t value) {
+        do {
+            uint8_t byte = value & 0x7f;
+            value >>= 7;
+            data += static_cast<char>(value ? byte | 0x80 : byte);
+        } while (value);
+    }
+    void i64(int64_t value) { u64((static_cast<uint64_t>(value) << 1) ^ static_cast<uint64_t>(value >> 63)); }
+    void boolean(bool value) { u64(value ? 1 : 0); }
+    void str(const std::string& value) {
+        u64(value.size());
+        data += value;
+    }
+    void fixed64(uint64_t value) {
+        for (int i = 0; i < 8; i++) data += static_cast<char>((value >> (8 * i)) & 0xff);
+    }
+};
+
+// Every read checks bounds; after the first failure `ok` stays false and
+// reads return zeroes
+class Reader {
+public:
+    explicit Reader(const std::string& data) : data_(data) {}
+
+    bool ok{true};
+
+    uint64_t u64() {
+        uint64_t value = 0;
+        for (unsigned shift = 0; shift < 64; shift += 7) {
+            if (pos_ >= data_.size()) return fail();
+            uint8_t byte = static_cast<uint8_t>(data_[pos_++]);
+            value |= static_cast<uint64_t>(byte & 0x7f) << shift;
+            if (!(byte & 0x80)) return value;
+        }
+        return fail();
+    }
+    int64_t i64() {
+        uint64_t value = u64();
+        return static_cast<int64_t>((value >> 1) ^ (~(value & 1) + 1));
+    }
+    bool boolean() { return u64() != 0; }
+    std::string str() {
+        uint64_t size = u64();
+        if (!ok || size > data_.size() - pos_) return fail(), std::string();
+        std::string value = data_.substr(pos_, size);
+        pos_ += size;
+        return value;
+    }
+    uint64_t fixed64() {
+        if (data_.size() - pos_ < 8) return fail();
+        uint64_t value = 0;
+        for (int i = 0; i < 8; i++) value |= static_cast<uint64_t>(static_cast<uint8_t>(data_[pos_++])) << (8 * i);
+        return value;
+    }
+    // Element counts can't exceed the remaining bytes; guards allocations
+    size_t count() {
+        uint64_t value = u64();
+        if (value > data_.size() - pos_) return fail();
+        return static_cast<size_t>(value);
+    }
+    template <typename E>
+    E enumerator(E last) {
+        uint64_t value = u64();
+        if (value > static_cast<uint64_t>(last)) return fail(), E{};
+        return static_cast<E>(value);
+    }
+    bool expect(const char* bytes, size_t size) {
+        if (data_.size() - pos_ < size || std::memcmp(data_.data() + pos_, bytes, size) != 0) return fail();
+        pos_ += size;
+        return true;
+    }
+
+private:
+    const std::string& data_;
+    size_t pos_{0};
+
+    uint64_t fail() {
+        ok = false;
+        pos_ = data_.size();
+        return 0;
+    }
+};
+
+// ---- Locations: the file is the module's source, stored once in the header
+
+void write_location(Writer& w, const SourceLocation& loc) {
+    w.u64(loc.line);
+    w.u64(loc.column);
+}
+
+SourceLocation read_location(Reader& r, const std::string& path) {
+    size_t line = r.u64();
+    size_t column = r.u64();
+    return SourceLocation(path, line, column, 0);
+}
+
+// ---- AST declarations
+
+void write_type(Writer& w, const ast::Type* type) {
+    w.boolean(type != nullptr);
+    if (!type) return;
+    w.u64(static_cast<uint64_t>(type->kind));
+    w.boolean(type->primitive_name.has_value());
+    if (type->primitive_name) w.str(*type->primitive_name);
+    w.boolean(type->is_mutable);
+    write_type(w, type->pointee_type.get());
+    write_type(w, type->element_type.get());
+    w.boolean(type->array_size.has_value());
+    if (type->array_size) w.u64(*type->array_size);
+    w.u64(type->tuple_types.size());
+    for (const auto& elem : type->tuple_types) write_type(w, elem.get());
+    w.u64(type->param_types.size());
+    for (const auto& param : type->param_types) write_type(w, param.get());
+    write_type(w, type->return_type.get());
+    w.u64(type->path_segments.size());
+    for (const auto& segment : type->path_segments) w.str(segment);
+}
+
+std::unique_ptr<ast::Type> read_type(Reader& r, const std::string& path) {
+    if (!r.boolean() || !r.ok) return nullptr;
+    auto kind = r.enumerator(ast::TypeKind::Generic);
+    auto type = std::make_unique<ast::Type>(kind, SourceLocation(path, 1, 1, 0));
+    if (r.boolean()) type->primitive_name = r.str();
+    type->is_mutable = r.boolean();
+    type->pointee_type = read_type(r, path);
+    type->element_type = read_type(r, path);
+    if (r.boolean()) type->array_size = r.u64();
+    for (size_t i = 0, n = r.count(); i < n && r.ok; i++) type->tuple_types.push_back(read_type(r, path));
+    for (size_t i = 0, n = r.count(); i < n && r.ok; i++) type->param_types.push_back(read_type(r, path));
+    type->return_type = read_type(r, path);
+    for (size_t i = 0, n = r.count(); i < n && r.ok; i++) type->path_segments.push_back(r.str());
+    return type;
+}
+
+void write_item(Writer& w, const ast::Item& item) {
+    w.u64(static_cast<uint64_t>(item.kind));
+    w.u64(static_cast<uint64_t>(item.visibility));
+    w.str(item.name);
+    write_location(w, item.location);
+    w.u64(item.attributes.size());
+    for (const auto& attr : item.attributes) {
+        w.str(attr.name);
+        w.u64(attr.args.size());
+        for (const auto& arg : attr.args) w.str(arg);
+    }
+    if (item.kind == ast::ItemKind::Function) {
+        w.u64(item.params.size());
+        for (const auto& param : item.params) {
+            w.str(param.name);
+            write_type(w, param.type.get());
+        }
+        write_type(w, item.return_type.get());
+    } else {
+        w.u64(item.struct_fields.size());
+        for (const auto& field : item.struct_fields) {
+            w.u64(static_cast<uint64_t>(field.visibility));
+            w.str(field.name);
+            write_type(w, field.type.get());
+        }
+    }
+}
+
+// Functions come back as declarations, structs with their fields
+std::unique_ptr<ast::Item> read_item(Reader& r, const ModuleHeader& header) {
+    auto kind = r.enumerator(ast::ItemKind::Extern);
+    if (kind != ast::ItemKind::Function && kind != ast::ItemKind::Struct) {
+        r.ok = false;
+        return nullptr;
+    }
+    auto item = std::make_unique<ast::Item>(kind, SourceLocation(header.path, 1, 1, 0));
+    item->visibility = r.enumerator(ast::Visibility::Public);
+    item->name = r.str();
+    item->location = read_location(r, header.path);
+    item->imported_from = header.name;
+    for (size_t i = 0, n = r.count(); i < n && r.ok; i++) {
+        ast::Attribute attr;
+        attr.name = r.str();
+        attr.location = item->location;
+        for (size_t j = 0, m = r.count(); j < m && r.ok; j++) attr.args.push_back(r.str());
+        item->attributes.push_back(std::move(attr));
+    }
+    if (kind == ast::ItemKind::Function) {
+        for (size_t i = 0, n = r.count(); i < n && r.ok; i++) {
+            ast::FunctionParam param;
+            param.name = r.str();
+            param.type = read_type(r, header.path);
+            param.location = item->location;
+            item->params.push_back(std::move(param));
+        }
+        item->return_type = read_type(r, header.path);
+    } else {
+        for (size_t i = 0, n = r.count(); i < n && r.ok; i++) {
+            ast::StructField field;
+            field.visibility = r.enumerator(ast::Visibility::Public);
+            field.name = r.str();
+            field.type = read_type(r, header.path);
+            field.location = item->location;
+            item->struct_fields.push_back(std::move(field));
+        }
+    }
+    return item;
+}
+
+// ---- MIR
+
+void write_type(Writer& w, const mir::Type& type) {
+    w.u64(static_cast<uint64_t>(type.kind));
+    w.u64(type.bits);
+    w.boolean(type.is_signed);
+    w.boolean(type.is_mutable);
+    w.boolean(type.pointee != nullptr);
+    if (type.pointee) write_type(w, *type.pointee);
+    w.u64(type.length);
+    w.str(type.struct_name);
+}
+
+mir::Type read_mir_type(Reader& r, unsigned depth = 0) {
+    mir::Type type;
+    type.kind = r.enumerator(mir::TypeKind::Array);
+    type.bits = static_cast<unsigned>(r.u64());
+    type.is_signed = r.boolean();
+    type.is_mutable = r.boolean();
+    if (r.boolean()) {
+        if (depth > 64) {
+            r.ok = false;
+            return type;
+        }
+        type.pointee = std::make_shared<mir::Type>(read_mir_type(r, depth + 1));
+    }
+    type.length = r.u64();
+    type.struct_name = r.str();
+    return type;
+}
+
+void write_place(Writer& w, const mir::Place& place) {
+    w.u64(place.local);
+    w.u64(place.projection.size());
+    for (const auto& elem : place.projection) {
+        w.u64(static_cast<uint64_t>(elem.kind));
+        w.u64(elem.field_index);
+    }
+}
+
+mir::Place read_place(Reader& r) {
+    mir::Place place(static_cast<mir::LocalId>(r.u64()));
+    for (size_t i = 0, n = r.count(); i < n && r.ok; i++) {
+        mir::ProjectionElem elem;
+        elem.kind = r.enumerator(mir::ProjectionKind::Field);
+        elem.field_index = static_cast<unsigned>(r.u64());
+        place.projection.push_back(elem);
+    }
+    return place;
+}
+
+void write_operand(Writer& w, const mir::Operand& op) {
+    w.u64(static_cast<uint64_t>(op.kind));
+    if (op.is_place()) {
+        write_place(w, op.place);
+        return;
+    }
+    write_type(w, op.constant.type);
+    w.u64(op.constant.value.index());
+    if (auto* i = std::get_if<int64_t>(&op.constant.value)) {
+        w.i64(*i);
+    } else if (auto* d = std::get_if<double>(&op.constant.value)) {
+        uint64_t bits;
+        std::memcpy(&bits, d, sizeof(bits));
+        w.fixed64(bits);
+    } else {
+        w.boolean(std::get<bool>(op.constant.value));
+    }
+}
+
+mir::Operand read_operand(Reader& r) {
+    mir::Operand op;
+    op.kind = r.enumerator(mir::OperandKind::Constant);
+    if (op.is_place()) {
+        op.place = read_place(r);
+        return op;
+    }
+    op.constant.type = read_mir_type(r);
+    switch (r.u64()) {
+        case 0: op.constant.value = r.i64(); break;
+        case 1: {
+            uint64_t bits = r.fixed64();
+            double value;
+            std::memcpy(&value, &bits, sizeof(value));
+            op.constant.value = value;
+            break;
+        }
+        case 2: op.constant.value = r.boolean(); break;
+        default: r.ok = false; break;
+    }
+    return op;
+}
+
+void write_rvalue(Writer& w, const mir::Rvalue& rv) {
+    w.u64(static_cast<uint64_t>(rv.kind));
+    w.u64(rv.operands.size());
+    for (const auto& op : rv.operands) write_operand(w, op);
+    w.u64(static_cast<uint64_t>(rv.bin_op));
+    w.u64(static_cast<uint64_t>(rv.un_op));
+    w.boolean(rv.no_overflow);
+    write_place(w, rv.place);
+    w.boolean(rv.is_mutable);
+    write_type(w, rv.type);
+}
+
+mir::Rvalue read_rvalue(Reader& r) {
+    mir::Rvalue rv;
+    rv.kind = r.enumerator(mir::RvalueKind::Cast);
+    for (size_t i = 0, n = r.count(); i < n && r.ok; i++) rv.operands.push_back(read_operand(r));
+    rv.bin_op = r.enumerator(mir::BinOp::Ge);
+    rv.un_op = r.enumerator(mir::UnOp::Not);
+    rv.no_overflow = r.boolean();
+    rv.place = read_place(r);
+    rv.is_mutable = r.boolean();
+    rv.type = read_mir_type(r);
+    return rv;
+}
+
+void write_function(Writer& w, const mir::Function& func) {
+    w.str(func.name);
+    write_location(w, func.location);
+    write_type(w, func.return_type);
+    w.u64(func.arg_count);
+    w.boolean(func.is_extern);
+    w.boolean(func.is_public);
+    w.boolean(func.is_exported);
+    w.boolean(func.is_destructor);
+    w.u64(static_cast<uint64_t>(func.inline_hint));
+
+    w.u64(func.locals.size());
+    for (const auto& decl : func.locals) {
+        w.str(decl.name);
+        write_type(w, decl.type);
+        w.boolean(decl.is_mutable);
+        write_location(w, decl.location);
+        w.boolean(decl.range.has_value());
+        if (decl.range) {
+            w.i64(decl.range->lo);
+            w.i64(decl.range->hi);
+        }
+        w.u64(decl.align);
+    }
+
+    w.u64(func.blocks.size());
+    for (const auto& block : func.blocks) {
+        w.u64(block.statements.size());
+        for (const auto& stmt : block.statements) {
+            w.u64(static_cast<uint64_t>(stmt.kind));
+            write_location(w, stmt.location);
+            if (stmt.kind == mir::StatementKind::Assign) {
+                write_place(w, stmt.place);
+                write_rvalue(w, stmt.rvalue);
+            } else {
+                w.u64(stmt.local);
+            }
+        }
+
+        w.boolean(block.terminator.has_value());
+        if (!block.terminator) continue;
+        const mir::Terminator& term = *block.terminator;
+        w.u64(static_cast<uint64_t>(term.kind));
+        write_location(w, term.location);
+        w.u64(term.target);
+        write_operand(w, term.discriminant);
+        w.u64(term.values.size());
+        for (int64_t value : term.values) w.i64(value);
+        w.u64(term.targets.size());
+        for (mir::BlockId target : term.targets) w.u64(target);
+        w.boolean(term.source_branch);
+        w.str(term.callee);
+        w.u64(term.args.size());
+        for (const auto& arg : term.args) write_operand(w, arg);
+        write_place(w, term.destination);
+        write_place(w, term.place);
+    }
+}
+
+// Every local and block number read is checked, and a SwitchInt has one
+// more target than values, so a damaged file can't make later passes index
+// out of bounds
+bool valid_place(const mir::Place& place, size_t num_locals) { return place.local < num_locals; }
+
+bool valid_operand(const mir::Operand& op, size_t num_locals) {
+    return !op.is_place() || valid_place(op.place, num_locals);
+}
+
+bool valid_rvalue(const mir::Rvalue& rv, size_t num_locals) {
+    for (const auto& op : rv.operands) {
+        if (!valid_operand(op, num_locals)) return false;
+    }
+    return valid_place(rv.place, num_locals);
+}
+
+bool valid_terminator(const mir::Terminator& term, size_t num_locals, size_t num_blocks) {
+    for (mir::BlockId succ : term.successors()) {
+        if (succ >= num_blocks) return false;
+    }
+    if (term.kind == mir::TerminatorKind::SwitchInt && term.targets.size() != term.values.size() + 1) return false;
+    for (const auto& arg : term.args) {
+        if (!valid_operand(arg, num_locals)) return false;
+    }
+    return valid_operand(term.discriminant, num_locals) && valid_place(term.destination, num_locals) &&
+           valid_place(term.place, num_locals);
+}
+
+std::unique_ptr<mir::Function> read_function(Reader& r, const std::string& path) {
+    auto func = std::make_unique<mir::Function>();
+    func->name = r.str();
+    func->location = read_location(r, path);
+    func->return_type = read_mir_type(r);
+    func->arg_count = r.u64();
+    func->is_extern = r.boolean();
+    func->is_public = r.boolean();
+    func->is_exported = r.boolean();
+    func->is_destructor = r.boolean();
+    func->inline_hint = r.enumerator(mir::InlineHint::Never);
+
+    for (size_t i = 0, n = r.count(); i < n && r.ok; i++) {
+        mir::LocalDecl decl;
+        decl.name = r.str();
+        decl.type = read_mir_type(r);
+        decl.is_mutable = r.boolean();
+        decl.location = read_location(r, path);
+        if (r.boolean()) {
+            int64_t lo = r.i64();
+            int64_t hi = r.i64();
+            decl.range = mir::ValueRange{lo, hi};
+        }
+        decl.align = static_cast<unsigned>(r.u64());
+        if (decl.align & (decl.align - 1)) r.ok = false;
+        func->locals.push_back(std::move(decl));
+    }
+    size_t num_locals = func->locals.size();
+    if (func->arg_count >= num_locals && !func->is_extern) r.ok = false;
+
+    size_t num_blocks = r.count();
+    func->blocks.resize(num_blocks);
+    for (auto& block : func->blocks) {
+        if (!r.ok) break;
+        for (size_t i = 0, n = r.count(); i < n && r.ok; i++) {
+            mir::Statement stmt;
+            stmt.kind = r.enumerator(mir::StatementKind::Nop);
+            stmt.location = read_location(r, path);
+            if (stmt.kind == mir::StatementKind::Assign) {
+                stmt.place = read_place(r);
+                stmt.rvalue = read_rvalue(r);
+                if (!valid_place(stmt.place, num_locals) || !valid_rvalue(stmt.rvalue, num_locals)) r.ok = false;
+            } else {
+                stmt.local = static_cast<mir::LocalId>(r.u64());
+                if (stmt.local >= num_locals) r.ok = false;
+            }
+            block.statements.push_back(std::move(stmt));
+        }
+
+        if (!r.boolean()) continue;
+        mir::Terminator term;
+        term.kind = r.enumerator(mir::TerminatorKind::Drop);
+        term.location = read_location(r, path);
+        term.target = static_cast<mir::BlockId>(r.u64());
+        term.discriminant = read_operand(r);
+        for (size_t i = 0, n = r.count(); i < n && r.ok; i++) term.values.push_back(r.i64());
+        for (size_t i = 0, n = r.count(); i < n && r.ok; i++) term.targets.push_back(static_cast<mir::BlockId>(r.u64()));
+        term.source_branch = r.boolean();
+        term.callee = r.str();
+        for (size_t i = 0, n = r.count(); i < n && r.ok; i++) term.args.push_back(read_operand(r));
+        term.destination = read_place(r);
+        term.place = read_place(r);
+        if (!valid_terminator(term, num_locals, num_blocks)) r.ok = false;
+        block.terminator = std::move(term);
+    }
+    return func;
+}
+
+void write_header(Writer& w, const ModuleHeader& header) {
+    w.data.append(MAGIC, sizeof(MAGIC));
+    w.u64(FORMAT_VERSION);
+    w.str(header.name);
+    w.str(header.path);
+    w.fixed64(header.source_hash);
+    w.fixed64(header.fingerprint);
+    w.u64(header.imports.size());
+    for (const auto& import : header.imports) w.str(import);
+}
+
+bool read_header(Reader& r, ModuleHeader& header) {
+    if (!r.expect(MAGIC, sizeof(MAGIC)) || r.u64() != FORMAT_VERSION) return false;
+    header.name = r.str();
+    header.path = r.str();
+    header.source_hash = r.fixed64();
+    header.fingerprint = r.fixed64();
+    header.imports.clear();
+    for (size_t i = 0, n = r.count(); i < n && r.ok; i++) header.imports.push_back(r.str());
+    return r.ok;
+}
+
+} // namespace
+
+uint64_t hash_bytes(const std::string& data, uint64_t seed) {
+    uint64_t hash = seed;
+    for (char c : data) {
+        hash ^= static_cast<uint8_t>(c);
+        hash *= 0x100000001b3ULL;
+    }
+    return hash;
+}
+
+std::string encode_module_file(const ModuleHeader& header, const std::vector<const ast::Item*>& interface,
+                               const std::vector<const mir::Function*>& functions) {
+    Writer w;
+    write_header(w, header);
+    w.u64(interface.size());
+    for (const ast::Item* item : interface) write_item(w, *item);
+    w.u64(functions.size());
+    for (const mir::Function* func : functions) write_function(w, *func);
+    return std::move(w.data);
+}
+
+bool decode_module_header(const std::string& data, ModuleHeader& header) {
+    Reader r(data);
+    return read_header(r, header);
+}
+
+bool decode_module_file(const std::string& data, ModuleFile& file) {
+    Reader r(data);
+    if (!read_header(r, file.header)) return false;
+    for (size_t i = 0, n = r.count(); i < n && r.ok; i++) {
+        auto item = read_item(r, file.header);
+        if (item) file.interface.push_back(std::move(item));
+    }
+    for (size_t i = 0, n = r.count(); i < n && r.ok; i++) {
+        file.functions.push_back(read_function(r, file.header.path));
+    }
+    return r.ok;
+}
+
+} // namespace apex::driver
@@ -0,0 +1,45 @@
+#pragma once
+
+#include "../ast/AST.h"
+#include "../mir/MIR.h"
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace apex::driver {
+
+// A .apxmod file is what importers need from a compiled module, in a
+// compact binary encoding, so they never lex or parse its source:
+//   - the header: module name, source path and content hash, the imports,
+//     and a fingerprint over the source, the options and the fingerprints
+//     of every import (a module is up to date when its fingerprint matches)
+//   - the interface declarations (see collect_interface)
+//   - optimized MIR of the public functions small enough to inline, plus
+//     declarations of whatever those call
+// The header comes first so that checking freshness doesn't decode the rest.
+struct ModuleHeader {
+    std::string name;
+    std::string path;
+    uint64_t source_hash{0};
+    uint64_t fingerprint{0};
+    std::vector<std::string> imports;
+};
+
+struct ModuleFile {
+    ModuleHeader header;
+    std::vector<std::unique_ptr<ast::Item>> interface;        // Marked as imported from the module
+    std::vector<std::unique_ptr<mir::Function>> functions;
+};
+
+// 64-bit FNV-1a
+uint64_t hash_bytes(const std::string& data, uint64_t seed = 0xcbf29ce484222325ULL);
+
+std::string encode_module_file(const ModuleHeader& header, const std::vector<const ast::Item*>& interface,
+                               const std::vector<const mir::Function*>& functions);
+
+// Both fail on anything malformed or written by another format version
+bool decode_module_header(const std::string& data, ModuleHeader& header);
+bool decode_module_file(const std::string& data, ModuleFile& file);
+
+} // namespace apex::driver
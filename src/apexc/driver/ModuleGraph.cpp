@@ -0,0 +1,200 @@
+#include "ModuleGraph.h"
+#include "Cache.h"
+#include "../lexer/Lexer.h"
+#include "../parser/Parser.h"
+#include <algorithm>
+#include <filesystem>
+#include <functional>
+#include <sstream>
+
+namespace apex::driver {
+
+namespace fs = std::filesystem;
+
+std::string artifact_name(const std::string& module) {
+    std::string name;
+    for (size_t i = 0; i < module.size(); i++) {
+        if (module.compare(i, 2, "::") == 0) {
+            name += '.';
+            i++;
+        } else {
+            name += module[i];
+        }
+    }
+    return name;
+}
+
+std::unique_ptr<ast::Module> parse_source(const std::string& source, const std::string& path,
+                                          std::vector<std::string>& errors) {
+    Lexer lexer(source, path);
+    auto tokens = lexer.tokenize_all();
+    if (lexer.has_errors()) {
+        errors.insert(errors.end(), lexer.get_errors().begin(), lexer.get_errors().end());
+        return nullptr;
+    }
+    Parser parser(std::move(tokens));
+    auto module = parser.parse_module();
+    if (parser.has_errors()) {
+        errors.insert(errors.end(), parser.get_errors().begin(), parser.get_errors().end());
+        return nullptr;
+    }
+    return module;
+}
+
+bool ModuleGraph::load(const std::string& entry_file, const std::string& cache_dir) {
+    root_ = fs::path(entry_file).parent_path().string();
+
+    auto entry = std::make_unique<ModuleNode>();
+    entry->name = fs::path(entry_file).stem().string();
+    entry->path = entry_file;
+    by_name_[entry->name] = 0;
+    nodes_.push_back(std::move(entry));
+
+    // Breadth-first, so modules are numbered in discovery order
+    for (size_t index = 0; index < nodes_.size(); index++) {
+        ModuleNode& node = *nodes_[index];
+        if (!read_module(node, cache_dir)) continue;
+
+        if (node.cached) {
+            SourceLocation loc(node.path, 1, 1, 0);
+            for (const auto& import : node.cached->imports) {
+                std::vector<std::string> import_path;
+                for (size_t pos = 0;;) {
+                    size_t sep = import.find("::", pos);
+                    import_path.push_back(import.substr(pos, sep - pos));
+                    if (sep == std::string::npos) break;
+                    pos = sep + 2;
+                }
+                add_import(index, import_path, loc);
+            }
+        } else {
+            for (const auto& item : node.ast->items) {
+                if (item->kind == ast::ItemKind::Import) add_import(index, item->import_path, item->location);
+            }
+        }
+    }
+
+    return !has_errors() && assign_waves();
+}
+
+// Reads the source, then either a matching .apxmod header or the parsed source
+bool ModuleGraph::read_module(ModuleNode& node, const std::string& cache_dir) {
+    if (!FileCache::instance().read(node.path, node.source)) {
+        errors_.push_back("error: Could not open file: " + node.path);
+        return false;
+    }
+    node.source_hash = hash_bytes(node.source);
+
+    std::string data;
+    if (!cache_dir.empty() &&
+        FileCache::instance().read((fs::path(cache_dir) / (artifact_name(node.name) + ".apxmod")).string(), data)) {
+        ModuleHeader header;
+        if (decode_module_header(data, header) && header.name == node.name && header.source_hash == node.source_hash) {
+            node.cached = std::move(header);
+            node.cached_data = std::move(data);
+            return true;
+        }
+    }
+
+    node.ast = parse_source(node.source, node.path, errors_);
+    if (!node.ast) return false;
+    node.ast->name = node.name;
+    return true;
+}
+
+void ModuleGraph::add_import(size_t importer, const std::vector<std::string>& import_path,
+                             const SourceLocation& loc) {
+    std::string name;
+    for (const auto& segment : import_path) {
+        name += (name.empty() ? "" : "::") + segment;
+    }
+
+    auto known = by_name_.find(name);
+    if (known != by_name_.end()) {
+        nodes_[importer]->imports.push_back(known->second);
+        return;
+    }
+    std::string path = find_module(import_path);
+    if (path.empty()) {
+        error(loc, "Cannot find module '" + name + "'");
+        return;
+    }
+    auto dep = std::make_unique<ModuleNode>();
+    dep->name = name;
+    dep->path = path;
+    by_name_[name] = nodes_.size();
+    nodes_[importer]->imports.push_back(nodes_.size());
+    nodes_.push_back(std::move(dep));
+}
+
+std::string ModuleGraph::find_module(const std::vector<std::string>& import_path) const {
+    fs::path dir = root_;
+    for (const auto& segment : import_path) dir /= segment;
+
+    fs::path file = dir;
+    file += ".apx";
+    if (fs::is_regular_file(file)) return file.string();
+    if (fs::is_regular_file(dir / "mod.apx")) return (dir / "mod.apx").string();
+    return "";
+}
+
+// Depth-first; a module still on the stack when reached again closes a cycle
+bool ModuleGraph::assign_waves() {
+    enum class Mark { None, Active, Done };
+    std::vector<Mark> marks(nodes_.size(), Mark::None);
+    std::vector<size_t> stack;
+
+    std::function<bool(size_t)> visit = [&](size_t index) {
+        marks[index] = Mark::Active;
+        stack.push_back(index);
+        ModuleNode& node = *nodes_[index];
+        for (size_t dep : node.imports) {
+            if (marks[dep] == Mark::Active) {
+                std::string cycle;
+                auto start = std::find(stack.begin(), stack.end(), dep);
+                for (auto it = start; it != stack.end(); ++it) cycle += nodes_[*it]->name + " -> ";
+                errors_.push_back(node.path + ": error: Import cycle: " + cycle + nodes_[dep]->name);
+                return false;
+            }
+            if (marks[dep] == Mark::None && !visit(dep)) return false;
+            node.wave = std::max(node.wave, nodes_[dep]->wave + 1);
+        }
+        stack.pop_back();
+        marks[index] = Mark::Done;
+        return true;
+    };
+    return visit(0);
+}
+
+std::vector<std::vector<size_t>> ModuleGraph::waves() const {
+    std::vector<std::vector<size_t>> result;
+    for (size_t index = 0; index < nodes_.size(); index++) {
+        size_t wave = nodes_[index]->wave;
+        if (result.size() <= wave) result.resize(wave + 1);
+        result[wave].push_back(index);
+    }
+    return result;
+}
+
+std::vector<size_t> ModuleGraph::dependencies(size_t index) const {
+    std::vector<bool> seen(nodes_.size(), false);
+    std::vector<size_t> order;
+    std::function<void(size_t)> visit = [&](size_t current) {
+        for (size_t dep : nodes_[current]->imports) {
+            if (seen[dep]) continue;
+            seen[dep] = true;
+            visit(dep);
+            order.push_back(dep);
+        }
+    };
+    visit(index);
+    return order;
+}
+
+void ModuleGraph::error(const SourceLocation& loc, const std::string& message) {
+    std::ostringstream oss;
+    oss << loc.filename << ":" << loc.line << ":" << loc.column << ": error: " << message;
+    errors_.push_back(oss.str());
+}
+
+} // namespace apex::driver
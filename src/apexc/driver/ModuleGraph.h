@@ -0,0 +1,69 @@
+#pragma once
+
+#include "ModuleFile.h"
+#include "../ast/AST.h"
+#include <cstdint>
+#include <memory>
+#include <optional>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace apex::driver {
+
+struct ModuleNode {
+    std::string name;                   // a::b; the entry module is named after its file
+    std::string path;                   // Source file
+    std::string source;
+    uint64_t source_hash{0};
+    std::unique_ptr<ast::Module> ast;   // Null until parsed
+    std::vector<size_t> imports;        // Direct dependencies
+    size_t wave{0};                     // 0 for modules without imports, else 1 + the deepest import
+
+    // A .apxmod written for this very source, kept undecoded for importers
+    std::optional<ModuleHeader> cached;
+    std::string cached_data;
+};
+
+// a::b -> a.b: the stem of a module's object and .apxmod files
+std::string artifact_name(const std::string& module);
+
+std::unique_ptr<ast::Module> parse_source(const std::string& source, const std::string& path,
+                                          std::vector<std::string>& errors);
+
+// The modules reachable from an entry file through `import` declarations.
+// `import a::b;` is looked up as a/b.apx, then a/b/mod.apx, relative to the
+// directory of the entry file. Imports must not form a cycle.
+//
+// When `cache_dir` holds a .apxmod whose source hash matches a module's
+// source, the imports are taken from it and the source isn't parsed.
+class ModuleGraph {
+public:
+    bool load(const std::string& entry_file, const std::string& cache_dir = "");
+
+    const std::vector<std::unique_ptr<ModuleNode>>& nodes() const { return nodes_; }
+    ModuleNode& node(size_t index) { return *nodes_[index]; }
+
+    // Modules grouped by wave; a wave only depends on earlier ones
+    std::vector<std::vector<size_t>> waves() const;
+
+    // Everything `index` depends on, directly or not, dependencies first
+    std::vector<size_t> dependencies(size_t index) const;
+
+    const std::vector<std::string>& get_errors() const { return errors_; }
+    bool has_errors() const { return !errors_.empty(); }
+
+private:
+    std::string root_;
+    std::vector<std::unique_ptr<ModuleNode>> nodes_;
+    std::unordered_map<std::string, size_t> by_name_;
+    std::vector<std::string> errors_;
+
+    bool read_module(ModuleNode& node, const std::string& cache_dir);
+    std::string find_module(const std::vector<std::string>& import_path) const;
+    void add_import(size_t importer, const std::vector<std::string>& import_path, const SourceLocation& loc);
+    bool assign_waves();
+    void error(const SourceLocation& loc, const std::string& message);
+};
+
+} // namespace apex::driver
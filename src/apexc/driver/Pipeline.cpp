@@ -0,0 +1,72 @@
+#include "Pipeline.h"
+#include "Stats.h"
+#include "../mir/MIRBuilder.h"
+#include "../mir/InitCheck.h"
+#include "../mir/BorrowCheck.h"
+#include "../mir/ElaborateDrops.h"
+
+namespace apex::driver {
+
+namespace {
+
+void print(std::ostream& diag, const std::vector<std::string>& messages) {
+    for (const auto& message : messages) {
+        diag << message << "\n";
+    }
+}
+
+} // namespace
+
+std::unique_ptr<mir::Module> check_module(ast::Module* module, sema::SemanticAnalyzer& analyzer,
+                                          std::ostream& diag, std::ostream* log, CompileStats* stats) {
+    // Semantic analysis
+    if (log) *log << "Starting semantic analysis..." << std::endl;
+    {
+        CompileStats::Phase phase(stats, "sema");
+        if (!analyzer.analyze(module)) {
+            print(diag, analyzer.get_errors());
+            return nullptr;
+        }
+    }
+    print(diag, analyzer.get_warnings());
+    if (log) *log << "Semantic analysis completed\n";
+    
+    // MIR construction
+    if (log) *log << "Building MIR..." << std::endl;
+    std::unique_ptr<mir::Module> mir_module;
+    {
+        CompileStats::Phase phase(stats, "mir build");
+        mir::MIRBuilder mir_builder;
+        mir_module = mir_builder.build(module);
+        if (mir_builder.has_errors()) {
+            print(diag, mir_builder.get_errors());
+            return nullptr;
+        }
+    }
+    
+    CompileStats::Phase phase(stats, "mir checks");
+    mir::InitChecker init_checker;
+    if (!init_checker.check(*mir_module)) {
+        print(diag, init_checker.get_errors());
+        return nullptr;
+    }
+    
+    // Borrow checking runs on unoptimized MIR so errors match the source
+    mir::BorrowChecker borrow_checker;
+    if (!borrow_checker.check(*mir_module)) {
+        print(diag, borrow_checker.get_errors());
+        return nullptr;
+    }
+    
+    // Drops become destructor calls (and drop flags) before anything is moved around
+    mir::DropElaborator drop_elaborator;
+    drop_elaborator.run(*mir_module);
+    if (drop_elaborator.has_errors()) {
+        print(diag, drop_elaborator.get_errors());
+        return nullptr;
+    }
+    
+    return mir_module;
+}
+
+} // namespace apex::driver
@@ -0,0 +1,22 @@
+#pragma once
+
+#include "../ast/AST.h"
+#include "../sema/SemanticAnalyzer.h"
+#include "../mir/MIR.h"
+#include <memory>
+#include <ostream>
+
+namespace apex::driver {
+
+class CompileStats;
+
+// The checking half of the compiler, shared by single-file compiles and
+// `apexc build`: sema, MIR construction, initialization and borrow checks,
+// and drop elaboration. Errors and warnings go to `diag`; progress messages
+// go to `log` when it is set, and phase timings to `stats`. Returns null if
+// any stage reported an error.
+std::unique_ptr<mir::Module> check_module(ast::Module* module, sema::SemanticAnalyzer& analyzer,
+                                          std::ostream& diag, std::ostream* log = nullptr,
+                                          CompileStats* stats = nullptr);
+
+} // namespace apex::driver
@@ -0,0 +1,323 @@
+#include "Server.h"
+#include "Cache.h"
+#include "../codegen/LLVMCodeGen.h"
+#include <llvm/Support/raw_ostream.h>
+#include <cerrno>
+#include <csignal>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <iostream>
+#include <optional>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/time.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+namespace apex::driver {
+
+namespace {
+
+// Both directions send a list of strings: a 32-bit count, then each string
+// as a 32-bit length and its bytes (little-endian). Requests are
+// [PROTOCOL, cwd, has CC ("0"/"1"), CC, args...]; responses are
+// [exit code, stdout, stderr].
+constexpr char PROTOCOL[] = "apexc-server-1";
+constexpr uint32_t MAX_MESSAGE = 256u << 20;
+
+// Compiler output is cached up to this many bytes
+constexpr size_t OBJECT_CACHE_BUDGET = 256u << 20;
+
+constexpr long CLIENT_TIMEOUT_SECONDS = 30;
+
+volatile std::sig_atomic_t stop_requested = 0;
+
+void request_stop(int) { stop_requested = 1; }
+
+bool write_all(int fd, const char* data, size_t size) {
+    while (size > 0) {
+        ssize_t n = ::write(fd, data, size);
+        if (n < 0 && errno == EINTR) continue;
+        if (n <= 0) return false;
+        data += n;
+        size -= static_cast<size_t>(n);
+    }
+    return true;
+}
+
+bool read_all(int fd, char* data, size_t size) {
+    while (size > 0) {
+        ssize_t n = ::read(fd, data, size);
+        if (n < 0 && errno == EINTR && !stop_requested) continue;
+        if (n <= 0) return false;
+        data += n;
+        size -= static_cast<size_t>(n);
+    }
+    return true;
+}
+
+bool write_u32(int fd, uint32_t value) {
+    char bytes[4];
+    for (int i = 0; i < 4; i++) bytes[i] = static_cast<char>((value >> (8 * i)) & 0xff);
+    return write_all(fd, bytes, sizeof(bytes));
+}
+
+bool read_u32(int fd, uint32_t& value) {
+    unsigned char bytes[4];
+    if (!read_all(fd, reinterpret_cast<char*>(bytes), sizeof(bytes))) return false;
+    value = 0;
+    for (int i = 0; i < 4; i++) value |= static_cast<uint32_t>(bytes[i]) << (8 * i);
+    return true;
+}
+
+bool send_message(int fd, const std::vector<std::string>& parts) {
+    if (!write_u32(fd, static_cast<uint32_t>(parts.size()))) return false;
+    for (const auto& part : parts) {
+        if (!write_u32(fd, static_cast<uint32_t>(part.size())) || !write_all(fd, part.data(), part.size())) {
+            return false;
+        }
+    }
+    return true;
+}
+
+bool receive_message(int fd, std::vector<std::string>& parts) {
+    uint32_t count = 0;
+    if (!read_u32(fd, count) || count > MAX_MESSAGE / 4) return false;
+    size_t total = 0;
+    parts.clear();
+    for (uint32_t i = 0; i < count; i++) {
+        uint32_t size = 0;
+        if (!read_u32(fd, size) || (total += size) > MAX_MESSAGE) return false;
+        std::string part(size, '\0');
+        if (!read_all(fd, part.data(), size)) return false;
+        parts.push_back(std::move(part));
+    }
+    return true;
+}
+
+bool make_address(const std::string& socket_path, sockaddr_un& addr) {
+    std::memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    if (socket_path.empty() || socket_path.size() >= sizeof(addr.sun_path)) return false;
+    std::memcpy(addr.sun_path, socket_path.c_str(), socket_path.size() + 1);
+    return true;
+}
+
+int connect_to(const std::string& socket_path) {
+    sockaddr_un addr;
+    if (!make_address(socket_path, addr)) return -1;
+    int fd = ::socket(AF_UNIX, SOCK_STREAM, 0);
+    if (fd < 0) return -1;
+    if (::connect(fd, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) != 0) {
+        ::close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+// Requests run the client's CC, so only the server's own user may send them
+bool same_user(int fd) {
+#ifdef __linux__
+    ucred cred;
+    socklen_t size = sizeof(cred);
+    if (::getsockopt(fd, SOL_SOCKET, SO_PEERCRED, &cred, &size) != 0) return false;
+    return cred.uid == ::geteuid();
+#else
+    uid_t uid;
+    gid_t gid;
+    if (::getpeereid(fd, &uid, &gid) != 0) return false;
+    return uid == ::geteuid();
+#endif
+}
+
+std::string read_back(std::FILE* file) {
+    std::string contents;
+    std::rewind(file);
+    char buffer[4096];
+    size_t n;
+    while ((n = std::fread(buffer, 1, sizeof(buffer), file)) > 0) contents.append(buffer, n);
+    return contents;
+}
+
+void flush_output() {
+    std::cout.flush();
+    std::cerr.flush();
+    llvm::outs().flush();
+    llvm::errs().flush();
+    std::fflush(nullptr);
+}
+
+// Runs one request with stdout and stderr (the descriptors, so child
+// processes and LLVM's streams are captured too) sent to temporary files
+std::vector<std::string> run_request(const std::vector<std::string>& request, const CompileHandler& compile) {
+    const std::string& cwd = request[1];
+    std::optional<std::string> cc;
+    if (request[2] == "1") cc = request[3];
+    std::vector<std::string> args(request.begin() + 4, request.end());
+
+    std::error_code ec;
+    auto server_cwd = std::filesystem::current_path(ec);
+    std::filesystem::current_path(cwd, ec);
+    if (ec) return {"1", "", "error: Could not enter directory: " + cwd + "\n"};
+
+    const char* server_cc = std::getenv("CC");
+    std::optional<std::string> saved_cc;
+    if (server_cc) saved_cc = server_cc;
+    if (cc) {
+        ::setenv("CC", cc->c_str(), 1);
+    } else {
+        ::unsetenv("CC");
+    }
+
+    flush_output();
+    std::FILE* out = std::tmpfile();
+    std::FILE* err = std::tmpfile();
+    int saved_out = ::dup(STDOUT_FILENO);
+    int saved_err = ::dup(STDERR_FILENO);
+    ::dup2(::fileno(out), STDOUT_FILENO);
+    ::dup2(::fileno(err), STDERR_FILENO);
+
+    int exit_code;
+    try {
+        std::vector<char*> argv;
+        std::string program = "apexc";
+        argv.push_back(program.data());
+        for (auto& arg : args) argv.push_back(arg.data());
+        argv.push_back(nullptr);
+        exit_code = compile(static_cast<int>(args.size() + 1), argv.data());
+    } catch (const std::exception& e) {
+        std::cerr << "internal compiler error: " << e.what() << std::endl;
+        exit_code = 1;
+    }
+
+    flush_output();
+    ::dup2(saved_out, STDOUT_FILENO);
+    ::dup2(saved_err, STDERR_FILENO);
+    ::close(saved_out);
+    ::close(saved_err);
+    std::vector<std::string> response{std::to_string(exit_code), read_back(out), read_back(err)};
+    std::fclose(out);
+    std::fclose(err);
+
+    if (saved_cc) {
+        ::setenv("CC", saved_cc->c_str(), 1);
+    } else {
+        ::unsetenv("CC");
+    }
+    std::filesystem::current_path(server_cwd, ec);
+    return response;
+}
+
+} // namespace
+
+int serve(const std::string& socket_path, const CompileHandler& compile) {
+    sockaddr_un addr;
+    if (!make_address(socket_path, addr)) {
+        std::cerr << "Error: Invalid socket path: " << socket_path << std::endl;
+        return 1;
+    }
+
+    // A socket file nobody answers on is left over from a server that died
+    int existing = connect_to(socket_path);
+    if (existing >= 0) {
+        ::close(existing);
+        std::cerr << "Error: A server is already listening on " << socket_path << std::endl;
+        return 1;
+    }
+    std::error_code ec;
+    if (std::filesystem::exists(socket_path, ec) && !std::filesystem::is_socket(socket_path, ec)) {
+        std::cerr << "Error: Not a socket: " << socket_path << std::endl;
+        return 1;
+    }
+    ::unlink(socket_path.c_str());
+
+    // The socket file is created 0600: other users can't even connect
+    int listener = ::socket(AF_UNIX, SOCK_STREAM, 0);
+    mode_t saved_umask = ::umask(0077);
+    bool bound = listener >= 0 && ::bind(listener, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) == 0;
+    ::umask(saved_umask);
+    if (!bound || ::chmod(socket_path.c_str(), S_IRUSR | S_IWUSR) != 0 || ::listen(listener, SOMAXCONN) != 0) {
+        std::cerr << "Error: Could not listen on " << socket_path << ": " << std::strerror(errno) << std::endl;
+        if (listener >= 0) ::close(listener);
+        return 1;
+    }
+
+    // No SA_RESTART, so a signal interrupts accept()
+    struct sigaction action;
+    std::memset(&action, 0, sizeof(action));
+    action.sa_handler = request_stop;
+    sigemptyset(&action.sa_mask);
+    ::sigaction(SIGINT, &action, nullptr);
+    ::sigaction(SIGTERM, &action, nullptr);
+    std::signal(SIGPIPE, SIG_IGN);
+
+    // Warm up: initializes the native target and leaves a target machine in
+    // the free list for the first request
+    FileCache::instance().enable();
+    ObjectCache::instance().enable(OBJECT_CACHE_BUDGET);
+    { codegen::LLVMCodeGen warm_up("apexc-server", std::cerr); }
+
+    std::cout << "Listening on " << socket_path << std::endl;
+    while (!stop_requested) {
+        int client = ::accept(listener, nullptr, nullptr);
+        if (client < 0) {
+            if (errno == EINTR) continue;
+            std::cerr << "Error: accept failed: " << std::strerror(errno) << std::endl;
+            break;
+        }
+
+        if (!same_user(client)) {
+            ::close(client);
+            continue;
+        }
+
+        // A client that stalls sending its request or reading the response
+        // must not hold up the others (the compile itself isn't bounded)
+        timeval timeout{CLIENT_TIMEOUT_SECONDS, 0};
+        ::setsockopt(client, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+        ::setsockopt(client, SOL_SOCKET, SO_SNDTIMEO, &timeout, sizeof(timeout));
+
+        std::vector<std::string> request;
+        if (receive_message(client, request)) {
+            std::vector<std::string> response;
+            if (request.size() < 4 || request[0] != PROTOCOL) {
+                response = {"1", "", "error: apexc client and server versions differ\n"};
+            } else {
+                response = run_request(request, compile);
+            }
+            send_message(client, response);
+        }
+        ::close(client);
+    }
+
+    ::close(listener);
+    ::unlink(socket_path.c_str());
+    return 0;
+}
+
+bool forward(const std::string& socket_path, const std::vector<std::string>& args, int& exit_code) {
+    int fd = connect_to(socket_path);
+    if (fd < 0) return false;
+    std::signal(SIGPIPE, SIG_IGN);
+
+    std::error_code ec;
+    std::string cwd = std::filesystem::current_path(ec).string();
+    const char* cc = std::getenv("CC");
+    std::vector<std::string> request{PROTOCOL, cwd, cc ? "1" : "0", cc ? cc : ""};
+    request.insert(request.end(), args.begin(), args.end());
+
+    std::vector<std::string> response;
+    bool ok = !ec && send_message(fd, request) && receive_message(fd, response) && response.size() == 3;
+    ::close(fd);
+    if (!ok) return false;
+
+    std::cout << response[1] << std::flush;
+    std::cerr << response[2] << std::flush;
+    exit_code = std::atoi(response[0].c_str());
+    return true;
+}
+
+} // namespace apex::driver
@@ -0,0 +1,31 @@
+#pragma once
+
+#include <functional>
+#include <string>
+#include <vector>
+
+namespace apex::driver {
+
+// Runs one compiler invocation in-process, as main would: argv[0] is the
+// program name. Returns the exit code.
+using CompileHandler = std::function<int(int argc, char** argv)>;
+
+// `apexc --server <socket>`: listens on a Unix domain socket and runs the
+// compiles that clients forward, one at a time, in this process. LLVM's
+// targets, the target machines and the file and object caches stay warm
+// between requests. Each request runs in the client's working directory with
+// its CC, and whatever it prints (including the linker's output) is sent
+// back. Runs until SIGINT or SIGTERM. Returns the process exit code.
+//
+// The working directory, CC and stdout/stderr belong to the process, so
+// requests can't overlap: while one compiles, other clients wait, however
+// long it takes. The client timeout only bounds reading a request and
+// sending its response. The server saves startup latency, not throughput.
+int serve(const std::string& socket_path, const CompileHandler& compile);
+
+// Client side: forwards `args` (without the program name) to the server at
+// `socket_path` and replays its output. Returns false without printing
+// anything if no server answers, so the caller can compile locally.
+bool forward(const std::string& socket_path, const std::vector<std::string>& args, int& exit_code);
+
+} // namespace apex::driver
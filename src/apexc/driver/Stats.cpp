@@ -0,0 +1,365 @@
+#include "Stats.h"
+#include "../support/TimeTrace.h"
+#include <llvm/IR/Module.h>
+#include <algorithm>
+#include <cstdio>
+#include <ctime>
+#include <iomanip>
+#include <sstream>
+#include <sys/resource.h>
+#ifdef __linux__
+#include <malloc.h>
+#endif
+
+namespace apex::driver {
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+double thread_cpu_ms() {
+    timespec ts{};
+    if (clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts) != 0) return 0;
+    return ts.tv_sec * 1000.0 + ts.tv_nsec / 1e6;
+}
+
+// Bytes handed out by malloc and not yet freed, all threads together
+uint64_t heap_in_use() {
+#if defined(__GLIBC__) && (__GLIBC__ > 2 || (__GLIBC__ == 2 && __GLIBC_MINOR__ >= 33))
+    struct mallinfo2 info = mallinfo2();
+    return info.uordblks + info.hblkhd;
+#else
+    return 0;
+#endif
+}
+
+uint64_t peak_rss() {
+    rusage usage{};
+    if (getrusage(RUSAGE_SELF, &usage) != 0) return 0;
+#ifdef __APPLE__
+    return usage.ru_maxrss;             // Bytes
+#else
+    return static_cast<uint64_t>(usage.ru_maxrss) * 1024;
+#endif
+}
+
+const char* expr_kind_name(ast::ExprKind kind) {
+    switch (kind) {
+        case ast::ExprKind::Literal: return "Literal";
+        case ast::ExprKind::Identifier: return "Identifier";
+        case ast::ExprKind::Binary: return "Binary";
+        case ast::ExprKind::Unary: return "Unary";
+        case ast::ExprKind::Call: return "Call";
+        case ast::ExprKind::Index: return "Index";
+        case ast::ExprKind::FieldAccess: return "FieldAccess";
+        case ast::ExprKind::Cast: return "Cast";
+        case ast::ExprKind::StructLiteral: return "StructLiteral";
+        case ast::ExprKind::ArrayLiteral: return "ArrayLiteral";
+        case ast::ExprKind::Tuple: return "Tuple";
+        case ast::ExprKind::Block: return "Block";
+        case ast::ExprKind::If: return "If";
+        case ast::ExprKind::Match: return "Match";
+        case ast::ExprKind::Range: return "Range";
+        case ast::ExprKind::Return: return "Return";
+        case ast::ExprKind::While: return "While";
+        case ast::ExprKind::For: return "For";
+        case ast::ExprKind::Break: return "Break";
+        case ast::ExprKind::Continue: return "Continue";
+    }
+    return "Expr";
+}
+
+const char* stmt_kind_name(ast::StmtKind kind) {
+    switch (kind) {
+        case ast::StmtKind::Let: return "Let";
+        case ast::StmtKind::Expr: return "ExprStmt";
+        case ast::StmtKind::Item: return "ItemStmt";
+        case ast::StmtKind::Defer: return "Defer";
+    }
+    return "Stmt";
+}
+
+const char* item_kind_name(ast::ItemKind kind) {
+    switch (kind) {
+        case ast::ItemKind::Function: return "Function";
+        case ast::ItemKind::Struct: return "Struct";
+        case ast::ItemKind::Enum: return "Enum";
+        case ast::ItemKind::Trait: return "Trait";
+        case ast::ItemKind::Impl: return "Impl";
+        case ast::ItemKind::TypeAlias: return "TypeAlias";
+        case ast::ItemKind::Module: return "Module";
+        case ast::ItemKind::Import: return "Import";
+        case ast::ItemKind::Extern: return "Extern";
+    }
+    return "Item";
+}
+
+// Counts expressions, statements, items and patterns by kind; types are
+// left out
+class AstCounter {
+public:
+    explicit AstCounter(std::map<std::string, uint64_t>& counts) : counts_(counts) {}
+
+    void item(const ast::Item* item) {
+        if (!item) return;
+        counts_[item_kind_name(item->kind)]++;
+        expr(item->body.get());
+        for (const auto& nested : item->trait_items) this->item(nested.get());
+        for (const auto& nested : item->impl_items) this->item(nested.get());
+        for (const auto& nested : item->module_items) this->item(nested.get());
+    }
+
+private:
+    std::map<std::string, uint64_t>& counts_;
+
+    void stmt(const ast::Stmt* stmt) {
+        if (!stmt) return;
+        counts_[stmt_kind_name(stmt->kind)]++;
+        pattern(stmt->let_pattern.get());
+        expr(stmt->let_initializer.get());
+        expr(stmt->expr.get());
+        item(stmt->item.get());
+        expr(stmt->defer_body.get());
+    }
+
+    void pattern(const ast::Pattern* pattern) {
+        if (!pattern) return;
+        counts_["Pattern"]++;
+        for (const auto& sub : pattern->tuple_patterns) this->pattern(sub.get());
+        for (const auto& field : pattern->field_patterns) this->pattern(field.second.get());
+        this->pattern(pattern->range_start.get());
+        this->pattern(pattern->range_end.get());
+        for (const auto& sub : pattern->or_patterns) this->pattern(sub.get());
+    }
+
+    void expr(const ast::Expr* expr) {
+        if (!expr) return;
+        counts_[expr_kind_name(expr->kind)]++;
+        for (const ast::Expr* child : {expr->left.get(), expr->right.get(), expr->operand.get(),
+                                       expr->callee.get(), expr->indexed_expr.get(), expr->index_expr.get(),
+                                       expr->object.get(), expr->cast_expr.get(), expr->repeat_value.get(),
+                                       expr->repeat_count.get(), expr->block_expr.get(), expr->condition.get(),
+                                       expr->then_branch.get(), expr->else_branch.get(), expr->match_expr.get(),
+                                       expr->range_start.get(), expr->range_end.get(), expr->return_value.get(),
+                                       expr->while_condition.get(), expr->while_body.get(),
+                                       expr->for_iterator.get(), expr->for_body.get()}) {
+            this->expr(child);
+        }
+        for (const auto& arg : expr->arguments) this->expr(arg.get());
+        for (const auto& field : expr->fields) this->expr(field.value.get());
+        for (const auto& element : expr->array_elements) this->expr(element.get());
+        for (const auto& element : expr->tuple_elements) this->expr(element.get());
+        for (const auto& s : expr->block_stmts) stmt(s.get());
+        for (const auto& arm : expr->match_arms) {
+            pattern(arm.pattern.get());
+            if (arm.guard) this->expr(arm.guard->get());
+            this->expr(arm.body.get());
+        }
+        pattern(expr->for_pattern.get());
+    }
+};
+
+std::string json_string(const std::string& text) {
+    std::ostringstream escaped;
+    escaped << '"';
+    for (char c : text) {
+        if (c == '"' || c == '\\') {
+            escaped << '\\' << c;
+        } else if (static_cast<unsigned char>(c) < 0x20) {
+            char buffer[8];
+            std::snprintf(buffer, sizeof(buffer), "\\u%04x", c);
+            escaped << buffer;
+        } else {
+            escaped << c;
+        }
+    }
+    escaped << '"';
+    return escaped.str();
+}
+
+std::string kib(uint64_t bytes) {
+    std::ostringstream text;
+    text << std::fixed << std::setprecision(1) << bytes / 1024.0 << " KiB";
+    return text.str();
+}
+
+std::string signed_kib(int64_t bytes) {
+    return (bytes < 0 ? "-" : "+") + kib(static_cast<uint64_t>(bytes < 0 ? -bytes : bytes));
+}
+
+} // namespace
+
+CompileStats::Phase::Phase(CompileStats* stats, const char* name) : stats_(stats), name_(name) {
+    if (APEX_TIME_TRACE && trace::enabled()) {
+        trace::begin(name);
+        traced_ = true;
+    }
+    if (!stats_) return;
+    heap_start_ = heap_in_use();
+    cpu_start_ms_ = thread_cpu_ms();
+    wall_start_ = Clock::now();
+}
+
+CompileStats::Phase::~Phase() {
+    if (traced_) trace::end();
+    if (!stats_) return;
+    PhaseRecord record;
+    record.name = name_;
+    record.wall_ms = std::chrono::duration<double, std::milli>(Clock::now() - wall_start_).count();
+    record.cpu_ms = thread_cpu_ms() - cpu_start_ms_;
+    record.heap_bytes = heap_in_use();
+    record.heap_delta = static_cast<int64_t>(record.heap_bytes) - static_cast<int64_t>(heap_start_);
+    record.peak_rss_bytes = peak_rss();
+    stats_->phases_.push_back(std::move(record));
+}
+
+void CompileStats::count_ast(const ast::Module& module) {
+    AstCounter counter(ast_nodes_);
+    for (const auto& item : module.items) counter.item(item.get());
+    uint64_t total = 0;
+    for (const auto& [kind, n] : ast_nodes_) total += n;
+    count("ast nodes", total);
+}
+
+void CompileStats::count_mir(const mir::Module& module) {
+    uint64_t functions = 0;
+    uint64_t blocks = 0;
+    uint64_t statements = 0;
+    for (const auto& func : module.functions) {
+        if (func->is_extern) continue;
+        functions++;
+        blocks += func->blocks.size();
+        for (const auto& block : func->blocks) statements += block.statements.size();
+    }
+    count("mir functions", functions);
+    count("mir blocks", blocks);
+    count("mir statements", statements);
+}
+
+void CompileStats::count_ir(const llvm::Module& module, const std::string& stage) {
+    uint64_t functions = 0;
+    uint64_t blocks = 0;
+    uint64_t instructions = 0;
+    for (const auto& func : module) {
+        if (func.isDeclaration()) continue;
+        functions++;
+        blocks += func.size();
+        instructions += func.getInstructionCount();
+    }
+    count("ir functions (" + stage + ")", functions);
+    count("ir blocks (" + stage + ")", blocks);
+    count("ir instructions (" + stage + ")", instructions);
+}
+
+void CompileStats::add_passes(const std::vector<codegen::PassTiming>& passes) {
+    passes_.insert(passes_.end(), passes.begin(), passes.end());
+    std::stable_sort(passes_.begin(), passes_.end(),
+                     [](const codegen::PassTiming& a, const codegen::PassTiming& b) { return a.wall_ms > b.wall_ms; });
+}
+
+double CompileStats::total_wall_ms() const {
+    double total = 0;
+    for (const auto& phase : phases_) total += phase.wall_ms;
+    return total;
+}
+
+void CompileStats::print_text(std::ostream& out, bool time, bool memory) const {
+    std::ostringstream text;
+    text << std::fixed << std::setprecision(3);
+    text << "===-------------------------------------------------------------------===\n"
+         << "  Compile report: " << file_ << "\n"
+         << "===-------------------------------------------------------------------===\n";
+
+    double total_ms = total_wall_ms();
+    if (time) {
+        text << "\n  " << std::left << std::setw(14) << "Phase" << std::right << std::setw(12) << "Wall (ms)"
+             << std::setw(8) << "%" << std::setw(12) << "CPU (ms)" << "\n";
+        double total_cpu = 0;
+        for (const auto& phase : phases_) {
+            total_cpu += phase.cpu_ms;
+            text << "  " << std::left << std::setw(14) << phase.name << std::right << std::setw(12)
+                 << phase.wall_ms << std::setw(7) << std::setprecision(1)
+                 << (total_ms > 0 ? phase.wall_ms * 100 / total_ms : 0) << "%" << std::setprecision(3)
+                 << std::setw(12) << phase.cpu_ms << "\n";
+        }
+        text << "  " << std::left << std::setw(14) << "total" << std::right << std::setw(12) << total_ms
+             << std::setw(8) << "" << std::setw(12) << total_cpu << "\n";
+    }
+
+    if (memory) {
+        text << "\n  " << std::left << std::setw(14) << "Phase" << std::right << std::setw(16) << "Heap in use"
+             << std::setw(16) << "Heap change" << std::setw(16) << "Peak RSS" << "\n";
+        for (const auto& phase : phases_) {
+            text << "  " << std::left << std::setw(14) << phase.name << std::right << std::setw(16)
+                 << kib(phase.heap_bytes) << std::setw(16) << signed_kib(phase.heap_delta) << std::setw(16)
+                 << kib(phase.peak_rss_bytes) << "\n";
+        }
+    }
+
+    text << "\n  Counts\n";
+    for (const auto& [name, value] : counts_) {
+        text << "    " << std::left << std::setw(34) << name << std::right << std::setw(10) << value << "\n";
+    }
+    if (!ast_nodes_.empty()) {
+        text << "\n  AST nodes by kind\n";
+        for (const auto& [kind, value] : ast_nodes_) {
+            text << "    " << std::left << std::setw(34) << kind << std::right << std::setw(10) << value << "\n";
+        }
+    }
+
+    if (time && !passes_.empty()) {
+        double passes_ms = 0;
+        for (const auto& pass : passes_) passes_ms += pass.wall_ms;
+        text << "\n  LLVM passes (" << passes_ms << " ms in optimize)\n"
+             << "    " << std::left << std::setw(44) << "Pass" << std::right << std::setw(12) << "Wall (ms)"
+             << std::setw(8) << "Runs" << "\n";
+        for (const auto& pass : passes_) {
+            text << "    " << std::left << std::setw(44) << pass.name << std::right << std::setw(12) << pass.wall_ms
+                 << std::setw(8) << pass.runs << "\n";
+        }
+    }
+    out << text.str();
+}
+
+void CompileStats::print_json(std::ostream& out, bool time, bool memory) const {
+    std::ostringstream json;
+    json << std::fixed << std::setprecision(3);
+    json << "{\n  \"file\": " << json_string(file_) << ",\n  \"phases\": [";
+    for (size_t i = 0; i < phases_.size(); i++) {
+        const auto& phase = phases_[i];
+        json << (i ? ",\n" : "\n") << "    {\"name\": " << json_string(phase.name);
+        if (time) json << ", \"wall_ms\": " << phase.wall_ms << ", \"cpu_ms\": " << phase.cpu_ms;
+        if (memory) {
+            json << ", \"heap_bytes\": " << phase.heap_bytes << ", \"heap_delta_bytes\": " << phase.heap_delta
+                 << ", \"peak_rss_bytes\": " << phase.peak_rss_bytes;
+        }
+        json << "}";
+    }
+    json << "\n  ],\n";
+    if (time) json << "  \"total_ms\": " << total_wall_ms() << ",\n";
+
+    json << "  \"counts\": {";
+    for (size_t i = 0; i < counts_.size(); i++) {
+        json << (i ? ", " : "") << json_string(counts_[i].first) << ": " << counts_[i].second;
+    }
+    json << "},\n  \"ast_nodes\": {";
+    bool first = true;
+    for (const auto& [kind, value] : ast_nodes_) {
+        json << (first ? "" : ", ") << json_string(kind) << ": " << value;
+        first = false;
+    }
+    json << "}";
+
+    if (time) {
+        json << ",\n  \"llvm_passes\": [";
+        for (size_t i = 0; i < passes_.size(); i++) {
+            json << (i ? ",\n" : "\n") << "    {\"name\": " << json_string(passes_[i].name)
+                 << ", \"wall_ms\": " << passes_[i].wall_ms << ", \"runs\": " << passes_[i].runs << "}";
+        }
+        json << (passes_.empty() ? "]" : "\n  ]");
+    }
+    json << "\n}\n";
+    out << json.str();
+}
+
+} // namespace apex::driver
@@ -0,0 +1,77 @@
+#pragma once
+
+#include "../ast/AST.h"
+#include "../codegen/LLVMCodeGen.h"
+#include "../mir/MIR.h"
+#include <chrono>
+#include <cstdint>
+#include <map>
+#include <ostream>
+#include <string>
+#include <vector>
+
+namespace llvm {
+class Module;
+}
+
+namespace apex::driver {
+
+// What -ftime-report and -fmem-report show for one compile: a timer and a
+// memory reading per phase, counts of what each phase produced, and the time
+// spent in each LLVM pass. One per compile, filled on the compiling thread.
+class CompileStats {
+public:
+    // Times the enclosing scope as one phase, and traces it under
+    // -ftime-trace. Cheap without either, so the driver can open phases
+    // unconditionally.
+    class Phase {
+    public:
+        Phase(CompileStats* stats, const char* name);
+        ~Phase();
+
+        Phase(const Phase&) = delete;
+        Phase& operator=(const Phase&) = delete;
+
+    private:
+        CompileStats* stats_;
+        const char* name_;
+        bool traced_{false};
+        std::chrono::steady_clock::time_point wall_start_;
+        double cpu_start_ms_{0};
+        uint64_t heap_start_{0};
+    };
+
+    explicit CompileStats(std::string file) : file_(std::move(file)) {}
+
+    void count(const std::string& name, uint64_t value) { counts_.emplace_back(name, value); }
+    void count_ast(const ast::Module& module);
+    void count_mir(const mir::Module& module);
+    // `stage` tells the readings before and after LLVM's pipeline apart
+    void count_ir(const llvm::Module& module, const std::string& stage);
+    void add_passes(const std::vector<codegen::PassTiming>& passes);
+
+    // Only the sections asked for: timers and passes, memory, or both (the
+    // counts are in either)
+    void print_text(std::ostream& out, bool time, bool memory) const;
+    void print_json(std::ostream& out, bool time, bool memory) const;
+
+private:
+    struct PhaseRecord {
+        std::string name;
+        double wall_ms{0};
+        double cpu_ms{0};           // This thread only, so batch compiles don't add up
+        uint64_t heap_bytes{0};     // malloc'ed and not freed at the end of the phase
+        int64_t heap_delta{0};
+        uint64_t peak_rss_bytes{0}; // Whole process, so far
+    };
+
+    std::string file_;
+    std::vector<PhaseRecord> phases_;
+    std::vector<std::pair<std::string, uint64_t>> counts_;
+    std::map<std::string, uint64_t> ast_nodes_;
+    std::vector<codegen::PassTiming> passes_;
+
+    double total_wall_ms() const;
+};
+
+} // namespace apex::driver
@@ -0,0 +1,472 @@
+#include "TestRunner.h"
+#include "Cache.h"
+#include "ModuleGraph.h"
+#include "Pipeline.h"
+#include "ThreadPool.h"
+#include "../codegen/LLVMCodeGen.h"
+#include "../mir/Passes.h"
+#include <llvm/ExecutionEngine/Orc/ExecutionUtils.h>
+#include <llvm/ExecutionEngine/Orc/LLJIT.h>
+#include <llvm/Support/Error.h>
+#include <algorithm>
+#include <cctype>
+#include <cerrno>
+#include <chrono>
+#include <csignal>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <optional>
+#include <sstream>
+#include <thread>
+#include <fcntl.h>
+#include <sys/resource.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+namespace apex::driver {
+
+namespace {
+
+namespace fs = std::filesystem;
+using Clock = std::chrono::steady_clock;
+
+// A test's output is cut off in reports after this many bytes
+constexpr size_t MAX_CAPTURED_OUTPUT = 64 * 1024;
+
+enum class TestStatus { Pass, Fail, CompileError, Timeout, Crash, Skip };
+
+const char* status_name(TestStatus status) {
+    switch (status) {
+        case TestStatus::Pass: return "pass";
+        case TestStatus::Fail: return "fail";
+        case TestStatus::CompileError: return "error";
+        case TestStatus::Timeout: return "timeout";
+        case TestStatus::Crash: return "crash";
+        case TestStatus::Skip: return "skip";
+    }
+    return "?";
+}
+
+struct TestCase {
+    std::string name;                   // File stem
+    std::string path;
+    std::optional<int> expected;
+    TestStatus status{TestStatus::Skip};
+    std::optional<int> actual;
+    std::string message;                // Why it didn't pass
+    std::string output;                 // Compiler diagnostics, then what the program printed
+    double compile_ms{0};
+    double run_ms{0};
+
+    // Kept alive until the run, which calls `entry` in a forked child
+    std::unique_ptr<llvm::orc::LLJIT> jit;
+    int (*entry)(){nullptr};
+};
+
+double elapsed_ms(Clock::time_point start) {
+    return std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+}
+
+// The value of the first `// Expected: N` comment, as tests/run_tests.sh reads it
+std::optional<int> expected_exit_code(const std::string& source) {
+    size_t pos = source.find("// Expected:");
+    if (pos == std::string::npos) return std::nullopt;
+    pos += std::strlen("// Expected:");
+    while (pos < source.size() && source[pos] == ' ') pos++;
+    size_t end = pos;
+    while (end < source.size() && end - pos < 9 && std::isdigit(static_cast<unsigned char>(source[end]))) end++;
+    if (end == pos) return std::nullopt;
+    return std::stoi(source.substr(pos, end - pos));
+}
+
+void find_tests(const TestOptions& opts, std::vector<TestCase>& tests, std::vector<std::string>& errors) {
+    for (const auto& path : opts.paths) {
+        std::error_code ec;
+        std::vector<std::string> files;
+        if (fs::is_directory(path, ec)) {
+            for (const auto& entry : fs::directory_iterator(path, ec)) {
+                if (entry.is_regular_file() && entry.path().extension() == ".apx") {
+                    files.push_back(entry.path().string());
+                }
+            }
+            std::sort(files.begin(), files.end());
+        } else if (fs::is_regular_file(path, ec)) {
+            files.push_back(path);
+        } else {
+            errors.push_back("error: No such test file or directory: " + path);
+        }
+        for (const auto& file : files) {
+            TestCase test;
+            test.name = fs::path(file).stem().string();
+            test.path = file;
+            tests.push_back(std::move(test));
+        }
+    }
+}
+
+// Runs on a worker thread: the whole compiler, then the JIT up to the
+// address of `main`
+void compile_test(TestCase& test, unsigned opt_level) {
+    std::string source;
+    if (!FileCache::instance().read(test.path, source)) {
+        test.status = TestStatus::CompileError;
+        test.message = "could not read the file";
+        return;
+    }
+    test.expected = expected_exit_code(source);
+    if (!test.expected) {
+        test.status = TestStatus::Skip;
+        test.message = "no expected exit code";
+        return;
+    }
+
+    test.status = TestStatus::CompileError;
+    test.message = "compilation failed";
+    std::vector<std::string> errors;
+    auto module = parse_source(source, test.path, errors);
+    std::ostringstream diag;
+    for (const auto& error : errors) diag << error << "\n";
+    std::unique_ptr<mir::Module> mir_module;
+    if (module) {
+        sema::SemanticAnalyzer analyzer;
+        mir_module = check_module(module.get(), analyzer, diag);
+    }
+    test.output = diag.str();
+    if (!mir_module) return;
+    mir::optimize_module(*mir_module, opt_level);
+
+    codegen::LLVMCodeGen codegen(test.path, diag);
+    if (!codegen.generate(mir_module.get())) {
+        test.output = diag.str();
+        test.message = "code generation failed";
+        return;
+    }
+    codegen.optimize(opt_level);
+    std::unique_ptr<llvm::LLVMContext> context;
+    std::unique_ptr<llvm::Module> llvm_module;
+    codegen.release(context, llvm_module);
+
+    auto jit = llvm::orc::LLJITBuilder().create();
+    if (!jit) {
+        test.message = "JIT: " + llvm::toString(jit.takeError());
+        return;
+    }
+    // The programs call into libc (printf, malloc, ...)
+    auto& dylib = (*jit)->getMainJITDylib();
+    auto process = llvm::orc::DynamicLibrarySearchGenerator::GetForCurrentProcess(
+        (*jit)->getDataLayout().getGlobalPrefix());
+    if (!process) {
+        test.message = "JIT: " + llvm::toString(process.takeError());
+        return;
+    }
+    dylib.addGenerator(std::move(*process));
+    if (auto err = (*jit)->addIRModule(llvm::orc::ThreadSafeModule(std::move(llvm_module), std::move(context)))) {
+        test.message = "JIT: " + llvm::toString(std::move(err));
+        return;
+    }
+    auto main_symbol = (*jit)->lookup("main");
+    if (!main_symbol) {
+        test.message = "JIT: " + llvm::toString(main_symbol.takeError());
+        return;
+    }
+
+    test.entry = main_symbol->toPtr<int (*)()>();
+    test.jit = std::move(*jit);
+    test.status = TestStatus::Pass;     // Until it runs
+    test.message.clear();
+}
+
+std::string read_back(std::FILE* file) {
+    std::string contents;
+    std::rewind(file);
+    char buffer[4096];
+    size_t n;
+    while (contents.size() < MAX_CAPTURED_OUTPUT && (n = std::fread(buffer, 1, sizeof(buffer), file)) > 0) {
+        contents.append(buffer, n);
+    }
+    if (contents.size() > MAX_CAPTURED_OUTPUT) {
+        contents.resize(MAX_CAPTURED_OUTPUT);
+        contents += "\n[output truncated]\n";
+    }
+    return contents;
+}
+
+struct Running {
+    TestCase* test;
+    pid_t pid;
+    Clock::time_point start;
+    std::FILE* output;
+    bool timed_out{false};
+};
+
+// In the child: only the JIT-compiled code and libc run here, never LLVM
+[[noreturn]] void run_child(const TestCase& test, std::FILE* output, unsigned cpu_limit_seconds) {
+    int devnull = ::open("/dev/null", O_RDONLY);
+    if (devnull >= 0) ::dup2(devnull, STDIN_FILENO);
+    ::dup2(::fileno(output), STDOUT_FILENO);
+    ::dup2(::fileno(output), STDERR_FILENO);
+    rlimit cpu{cpu_limit_seconds, cpu_limit_seconds + 1};
+    ::setrlimit(RLIMIT_CPU, &cpu);
+
+    int result = test.entry();
+    std::fflush(nullptr);
+    ::_exit(result & 0xff);
+}
+
+void finish(Running& run, int status, unsigned cpu_limit_seconds) {
+    TestCase& test = *run.test;
+    test.run_ms = elapsed_ms(run.start);
+    test.output += read_back(run.output);
+    std::fclose(run.output);
+
+    std::ostringstream message;
+    if (run.timed_out) {
+        test.status = TestStatus::Timeout;
+        message << "timed out after " << test.run_ms / 1000 << "s";
+    } else if (WIFSIGNALED(status) && WTERMSIG(status) == SIGXCPU) {
+        test.status = TestStatus::Timeout;
+        message << "exceeded the CPU limit of " << cpu_limit_seconds << "s";
+    } else if (WIFSIGNALED(status)) {
+        test.status = TestStatus::Crash;
+        message << "killed by signal " << WTERMSIG(status) << " (" << strsignal(WTERMSIG(status)) << ")";
+    } else {
+        test.actual = WEXITSTATUS(status);
+        if (*test.actual == *test.expected) {
+            test.status = TestStatus::Pass;
+        } else {
+            test.status = TestStatus::Fail;
+            message << "expected: " << *test.expected << ", got: " << *test.actual;
+        }
+    }
+    test.message = message.str();
+}
+
+// Runs from the main thread once the pool is gone, so fork() copies a
+// process without other threads
+void run_all(std::vector<TestCase>& tests, const TestOptions& opts, unsigned jobs) {
+    std::vector<TestCase*> pending;
+    for (auto& test : tests) {
+        if (test.entry) pending.push_back(&test);
+    }
+    std::cout.flush();
+    std::cerr.flush();
+    std::fflush(nullptr);
+
+    auto timeout = std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double>(opts.timeout_seconds));
+    std::vector<Running> running;
+    size_t next = 0;
+    while (next < pending.size() || !running.empty()) {
+        while (next < pending.size() && running.size() < jobs) {
+            TestCase& test = *pending[next++];
+            std::FILE* output = std::tmpfile();
+            pid_t pid = output ? ::fork() : -1;
+            if (pid == 0) run_child(test, output, opts.cpu_limit_seconds);
+            if (pid < 0) {
+                if (output) std::fclose(output);
+                test.status = TestStatus::Crash;
+                test.message = std::string("could not start: ") + std::strerror(errno);
+                continue;
+            }
+            running.push_back({&test, pid, Clock::now(), output});
+        }
+
+        int status = 0;
+        pid_t done = ::waitpid(-1, &status, WNOHANG);
+        if (done > 0) {
+            auto it = std::find_if(running.begin(), running.end(), [&](const Running& r) { return r.pid == done; });
+            if (it != running.end()) {
+                finish(*it, status, opts.cpu_limit_seconds);
+                running.erase(it);
+            }
+            continue;
+        }
+
+        auto now = Clock::now();
+        for (auto& run : running) {
+            if (!run.timed_out && now - run.start > timeout) {
+                ::kill(run.pid, SIGKILL);
+                run.timed_out = true;
+            }
+        }
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+}
+
+std::string xml_escape(const std::string& text) {
+    std::string escaped;
+    for (char c : text) {
+        switch (c) {
+            case '<': escaped += "&lt;"; break;
+            case '>': escaped += "&gt;"; break;
+            case '&': escaped += "&amp;"; break;
+            case '"': escaped += "&quot;"; break;
+            default:
+                // Control characters other than tab and newline aren't valid XML 1.0
+                if (static_cast<unsigned char>(c) >= 0x20 || c == '\t' || c == '\n') escaped += c;
+        }
+    }
+    return escaped;
+}
+
+std::string json_escape(const std::string& text) {
+    std::ostringstream escaped;
+    for (char c : text) {
+        switch (c) {
+            case '"': escaped << "\\\""; break;
+            case '\\': escaped << "\\\\"; break;
+            case '\n': escaped << "\\n"; break;
+            case '\t': escaped << "\\t"; break;
+            default:
+                if (static_cast<unsigned char>(c) < 0x20) {
+                    escaped << "\\u" << std::hex << std::setw(4) << std::setfill('0') << static_cast<int>(c)
+                            << std::dec;
+                } else {
+                    escaped << c;
+                }
+        }
+    }
+    return escaped.str();
+}
+
+struct Summary {
+    size_t passed{0};
+    size_t failed{0};                   // Wrong exit code, timeout or crash
+    size_t errors{0};                   // Didn't compile
+    size_t skipped{0};
+    double total_ms{0};
+};
+
+Summary summarize(const std::vector<TestCase>& tests, double total_ms) {
+    Summary summary;
+    summary.total_ms = total_ms;
+    for (const auto& test : tests) {
+        switch (test.status) {
+            case TestStatus::Pass: summary.passed++; break;
+            case TestStatus::CompileError: summary.errors++; break;
+            case TestStatus::Skip: summary.skipped++; break;
+            default: summary.failed++; break;
+        }
+    }
+    return summary;
+}
+
+void report_text(std::ostream& out, const std::vector<TestCase>& tests, const Summary& summary, bool verbose) {
+    out << std::fixed << std::setprecision(1);
+    for (const auto& test : tests) {
+        switch (test.status) {
+            case TestStatus::Pass:
+                out << "PASS " << test.name << " (exit code: " << *test.actual << ", " << test.run_ms << " ms)\n";
+                break;
+            case TestStatus::Skip:
+                out << "SKIP " << test.name << " (" << test.message << ")\n";
+                break;
+            default:
+                out << "FAIL " << test.name << " (" << test.message << ")\n";
+                if (verbose && !test.output.empty()) {
+                    std::istringstream lines(test.output);
+                    for (std::string line; std::getline(lines, line);) out << "    " << line << "\n";
+                }
+                break;
+        }
+    }
+    out << "\nPassed: " << summary.passed << ", failed: " << summary.failed + summary.errors
+        << ", skipped: " << summary.skipped << ", total: " << tests.size() << " (" << summary.total_ms
+        << " ms)\n";
+}
+
+void report_junit(std::ostream& out, const std::vector<TestCase>& tests, const Summary& summary) {
+    out << std::fixed << std::setprecision(6);
+    out << "<?xml version=\"1.0\" encoding=\"UTF-8\"?>\n"
+        << "<testsuite name=\"apex\" tests=\"" << tests.size() << "\" failures=\"" << summary.failed
+        << "\" errors=\"" << summary.errors << "\" skipped=\"" << summary.skipped << "\" time=\""
+        << summary.total_ms / 1000 << "\">\n";
+    for (const auto& test : tests) {
+        out << "  <testcase name=\"" << xml_escape(test.name) << "\" file=\"" << xml_escape(test.path)
+            << "\" time=\"" << (test.compile_ms + test.run_ms) / 1000 << "\"";
+        if (test.status == TestStatus::Pass) {
+            out << "/>\n";
+            continue;
+        }
+        out << ">\n";
+        if (test.status == TestStatus::Skip) {
+            out << "    <skipped message=\"" << xml_escape(test.message) << "\"/>\n";
+        } else {
+            const char* element = test.status == TestStatus::CompileError ? "error" : "failure";
+            out << "    <" << element << " type=\"" << status_name(test.status) << "\" message=\""
+                << xml_escape(test.message) << "\"/>\n";
+        }
+        if (!test.output.empty()) out << "    <system-out>" << xml_escape(test.output) << "</system-out>\n";
+        out << "  </testcase>\n";
+    }
+    out << "</testsuite>\n";
+}
+
+void report_json(std::ostream& out, const std::vector<TestCase>& tests, const Summary& summary) {
+    out << std::fixed << std::setprecision(3);
+    out << "{\n  \"tests\": [";
+    for (size_t i = 0; i < tests.size(); i++) {
+        const TestCase& test = tests[i];
+        out << (i ? ",\n" : "\n") << "    {\"name\": \"" << json_escape(test.name) << "\", \"file\": \""
+            << json_escape(test.path) << "\", \"status\": \"" << status_name(test.status) << "\"";
+        if (test.expected) out << ", \"expected\": " << *test.expected;
+        if (test.actual) out << ", \"actual\": " << *test.actual;
+        out << ", \"compile_ms\": " << test.compile_ms << ", \"run_ms\": " << test.run_ms;
+        if (!test.message.empty()) out << ", \"message\": \"" << json_escape(test.message) << "\"";
+        if (!test.output.empty()) out << ", \"output\": \"" << json_escape(test.output) << "\"";
+        out << "}";
+    }
+    out << "\n  ],\n  \"summary\": {\"passed\": " << summary.passed << ", \"failed\": " << summary.failed
+        << ", \"errors\": " << summary.errors << ", \"skipped\": " << summary.skipped << ", \"total\": "
+        << tests.size() << ", \"time_ms\": " << summary.total_ms << "}\n}\n";
+}
+
+} // namespace
+
+int run_tests(const TestOptions& opts) {
+    auto start = Clock::now();
+    std::vector<TestCase> tests;
+    std::vector<std::string> errors;
+    find_tests(opts, tests, errors);
+    for (const auto& error : errors) std::cerr << error << std::endl;
+    if (!errors.empty()) return 1;
+
+    unsigned jobs = opts.jobs ? opts.jobs : std::max(1u, std::thread::hardware_concurrency());
+    {
+        ThreadPool pool(std::min<size_t>(jobs, std::max<size_t>(tests.size(), 1)));
+        for (auto& test : tests) {
+            pool.submit([&test, &opts] {
+                auto compile_start = Clock::now();
+                compile_test(test, opts.opt_level);
+                test.compile_ms = elapsed_ms(compile_start);
+            });
+        }
+        pool.wait();
+    }
+    run_all(tests, opts, jobs);
+    Summary summary = summarize(tests, elapsed_ms(start));
+
+    std::ofstream file;
+    if (!opts.report_file.empty()) {
+        file.open(opts.report_file);
+        if (!file) {
+            std::cerr << "Failed to write output file: " << opts.report_file << std::endl;
+            return 1;
+        }
+    }
+    std::ostream& out = opts.report_file.empty() ? std::cout : file;
+    if (opts.format == "junit") {
+        report_junit(out, tests, summary);
+    } else if (opts.format == "json") {
+        report_json(out, tests, summary);
+    } else {
+        report_text(out, tests, summary, opts.verbose);
+    }
+    return summary.failed + summary.errors > 0 ? 1 : 0;
+}
+
+} // namespace apex::driver
@@ -0,0 +1,26 @@
+#pragma once
+
+#include <string>
+#include <vector>
+
+namespace apex::driver {
+
+struct TestOptions {
+    std::vector<std::string> paths;     // Test files, or directories searched for *.apx
+    unsigned opt_level{0};
+    unsigned jobs{0};                   // 0: one per hardware thread
+    double timeout_seconds{5};          // Wall clock, per test run
+    unsigned cpu_limit_seconds{5};      // CPU time (RLIMIT_CPU), per test run
+    std::string format{"text"};         // text, junit or json
+    std::string report_file;            // Report destination; stdout if empty
+    bool verbose{false};                // Also print each failing test's output
+};
+
+// `apexc test`: a test is an .apx file whose `main` must return the value of
+// its first `// Expected: N` comment (files without one are skipped). Tests
+// are compiled and JIT-compiled in this process on a thread pool; then each
+// one runs in a forked child, which only calls the JIT-compiled `main`, under
+// the CPU and wall-clock limits. Returns 0 when every test passed.
+int run_tests(const TestOptions& opts);
+
+} // namespace apex::driver
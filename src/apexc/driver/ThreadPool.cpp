@@ -0,0 +1,54 @@
+#include "ThreadPool.h"
+
+namespace apex::driver {
+
+ThreadPool::ThreadPool(unsigned num_threads) {
+    if (num_threads == 0) num_threads = 1;
+    for (unsigned i = 0; i < num_threads; i++) {
+        workers_.emplace_back([this] { work(); });
+    }
+}
+
+ThreadPool::~ThreadPool() {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        stopping_ = true;
+    }
+    work_ready_.notify_all();
+    for (auto& worker : workers_) worker.join();
+}
+
+void ThreadPool::submit(std::function<void()> task) {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        queue_.push_back(std::move(task));
+    }
+    work_ready_.notify_one();
+}
+
+void ThreadPool::wait() {
+    std::unique_lock<std::mutex> lock(mutex_);
+    all_done_.wait(lock, [this] { return queue_.empty() && running_ == 0; });
+}
+
+void ThreadPool::work() {
+    for (;;) {
+        std::function<void()> task;
+        {
+            std::unique_lock<std::mutex> lock(mutex_);
+            work_ready_.wait(lock, [this] { return stopping_ || !queue_.empty(); });
+            if (queue_.empty()) return;
+            task = std::move(queue_.front());
+            queue_.pop_front();
+            running_++;
+        }
+        task();
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            running_--;
+        }
+        all_done_.notify_all();
+    }
+}
+
+} // namespace apex::driver
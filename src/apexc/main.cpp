@@ -1,302 +1,933 @@
 #include "lexer/Lexer.h"
 #include "parser/Parser.h"
 #include "sema/SemanticAnalyzer.h"
+#include "mir/Passes.h"
 #include "codegen/LLVMCodeGen.h"
+#include "driver/Pipeline.h"
+#include "driver/Build.h"
+#include "driver/Cache.h"
+#include "driver/Coverage.h"
+#include "driver/Server.h"
+#include "driver/Stats.h"
+#include "driver/TestRunner.h"
+#include "driver/ThreadPool.h"
+#include "support/TimeTrace.h"
+#include <algorithm>
+#include <filesystem>
 #include <iostream>
 #include <fstream>
+#include <functional>
 #include <sstream>
 #include <cstring>
+#include <cstdlib>
+#include <set>
+#include <thread>
 
 struct CompilerOptions {
-    std::string input_file;
-    std::string output_file;
+    std::vector<std::string> input_files;
+    std::string output_file;            // Only with a single input file
     bool emit_llvm_ir{false};
     bool emit_ast{false};
+    bool emit_mir{false};
+    std::string emit_callgraph;   // "dot" or "json", empty if not requested
+    unsigned opt_level{0};
+    apex::codegen::DebugInfo debug_info{apex::codegen::DebugInfo::None};
+    apex::codegen::ProfilingOptions profiling;
+    apex::codegen::SanitizerOptions sanitizers;
     bool emit_tokens{false};
+    unsigned jobs{0};                   // Inputs compiled at once; 0: one per hardware thread
+    std::string time_report;            // -ftime-report: "text" or "json", empty if not requested
+    std::string mem_report;             // -fmem-report, likewise
+    std::string time_trace;             // -ftime-trace output, empty if not requested
+    unsigned time_trace_granularity{0}; // Microseconds
+    apex::codegen::RemarkOptions remarks;   // record_file is only set by -foptimization-record-file
+    bool save_optimization_record{false};   // Record next to the output unless a file was given
     bool verbose{false};
     bool help{false};
 };
 
 void print_usage(const char* program_name) {
-    std::cout << "Usage: " << program_name << " [options] <input-file>\n"
+    std::cout << "Usage: " << program_name << " [options] <input-file>...\n"
+              << "       " << program_name << " build [build-options] <entry-file>\n"
+              << "       " << program_name << " test [test-options] <file-or-dir>...\n"
+              << "       " << program_name << " cov report [report-options] <program> [<profile>...]\n"
               << "\nOptions:\n"
-              << "  -o <file>          Write output to <file>\n"
+              << "  -o <file>          Write output to <file> (single input only)\n"
+              << "  -O<level>          Optimization level (0-3, default 0)\n"
+              << "  -g                 Emit DWARF debug info: line tables, types and variables\n"
+              << "  -gline-tables-only Emit line tables only (enough for profilers and backtraces)\n"
+              << "  -g0                No debug info (default)\n"
+              << "  -fno-omit-frame-pointer\n"
+              << "                     Keep frame pointers, for profilers that walk the stack\n"
+              << "  -finstrument-functions\n"
+              << "                     Call __apex_enter/__apex_exit on entry to and return from each\n"
+              << "                     function; link libapex_profile for a per-function report\n"
+              << "  -fxray-instrument  Start and end functions with NOP sleds that libapex_xray can\n"
+              << "                     patch at run time to trace calls\n"
+              << "  -fxray-instruction-threshold=<n>\n"
+              << "                     Only give sleds to functions of <n> or more instructions, or\n"
+              << "                     with a loop (default 200)\n"
+              << "  -fcoverage         Count each block and branch outcome; link libapex_coverage and\n"
+              << "                     read the profile with `cov report`\n"
+              << "  -fsanitize=<list>  Instrument for address, undefined and/or thread sanitizers;\n"
+              << "                     link with `cc -fsanitize=<list>`\n"
+              << "  -fno-sanitize=<list>\n"
+              << "                     Turn sanitizers from an earlier -fsanitize off\n"
+              << "  -j <n>             Compile up to <n> input files at once (default: all cores)\n"
               << "  --emit-llvm        Emit LLVM IR instead of object file\n"
               << "  --emit-ast         Print the AST and exit\n"
+              << "  --emit-mir         Print the MIR and exit\n"
+              << "  --emit-callgraph[=dot|json]\n"
+              << "                     Print the call graph of the optimized MIR and exit\n"
               << "  --emit-tokens      Print tokens and exit\n"
+              << "  -ftime-report[=json]\n"
+              << "                     Print per-phase and per-LLVM-pass times and counts\n"
+              << "  -fmem-report[=json]\n"
+              << "                     Print heap usage and peak RSS after each phase, and counts\n"
+              << "  -ftime-trace=<file>\n"
+              << "                     Write a Chrome trace (chrome://tracing, Perfetto) of the compile\n"
+              << "  -ftime-trace-granularity=<us>\n"
+              << "                     Leave out trace spans shorter than <us> microseconds (default 0)\n"
+              << "  -Rpass=<regex>     Report optimizations done by LLVM passes matching <regex>\n"
+              << "  -Rpass-missed=<regex>\n"
+              << "                     Report optimizations those passes tried and didn't do\n"
+              << "  -Rpass-analysis=<regex>\n"
+              << "                     Report what those passes found that decided it\n"
+              << "  -fsave-optimization-record[=yaml]\n"
+              << "                     Write every remark to <output>.opt.yaml\n"
+              << "  -foptimization-record-file=<file>\n"
+              << "                     Write the remarks to <file> instead (single input only)\n"
               << "  -v, --verbose      Enable verbose output\n"
               << "  -h, --help         Display this help message\n"
+              << "\nBuild options (modules are found from `import` declarations):\n"
+              << "  -o <file>          Write the executable to <file> (default <build-dir>/<entry>)\n"
+              << "  -O<level>          Optimization level (0-3, default 0)\n"
+              << "  -g, -gline-tables-only, -g0\n"
+              << "                     Debug info, as for single compiles\n"
+              << "  -fno-omit-frame-pointer, -finstrument-functions\n"
+              << "                     As for single compiles; libapex_profile is linked in\n"
+              << "  -fxray-instrument, -fxray-instruction-threshold=<n>\n"
+              << "                     As for single compiles; libapex_xray is linked in\n"
+              << "  -fcoverage         As for single compiles; libapex_coverage is linked in\n"
+              << "  -fsanitize=<list>, -fno-sanitize=<list>\n"
+              << "                     As for single compiles; cc links the sanitizer runtimes\n"
+              << "  -j <n>             Compile up to <n> modules at once (default: all cores)\n"
+              << "  --build-dir <dir>  Directory for object files (default build)\n"
+              << "  -c                 Compile the modules without linking\n"
+              << "  -ftime-trace=<file>, -ftime-trace-granularity=<us>\n"
+              << "                     As for single compiles, with a track per worker thread\n"
+              << "  -v, --verbose      Enable verbose output\n"
+              << "\nTest options (tests are .apx files with an `// Expected: <exit code>` comment):\n"
+              << "  -O<level>          Optimization level (0-3, default 0)\n"
+              << "  -j <n>             Compile and run up to <n> tests at once (default: all cores)\n"
+              << "  --timeout <s>      Wall-clock limit per test run (default 5)\n"
+              << "  --cpu-limit <s>    CPU time limit per test run (default 5)\n"
+              << "  --format=<fmt>     Report as text (default), junit or json\n"
+              << "  -o <file>          Write the report to <file>\n"
+              << "  -v, --verbose      Show the output of failing tests\n"
+              << "\nCoverage report options (programs built with -fcoverage; the profile defaults to\n"
+              << "apex-coverage.raw):\n"
+              << "  --show-lines       Also list each file with the count of every line and branch\n"
+              << "  --format=<fmt>     Report as text (default) or lcov\n"
+              << "  -o <file>          Write the report to <file>\n"
+              << "\nCompiler server:\n"
+              << "  " << program_name << " --server <socket>\n"
+              << "                     Serve compiles on a Unix domain socket with warm caches;\n"
+              << "                     set APEXC_SERVER=<socket> to forward compiles to it\n"
               << "\nExamples:\n"
               << "  " << program_name << " hello.apx\n"
               << "  " << program_name << " -o hello.o hello.apx\n"
-              << "  " << program_name << " --emit-llvm hello.apx\n";
+              << "  " << program_name << " --emit-llvm hello.apx\n"
+              << "  " << program_name << " -j 8 tests/*.apx\n"
+              << "  " << program_name << " build -j 4 -o app src/main.apx\n"
+              << "  " << program_name << " build -fsanitize=address,undefined -g -o app src/main.apx\n"
+              << "  " << program_name << " test --format=junit -o report.xml tests\n"
+              << "  " << program_name << " cov report --show-lines build/main apex-coverage.raw\n";
 }
 
-CompilerOptions parse_args(int argc, char** argv) {
-    CompilerOptions opts;
-    
+bool parse_jobs(const std::string& value, unsigned& jobs) {
+    char* end = nullptr;
+    unsigned long count = std::strtoul(value.c_str(), &end, 10);
+    if (value.empty() || *end != '\0' || count == 0) {
+        std::cerr << "Invalid job count: " << value << std::endl;
+        return false;
+    }
+    jobs = static_cast<unsigned>(count);
+    return true;
+}
+
+// -ftime-trace=<file> and -ftime-trace-granularity=<us>, taken by compiles
+// and builds alike. False if `arg` is neither; `valid` is false if it is one
+// with a bad value.
+bool parse_time_trace_arg(const std::string& arg, std::string& file, unsigned& granularity, bool& valid) {
+    valid = true;
+    const std::string file_flag = "-ftime-trace=";
+    const std::string granularity_flag = "-ftime-trace-granularity=";
+    if (arg.compare(0, file_flag.size(), file_flag) == 0) {
+        file = arg.substr(file_flag.size());
+        valid = !file.empty();
+    } else if (arg.compare(0, granularity_flag.size(), granularity_flag) == 0) {
+        std::string value = arg.substr(granularity_flag.size());
+        char* end = nullptr;
+        unsigned long micros = std::strtoul(value.c_str(), &end, 10);
+        valid = !value.empty() && *end == '\0';
+        granularity = static_cast<unsigned>(micros);
+    } else {
+        return false;
+    }
+    if (!valid) std::cerr << "Invalid value in " << arg << std::endl;
+    return true;
+}
+
+// Frame pointer, -finstrument-functions, XRay and coverage flags, shared
+// like parse_time_trace_arg
+bool parse_profiling_arg(const std::string& arg, apex::codegen::ProfilingOptions& profiling, bool& valid) {
+    valid = true;
+    const std::string threshold_flag = "-fxray-instruction-threshold=";
+    if (arg == "-fno-omit-frame-pointer" || arg == "-fomit-frame-pointer") {
+        profiling.frame_pointers = arg == "-fno-omit-frame-pointer";
+    } else if (arg == "-finstrument-functions") {
+        profiling.instrument_functions = true;
+    } else if (arg == "-fxray-instrument") {
+        profiling.xray = true;
+    } else if (arg == "-fcoverage") {
+        profiling.coverage = true;
+    } else if (arg.compare(0, threshold_flag.size(), threshold_flag) == 0) {
+        std::string value = arg.substr(threshold_flag.size());
+        char* end = nullptr;
+        unsigned long count = std::strtoul(value.c_str(), &end, 10);
+        valid = !value.empty() && *end == '\0';
+        profiling.xray_threshold = static_cast<unsigned>(count);
+    } else {
+        return false;
+    }
+    if (!valid) std::cerr << "Invalid value in " << arg << std::endl;
+    return true;
+}
+
+// -fsanitize=<list> and -fno-sanitize=<list>, with address, undefined and
+// thread in the list; later flags add to or take from earlier ones
+bool parse_sanitize_arg(const std::string& arg, apex::codegen::SanitizerOptions& sanitizers, bool& valid) {
+    bool enable = arg.compare(0, 11, "-fsanitize=") == 0;
+    if (!enable && arg.compare(0, 14, "-fno-sanitize=") != 0) return false;
+    valid = true;
+    std::stringstream list(arg.substr(arg.find('=') + 1));
+    std::string name;
+    while (std::getline(list, name, ',')) {
+        if (name == "address") {
+            sanitizers.address = enable;
+        } else if (name == "undefined") {
+            sanitizers.undefined = enable;
+        } else if (name == "thread") {
+            sanitizers.thread = enable;
+        } else {
+            std::cerr << "Unsupported sanitizer '" << name << "' in " << arg << std::endl;
+            valid = false;
+            return true;
+        }
+    }
+    if (sanitizers.address && sanitizers.thread) {
+        std::cerr << "-fsanitize=address and -fsanitize=thread can't be combined" << std::endl;
+        valid = false;
+    }
+    return true;
+}
+
+// -g, -gline-tables-only or -g0; the last one given wins
+apex::codegen::DebugInfo debug_info_flag(const std::string& arg) {
+    if (arg == "-g") return apex::codegen::DebugInfo::Full;
+    if (arg == "-gline-tables-only") return apex::codegen::DebugInfo::LineTablesOnly;
+    return apex::codegen::DebugInfo::None;
+}
+
+// Returns false (after printing why) on a bad option
+bool parse_args(int argc, char** argv, CompilerOptions& opts) {
     for (int i = 1; i < argc; i++) {
         std::string arg = argv[i];
         
         if (arg == "-h" || arg == "--help") {
             opts.help = true;
-            return opts;
+            return true;
         } else if (arg == "-o" && i + 1 < argc) {
             opts.output_file = argv[++i];
+        } else if (arg.size() == 3 && arg[0] == '-' && arg[1] == 'O' && arg[2] >= '0' && arg[2] <= '3') {
+            opts.opt_level = arg[2] - '0';
+        } else if (arg == "-g" || arg == "-gline-tables-only" || arg == "-g0") {
+            opts.debug_info = debug_info_flag(arg);
+        } else if (bool valid; parse_profiling_arg(arg, opts.profiling, valid)) {
+            if (!valid) return false;
+        } else if (bool valid; parse_sanitize_arg(arg, opts.sanitizers, valid)) {
+            if (!valid) return false;
         } else if (arg == "--emit-llvm") {
             opts.emit_llvm_ir = true;
         } else if (arg == "--emit-ast") {
             opts.emit_ast = true;
+        } else if (arg == "--emit-mir") {
+            opts.emit_mir = true;
+        } else if (arg == "--emit-callgraph" || arg == "--emit-callgraph=dot") {
+            opts.emit_callgraph = "dot";
+        } else if (arg == "--emit-callgraph=json") {
+            opts.emit_callgraph = "json";
         } else if (arg == "--emit-tokens") {
             opts.emit_tokens = true;
+        } else if (arg == "-ftime-report" || arg == "-ftime-report=json") {
+            opts.time_report = arg == "-ftime-report" ? "text" : "json";
+        } else if (arg == "-fmem-report" || arg == "-fmem-report=json") {
+            opts.mem_report = arg == "-fmem-report" ? "text" : "json";
+        } else if (bool valid; parse_time_trace_arg(arg, opts.time_trace, opts.time_trace_granularity, valid)) {
+            if (!valid) return false;
+        } else if (arg.compare(0, 7, "-Rpass=") == 0) {
+            opts.remarks.passed = arg.substr(7);
+        } else if (arg.compare(0, 14, "-Rpass-missed=") == 0) {
+            opts.remarks.missed = arg.substr(14);
+        } else if (arg.compare(0, 16, "-Rpass-analysis=") == 0) {
+            opts.remarks.analysis = arg.substr(16);
+        } else if (arg == "-fsave-optimization-record" || arg == "-fsave-optimization-record=yaml") {
+            opts.save_optimization_record = true;
+        } else if (arg.compare(0, 27, "-foptimization-record-file=") == 0 && arg.size() > 27) {
+            opts.remarks.record_file = arg.substr(27);
+            opts.save_optimization_record = true;
         } else if (arg == "-v" || arg == "--verbose") {
             opts.verbose = true;
+        } else if ((arg == "-j" && i + 1 < argc) || (arg.size() > 2 && arg.compare(0, 2, "-j") == 0)) {
+            if (!parse_jobs(arg == "-j" ? argv[++i] : arg.substr(2), opts.jobs)) return false;
         } else if (arg[0] != '-') {
-            opts.input_file = arg;
+            opts.input_files.push_back(arg);
         } else {
             std::cerr << "Unknown option: " << arg << std::endl;
-            opts.help = true;
-            return opts;
+            return false;
         }
     }
     
-    return opts;
+    return true;
 }
 
-std::string read_file(const std::string& filename) {
-    std::ifstream file(filename);
-    if (!file) {
-        std::cerr << "Error: Could not open file: " << filename << std::endl;
-        return "";
+// Arguments after `build`; returns false (after printing why) on a bad option
+bool parse_build_args(int argc, char** argv, apex::driver::BuildOptions& opts, bool& help) {
+    for (int i = 2; i < argc; i++) {
+        std::string arg = argv[i];
+        
+        if (arg == "-h" || arg == "--help") {
+            help = true;
+            return true;
+        } else if (arg == "-o" && i + 1 < argc) {
+            opts.output_file = argv[++i];
+        } else if (arg.size() == 3 && arg[0] == '-' && arg[1] == 'O' && arg[2] >= '0' && arg[2] <= '3') {
+            opts.opt_level = arg[2] - '0';
+        } else if ((arg == "-j" && i + 1 < argc) || (arg.size() > 2 && arg.compare(0, 2, "-j") == 0)) {
+            if (!parse_jobs(arg == "-j" ? argv[++i] : arg.substr(2), opts.jobs)) return false;
+        } else if (arg == "--build-dir" && i + 1 < argc) {
+            opts.build_dir = argv[++i];
+        } else if (arg == "-g" || arg == "-gline-tables-only" || arg == "-g0") {
+            opts.debug_info = debug_info_flag(arg);
+        } else if (bool valid; parse_profiling_arg(arg, opts.profiling, valid)) {
+            if (!valid) return false;
+        } else if (bool valid; parse_sanitize_arg(arg, opts.sanitizers, valid)) {
+            if (!valid) return false;
+        } else if (arg == "-c") {
+            opts.compile_only = true;
+        } else if (bool valid; parse_time_trace_arg(arg, opts.time_trace, opts.time_trace_granularity, valid)) {
+            if (!valid) return false;
+        } else if (arg == "-v" || arg == "--verbose") {
+            opts.verbose = true;
+        } else if (arg[0] != '-' && opts.entry_file.empty()) {
+            opts.entry_file = arg;
+        } else {
+            std::cerr << "Unknown build option: " << arg << std::endl;
+            return false;
+        }
     }
     
-    std::stringstream buffer;
-    buffer << file.rdbuf();
-    return buffer.str();
+    if (opts.entry_file.empty()) {
+        std::cerr << "Missing entry file for 'build'" << std::endl;
+        return false;
+    }
+    return true;
 }
 
-void print_tokens(const std::vector<apex::Token>& tokens) {
-    std::cout << "\n=== TOKENS ===\n";
+// Arguments after `test`; returns false (after printing why) on a bad option
+bool parse_test_args(int argc, char** argv, apex::driver::TestOptions& opts, bool& help) {
+    for (int i = 2; i < argc; i++) {
+        std::string arg = argv[i];
+        
+        if (arg == "-h" || arg == "--help") {
+            help = true;
+            return true;
+        } else if (arg == "-o" && i + 1 < argc) {
+            opts.report_file = argv[++i];
+        } else if (arg.size() == 3 && arg[0] == '-' && arg[1] == 'O' && arg[2] >= '0' && arg[2] <= '3') {
+            opts.opt_level = arg[2] - '0';
+        } else if ((arg == "-j" && i + 1 < argc) || (arg.size() > 2 && arg.compare(0, 2, "-j") == 0)) {
+            if (!parse_jobs(arg == "-j" ? argv[++i] : arg.substr(2), opts.jobs)) return false;
+        } else if ((arg == "--timeout" || arg == "--cpu-limit") && i + 1 < argc) {
+            std::string value = argv[++i];
+            char* end = nullptr;
+            double seconds = std::strtod(value.c_str(), &end);
+            if (value.empty() || *end != '\0' || !(seconds > 0)) {
+                std::cerr << "Invalid number of seconds: " << value << std::endl;
+                return false;
+            }
+            if (arg == "--timeout") {
+                opts.timeout_seconds = seconds;
+            } else {
+                opts.cpu_limit_seconds = std::max(1u, static_cast<unsigned>(seconds));
+            }
+        } else if (arg == "--format=text" || arg == "--format=junit" || arg == "--format=json") {
+            opts.format = arg.substr(std::strlen("--format="));
+        } else if (arg == "-v" || arg == "--verbose") {
+            opts.verbose = true;
+        } else if (arg[0] != '-') {
+            opts.paths.push_back(arg);
+        } else {
+            std::cerr << "Unknown test option: " << arg << std::endl;
+            return false;
+        }
+    }
+    
+    if (opts.paths.empty()) {
+        std::cerr << "Missing test files or directories for 'test'" << std::endl;
+        return false;
+    }
+    return true;
+}
+
+// Arguments after `cov report`; returns false (after printing why) on a bad option
+bool parse_cov_args(int argc, char** argv, apex::driver::CoverageOptions& opts, bool& help) {
+    if (argc < 3 || std::strcmp(argv[2], "report") != 0) {
+        std::cerr << "Expected 'cov report'" << std::endl;
+        return false;
+    }
+    for (int i = 3; i < argc; i++) {
+        std::string arg = argv[i];
+        
+        if (arg == "-h" || arg == "--help") {
+            help = true;
+            return true;
+        } else if (arg == "-o" && i + 1 < argc) {
+            opts.report_file = argv[++i];
+        } else if (arg == "--show-lines") {
+            opts.show_lines = true;
+        } else if (arg == "--format=text" || arg == "--format=lcov") {
+            opts.format = arg.substr(std::strlen("--format="));
+        } else if (arg[0] != '-' && opts.program.empty()) {
+            opts.program = arg;
+        } else if (arg[0] != '-') {
+            opts.profiles.push_back(arg);
+        } else {
+            std::cerr << "Unknown coverage report option: " << arg << std::endl;
+            return false;
+        }
+    }
+    
+    if (opts.program.empty()) {
+        std::cerr << "Missing program for 'cov report'" << std::endl;
+        return false;
+    }
+    return true;
+}
+
+std::string read_file(const std::string& filename, std::ostream& err) {
+    std::string contents;
+    if (!apex::driver::FileCache::instance().read(filename, contents)) {
+        err << "Error: Could not open file: " << filename << std::endl;
+        return "";
+    }
+    return contents;
+}
+
+std::string default_output_file(const std::string& input_file, bool emit_llvm_ir) {
+    std::string output_file;
+    size_t dot = input_file.find_last_of('.');
+    if (dot != std::string::npos) {
+        output_file = input_file.substr(0, dot);
+    } else {
+        output_file = input_file;
+    }
+    return output_file + (emit_llvm_ir ? ".ll" : ".o");
+}
+
+void print_tokens(std::ostream& out, const std::vector<apex::Token>& tokens) {
+    out << "\n=== TOKENS ===\n";
     for (const auto& token : tokens) {
-        std::cout << token.location.line << ":" << token.location.column << " "
+        out << token.location.line << ":" << token.location.column << " "
                   << apex::token_type_to_string(token.type) << " \"" << token.lexeme << "\"\n";
     }
 }
 
-void print_ast_expr(const apex::ast::Expr* expr, int indent = 0);
-void print_ast_stmt(const apex::ast::Stmt* stmt, int indent = 0);
-void print_ast_item(const apex::ast::Item* item, int indent = 0);
+void print_ast_expr(std::ostream& out, const apex::ast::Expr* expr, int indent = 0);
+void print_ast_stmt(std::ostream& out, const apex::ast::Stmt* stmt, int indent = 0);
+void print_ast_item(std::ostream& out, const apex::ast::Item* item, int indent = 0);
 
-void print_indent(int indent) {
-    for (int i = 0; i < indent; i++) std::cout << "  ";
+void print_indent(std::ostream& out, int indent) {
+    for (int i = 0; i < indent; i++) out << "  ";
 }
 
-void print_ast_expr(const apex::ast::Expr* expr, int indent) {
+void print_ast_expr(std::ostream& out, const apex::ast::Expr* expr, int indent) {
     if (!expr) return;
     
-    print_indent(indent);
+    print_indent(out, indent);
     switch (expr->kind) {
         case apex::ast::ExprKind::Literal:
-            std::cout << "Literal\n";
+            out << "Literal\n";
             break;
         case apex::ast::ExprKind::Identifier:
-            std::cout << "Identifier: " << (expr->identifier ? *expr->identifier : "?") << "\n";
+            out << "Identifier: " << (expr->identifier ? *expr->identifier : "?") << "\n";
             break;
         case apex::ast::ExprKind::Binary:
-            std::cout << "Binary\n";
-            print_ast_expr(expr->left.get(), indent + 1);
-            print_ast_expr(expr->right.get(), indent + 1);
+            out << "Binary\n";
+            print_ast_expr(out, expr->left.get(), indent + 1);
+            print_ast_expr(out, expr->right.get(), indent + 1);
             break;
         case apex::ast::ExprKind::Call:
-            std::cout << "Call\n";
-            print_ast_expr(expr->callee.get(), indent + 1);
+            out << "Call\n";
+            print_ast_expr(out, expr->callee.get(), indent + 1);
             for (const auto& arg : expr->arguments) {
-                print_ast_expr(arg.get(), indent + 1);
+                print_ast_expr(out, arg.get(), indent + 1);
             }
             break;
         case apex::ast::ExprKind::Block:
-            std::cout << "Block\n";
+            out << "Block\n";
             for (const auto& stmt : expr->block_stmts) {
-                print_ast_stmt(stmt.get(), indent + 1);
+                print_ast_stmt(out, stmt.get(), indent + 1);
             }
             if (expr->block_expr) {
-                print_ast_expr(expr->block_expr.get(), indent + 1);
+                print_ast_expr(out, expr->block_expr.get(), indent + 1);
             }
             break;
         default:
-            std::cout << "Expr (kind " << static_cast<int>(expr->kind) << ")\n";
+            out << "Expr (kind " << static_cast<int>(expr->kind) << ")\n";
     }
 }
 
-void print_ast_stmt(const apex::ast::Stmt* stmt, int indent) {
+void print_ast_stmt(std::ostream& out, const apex::ast::Stmt* stmt, int indent) {
     if (!stmt) return;
     
-    print_indent(indent);
+    print_indent(out, indent);
     switch (stmt->kind) {
         case apex::ast::StmtKind::Let:
-            std::cout << "Let\n";
+            out << "Let\n";
             break;
         case apex::ast::StmtKind::Expr:
-            std::cout << "ExprStmt\n";
-            print_ast_expr(stmt->expr.get(), indent + 1);
+            out << "ExprStmt\n";
+            print_ast_expr(out, stmt->expr.get(), indent + 1);
             break;
         default:
-            std::cout << "Stmt\n";
+            out << "Stmt\n";
     }
 }
 
-void print_ast_item(const apex::ast::Item* item, int indent) {
+void print_ast_item(std::ostream& out, const apex::ast::Item* item, int indent) {
     if (!item) return;
     
-    print_indent(indent);
+    print_indent(out, indent);
     switch (item->kind) {
         case apex::ast::ItemKind::Function:
-            std::cout << "Function: " << item->name << "\n";
+            out << "Function: " << item->name << "\n";
             if (item->body) {
-                print_ast_expr(item->body.get(), indent + 1);
+                print_ast_expr(out, item->body.get(), indent + 1);
             }
             break;
         case apex::ast::ItemKind::Struct:
-            std::cout << "Struct: " << item->name << "\n";
+            out << "Struct: " << item->name << "\n";
             break;
         case apex::ast::ItemKind::Enum:
-            std::cout << "Enum: " << item->name << "\n";
+            out << "Enum: " << item->name << "\n";
             break;
         default:
-            std::cout << "Item: " << item->name << "\n";
+            out << "Item: " << item->name << "\n";
     }
 }
 
-void print_ast(const apex::ast::Module* module) {
-    std::cout << "\n=== AST ===\n";
-    std::cout << "Module: " << module->name << "\n";
+void print_ast(std::ostream& out, const apex::ast::Module* module) {
+    out << "\n=== AST ===\n";
+    out << "Module: " << module->name << "\n";
     for (const auto& item : module->items) {
-        print_ast_item(item.get(), 1);
+        print_ast_item(out, item.get(), 1);
     }
 }
 
-int main(int argc, char** argv) {
-    CompilerOptions opts = parse_args(argc, argv);
-    
-    if (opts.help || opts.input_file.empty()) {
-        print_usage(argv[0]);
-        return opts.help ? 0 : 1;
-    }
-    
+// Compiles one input, timing each phase into `stats` when it is set
+int compile_phases(const CompilerOptions& opts, const std::string& input_file, const std::string& output_file,
+                   std::ostream& out, std::ostream& err, apex::driver::CompileStats* stats) {
+    using Phase = apex::driver::CompileStats::Phase;
     if (opts.verbose) {
-        std::cout << "Compiling: " << opts.input_file << std::endl;
+        out << "Compiling: " << input_file << std::endl;
     }
     
     // Read source file
-    std::string source = read_file(opts.input_file);
+    std::string source;
+    {
+        Phase phase(stats, "read");
+        source = read_file(input_file, err);
+    }
     if (source.empty()) {
         return 1;
     }
+    if (stats) stats->count("source bytes", source.size());
+    
+    // A compiler server replays earlier compiles of the same source with the
+    // same options. Verbose runs and reports print more than the cache keeps.
+    auto& object_cache = apex::driver::ObjectCache::instance();
+    std::string cache_key;
+    if (object_cache.enabled() && !opts.verbose && !stats && !opts.emit_tokens && !opts.emit_ast &&
+        !opts.emit_mir && opts.emit_callgraph.empty() && !opts.remarks.any() && !opts.save_optimization_record) {
+        cache_key = input_file + '\0' + std::to_string(opts.opt_level) +
+                    std::to_string(static_cast<int>(opts.debug_info)) + (opts.profiling.frame_pointers ? "F" : "") +
+                    (opts.profiling.instrument_functions ? "I" : "") +
+                    (opts.profiling.xray ? "X" + std::to_string(opts.profiling.xray_threshold) : "") +
+                    (opts.profiling.coverage ? "C" : "") + (opts.sanitizers.address ? "A" : "") +
+                    (opts.sanitizers.undefined ? "U" : "") + (opts.sanitizers.thread ? "T" : "") +
+                    (opts.emit_llvm_ir ? "ll" : "o") + '\0' + source;
+        // Debug info records the working directory, and coverage the absolute
+        // source path, so checkouts elsewhere can't share those objects
+        if (opts.debug_info != apex::codegen::DebugInfo::None || opts.profiling.coverage) {
+            std::error_code ec;
+            cache_key += '\0' + std::filesystem::current_path(ec).string();
+        }
+        apex::driver::ObjectCache::Entry cached;
+        if (object_cache.lookup(cache_key, cached)) {
+            err << cached.diagnostics;
+            std::ofstream out(output_file, std::ios::binary);
+            out << cached.output;
+            if (!out) {
+                err << "Failed to write output file: " << output_file << std::endl;
+                return 1;
+            }
+            return 0;
+        }
+    }
     
     // Lexical analysis
-    if (opts.verbose) std::cout << "Starting lexer..." << std::endl;
-    apex::Lexer lexer(source, opts.input_file);
-    auto tokens = lexer.tokenize_all();
-    if (opts.verbose) std::cout << "Lexer done." << std::endl;
+    if (opts.verbose) out << "Starting lexer..." << std::endl;
+    std::vector<apex::Token> tokens;
+    apex::Lexer lexer(source, input_file);
+    {
+        Phase phase(stats, "lex");
+        tokens = lexer.tokenize_all();
+    }
+    if (opts.verbose) out << "Lexer done." << std::endl;
+    if (stats) stats->count("tokens", tokens.size());
     
     if (lexer.has_errors()) {
         for (const auto& error : lexer.get_errors()) {
-            std::cerr << error << std::endl;
+            err << error << std::endl;
         }
         return 1;
     }
     
     if (opts.emit_tokens) {
-        print_tokens(tokens);
+        print_tokens(out, tokens);
         return 0;
     }
     
     if (opts.verbose) {
-        std::cout << "Lexing completed: " << tokens.size() << " tokens\n";
+        out << "Lexing completed: " << tokens.size() << " tokens\n";
     }
     
     // Parsing
-    if (opts.verbose) std::cout << "Starting parser..." << std::endl;
+    if (opts.verbose) out << "Starting parser..." << std::endl;
     apex::Parser parser(std::move(tokens));
-    auto module = parser.parse_module();
-    if (opts.verbose) std::cout << "Parser done." << std::endl;
+    std::unique_ptr<apex::ast::Module> module;
+    {
+        Phase phase(stats, "parse");
+        module = parser.parse_module();
+    }
+    if (opts.verbose) out << "Parser done." << std::endl;
     
     if (parser.has_errors()) {
         for (const auto& error : parser.get_errors()) {
-            std::cerr << error << std::endl;
+            err << error << std::endl;
         }
         return 1;
     }
+    if (stats) stats->count_ast(*module);
     
     if (opts.emit_ast) {
-        print_ast(module.get());
+        print_ast(out, module.get());
         return 0;
     }
     
     if (opts.verbose) {
-        std::cout << "Parsing completed\n";
+        out << "Parsing completed\n";
     }
     
-    // Semantic analysis
-    if (opts.verbose) std::cout << "Starting semantic analysis..." << std::endl;
+    // Semantic analysis and the MIR checks
     apex::sema::SemanticAnalyzer analyzer;
-    if (!analyzer.analyze(module.get())) {
-        for (const auto& error : analyzer.get_errors()) {
-            std::cerr << error << std::endl;
-        }
+    std::ostringstream diagnostics;
+    auto mir_module = apex::driver::check_module(module.get(), analyzer, diagnostics,
+                                                 opts.verbose ? &out : nullptr, stats);
+    err << diagnostics.str();
+    if (!mir_module) {
         return 1;
     }
     
-    for (const auto& warning : analyzer.get_warnings()) {
-        std::cerr << warning << std::endl;
+    // MIR optimizations are cheap and run at every level
+    {
+        Phase phase(stats, "mir opt");
+        apex::mir::optimize_module(*mir_module, opts.opt_level);
+    }
+    if (stats) stats->count_mir(*mir_module);
+    
+    if (opts.emit_mir) {
+        apex::mir::print_module(*mir_module, out);
+        return 0;
+    }
+    
+    if (!opts.emit_callgraph.empty()) {
+        auto graph = apex::mir::CallGraph::build(*mir_module);
+        if (opts.emit_callgraph == "json") {
+            apex::mir::print_call_graph_json(graph, out);
+        } else {
+            apex::mir::print_call_graph_dot(graph, out);
+        }
+        return 0;
     }
     
     if (opts.verbose) {
-        std::cout << "Semantic analysis completed\n";
+        out << "MIR construction completed\n";
     }
     
     // Code generation
-    if (opts.verbose) std::cout << "Starting code generation..." << std::endl;
-    apex::codegen::LLVMCodeGen codegen(opts.input_file);
-    if (!codegen.generate(module.get())) {
-        std::cerr << "Code generation failed\n";
+    if (opts.verbose) out << "Starting code generation..." << std::endl;
+    apex::codegen::LLVMCodeGen codegen(input_file, err);
+    codegen.set_debug_info(opts.debug_info, opts.opt_level > 0);
+    codegen.set_profiling(opts.profiling);
+    codegen.set_sanitizers(opts.sanitizers);
+    if (opts.remarks.any() || opts.save_optimization_record) {
+        apex::codegen::RemarkOptions remarks = opts.remarks;
+        if (opts.save_optimization_record && remarks.record_file.empty()) {
+            remarks.record_file = std::filesystem::path(output_file).replace_extension(".opt.yaml").string();
+        }
+        std::string error;
+        if (!codegen.enable_remarks(remarks, err, error)) {
+            err << "Error: " << error << std::endl;
+            return 1;
+        }
+    }
+    bool generated;
+    {
+        Phase phase(stats, "codegen");
+        generated = codegen.lower(mir_module.get());
+    }
+    {
+        Phase phase(stats, "verify");
+        generated = codegen.verify() && generated;
+    }
+    if (!generated) {
+        err << "Code generation failed\n";
         return 1;
     }
+    if (stats) stats->count_ir(*codegen.get_module(), "codegen");
     
-    if (opts.verbose) {
-        std::cout << "Code generation completed\n";
-        codegen.dump_ir();
+    {
+        Phase phase(stats, "optimize");
+        std::vector<apex::codegen::PassTiming> passes;
+        codegen.optimize(opts.opt_level, stats ? &passes : nullptr);
+        if (stats) stats->add_passes(passes);
     }
+    if (stats && opts.opt_level > 0) stats->count_ir(*codegen.get_module(), "optimized");
     
-    // Determine output filename
-    std::string output_file = opts.output_file;
-    if (output_file.empty()) {
-        size_t dot = opts.input_file.find_last_of('.');
-        if (dot != std::string::npos) {
-            output_file = opts.input_file.substr(0, dot);
-        } else {
-            output_file = opts.input_file;
-        }
-        output_file += opts.emit_llvm_ir ? ".ll" : ".o";
+    if (opts.verbose) {
+        out << "Code generation completed\n";
+        codegen.dump_ir(out);
     }
     
     // Emit output
-    if (opts.verbose) std::cout << "Emitting output..." << std::endl;
+    if (opts.verbose) out << "Emitting output..." << std::endl;
     bool success;
-    if (opts.emit_llvm_ir) {
-        success = codegen.emit_llvm_ir(output_file);
-    } else {
-        success = codegen.emit_object_file(output_file);
+    {
+        Phase phase(stats, "emit");
+        if (opts.emit_llvm_ir) {
+            success = codegen.emit_llvm_ir(output_file);
+        } else {
+            success = codegen.emit_object_file(output_file);
+        }
     }
     
     if (!success) {
-        std::cerr << "Failed to write output file: " << output_file << std::endl;
+        err << "Failed to write output file: " << output_file << std::endl;
         return 1;
     }
     
     if (opts.verbose) {
-        std::cout << "Output written to: " << output_file << std::endl;
+        out << "Output written to: " << output_file << std::endl;
+    }
+    
+    if (!cache_key.empty()) {
+        std::ifstream written(output_file, std::ios::binary);
+        std::stringstream output;
+        output << written.rdbuf();
+        if (written) object_cache.insert(cache_key, {output.str(), diagnostics.str()});
     }
     
     return 0;
 }
+
+// Compiles one input. Everything it prints goes to `out` and `err`, so
+// batch compiles can buffer each file's output. -ftime-report and
+// -fmem-report go to `err` once the compile ends, however it ended.
+int compile_file(const CompilerOptions& opts, const std::string& input_file, const std::string& output_file,
+                 std::ostream& out, std::ostream& err) {
+    APEX_TIME_SCOPE_DETAIL("compile", input_file);
+    if (opts.time_report.empty() && opts.mem_report.empty()) {
+        return compile_phases(opts, input_file, output_file, out, err, nullptr);
+    }
+    
+    apex::driver::CompileStats stats(input_file);
+    int status = compile_phases(opts, input_file, output_file, out, err, &stats);
+    bool time = !opts.time_report.empty();
+    bool memory = !opts.mem_report.empty();
+    if (opts.time_report == "json" || opts.mem_report == "json") {
+        stats.print_json(err, time, memory);
+    } else {
+        stats.print_text(err, time, memory);
+    }
+    return status;
+}
+
+
+// `apexc a.apx b.apx ...`: the inputs are compiled independently on a thread
+// pool, each to the output it would get on its own. Each file's output is
+// buffered and printed in input order, so it doesn't depend on scheduling.
+// Fails if any input does.
+int compile_batch(const CompilerOptions& opts) {
+    if (!opts.output_file.empty()) {
+        std::cerr << "Error: -o can't be used with multiple input files" << std::endl;
+        return 1;
+    }
+    if (!opts.remarks.record_file.empty()) {
+        std::cerr << "Error: -foptimization-record-file can't be used with multiple input files" << std::endl;
+        return 1;
+    }
+    std::vector<std::string> output_files;
+    std::set<std::string> seen;
+    for (const auto& input_file : opts.input_files) {
+        output_files.push_back(default_output_file(input_file, opts.emit_llvm_ir));
+        // `a.apx` and `./a.apx` name the same output
+        std::error_code ec;
+        auto canonical = std::filesystem::weakly_canonical(output_files.back(), ec);
+        if (!seen.insert(ec ? output_files.back() : canonical.string()).second) {
+            std::cerr << "Error: Several inputs would write " << output_files.back() << std::endl;
+            return 1;
+        }
+    }
+    
+    struct FileResult {
+        int status{0};
+        std::string out;
+        std::string err;
+    };
+    std::vector<FileResult> results(opts.input_files.size());
+    unsigned jobs = opts.jobs ? opts.jobs : std::max(1u, std::thread::hardware_concurrency());
+    apex::driver::ThreadPool pool(std::min<size_t>(jobs, results.size()));
+    for (size_t i = 0; i < results.size(); i++) {
+        pool.submit([&, i] {
+            std::ostringstream out;
+            std::ostringstream err;
+            results[i].status = compile_file(opts, opts.input_files[i], output_files[i], out, err);
+            results[i].out = out.str();
+            results[i].err = err.str();
+        });
+    }
+    pool.wait();
+    
+    int failed = 0;
+    for (const auto& result : results) {
+        std::cout << result.out << std::flush;
+        std::cerr << result.err << std::flush;
+        failed += result.status != 0;
+    }
+    if (failed > 0) {
+        std::cerr << failed << " of " << results.size() << " files failed to compile" << std::endl;
+    }
+    return failed > 0 ? 1 : 0;
+}
+
+// Runs `compile` with -ftime-trace recording on, when `trace_file` is set,
+// and writes the trace after it (and its worker threads) finished
+int with_time_trace(const std::string& trace_file, unsigned granularity, const std::function<int()>& compile) {
+    if (trace_file.empty()) return compile();
+    if (!APEX_TIME_TRACE) {
+        std::cerr << "Error: -ftime-trace is not supported by this build (APEX_TIME_TRACE=OFF)" << std::endl;
+        return 1;
+    }
+    
+    apex::trace::start(granularity);
+    int status = compile();
+    std::string error;
+    if (!apex::trace::finish(trace_file, error)) {
+        std::cerr << error << std::endl;
+        return 1;
+    }
+    return status;
+}
+
+int run_compiler(int argc, char** argv) {
+    if (argc > 1 && std::strcmp(argv[1], "build") == 0) {
+        apex::driver::BuildOptions build_opts;
+        bool help = false;
+        if (!parse_build_args(argc, argv, build_opts, help) || help) {
+            print_usage(argv[0]);
+            return help ? 0 : 1;
+        }
+        return with_time_trace(build_opts.time_trace, build_opts.time_trace_granularity,
+                               [&] { return apex::driver::build(build_opts); });
+    }
+    
+    if (argc > 1 && std::strcmp(argv[1], "test") == 0) {
+        apex::driver::TestOptions test_opts;
+        bool help = false;
+        if (!parse_test_args(argc, argv, test_opts, help) || help) {
+            print_usage(argv[0]);
+            return help ? 0 : 1;
+        }
+        return apex::driver::run_tests(test_opts);
+    }
+    
+    if (argc > 1 && std::strcmp(argv[1], "cov") == 0) {
+        apex::driver::CoverageOptions cov_opts;
+        bool help = false;
+        if (!parse_cov_args(argc, argv, cov_opts, help) || help) {
+            print_usage(argv[0]);
+            return help ? 0 : 1;
+        }
+        return apex::driver::coverage_report(cov_opts);
+    }
+    
+    CompilerOptions opts;
+    if (!parse_args(argc, argv, opts) || opts.help || opts.input_files.empty()) {
+        print_usage(argv[0]);
+        return opts.help ? 0 : 1;
+    }
+    
+    return with_time_trace(opts.time_trace, opts.time_trace_granularity, [&] {
+        if (opts.input_files.size() == 1) {
+            const std::string& input_file = opts.input_files[0];
+            std::string output_file = opts.output_file.empty()
+                                          ? default_output_file(input_file, opts.emit_llvm_ir)
+                                          : opts.output_file;
+            return compile_file(opts, input_file, output_file, std::cout, std::cerr);
+        }
+        return compile_batch(opts);
+    });
+}
+int main(int argc, char** argv) {
+    if (argc > 1 && std::strcmp(argv[1], "--server") == 0) {
+        if (argc != 3) {
+            print_usage(argv[0]);
+            return 1;
+        }
+        return apex::driver::serve(argv[2], run_compiler);
+    }
+    
+    // With APEXC_SERVER set, this process is a thin client for the server
+    // listening there, and only compiles by itself if none answers
+    const char* server = std::getenv("APEXC_SERVER");
+    if (server && *server) {
+        int exit_code = 1;
+        if (apex::driver::forward(server, std::vector<std::string>(argv + 1, argv + argc), exit_code)) {
+            return exit_code;
+        }
+    }
+    return run_compiler(argc, argv);
+}
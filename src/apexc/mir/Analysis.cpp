@@ -0,0 +1,124 @@
+#include "Analysis.h"
+#include <algorithm>
+
+namespace apex::mir {
+
+bool has_deref(const Place& place) {
+    for (const auto& elem : place.projection) {
+        if (elem.kind == ProjectionKind::Deref) return true;
+    }
+    return false;
+}
+
+std::vector<bool> find_address_taken(const Function& func) {
+    std::vector<bool> taken(func.locals.size(), false);
+    for (const auto& block : func.blocks) {
+        for (const auto& stmt : block.statements) {
+            if (stmt.kind == StatementKind::Assign && stmt.rvalue.kind == RvalueKind::Ref &&
+                !has_deref(stmt.rvalue.place)) {
+                taken[stmt.rvalue.place.local] = true;
+            }
+        }
+    }
+    return taken;
+}
+
+std::vector<bool> reachable_blocks(const Function& func) {
+    std::vector<bool> reachable(func.blocks.size(), false);
+    if (func.blocks.empty()) return reachable;
+
+    std::vector<BlockId> worklist = {ENTRY_BLOCK};
+    reachable[ENTRY_BLOCK] = true;
+    while (!worklist.empty()) {
+        BlockId bb = worklist.back();
+        worklist.pop_back();
+        if (!func.blocks[bb].terminator) continue;
+        for (BlockId succ : func.blocks[bb].terminator->successors()) {
+            if (!reachable[succ]) {
+                reachable[succ] = true;
+                worklist.push_back(succ);
+            }
+        }
+    }
+    return reachable;
+}
+
+std::vector<BlockId> reverse_postorder(const Function& func) {
+    std::vector<BlockId> postorder;
+    if (func.blocks.empty()) return postorder;
+
+    // Iterative DFS: (block, index of next successor to visit)
+    std::vector<bool> visited(func.blocks.size(), false);
+    std::vector<std::pair<BlockId, size_t>> stack = {{ENTRY_BLOCK, 0}};
+    visited[ENTRY_BLOCK] = true;
+    while (!stack.empty()) {
+        auto& [bb, next] = stack.back();
+        std::vector<BlockId> succs;
+        if (func.blocks[bb].terminator) succs = func.blocks[bb].terminator->successors();
+        if (next < succs.size()) {
+            BlockId succ = succs[next++];
+            if (!visited[succ]) {
+                visited[succ] = true;
+                stack.push_back({succ, 0});
+            }
+        } else {
+            postorder.push_back(bb);
+            stack.pop_back();
+        }
+    }
+
+    std::reverse(postorder.begin(), postorder.end());
+    return postorder;
+}
+
+std::optional<LocalId> assigned_local(const Statement& stmt) {
+    if (stmt.kind == StatementKind::Assign && stmt.place.is_local()) {
+        return stmt.place.local;
+    }
+    return std::nullopt;
+}
+
+std::vector<LiveSet> compute_live_out(const Function& func) {
+    size_t num_locals = func.locals.size();
+    std::vector<LiveSet> live_in(func.blocks.size(), LiveSet(num_locals, false));
+    std::vector<LiveSet> live_out(func.blocks.size(), LiveSet(num_locals, false));
+
+    std::vector<BlockId> order = reverse_postorder(func);
+    for (bool changed = true; changed;) {
+        changed = false;
+        for (auto it = order.rbegin(); it != order.rend(); ++it) {
+            BlockId bb = *it;
+            const auto& block = func.blocks[bb];
+
+            LiveSet live(num_locals, false);
+            if (block.terminator) {
+                for (BlockId succ : block.terminator->successors()) {
+                    for (size_t i = 0; i < num_locals; i++) {
+                        if (live_in[succ][i]) live[i] = true;
+                    }
+                }
+            }
+            live_out[bb] = live;
+
+            if (block.terminator) {
+                const Terminator& term = *block.terminator;
+                if (term.kind == TerminatorKind::Call && term.destination.is_local()) {
+                    live[term.destination.local] = false;
+                }
+                for_each_use(term, [&](LocalId local) { live[local] = true; });
+            }
+            for (auto s = block.statements.rbegin(); s != block.statements.rend(); ++s) {
+                if (auto local = assigned_local(*s)) live[*local] = false;
+                for_each_use(*s, [&](LocalId local) { live[local] = true; });
+            }
+
+            if (live != live_in[bb]) {
+                live_in[bb] = std::move(live);
+                changed = true;
+            }
+        }
+    }
+    return live_out;
+}
+
+} // namespace apex::mir
@@ -0,0 +1,116 @@
+#pragma once
+
+#include "MIR.h"
+#include <vector>
+
+namespace apex::mir {
+
+// Shared helpers for MIR passes and analyses.
+
+bool has_deref(const Place& place);
+
+// Locals whose address is taken with a direct borrow (`&x`, `&mut x.f`).
+// Such locals may be read or written through pointers, so passes that
+// reason about a local's value only by looking at direct assignments must
+// leave them alone.
+std::vector<bool> find_address_taken(const Function& func);
+
+// Blocks reachable from the entry block
+std::vector<bool> reachable_blocks(const Function& func);
+
+// Reachable blocks in reverse postorder (forward dataflow visiting order)
+std::vector<BlockId> reverse_postorder(const Function& func);
+
+// Backward liveness over whole locals, per block. A bare assignment kills
+// the local, everything else that mentions it (reads, partial writes,
+// writes through it as a pointer) keeps it live.
+using LiveSet = std::vector<bool>;
+std::vector<LiveSet> compute_live_out(const Function& func);
+
+// Local fully overwritten by a statement, if any
+std::optional<LocalId> assigned_local(const Statement& stmt);
+
+// Operand visitors (mutable, for rewriting)
+template <typename F>
+void for_each_operand(Statement& stmt, F&& f) {
+    if (stmt.kind != StatementKind::Assign) return;
+    for (auto& op : stmt.rvalue.operands) f(op);
+}
+
+template <typename F>
+void for_each_operand(Terminator& term, F&& f) {
+    if (term.kind == TerminatorKind::SwitchInt) f(term.discriminant);
+    if (term.kind == TerminatorKind::Call) {
+        for (auto& arg : term.args) f(arg);
+    }
+}
+
+// Calls f(Place&) for every place mentioned by a statement or terminator,
+// including destinations and borrowed places.
+template <typename F>
+void for_each_place(Statement& stmt, F&& f) {
+    if (stmt.kind != StatementKind::Assign) return;
+    f(stmt.place);
+    for (auto& op : stmt.rvalue.operands) {
+        if (op.is_place()) f(op.place);
+    }
+    if (stmt.rvalue.kind == RvalueKind::Ref) f(stmt.rvalue.place);
+}
+
+template <typename F>
+void for_each_place(Terminator& term, F&& f) {
+    switch (term.kind) {
+        case TerminatorKind::SwitchInt:
+            if (term.discriminant.is_place()) f(term.discriminant.place);
+            break;
+        case TerminatorKind::Call:
+            for (auto& arg : term.args) {
+                if (arg.is_place()) f(arg.place);
+            }
+            f(term.destination);
+            break;
+        case TerminatorKind::Drop:
+            f(term.place);
+            break;
+        default:
+            break;
+    }
+}
+
+// Calls f(LocalId) for every local whose current value a statement reads.
+// A write through `*p` reads `p`; a partial write `x.f = ...` keeps the rest
+// of `x` alive, so it counts as a read too.
+template <typename F>
+void for_each_use(const Statement& stmt, F&& f) {
+    if (stmt.kind != StatementKind::Assign) return;
+    for (const auto& op : stmt.rvalue.operands) {
+        if (op.is_place()) f(op.place.local);
+    }
+    if (stmt.rvalue.kind == RvalueKind::Ref) f(stmt.rvalue.place.local);
+    if (!stmt.place.is_local()) f(stmt.place.local);
+}
+
+template <typename F>
+void for_each_use(const Terminator& term, F&& f) {
+    switch (term.kind) {
+        case TerminatorKind::SwitchInt:
+            if (term.discriminant.is_place()) f(term.discriminant.place.local);
+            break;
+        case TerminatorKind::Call:
+            for (const auto& arg : term.args) {
+                if (arg.is_place()) f(arg.place.local);
+            }
+            if (!term.destination.is_local()) f(term.destination.local);
+            break;
+        case TerminatorKind::Drop:
+            f(term.place.local);
+            break;
+        case TerminatorKind::Return:
+            f(RETURN_LOCAL);
+            break;
+        default:
+            break;
+    }
+}
+
+} // namespace apex::mir
@@ -0,0 +1,399 @@
+#include "BorrowCheck.h"
+#include "Analysis.h"
+#include <algorithm>
+#include <sstream>
+
+namespace apex::mir {
+
+namespace {
+
+void merge(std::vector<bool>& into, const std::vector<bool>& from) {
+    for (size_t i = 0; i < from.size(); i++) {
+        if (from[i]) into[i] = true;
+    }
+}
+
+bool overlapping_projections(const Place& a, const Place& b, size_t from) {
+    size_t common = std::min(a.projection.size(), b.projection.size());
+    for (size_t i = from; i < common; i++) {
+        const auto& x = a.projection[i];
+        const auto& y = b.projection[i];
+        if (x.kind != y.kind) return false;
+        if (x.kind == ProjectionKind::Field && x.field_index != y.field_index) return false;
+    }
+    return true;
+}
+
+// Two places overlap when one is a prefix of the other
+bool overlaps(const Place& a, const Place& b) {
+    return a.local == b.local && overlapping_projections(a, b, 0);
+}
+
+// Overwriting a reference (or its storage going away) leaves the memory
+// behind it untouched, so it doesn't conflict with borrows through it
+bool only_reaches_through_deref(const Place& access, const Place& borrowed) {
+    for (size_t i = access.projection.size(); i < borrowed.projection.size(); i++) {
+        if (borrowed.projection[i].kind == ProjectionKind::Deref) return true;
+    }
+    return false;
+}
+
+} // namespace
+
+bool BorrowChecker::check(const Module& module) {
+    module_ = &module;
+    for (const auto& func : module.functions) {
+        if (func->is_extern || func->blocks.empty()) continue;
+        check_function(*func);
+    }
+    return errors_.empty();
+}
+
+void BorrowChecker::check_function(const Function& func) {
+    func_ = &func;
+    borrows_.clear();
+
+    // Every `&place` / `&mut place` statement creates one borrow
+    std::vector<std::vector<std::optional<size_t>>> borrow_at(func.blocks.size());
+    for (BlockId bb = 0; bb < func.blocks.size(); bb++) {
+        const auto& stmts = func.blocks[bb].statements;
+        borrow_at[bb].resize(stmts.size());
+        for (size_t i = 0; i < stmts.size(); i++) {
+            if (stmts[i].kind == StatementKind::Assign && stmts[i].rvalue.kind == RvalueKind::Ref) {
+                borrow_at[bb][i] = borrows_.size();
+                borrows_.push_back({stmts[i].rvalue.place, stmts[i].rvalue.is_mutable});
+            }
+        }
+    }
+
+    // Forward dataflow: which borrows each local may hold on block entry
+    size_t num_locals = func.locals.size();
+    HolderState empty(num_locals, BorrowSet(borrows_.size(), false));
+    std::vector<HolderState> entry_state(func.blocks.size(), empty);
+    std::vector<BlockId> order = reverse_postorder(func);
+
+    for (bool changed = true; changed;) {
+        changed = false;
+        for (BlockId bb : order) {
+            const auto& block = func.blocks[bb];
+            HolderState state = entry_state[bb];
+            for (size_t i = 0; i < block.statements.size(); i++) {
+                transfer(state, block.statements[i], borrow_at[bb][i]);
+            }
+            if (!block.terminator) continue;
+            transfer(state, *block.terminator);
+
+            for (BlockId succ : block.terminator->successors()) {
+                HolderState& target = entry_state[succ];
+                for (size_t local = 0; local < num_locals; local++) {
+                    for (size_t b = 0; b < borrows_.size(); b++) {
+                        if (state[local][b] && !target[local][b]) {
+                            target[local][b] = true;
+                            changed = true;
+                        }
+                    }
+                }
+            }
+        }
+    }
+
+    // A borrow is alive at a point if a local holding it is live there
+    std::vector<LiveSet> live_out = compute_live_out(func);
+    std::vector<bool> reachable = reachable_blocks(func);
+
+    for (BlockId bb = 0; bb < func.blocks.size(); bb++) {
+        if (!reachable[bb]) continue;
+        const auto& block = func.blocks[bb];
+        size_t n = block.statements.size();
+
+        std::vector<LiveSet> live_before(n + 1);
+        LiveSet live = live_out[bb];
+        if (block.terminator) {
+            const Terminator& term = *block.terminator;
+            if (term.kind == TerminatorKind::Call && term.destination.is_local()) {
+                live[term.destination.local] = false;
+            }
+            for_each_use(term, [&](LocalId local) { live[local] = true; });
+        }
+        live_before[n] = live;
+        for (size_t i = n; i-- > 0;) {
+            if (auto local = assigned_local(block.statements[i])) live[*local] = false;
+            for_each_use(block.statements[i], [&](LocalId local) { live[local] = true; });
+            live_before[i] = live;
+        }
+
+        HolderState state = entry_state[bb];
+        auto active_borrows = [&](const LiveSet& live_locals, std::optional<LocalId> except) {
+            BorrowSet active(borrows_.size(), false);
+            for (LocalId local = 0; local < num_locals; local++) {
+                if (live_locals[local] && local != except) merge(active, state[local]);
+            }
+            return active;
+        };
+
+        for (size_t i = 0; i < n; i++) {
+            const Statement& stmt = block.statements[i];
+            BorrowSet active = active_borrows(live_before[i], std::nullopt);
+
+            if (stmt.kind == StatementKind::Assign) {
+                for (const auto& op : stmt.rvalue.operands) {
+                    if (op.is_place()) check_access(op.place, AccessKind::Read, active, stmt.location);
+                }
+                if (stmt.rvalue.kind == RvalueKind::Cast && !stmt.rvalue.operands.empty()) {
+                    const Operand& op = stmt.rvalue.operands[0];
+                    BorrowSet held = op.is_place() ? state[op.place.local] : BorrowSet(borrows_.size(), false);
+                    check_cast(stmt.rvalue, held, stmt.location);
+                }
+                if (stmt.rvalue.kind == RvalueKind::Ref) {
+                    bool is_mut = stmt.rvalue.is_mutable;
+                    check_access(stmt.rvalue.place, is_mut ? AccessKind::BorrowMut : AccessKind::BorrowShared,
+                                 active, stmt.location);
+                    if (is_mut) {
+                        check_projected_write(stmt.rvalue.place, true, stmt.location);
+                        check_write_through_shared(stmt.rvalue.place, stmt.location);
+                    }
+                }
+                check_access(stmt.place, AccessKind::Write, active, stmt.location);
+                check_projected_write(stmt.place, false, stmt.location);
+                check_write_through_shared(stmt.place, stmt.location);
+            } else if (stmt.kind == StatementKind::StorageDead) {
+                // References returned from the function are reported at the return
+                BorrowSet held = active_borrows(live_before[i], RETURN_LOCAL);
+                check_access(Place(stmt.local), AccessKind::StorageDead, held, stmt.location);
+            }
+
+            transfer(state, stmt, borrow_at[bb][i]);
+        }
+
+        if (!block.terminator) continue;
+        const Terminator& term = *block.terminator;
+        BorrowSet active = active_borrows(live_before[n], std::nullopt);
+        switch (term.kind) {
+            case TerminatorKind::SwitchInt:
+                if (term.discriminant.is_place()) {
+                    check_access(term.discriminant.place, AccessKind::Read, active, term.location);
+                }
+                break;
+            case TerminatorKind::Call: {
+                for (const auto& arg : term.args) {
+                    if (arg.is_place()) check_access(arg.place, AccessKind::Read, active, term.location);
+                }
+                // Borrows passed to the call end with it unless still held
+                std::optional<LocalId> overwritten;
+                if (term.destination.is_local()) overwritten = term.destination.local;
+                BorrowSet after = active_borrows(live_out[bb], overwritten);
+                check_access(term.destination, AccessKind::Write, after, term.location);
+                check_projected_write(term.destination, false, term.location);
+                check_write_through_shared(term.destination, term.location);
+                break;
+            }
+            case TerminatorKind::Drop:
+                check_access(term.place, AccessKind::Write, active, term.location);
+                break;
+            case TerminatorKind::Return:
+                for (size_t b = 0; b < borrows_.size(); b++) {
+                    if (state[RETURN_LOCAL][b] && !has_deref(borrows_[b].place)) {
+                        const Place& place = borrows_[b].place;
+                        error(term.location, func.locals[place.local].name.empty()
+                                                 ? "Cannot return a reference to a temporary value"
+                                                 : "Cannot return a reference to local variable '" +
+                                                       describe(place) + "'");
+                        break;
+                    }
+                }
+                break;
+            default:
+                break;
+        }
+    }
+}
+
+bool BorrowChecker::may_hold_borrow(const Type& type) const {
+    if (type.kind == TypeKind::Ref || type.kind == TypeKind::Ptr) return true;
+    if (type.kind != TypeKind::Struct) return false;
+    const StructDef* def = module_->find_struct(type.struct_name);
+    if (!def) return false;
+    for (const auto& field : def->fields) {
+        if (may_hold_borrow(field.second)) return true;
+    }
+    return false;
+}
+
+BorrowChecker::BorrowSet BorrowChecker::contents(const HolderState& state, const Operand& op) const {
+    if (!op.is_place() || !may_hold_borrow(module_->operand_type(*func_, op))) {
+        return BorrowSet(borrows_.size(), false);
+    }
+    return state[op.place.local];
+}
+
+void BorrowChecker::transfer(HolderState& state, const Statement& stmt, std::optional<size_t> borrow) const {
+    if (stmt.kind == StatementKind::StorageDead) {
+        state[stmt.local].assign(borrows_.size(), false);
+        return;
+    }
+    if (stmt.kind != StatementKind::Assign) return;
+
+    BorrowSet value(borrows_.size(), false);
+    if (stmt.rvalue.kind == RvalueKind::Ref) {
+        // A reborrow keeps the borrows it goes through alive
+        if (borrow) value[*borrow] = true;
+        merge(value, state[stmt.rvalue.place.local]);
+    } else {
+        for (const auto& op : stmt.rvalue.operands) {
+            merge(value, contents(state, op));
+        }
+    }
+
+    if (stmt.place.is_local()) {
+        state[stmt.place.local] = std::move(value);
+    } else {
+        merge(state[stmt.place.local], value);
+    }
+}
+
+void BorrowChecker::transfer(HolderState& state, const Terminator& term) const {
+    if (term.kind != TerminatorKind::Call) return;
+
+    // Without signatures that relate lifetimes, a returned reference may
+    // come from any reference argument
+    BorrowSet value(borrows_.size(), false);
+    if (may_hold_borrow(module_->place_type(*func_, term.destination))) {
+        for (const auto& arg : term.args) {
+            merge(value, contents(state, arg));
+        }
+    }
+
+    if (term.destination.is_local()) {
+        state[term.destination.local] = std::move(value);
+    } else {
+        merge(state[term.destination.local], value);
+    }
+}
+
+void BorrowChecker::check_access(const Place& place, AccessKind kind, const BorrowSet& active,
+                                 const SourceLocation& loc) {
+    for (size_t b = 0; b < borrows_.size(); b++) {
+        if (!active[b]) continue;
+        const Borrow& borrow = borrows_[b];
+        if (!may_alias(place, borrow.place)) continue;
+
+        std::string name = describe(place);
+        switch (kind) {
+            case AccessKind::Read:
+                if (!borrow.is_mutable) continue;
+                error(loc, "Cannot use '" + name + "' because it is mutably borrowed");
+                return;
+            case AccessKind::Write:
+                if (only_reaches_through_deref(place, borrow.place)) continue;
+                error(loc, "Cannot assign to '" + name + "' because it is borrowed");
+                return;
+            case AccessKind::BorrowShared:
+                if (!borrow.is_mutable) continue;
+                error(loc, "Cannot borrow '" + name + "' as immutable because it is also borrowed as mutable");
+                return;
+            case AccessKind::BorrowMut:
+                error(loc, borrow.is_mutable
+                               ? "Cannot borrow '" + name + "' as mutable more than once at a time"
+                               : "Cannot borrow '" + name + "' as mutable because it is also borrowed as immutable");
+                return;
+            case AccessKind::StorageDead:
+                if (only_reaches_through_deref(place, borrow.place)) continue;
+                error(loc, "'" + name + "' does not live long enough");
+                return;
+        }
+    }
+}
+
+// `s.f = v` and `&mut s.f` need `s` itself to be `mut`, unless `s` is a
+// reference the write goes through (`r.f` is `(*r).f`). Sema checks this
+// for bindings whose type it knows; the rest are left to here. Writes to
+// the whole variable are InitChecker's.
+void BorrowChecker::check_projected_write(const Place& place, bool borrow, const SourceLocation& loc) {
+    if (place.projection.empty() || place.projection[0].kind == ProjectionKind::Deref) return;
+    const LocalDecl& decl = func_->locals[place.local];
+    if (decl.is_mutable || decl.name.empty()) return;
+    error(loc, borrow ? "Cannot borrow immutable variable '" + decl.name + "' as mutable"
+                      : "Cannot assign to immutable variable '" + decl.name + "'");
+}
+
+void BorrowChecker::check_write_through_shared(const Place& place, const SourceLocation& loc) {
+    Type type = func_->locals[place.local].type;
+    Place prefix(place.local);
+    for (const auto& elem : place.projection) {
+        if (elem.kind == ProjectionKind::Deref) {
+            if (type.kind == TypeKind::Ref && !type.is_mutable) {
+                error(loc, "Cannot write through '&' reference '" + describe(prefix) + "'");
+                return;
+            }
+            if (!type.pointee) return;
+            type = *type.pointee;
+        } else {
+            const StructDef* def = module_->find_struct(type.struct_name);
+            if (!def || elem.field_index >= def->fields.size()) return;
+            type = def->fields[elem.field_index].second;
+        }
+        prefix.projection.push_back(elem);
+    }
+}
+
+// `&T as *mut T` (also by way of `*const T` or an integer, which still hold
+// the borrow) would allow writes through a `&`, and `p as &mut T` an alias
+// the checker can't see. References come from borrows only.
+void BorrowChecker::check_cast(const Rvalue& rv, const BorrowSet& held, const SourceLocation& loc) {
+    Type from = module_->operand_type(*func_, rv.operands[0]);
+    const Type& to = rv.type;
+    if (to.kind == TypeKind::Ref && from.kind != TypeKind::Ref) {
+        error(loc, "Cannot cast " + from.to_string() + " to a reference; borrow through it instead");
+        return;
+    }
+    if ((to.kind != TypeKind::Ref && to.kind != TypeKind::Ptr) || !to.is_mutable) return;
+
+    bool shared = (from.kind == TypeKind::Ref || from.kind == TypeKind::Ptr) && !from.is_mutable;
+    for (size_t b = 0; b < borrows_.size() && !shared; b++) {
+        shared = held[b] && !borrows_[b].is_mutable;
+    }
+    if (shared) error(loc, "Cannot cast a '&' reference to mutable " + to.to_string());
+}
+
+// `*p` with `p` a raw pointer, which any other raw pointer may alias
+bool BorrowChecker::through_raw_pointer(const Place& place) const {
+    return !place.projection.empty() && place.projection[0].kind == ProjectionKind::Deref &&
+           func_->locals[place.local].type.kind == TypeKind::Ptr;
+}
+
+bool BorrowChecker::may_alias(const Place& a, const Place& b) const {
+    if (overlaps(a, b)) return true;
+    return through_raw_pointer(a) && through_raw_pointer(b) && overlapping_projections(a, b, 1);
+}
+
+// Source-level spelling of a place: `p.x`, `*r`, `r.x` for `(*r).x`
+std::string BorrowChecker::describe(const Place& place) const {
+    const LocalDecl& decl = func_->locals[place.local];
+    if (decl.name.empty()) return "temporary value";
+
+    std::string text = decl.name;
+    Type type = decl.type;
+    for (size_t i = 0; i < place.projection.size(); i++) {
+        const auto& elem = place.projection[i];
+        if (elem.kind == ProjectionKind::Deref) {
+            bool field_follows = i + 1 < place.projection.size() &&
+                                 place.projection[i + 1].kind == ProjectionKind::Field;
+            if (!field_follows) text = "*" + text;
+            type = type.pointee ? *type.pointee : Type::void_type();
+        } else {
+            const StructDef* def = module_->find_struct(type.struct_name);
+            if (!def || elem.field_index >= def->fields.size()) break;
+            text += "." + def->fields[elem.field_index].first;
+            type = def->fields[elem.field_index].second;
+        }
+    }
+    return text;
+}
+
+void BorrowChecker::error(const SourceLocation& loc, const std::string& message) {
+    std::ostringstream oss;
+    oss << loc.filename << ":" << loc.line << ":" << loc.column << ": error: " << message;
+    errors_.push_back(oss.str());
+}
+
+} // namespace apex::mir
@@ -0,0 +1,64 @@
+#pragma once
+
+#include "MIR.h"
+#include <string>
+#include <vector>
+
+namespace apex::mir {
+
+// Borrow checker over MIR with non-lexical lifetimes. A borrow stays alive
+// only while some local that may hold it (the reference itself, copies of
+// it and reborrows through it) is still going to be read, so a reference's
+// last use ends the borrow rather than the end of its scope.
+//
+// While a borrow is alive, its place (and anything overlapping it) may not
+// be written or moved out of, and a `&mut` borrow is unique: the place may
+// not be read or borrowed again except through that reference. Writes
+// through `&` references and references that escape their local's storage
+// are rejected too, and so are casts that would get around these rules:
+// ones that make a `&` reference writable and ones that make references out
+// of raw pointers. Places reached through different raw pointers may be the
+// same memory. Codegen relies on this to mark `&mut` parameters `noalias`
+// and `&` parameters `readonly`.
+class BorrowChecker {
+public:
+    bool check(const Module& module);
+
+    const std::vector<std::string>& get_errors() const { return errors_; }
+    bool has_errors() const { return !errors_.empty(); }
+
+private:
+    struct Borrow {
+        Place place;
+        bool is_mutable;
+    };
+
+    enum class AccessKind { Read, Write, BorrowShared, BorrowMut, StorageDead };
+
+    // Per local, the borrows whose reference it may currently contain
+    using BorrowSet = std::vector<bool>;
+    using HolderState = std::vector<BorrowSet>;
+
+    const Module* module_{nullptr};
+    const Function* func_{nullptr};
+    std::vector<Borrow> borrows_;
+    std::vector<std::string> errors_;
+
+    void check_function(const Function& func);
+    void transfer(HolderState& state, const Statement& stmt, std::optional<size_t> borrow) const;
+    void transfer(HolderState& state, const Terminator& term) const;
+    BorrowSet contents(const HolderState& state, const Operand& op) const;
+    bool may_hold_borrow(const Type& type) const;
+
+    void check_access(const Place& place, AccessKind kind, const BorrowSet& active, const SourceLocation& loc);
+    void check_write_through_shared(const Place& place, const SourceLocation& loc);
+    void check_cast(const Rvalue& rv, const BorrowSet& held, const SourceLocation& loc);
+    bool through_raw_pointer(const Place& place) const;
+    bool may_alias(const Place& a, const Place& b) const;
+    void check_projected_write(const Place& place, bool borrow, const SourceLocation& loc);
+
+    std::string describe(const Place& place) const;
+    void error(const SourceLocation& loc, const std::string& message);
+};
+
+} // namespace apex::mir
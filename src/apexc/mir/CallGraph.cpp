@@ -0,0 +1,161 @@
+#include "CallGraph.h"
+#include <algorithm>
+
+namespace apex::mir {
+
+CallGraph CallGraph::build(const Module& module) {
+    CallGraph graph;
+    for (const auto& func : module.functions) {
+        graph.index[func->name] = graph.nodes.size();
+        graph.nodes.push_back(func.get());
+    }
+
+    size_t n = graph.nodes.size();
+    graph.callees.resize(n);
+    for (size_t node = 0; node < n; node++) {
+        auto& edges = graph.callees[node];
+        for (const auto& block : graph.nodes[node]->blocks) {
+            if (!block.terminator || block.terminator->kind != TerminatorKind::Call) continue;
+            auto it = graph.index.find(block.terminator->callee);
+            if (it != graph.index.end()) edges.push_back(it->second);
+        }
+        std::sort(edges.begin(), edges.end());
+        edges.erase(std::unique(edges.begin(), edges.end()), edges.end());
+    }
+
+    // Tarjan's algorithm, iterative so deep call chains can't overflow the
+    // stack. SCCs are emitted in reverse topological order, i.e. bottom-up.
+    constexpr size_t UNVISITED = static_cast<size_t>(-1);
+    std::vector<size_t> order(n, UNVISITED), lowlink(n, 0);
+    std::vector<bool> on_stack(n, false);
+    std::vector<size_t> stack;
+    size_t counter = 0;
+    graph.scc_of.assign(n, 0);
+
+    for (size_t root = 0; root < n; root++) {
+        if (order[root] != UNVISITED) continue;
+
+        std::vector<std::pair<size_t, size_t>> work = {{root, 0}};   // (node, next edge)
+        order[root] = lowlink[root] = counter++;
+        stack.push_back(root);
+        on_stack[root] = true;
+
+        while (!work.empty()) {
+            auto& [node, next] = work.back();
+            if (next < graph.callees[node].size()) {
+                size_t callee = graph.callees[node][next++];
+                if (order[callee] == UNVISITED) {
+                    order[callee] = lowlink[callee] = counter++;
+                    stack.push_back(callee);
+                    on_stack[callee] = true;
+                    work.push_back({callee, 0});
+                } else if (on_stack[callee]) {
+                    lowlink[node] = std::min(lowlink[node], order[callee]);
+                }
+                continue;
+            }
+
+            if (lowlink[node] == order[node]) {
+                std::vector<size_t> scc;
+                size_t member;
+                do {
+                    member = stack.back();
+                    stack.pop_back();
+                    on_stack[member] = false;
+                    graph.scc_of[member] = graph.sccs.size();
+                    scc.push_back(member);
+                } while (member != node);
+                std::reverse(scc.begin(), scc.end());
+                graph.sccs.push_back(std::move(scc));
+            }
+
+            size_t finished = node;
+            work.pop_back();
+            if (!work.empty()) {
+                size_t parent = work.back().first;
+                lowlink[parent] = std::min(lowlink[parent], lowlink[finished]);
+            }
+        }
+    }
+
+    return graph;
+}
+
+std::optional<size_t> CallGraph::find(const std::string& name) const {
+    auto it = index.find(name);
+    if (it == index.end()) return std::nullopt;
+    return it->second;
+}
+
+bool CallGraph::is_recursive(size_t node) const {
+    if (sccs[scc_of[node]].size() > 1) return true;
+    const auto& edges = callees[node];
+    return std::binary_search(edges.begin(), edges.end(), node);
+}
+
+bool CallGraph::is_root(size_t node) const {
+    const Function& func = *nodes[node];
+    if (func.is_imported) return false;
+    return func.name == "main" || func.is_public || func.is_exported || func.is_destructor;
+}
+
+std::vector<bool> CallGraph::reachable() const {
+    std::vector<bool> seen(nodes.size(), false);
+    std::vector<size_t> worklist;
+    for (size_t node = 0; node < nodes.size(); node++) {
+        if (is_root(node)) {
+            seen[node] = true;
+            worklist.push_back(node);
+        }
+    }
+    while (!worklist.empty()) {
+        size_t node = worklist.back();
+        worklist.pop_back();
+        for (size_t callee : callees[node]) {
+            if (seen[callee]) continue;
+            seen[callee] = true;
+            worklist.push_back(callee);
+        }
+    }
+    return seen;
+}
+
+void print_call_graph_dot(const CallGraph& graph, std::ostream& os) {
+    os << "digraph callgraph {\n";
+    for (size_t node = 0; node < graph.nodes.size(); node++) {
+        os << "  \"" << graph.nodes[node]->name << "\"";
+        if (graph.is_root(node)) {
+            os << " [shape=box]";
+        } else if (graph.nodes[node]->is_extern) {
+            os << " [style=dashed]";
+        }
+        os << ";\n";
+    }
+    for (size_t node = 0; node < graph.nodes.size(); node++) {
+        for (size_t callee : graph.callees[node]) {
+            os << "  \"" << graph.nodes[node]->name << "\" -> \"" << graph.nodes[callee]->name << "\";\n";
+        }
+    }
+    os << "}\n";
+}
+
+void print_call_graph_json(const CallGraph& graph, std::ostream& os) {
+    // Function names are identifiers, so nothing needs escaping
+    os << "{\n  \"functions\": [";
+    for (size_t node = 0; node < graph.nodes.size(); node++) {
+        const Function& func = *graph.nodes[node];
+        os << (node ? ",\n" : "\n") << "    {\"name\": \"" << func.name << "\""
+           << ", \"root\": " << (graph.is_root(node) ? "true" : "false")
+           << ", \"extern\": " << (func.is_extern ? "true" : "false")
+           << ", \"recursive\": " << (graph.is_recursive(node) ? "true" : "false")
+           << ", \"scc\": " << graph.scc_of[node]
+           << ", \"callees\": [";
+        for (size_t i = 0; i < graph.callees[node].size(); i++) {
+            os << (i ? ", " : "") << "\"" << graph.nodes[graph.callees[node][i]]->name << "\"";
+        }
+        os << "]}";
+    }
+    os << "\n  ]\n}\n";
+}
+
+} // namespace apex::mir
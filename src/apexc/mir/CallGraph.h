@@ -0,0 +1,48 @@
+#pragma once
+
+#include "MIR.h"
+#include <optional>
+#include <ostream>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace apex::mir {
+
+// Direct-call graph over a module's functions. Nodes are indices into
+// `nodes`, in module order; each node's callee list is deduplicated.
+struct CallGraph {
+    std::vector<Function*> nodes;
+    std::unordered_map<std::string, size_t> index;
+    std::vector<std::vector<size_t>> callees;
+
+    // Strongly connected components in bottom-up order: every SCC comes
+    // after all SCCs it calls into.
+    std::vector<std::vector<size_t>> sccs;
+    std::vector<size_t> scc_of;
+
+    static CallGraph build(const Module& module);
+
+    std::optional<size_t> find(const std::string& name) const;
+
+    // True for functions that can reach themselves through calls
+    bool is_recursive(size_t node) const;
+    bool same_scc(size_t a, size_t b) const { return scc_of[a] == scc_of[b]; }
+
+    // Entry points that must be kept whether or not anything calls them:
+    // `main`, `pub` functions, functions exported from `extern` blocks and
+    // destructors (values may be dropped in another module). Bodies imported
+    // for inlining are only kept while something still calls them.
+    bool is_root(size_t node) const;
+
+    // Nodes reachable through calls from some root
+    std::vector<bool> reachable() const;
+};
+
+// Graphviz and JSON renderings for external tooling. Roots are boxed in
+// DOT and extern declarations dashed; JSON lists every node with its
+// callees, SCC index (bottom-up) and flags.
+void print_call_graph_dot(const CallGraph& graph, std::ostream& os);
+void print_call_graph_json(const CallGraph& graph, std::ostream& os);
+
+} // namespace apex::mir
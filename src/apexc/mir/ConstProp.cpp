@@ -0,0 +1,372 @@
+#include "Passes.h"
+#include "Analysis.h"
+#include <algorithm>
+#include <cmath>
+
+namespace apex::mir {
+
+namespace {
+
+// Lattice value of a tracked local: a known constant or overdefined.
+// "Not yet reached" is represented by a block having no state at all.
+struct LatticeValue {
+    bool is_const{false};
+    Constant value;
+
+    bool operator==(const LatticeValue& other) const {
+        if (is_const != other.is_const) return false;
+        return !is_const || (value.type == other.value.type && value.value == other.value.value);
+    }
+};
+
+using State = std::vector<LatticeValue>;
+
+bool is_foldable_type(const Type& type) {
+    return type.kind == TypeKind::Bool || type.kind == TypeKind::Float ||
+           (type.kind == TypeKind::Int && type.bits <= 64);
+}
+
+// Truncates to the type's width and sign- or zero-extends back to 64 bits
+int64_t wrap_int(uint64_t value, const Type& type) {
+    if (type.bits >= 64) return static_cast<int64_t>(value);
+    uint64_t mask = (uint64_t(1) << type.bits) - 1;
+    value &= mask;
+    if (type.is_signed && (value >> (type.bits - 1)) & 1) value |= ~mask;
+    return static_cast<int64_t>(value);
+}
+
+Constant make_int(const Type& type, uint64_t value) {
+    return Constant{type, wrap_int(value, type)};
+}
+
+Constant make_bool(bool value) {
+    return Constant{Type::bool_type(), value};
+}
+
+Constant make_float(const Type& type, double value) {
+    if (type.bits == 32) value = static_cast<float>(value);
+    return Constant{type, value};
+}
+
+double as_float(const Constant& c) {
+    return std::holds_alternative<double>(c.value) ? std::get<double>(c.value) : 0.0;
+}
+
+std::optional<Constant> compare(BinOp op, bool lt, bool eq) {
+    switch (op) {
+        case BinOp::Eq: return make_bool(eq);
+        case BinOp::Ne: return make_bool(!eq);
+        case BinOp::Lt: return make_bool(lt);
+        case BinOp::Le: return make_bool(lt || eq);
+        case BinOp::Gt: return make_bool(!lt && !eq);
+        case BinOp::Ge: return make_bool(!lt);
+        default: return std::nullopt;
+    }
+}
+
+std::optional<Constant> fold_binary(BinOp op, const Constant& lhs, const Constant& rhs) {
+    const Type& type = lhs.type;
+    if (!is_foldable_type(type) || !is_foldable_type(rhs.type)) return std::nullopt;
+
+    if (type.kind == TypeKind::Float) {
+        double a = as_float(lhs), b = as_float(rhs);
+        switch (op) {
+            case BinOp::Add: return make_float(type, a + b);
+            case BinOp::Sub: return make_float(type, a - b);
+            case BinOp::Mul: return make_float(type, a * b);
+            case BinOp::Div: return make_float(type, a / b);
+            case BinOp::Rem: return make_float(type, std::fmod(a, b));
+            case BinOp::Ne: return make_bool(!(a == b));   // Unordered-or-not-equal
+            default:
+                if (std::isnan(a) || std::isnan(b)) {
+                    return is_comparison(op) ? std::optional<Constant>(make_bool(false)) : std::nullopt;
+                }
+                return compare(op, a < b, a == b);
+        }
+    }
+
+    // Integers and booleans (booleans compare as unsigned 0/1)
+    bool is_signed = type.kind == TypeKind::Int && type.is_signed;
+    int64_t a = lhs.as_int(), b = rhs.as_int();
+    uint64_t ua = static_cast<uint64_t>(a), ub = static_cast<uint64_t>(b);
+
+    if (is_comparison(op)) {
+        return compare(op, is_signed ? a < b : ua < ub, a == b);
+    }
+
+    if (type.kind == TypeKind::Bool) {
+        switch (op) {
+            case BinOp::BitAnd: return make_bool(a && b);
+            case BinOp::BitOr: return make_bool(a || b);
+            case BinOp::BitXor: return make_bool((a != 0) != (b != 0));
+            default: return std::nullopt;
+        }
+    }
+
+    switch (op) {
+        case BinOp::Add: return make_int(type, ua + ub);
+        case BinOp::Sub: return make_int(type, ua - ub);
+        case BinOp::Mul: return make_int(type, ua * ub);
+        case BinOp::Div:
+        case BinOp::Rem: {
+            if (b == 0) return std::nullopt;   // Leave the trap to runtime
+            if (!is_signed) return make_int(type, op == BinOp::Div ? ua / ub : ua % ub);
+            int64_t min = wrap_int(uint64_t(1) << (std::min(type.bits, 64u) - 1), type);
+            if (a == min && b == -1) return std::nullopt;   // Overflow is undefined
+            return make_int(type, static_cast<uint64_t>(op == BinOp::Div ? a / b : a % b));
+        }
+        case BinOp::BitAnd: return make_int(type, ua & ub);
+        case BinOp::BitOr: return make_int(type, ua | ub);
+        case BinOp::BitXor: return make_int(type, ua ^ ub);
+        case BinOp::Shl:
+        case BinOp::Shr:
+            if (b < 0 || ub >= type.bits) return std::nullopt;   // Poison in LLVM
+            if (op == BinOp::Shl) return make_int(type, ua << ub);
+            return make_int(type, is_signed ? static_cast<uint64_t>(a >> b) : ua >> ub);
+        default:
+            return std::nullopt;
+    }
+}
+
+std::optional<Constant> fold_unary(UnOp op, const Constant& operand) {
+    const Type& type = operand.type;
+    if (!is_foldable_type(type)) return std::nullopt;
+
+    switch (type.kind) {
+        case TypeKind::Bool:
+            if (op == UnOp::Not) return make_bool(operand.as_int() == 0);
+            return std::nullopt;
+        case TypeKind::Float:
+            if (op == UnOp::Neg) return make_float(type, -as_float(operand));
+            return std::nullopt;
+        default: {
+            uint64_t value = static_cast<uint64_t>(operand.as_int());
+            return make_int(type, op == UnOp::Neg ? 0 - value : ~value);
+        }
+    }
+}
+
+std::optional<Constant> fold_cast(const Constant& operand, const Type& to) {
+    const Type& from = operand.type;
+    if (!is_foldable_type(from) || !is_foldable_type(to)) return std::nullopt;
+
+    if (from.kind == TypeKind::Float) {
+        double value = as_float(operand);
+        if (to.kind == TypeKind::Float) return make_float(to, value);
+        if (to.kind == TypeKind::Bool || std::isnan(value)) return std::nullopt;
+
+        // Out-of-range float-to-int conversions are poison; leave them alone
+        double truncated = std::trunc(value);
+        double lo = to.is_signed ? -std::ldexp(1.0, to.bits - 1) : 0.0;
+        double hi = to.is_signed ? std::ldexp(1.0, to.bits - 1) : std::ldexp(1.0, to.bits);
+        if (truncated < lo || truncated >= hi) return std::nullopt;
+        if (to.is_signed) return make_int(to, static_cast<uint64_t>(static_cast<int64_t>(truncated)));
+        return make_int(to, static_cast<uint64_t>(truncated));
+    }
+
+    // Integer or bool source; its 64-bit representation is already extended
+    // according to its own signedness
+    int64_t value = operand.as_int();
+    if (to.kind == TypeKind::Bool) return make_bool(value != 0);
+    if (to.kind == TypeKind::Float) {
+        bool is_signed = from.kind == TypeKind::Int && from.is_signed;
+        return make_float(to, is_signed ? static_cast<double>(value)
+                                        : static_cast<double>(static_cast<uint64_t>(value)));
+    }
+    return make_int(to, static_cast<uint64_t>(value));
+}
+
+Operand constant_operand(const Constant& c) {
+    Operand op;
+    op.kind = OperandKind::Constant;
+    op.constant = c;
+    return op;
+}
+
+class ConstantPropagation {
+public:
+    ConstantPropagation(const Module& module, Function& func)
+        : module_(module), func_(func) {
+        std::vector<bool> address_taken = find_address_taken(func);
+        tracked_.resize(func.locals.size());
+        for (LocalId local = 0; local < func.locals.size(); local++) {
+            tracked_[local] = !address_taken[local] && is_foldable_type(func.locals[local].type);
+        }
+    }
+
+    bool run() {
+        solve();
+        return rewrite();
+    }
+
+private:
+    const Module& module_;
+    Function& func_;
+    std::vector<bool> tracked_;
+    std::vector<std::optional<State>> entry_states_;
+
+    std::optional<Constant> eval_operand(const Operand& op, const State& state) const {
+        if (op.kind == OperandKind::Constant) return op.constant;
+        if (op.place.is_local() && tracked_[op.place.local] && state[op.place.local].is_const) {
+            return state[op.place.local].value;
+        }
+        return std::nullopt;
+    }
+
+    std::optional<Constant> eval_rvalue(const Rvalue& rv, const State& state) const {
+        switch (rv.kind) {
+            case RvalueKind::Use:
+                return eval_operand(rv.operands[0], state);
+            case RvalueKind::BinaryOp: {
+                auto lhs = eval_operand(rv.operands[0], state);
+                auto rhs = eval_operand(rv.operands[1], state);
+                if (!lhs || !rhs) return std::nullopt;
+                return fold_binary(rv.bin_op, *lhs, *rhs);
+            }
+            case RvalueKind::UnaryOp: {
+                auto operand = eval_operand(rv.operands[0], state);
+                if (!operand) return std::nullopt;
+                return fold_unary(rv.un_op, *operand);
+            }
+            case RvalueKind::Cast: {
+                auto operand = eval_operand(rv.operands[0], state);
+                if (!operand) return std::nullopt;
+                return fold_cast(*operand, rv.type);
+            }
+            default:
+                return std::nullopt;
+        }
+    }
+
+    void transfer(const Statement& stmt, State& state) const {
+        auto local = assigned_local(stmt);
+        if (!local || !tracked_[*local]) return;
+        auto value = eval_rvalue(stmt.rvalue, state);
+        state[*local] = value ? LatticeValue{true, *value} : LatticeValue{};
+    }
+
+    // Successors that can actually be taken given the block's out-state
+    std::vector<BlockId> feasible_successors(const Terminator& term, const State& state) const {
+        if (term.kind == TerminatorKind::SwitchInt) {
+            if (auto disc = eval_operand(term.discriminant, state)) {
+                int64_t value = disc->as_int();
+                for (size_t i = 0; i < term.values.size(); i++) {
+                    if (term.values[i] == value) return {term.targets[i]};
+                }
+                return {term.targets.back()};
+            }
+        }
+        return term.successors();
+    }
+
+    // Merges `incoming` into a block's entry state; returns true if it changed
+    bool meet_into(BlockId bb, const State& incoming) {
+        auto& current = entry_states_[bb];
+        if (!current) {
+            current = incoming;
+            return true;
+        }
+        bool changed = false;
+        for (size_t i = 0; i < incoming.size(); i++) {
+            if ((*current)[i].is_const && !((*current)[i] == incoming[i])) {
+                (*current)[i] = LatticeValue{};
+                changed = true;
+            }
+        }
+        return changed;
+    }
+
+    void solve() {
+        entry_states_.assign(func_.blocks.size(), std::nullopt);
+        // Parameters and uninitialized locals start out overdefined
+        entry_states_[ENTRY_BLOCK] = State(func_.locals.size());
+
+        std::vector<BlockId> worklist = {ENTRY_BLOCK};
+        std::vector<bool> queued(func_.blocks.size(), false);
+        queued[ENTRY_BLOCK] = true;
+
+        while (!worklist.empty()) {
+            BlockId bb = worklist.back();
+            worklist.pop_back();
+            queued[bb] = false;
+
+            State state = *entry_states_[bb];
+            const auto& block = func_.blocks[bb];
+            for (const auto& stmt : block.statements) {
+                transfer(stmt, state);
+            }
+            if (!block.terminator) continue;
+
+            const Terminator& term = *block.terminator;
+            if (term.kind == TerminatorKind::Call && term.destination.is_local() &&
+                tracked_[term.destination.local]) {
+                state[term.destination.local] = LatticeValue{};
+            }
+
+            for (BlockId succ : feasible_successors(term, state)) {
+                if (meet_into(succ, state) && !queued[succ]) {
+                    queued[succ] = true;
+                    worklist.push_back(succ);
+                }
+            }
+        }
+    }
+
+    bool substitute(Operand& op, const State& state) const {
+        if (op.kind == OperandKind::Constant) return false;
+        if (auto value = eval_operand(op, state)) {
+            op = constant_operand(*value);
+            return true;
+        }
+        return false;
+    }
+
+    bool rewrite() {
+        bool changed = false;
+        for (BlockId bb = 0; bb < func_.blocks.size(); bb++) {
+            if (!entry_states_[bb]) continue;   // Never executed; simplify_cfg drops it
+            State state = *entry_states_[bb];
+            auto& block = func_.blocks[bb];
+
+            for (auto& stmt : block.statements) {
+                for_each_operand(stmt, [&](Operand& op) { changed |= substitute(op, state); });
+
+                if (stmt.kind == StatementKind::Assign &&
+                    !(stmt.rvalue.kind == RvalueKind::Use && stmt.rvalue.operands[0].kind == OperandKind::Constant)) {
+                    if (auto value = eval_rvalue(stmt.rvalue, state)) {
+                        Type type = module_.place_type(func_, stmt.place);
+                        if (type == value->type) {
+                            stmt.rvalue = Rvalue::use(constant_operand(*value));
+                            changed = true;
+                        }
+                    }
+                }
+                transfer(stmt, state);
+            }
+
+            if (!block.terminator) continue;
+            Terminator& term = *block.terminator;
+            for_each_operand(term, [&](Operand& op) { changed |= substitute(op, state); });
+
+            if (term.kind == TerminatorKind::SwitchInt && term.discriminant.kind == OperandKind::Constant) {
+                BlockId target = feasible_successors(term, state)[0];
+                Terminator jump;
+                jump.kind = TerminatorKind::Goto;
+                jump.location = term.location;
+                jump.target = target;
+                term = std::move(jump);
+                changed = true;
+            }
+        }
+        return changed;
+    }
+};
+
+} // namespace
+
+bool propagate_constants(const Module& module, Function& func) {
+    if (func.blocks.empty()) return false;
+    return ConstantPropagation(module, func).run();
+}
+
+} // namespace apex::mir
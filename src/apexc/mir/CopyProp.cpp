@@ -0,0 +1,214 @@
+#include "Passes.h"
+#include "Analysis.h"
+
+namespace apex::mir {
+
+namespace {
+
+constexpr LocalId NO_COPY = static_cast<LocalId>(-1);
+
+// copy_of[a] == b means `a` currently holds the same value as `b`
+using CopyState = std::vector<LocalId>;
+
+class CopyPropagation {
+public:
+    explicit CopyPropagation(Function& func) : func_(func) {
+        std::vector<bool> address_taken = find_address_taken(func);
+        tracked_.resize(func.locals.size());
+        for (LocalId local = 0; local < func.locals.size(); local++) {
+            tracked_[local] = !address_taken[local] && func.locals[local].type.is_scalar();
+        }
+    }
+
+    bool run() {
+        solve();
+        return rewrite();
+    }
+
+private:
+    Function& func_;
+    std::vector<bool> tracked_;
+    std::vector<std::optional<CopyState>> entry_states_;
+
+    static void kill(CopyState& state, LocalId local) {
+        state[local] = NO_COPY;
+        for (auto& source : state) {
+            if (source == local) source = NO_COPY;
+        }
+    }
+
+    void transfer(const Statement& stmt, CopyState& state) const {
+        auto local = assigned_local(stmt);
+        if (!local || !tracked_[*local]) return;
+        kill(state, *local);
+
+        if (stmt.rvalue.kind != RvalueKind::Use) return;
+        const Operand& op = stmt.rvalue.operands[0];
+        if (op.is_place() && op.place.is_local() && tracked_[op.place.local] && op.place.local != *local) {
+            LocalId source = state[op.place.local] != NO_COPY ? state[op.place.local] : op.place.local;
+            state[*local] = source;
+        }
+    }
+
+    void solve() {
+        entry_states_.assign(func_.blocks.size(), std::nullopt);
+        entry_states_[ENTRY_BLOCK] = CopyState(func_.locals.size(), NO_COPY);
+
+        for (bool changed = true; changed;) {
+            changed = false;
+            for (BlockId bb : reverse_postorder(func_)) {
+                if (!entry_states_[bb]) continue;
+                CopyState state = *entry_states_[bb];
+                const auto& block = func_.blocks[bb];
+                for (const auto& stmt : block.statements) {
+                    transfer(stmt, state);
+                }
+                if (!block.terminator) continue;
+                if (block.terminator->kind == TerminatorKind::Call && block.terminator->destination.is_local()) {
+                    kill(state, block.terminator->destination.local);
+                }
+
+                for (BlockId succ : block.terminator->successors()) {
+                    auto& target = entry_states_[succ];
+                    if (!target) {
+                        target = state;
+                        changed = true;
+                        continue;
+                    }
+                    for (size_t i = 0; i < state.size(); i++) {
+                        if ((*target)[i] != NO_COPY && (*target)[i] != state[i]) {
+                            (*target)[i] = NO_COPY;
+                            changed = true;
+                        }
+                    }
+                }
+            }
+        }
+    }
+
+    // Replaces the base local of a place that only reads it
+    bool substitute(Place& place, const CopyState& state) const {
+        if (!tracked_[place.local] || state[place.local] == NO_COPY) return false;
+        place.local = state[place.local];
+        return true;
+    }
+
+    bool rewrite_operand(Operand& op, const CopyState& state) const {
+        if (!op.is_place()) return false;
+        if (op.place.is_local() || has_deref(op.place)) {
+            if (substitute(op.place, state)) {
+                if (op.place.is_local()) op.kind = OperandKind::Copy;
+                return true;
+            }
+        }
+        return false;
+    }
+
+    bool rewrite() {
+        bool changed = false;
+        for (BlockId bb = 0; bb < func_.blocks.size(); bb++) {
+            if (!entry_states_[bb]) continue;
+            CopyState state = *entry_states_[bb];
+            auto& block = func_.blocks[bb];
+
+            for (auto& stmt : block.statements) {
+                for_each_operand(stmt, [&](Operand& op) { changed |= rewrite_operand(op, state); });
+                if (stmt.kind == StatementKind::Assign) {
+                    // Reads through a copied pointer: `*a = ...`, `&(*a).f`
+                    if (has_deref(stmt.place)) changed |= substitute(stmt.place, state);
+                    if (stmt.rvalue.kind == RvalueKind::Ref && has_deref(stmt.rvalue.place)) {
+                        changed |= substitute(stmt.rvalue.place, state);
+                    }
+                }
+                transfer(stmt, state);
+            }
+
+            if (!block.terminator) continue;
+            Terminator& term = *block.terminator;
+            for_each_operand(term, [&](Operand& op) { changed |= rewrite_operand(op, state); });
+            if (term.kind == TerminatorKind::Call && has_deref(term.destination)) {
+                changed |= substitute(term.destination, state);
+            }
+        }
+        return changed;
+    }
+};
+
+// Number of times each local is mentioned anywhere in the function
+std::vector<size_t> count_mentions(Function& func) {
+    std::vector<size_t> counts(func.locals.size(), 0);
+    auto count = [&](Place& place) { counts[place.local]++; };
+    for (auto& block : func.blocks) {
+        for (auto& stmt : block.statements) {
+            for_each_place(stmt, count);
+        }
+        if (block.terminator) {
+            for_each_place(*block.terminator, count);
+            if (block.terminator->kind == TerminatorKind::Return) counts[RETURN_LOCAL]++;
+        }
+    }
+    return counts;
+}
+
+// `_t = <rvalue>; dest = move _t` with _t used nowhere else becomes
+// `dest = <rvalue>`. Only storage markers of unrelated locals may sit in
+// between, so evaluating the rvalue later cannot observe a different value.
+bool forward_temporaries(Function& func) {
+    std::vector<bool> address_taken = find_address_taken(func);
+    std::vector<size_t> mentions = count_mentions(func);
+    bool changed = false;
+
+    for (auto& block : func.blocks) {
+        auto& stmts = block.statements;
+        for (size_t i = 0; i < stmts.size(); i++) {
+            Statement& use = stmts[i];
+            if (use.kind != StatementKind::Assign || use.rvalue.kind != RvalueKind::Use) continue;
+            const Operand& op = use.rvalue.operands[0];
+            if (!op.is_place() || !op.place.is_local()) continue;
+
+            LocalId temp = op.place.local;
+            if (temp == RETURN_LOCAL || func.is_arg(temp) || !func.locals[temp].name.empty() ||
+                address_taken[temp] || mentions[temp] != 2 || temp == use.place.local) {
+                continue;
+            }
+
+            // Find the definition earlier in this block
+            size_t j = i;
+            bool blocked = false;
+            while (j > 0) {
+                j--;
+                Statement& prev = stmts[j];
+                if (assigned_local(prev) == temp) break;
+                if (prev.kind == StatementKind::Assign) {
+                    blocked = true;   // Conservatively stop at any other write
+                    break;
+                }
+                if (prev.kind != StatementKind::Nop &&
+                    (prev.local == temp || prev.local == use.place.local)) {
+                    blocked = true;   // Storage marker for a local involved
+                    break;
+                }
+            }
+            if (blocked || assigned_local(stmts[j]) != temp) continue;
+
+            Statement& def = stmts[j];
+            use.rvalue = std::move(def.rvalue);
+            def = Statement();
+            def.kind = StatementKind::Nop;
+            mentions[temp] = 0;
+            changed = true;
+        }
+    }
+    return changed;
+}
+
+} // namespace
+
+bool propagate_copies(Function& func) {
+    if (func.blocks.empty()) return false;
+    bool changed = forward_temporaries(func);
+    changed |= CopyPropagation(func).run();
+    return changed;
+}
+
+} // namespace apex::mir
@@ -0,0 +1,117 @@
+#include "Passes.h"
+#include "Analysis.h"
+
+namespace apex::mir {
+
+static bool is_removable_call(const Module& module, const Terminator& term) {
+    const Function* callee = module.find_function(term.callee);
+    if (!callee) return false;
+    const Effects& effects = callee->effects;
+    return !effects.writes_memory && effects.will_return && effects.no_unwind;
+}
+
+bool eliminate_dead_stores(const Module& module, Function& func) {
+    if (func.blocks.empty()) return false;
+
+    std::vector<bool> reachable = reachable_blocks(func);
+    bool changed = false;
+
+    // Removing a store can make the stores feeding it dead too, and removing
+    // an unused borrow can free the borrowed local for removal
+    for (bool progress = true; progress;) {
+        progress = false;
+        std::vector<bool> address_taken = find_address_taken(func);
+        std::vector<LiveSet> live_out = compute_live_out(func);
+
+        for (BlockId bb = 0; bb < func.blocks.size(); bb++) {
+            if (!reachable[bb]) continue;
+            auto& block = func.blocks[bb];
+            LiveSet live = live_out[bb];
+
+            if (block.terminator) {
+                Terminator& term = *block.terminator;
+                if (term.kind == TerminatorKind::Call && term.destination.is_local()) {
+                    LocalId dest = term.destination.local;
+                    if (!live[dest] && !address_taken[dest] && dest != RETURN_LOCAL &&
+                        is_removable_call(module, term)) {
+                        Terminator jump;
+                        jump.kind = TerminatorKind::Goto;
+                        jump.location = term.location;
+                        jump.target = term.target;
+                        term = std::move(jump);
+                        progress = true;
+                    } else {
+                        live[dest] = false;
+                    }
+                }
+                for_each_use(*block.terminator, [&](LocalId local) { live[local] = true; });
+            }
+
+            for (auto s = block.statements.rbegin(); s != block.statements.rend(); ++s) {
+                auto local = assigned_local(*s);
+                if (local && !live[*local] && !address_taken[*local] && *local != RETURN_LOCAL) {
+                    // MIR rvalues have no side effects, so the whole statement goes
+                    *s = Statement();
+                    s->kind = StatementKind::Nop;
+                    progress = true;
+                    continue;
+                }
+                if (local) live[*local] = false;
+                for_each_use(*s, [&](LocalId l) { live[l] = true; });
+            }
+        }
+        changed |= progress;
+    }
+    return changed;
+}
+
+bool remove_unused_locals(Function& func) {
+    size_t num_locals = func.locals.size();
+    std::vector<bool> used(num_locals, false);
+    for (LocalId local = 0; local <= func.arg_count && local < num_locals; local++) {
+        used[local] = true;
+    }
+    for (auto& block : func.blocks) {
+        for (auto& stmt : block.statements) {
+            for_each_place(stmt, [&](Place& place) { used[place.local] = true; });
+        }
+        if (block.terminator) {
+            for_each_place(*block.terminator, [&](Place& place) { used[place.local] = true; });
+        }
+    }
+
+    std::vector<LocalId> remap(num_locals, 0);
+    std::vector<LocalDecl> kept;
+    for (LocalId local = 0; local < num_locals; local++) {
+        if (used[local]) {
+            remap[local] = static_cast<LocalId>(kept.size());
+            kept.push_back(std::move(func.locals[local]));
+        }
+    }
+
+    bool changed = kept.size() != num_locals;
+    auto rename = [&](Place& place) { place.local = remap[place.local]; };
+    for (auto& block : func.blocks) {
+        std::vector<Statement> stmts;
+        for (auto& stmt : block.statements) {
+            if (stmt.kind == StatementKind::Nop) {
+                changed = true;
+                continue;
+            }
+            if (stmt.kind == StatementKind::StorageLive || stmt.kind == StatementKind::StorageDead) {
+                if (!used[stmt.local]) continue;
+                stmt.local = remap[stmt.local];
+            }
+            for_each_place(stmt, rename);
+            stmts.push_back(std::move(stmt));
+        }
+        block.statements = std::move(stmts);
+        if (block.terminator) {
+            for_each_place(*block.terminator, rename);
+        }
+    }
+    func.locals = std::move(kept);
+    return changed;
+}
+
+} // namespace apex::mir
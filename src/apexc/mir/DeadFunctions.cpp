@@ -0,0 +1,31 @@
+#include "Passes.h"
+#include <algorithm>
+#include <unordered_set>
+
+namespace apex::mir {
+
+bool remove_unreachable_functions(Module& module) {
+    CallGraph graph = CallGraph::build(module);
+    std::vector<bool> live = graph.reachable();
+    if (std::all_of(live.begin(), live.end(), [](bool b) { return b; })) return false;
+
+    std::unordered_set<std::string> removed;
+    std::vector<std::unique_ptr<Function>> kept;
+    for (size_t node = 0; node < graph.nodes.size(); node++) {
+        if (live[node]) {
+            kept.push_back(std::move(module.functions[node]));
+        } else {
+            removed.insert(graph.nodes[node]->name);
+        }
+    }
+    module.functions = std::move(kept);
+
+    // Drops were elaborated into direct calls already, so a destructor that
+    // nothing calls is no longer needed either
+    for (auto& def : module.structs) {
+        if (removed.count(def.destructor)) def.destructor.clear();
+    }
+    return true;
+}
+
+} // namespace apex::mir
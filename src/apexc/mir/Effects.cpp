@@ -0,0 +1,220 @@
+#include "Passes.h"
+#include "Analysis.h"
+
+namespace apex::mir {
+
+namespace {
+
+// Where a memory access through a place can land
+enum class Reach {
+    Frame,   // The function's own locals (no deref, or through a pointer to a local)
+    Args,    // Behind a pointer parameter
+    Any
+};
+
+bool contains_pointer(const Module& module, const Type& type) {
+    if (type.kind == TypeKind::Ref || type.kind == TypeKind::Ptr) return true;
+    if (type.kind != TypeKind::Struct) return false;
+    const StructDef* def = module.find_struct(type.struct_name);
+    if (!def) return true;
+    for (const auto& field : def->fields) {
+        if (contains_pointer(module, field.second)) return true;
+    }
+    return false;
+}
+
+class EffectAnalysis {
+public:
+    EffectAnalysis(const Module& module, const CallGraph& graph, const Function& func)
+        : module_(module), graph_(graph), func_(func) {
+        find_frame_pointers();
+    }
+
+    Effects run(size_t node) const;
+
+private:
+    const Module& module_;
+    const CallGraph& graph_;
+    const Function& func_;
+    std::vector<bool> frame_;        // Locals that only ever point at other locals
+    std::vector<bool> reassigned_;   // Parameters given a new value
+
+    void find_frame_pointers();
+    Reach reach(const Place& place) const;
+    Reach pointer_reach(const Operand& arg) const;
+    static void access(Effects& effects, Reach reach, bool is_write);
+};
+
+// A local points into the frame when every value it receives is `&local`
+// or a copy of another such pointer
+void EffectAnalysis::find_frame_pointers() {
+    size_t num_locals = func_.locals.size();
+    frame_.assign(num_locals, true);
+    reassigned_.assign(num_locals, false);
+    for (LocalId local = 0; local <= func_.arg_count; local++) frame_[local] = false;
+
+    for (const auto& block : func_.blocks) {
+        for (const auto& stmt : block.statements) {
+            if (stmt.kind == StatementKind::Assign && stmt.place.is_local()) reassigned_[stmt.place.local] = true;
+        }
+        if (block.terminator && block.terminator->kind == TerminatorKind::Call &&
+            block.terminator->destination.is_local()) {
+            frame_[block.terminator->destination.local] = false;
+            reassigned_[block.terminator->destination.local] = true;
+        }
+    }
+
+    for (bool changed = true; changed;) {
+        changed = false;
+        for (const auto& block : func_.blocks) {
+            for (const auto& stmt : block.statements) {
+                if (stmt.kind != StatementKind::Assign || !frame_[stmt.place.local]) continue;
+                const Rvalue& rv = stmt.rvalue;
+                bool points_to_frame = false;
+                if (rv.kind == RvalueKind::Ref) {
+                    points_to_frame = !has_deref(rv.place);
+                } else if ((rv.kind == RvalueKind::Use || rv.kind == RvalueKind::Cast) &&
+                           rv.operands[0].is_place() && rv.operands[0].place.is_local()) {
+                    points_to_frame = frame_[rv.operands[0].place.local];
+                }
+                if (!stmt.place.is_local() || !points_to_frame) {
+                    frame_[stmt.place.local] = false;
+                    changed = true;
+                }
+            }
+        }
+    }
+}
+
+Reach EffectAnalysis::reach(const Place& place) const {
+    size_t derefs = 0;
+    for (const auto& elem : place.projection) {
+        if (elem.kind == ProjectionKind::Deref) derefs++;
+    }
+    if (derefs == 0) return Reach::Frame;
+    if (derefs == 1 && place.projection[0].kind == ProjectionKind::Deref) {
+        if (frame_[place.local]) return Reach::Frame;
+        if (func_.is_arg(place.local) && !reassigned_[place.local]) return Reach::Args;
+    }
+    return Reach::Any;
+}
+
+// Memory a callee limited to its pointer arguments can reach through `arg`
+Reach EffectAnalysis::pointer_reach(const Operand& arg) const {
+    if (!arg.is_place()) return Reach::Frame;
+    if (!contains_pointer(module_, module_.operand_type(func_, arg))) return Reach::Frame;
+    const Place& place = arg.place;
+    if (!place.is_local()) return Reach::Any;
+    if (frame_[place.local]) return Reach::Frame;
+    if (func_.is_arg(place.local) && !reassigned_[place.local]) return Reach::Args;
+    return Reach::Any;
+}
+
+void EffectAnalysis::access(Effects& effects, Reach reach, bool is_write) {
+    if (reach == Reach::Frame) return;
+    if (is_write) {
+        effects.writes_memory = true;
+    } else {
+        effects.reads_memory = true;
+    }
+    if (reach == Reach::Any) effects.args_only = false;
+}
+
+Effects EffectAnalysis::run(size_t node) const {
+    Effects effects;
+    effects.reads_memory = false;
+    effects.writes_memory = false;
+    effects.args_only = true;
+    effects.will_return = true;
+    effects.no_unwind = true;
+
+    // Any cycle in the CFG is a loop that might not terminate
+    std::vector<BlockId> order = reverse_postorder(func_);
+    std::vector<size_t> position(func_.blocks.size(), 0);
+    for (size_t i = 0; i < order.size(); i++) position[order[i]] = i;
+    for (BlockId bb : order) {
+        if (!func_.blocks[bb].terminator) continue;
+        for (BlockId succ : func_.blocks[bb].terminator->successors()) {
+            if (position[succ] <= position[bb]) effects.will_return = false;
+        }
+    }
+
+    for (BlockId bb : order) {
+        const auto& block = func_.blocks[bb];
+        for (const auto& stmt : block.statements) {
+            if (stmt.kind != StatementKind::Assign) continue;
+            for (const auto& op : stmt.rvalue.operands) {
+                if (op.is_place()) access(effects, reach(op.place), false);
+            }
+            access(effects, reach(stmt.place), true);
+        }
+
+        if (!block.terminator) continue;
+        const Terminator& term = *block.terminator;
+        if (term.kind == TerminatorKind::SwitchInt && term.discriminant.is_place()) {
+            access(effects, reach(term.discriminant.place), false);
+        }
+        if (term.kind != TerminatorKind::Call) continue;
+
+        for (const auto& arg : term.args) {
+            if (arg.is_place()) access(effects, reach(arg.place), false);
+        }
+        access(effects, reach(term.destination), true);
+
+        auto callee_node = graph_.find(term.callee);
+        Effects callee = callee_node ? graph_.nodes[*callee_node]->effects : Effects();
+        if (callee_node && graph_.same_scc(node, *callee_node)) effects.will_return = false;
+        effects.will_return &= callee.will_return;
+        effects.no_unwind &= callee.no_unwind;
+
+        if (callee.is_pure()) continue;
+        if (!callee.args_only) {
+            effects.reads_memory |= callee.reads_memory;
+            effects.writes_memory |= callee.writes_memory;
+            effects.args_only = false;
+            continue;
+        }
+        for (const auto& arg : term.args) {
+            Reach target = pointer_reach(arg);
+            if (callee.reads_memory) access(effects, target, false);
+            if (callee.writes_memory) access(effects, target, true);
+        }
+    }
+    return effects;
+}
+
+bool same_effects(const Effects& a, const Effects& b) {
+    return a.reads_memory == b.reads_memory && a.writes_memory == b.writes_memory &&
+           a.args_only == b.args_only && a.will_return == b.will_return && a.no_unwind == b.no_unwind;
+}
+
+} // namespace
+
+void infer_effects(const Module& module, const CallGraph& graph, const std::vector<size_t>& scc) {
+    // Members of a recursive SCC start out optimistic (pure, no unwinding)
+    // and are recomputed against each other until nothing changes
+    for (size_t node : scc) {
+        Function& func = *graph.nodes[node];
+        if (func.is_extern || func.blocks.empty()) continue;
+        func.effects = Effects();
+        func.effects.reads_memory = false;
+        func.effects.writes_memory = false;
+        func.effects.args_only = true;
+        func.effects.no_unwind = true;
+    }
+
+    for (bool changed = true; changed;) {
+        changed = false;
+        for (size_t node : scc) {
+            Function& func = *graph.nodes[node];
+            if (func.is_extern || func.blocks.empty()) continue;
+            Effects effects = EffectAnalysis(module, graph, func).run(node);
+            if (!same_effects(effects, func.effects)) {
+                func.effects = effects;
+                changed = true;
+            }
+        }
+    }
+}
+
+} // namespace apex::mir
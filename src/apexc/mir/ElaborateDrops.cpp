@@ -0,0 +1,350 @@
+#include "ElaborateDrops.h"
+#include "Analysis.h"
+#include <sstream>
+
+namespace apex::mir {
+
+namespace {
+
+bool merge(std::vector<bool>& into, const std::vector<bool>& from) {
+    bool changed = false;
+    for (size_t i = 0; i < from.size(); i++) {
+        if (from[i] && !into[i]) {
+            into[i] = true;
+            changed = true;
+        }
+    }
+    return changed;
+}
+
+Statement make_assign(Place place, Rvalue rvalue, const SourceLocation& loc) {
+    Statement stmt;
+    stmt.kind = StatementKind::Assign;
+    stmt.location = loc;
+    stmt.place = std::move(place);
+    stmt.rvalue = std::move(rvalue);
+    return stmt;
+}
+
+Statement set_flag(LocalId flag, bool value, const SourceLocation& loc) {
+    return make_assign(Place(flag), Rvalue::use(Operand::constant_bool(value)), loc);
+}
+
+} // namespace
+
+bool DropElaborator::run(Module& module) {
+    module_ = &module;
+    bool changed = false;
+    for (auto& func : module.functions) {
+        if (func->is_extern || func->blocks.empty()) continue;
+        changed |= elaborate_function(*func);
+    }
+    return changed;
+}
+
+DropElaborator::State DropElaborator::entry_state() const {
+    size_t n = func_->locals.size();
+    State state{std::vector<bool>(n, false), std::vector<bool>(n, true), std::vector<bool>(n, false)};
+    for (LocalId local = 1; local <= func_->arg_count; local++) {
+        state.maybe_init[local] = true;
+        state.maybe_uninit[local] = false;
+    }
+    return state;
+}
+
+void DropElaborator::set(State& state, LocalId local, bool init, bool moved) const {
+    if (!tracked_[local]) return;
+    state.maybe_init[local] = init;
+    state.maybe_uninit[local] = !init;
+    state.maybe_moved[local] = moved;
+}
+
+void DropElaborator::transfer(State& state, const Statement& stmt) const {
+    switch (stmt.kind) {
+        case StatementKind::StorageLive:
+        case StatementKind::StorageDead:
+            set(state, stmt.local, false, false);
+            break;
+        case StatementKind::Assign:
+            for (const auto& op : stmt.rvalue.operands) {
+                if (op.kind == OperandKind::Move && op.place.is_local()) set(state, op.place.local, false, true);
+            }
+            if (stmt.place.is_local()) set(state, stmt.place.local, true, false);
+            break;
+        default:
+            break;
+    }
+}
+
+void DropElaborator::transfer(State& state, const Terminator& term) const {
+    if (term.kind == TerminatorKind::Call) {
+        for (const auto& arg : term.args) {
+            if (arg.kind == OperandKind::Move && arg.place.is_local()) set(state, arg.place.local, false, true);
+        }
+        if (term.destination.is_local()) set(state, term.destination.local, true, false);
+    } else if (term.kind == TerminatorKind::Drop && term.place.is_local() && tracked_[term.place.local]) {
+        state.maybe_init[term.place.local] = false;
+        state.maybe_uninit[term.place.local] = true;
+    }
+}
+
+bool DropElaborator::elaborate_function(Function& func) {
+    func_ = &func;
+    tracked_.assign(func.locals.size(), false);
+    bool any = false;
+    for (LocalId local = 1; local < func.locals.size(); local++) {
+        tracked_[local] = module_->needs_drop(func.locals[local].type);
+    }
+    for (const auto& block : func.blocks) {
+        any |= block.terminator && block.terminator->kind == TerminatorKind::Drop;
+    }
+    if (!any) return false;
+
+    // Forward dataflow to a fixed point; unreachable blocks stay empty
+    size_t num_locals = func.locals.size();
+    State bottom{std::vector<bool>(num_locals, false), std::vector<bool>(num_locals, false),
+                 std::vector<bool>(num_locals, false)};
+    std::vector<State> entry(func.blocks.size(), bottom);
+    entry[ENTRY_BLOCK] = entry_state();
+    std::vector<BlockId> order = reverse_postorder(func);
+
+    for (bool changed = true; changed;) {
+        changed = false;
+        for (BlockId bb : order) {
+            State state = entry[bb];
+            for (const auto& stmt : func.blocks[bb].statements) transfer(state, stmt);
+            if (!func.blocks[bb].terminator) continue;
+            transfer(state, *func.blocks[bb].terminator);
+            for (BlockId succ : func.blocks[bb].terminator->successors()) {
+                changed |= merge(entry[succ].maybe_init, state.maybe_init);
+                changed |= merge(entry[succ].maybe_uninit, state.maybe_uninit);
+                changed |= merge(entry[succ].maybe_moved, state.maybe_moved);
+            }
+        }
+    }
+
+    // Check moves and classify every drop by the state just before it
+    std::vector<std::pair<BlockId, DropKind>> drops;
+    std::vector<std::optional<LocalId>> flags(num_locals);
+    std::vector<bool> reported(num_locals, false);
+    for (BlockId bb : order) {
+        State state = entry[bb];
+        for (const auto& stmt : func.blocks[bb].statements) {
+            check_uses(state, stmt, reported);
+            transfer(state, stmt);
+        }
+        if (!func.blocks[bb].terminator) continue;
+        const Terminator& term = *func.blocks[bb].terminator;
+        check_uses(state, term, reported);
+        if (term.kind != TerminatorKind::Drop) continue;
+
+        LocalId local = term.place.local;
+        DropKind kind = DropKind::Static;
+        if (!has_deref(term.place) && tracked_[local]) {
+            if (!state.maybe_init[local]) {
+                kind = DropKind::Dead;
+            } else if (state.maybe_uninit[local]) {
+                kind = DropKind::Flagged;
+                if (!flags[local]) flags[local] = func.new_local(Type::bool_type(), "", true);
+            }
+        }
+        drops.emplace_back(bb, kind);
+    }
+    if (has_errors()) return false;
+
+    insert_flag_updates(flags);
+
+    // Drops in unreachable blocks are never visited above
+    std::vector<bool> classified(func.blocks.size(), false);
+    for (const auto& [bb, kind] : drops) classified[bb] = true;
+    for (BlockId bb = 0; bb < func.blocks.size(); bb++) {
+        const auto& term = func.blocks[bb].terminator;
+        if (term && term->kind == TerminatorKind::Drop && !classified[bb]) drops.emplace_back(bb, DropKind::Dead);
+    }
+
+    for (const auto& [bb, kind] : drops) {
+        Terminator drop = *func.blocks[bb].terminator;
+        // The local's flag, also when only a field of it is dropped
+        const std::optional<LocalId>& flag = flags[drop.place.local];
+
+        Terminator jump;
+        jump.kind = TerminatorKind::Goto;
+        jump.location = drop.location;
+        jump.target = drop.target;
+
+        if (kind == DropKind::Dead) {
+            func.blocks[bb].terminator = std::move(jump);
+            continue;
+        }
+
+        BlockId glue = bb;
+        if (kind == DropKind::Flagged) {
+            // if flag { flag = false; <glue> }
+            glue = func.new_block();
+            Terminator test;
+            test.kind = TerminatorKind::SwitchInt;
+            test.location = drop.location;
+            test.discriminant = Operand::copy(Place(*flag));
+            test.values = {0};
+            test.targets = {drop.target, glue};
+            func.blocks[bb].terminator = std::move(test);
+        }
+        // Dropping the whole local leaves it uninitialized
+        if (flag && drop.place.is_local()) {
+            func.blocks[glue].statements.push_back(set_flag(*flag, false, drop.location));
+        }
+
+        BlockId end = emit_glue(glue, drop.place, drop.location);
+        func.blocks[end].terminator = std::move(jump);
+    }
+    return true;
+}
+
+// Mirrors the dataflow transfer functions: a flag is true exactly when the
+// analysis would say its local is initialized
+void DropElaborator::insert_flag_updates(const std::vector<std::optional<LocalId>>& flags) {
+    auto flag_of = [&](const Place& place) -> std::optional<LocalId> {
+        return place.is_local() ? flags[place.local] : std::nullopt;
+    };
+
+    size_t num_blocks = func_->blocks.size();
+    for (BlockId bb = 0; bb < num_blocks; bb++) {
+        std::vector<Statement> statements;
+        if (bb == ENTRY_BLOCK) {
+            for (LocalId local = 1; local < flags.size(); local++) {
+                if (flags[local]) statements.push_back(set_flag(*flags[local], local <= func_->arg_count, func_->location));
+            }
+        }
+
+        for (auto& stmt : func_->blocks[bb].statements) {
+            std::vector<Statement> after;
+            if (stmt.kind == StatementKind::StorageLive || stmt.kind == StatementKind::StorageDead) {
+                if (flags[stmt.local]) after.push_back(set_flag(*flags[stmt.local], false, stmt.location));
+            } else if (stmt.kind == StatementKind::Assign) {
+                for (const auto& op : stmt.rvalue.operands) {
+                    if (op.kind != OperandKind::Move) continue;
+                    if (auto flag = flag_of(op.place)) after.push_back(set_flag(*flag, false, stmt.location));
+                }
+                if (auto flag = flag_of(stmt.place)) after.push_back(set_flag(*flag, true, stmt.location));
+            }
+            statements.push_back(std::move(stmt));
+            for (auto& update : after) statements.push_back(std::move(update));
+        }
+        func_->blocks[bb].statements = std::move(statements);
+
+        auto& term = func_->blocks[bb].terminator;
+        if (!term || term->kind != TerminatorKind::Call) continue;
+        for (const auto& arg : term->args) {
+            if (arg.kind != OperandKind::Move) continue;
+            if (auto flag = flag_of(arg.place)) {
+                func_->blocks[bb].statements.push_back(set_flag(*flag, false, term->location));
+            }
+        }
+        if (auto flag = flag_of(term->destination)) {
+            // The destination is only written on the call's return edge
+            BlockId edge = func_->new_block();
+            func_->blocks[edge].statements.push_back(set_flag(*flag, true, term->location));
+            Terminator jump;
+            jump.kind = TerminatorKind::Goto;
+            jump.location = term->location;
+            jump.target = term->target;
+            func_->blocks[edge].terminator = std::move(jump);
+            func_->blocks[bb].terminator->target = edge;
+        }
+    }
+}
+
+// Appends the drop glue of `place` to `block`: its struct's destructor, then
+// each field that needs dropping. Returns the (unterminated) block it ends in.
+BlockId DropElaborator::emit_glue(BlockId block, const Place& place, const SourceLocation& loc) {
+    Type type = module_->place_type(*func_, place);
+    const StructDef* def = module_->find_struct(type.struct_name);
+    if (!def) return block;
+
+    if (!def->destructor.empty()) {
+        LocalId self = func_->new_local(Type::ref_type(type, true));
+        func_->blocks[block].statements.push_back(make_assign(Place(self), Rvalue::ref(place, true), loc));
+
+        Terminator call;
+        call.kind = TerminatorKind::Call;
+        call.location = loc;
+        call.callee = def->destructor;
+        call.args.push_back(Operand::move(Place(self)));
+        call.destination = Place(func_->new_local(Type::void_type()));
+        call.target = func_->new_block();
+
+        BlockId next = call.target;
+        func_->blocks[block].terminator = std::move(call);
+        block = next;
+    }
+
+    for (unsigned i = 0; i < def->fields.size(); i++) {
+        if (module_->needs_drop(def->fields[i].second)) block = emit_glue(block, place.field(i), loc);
+    }
+    return block;
+}
+
+void DropElaborator::check_uses(const State& state, const Statement& stmt, std::vector<bool>& reported) {
+    if (stmt.kind != StatementKind::Assign) return;
+    for (const auto& op : stmt.rvalue.operands) {
+        if (op.is_place()) check_use(state, op.place, op.kind == OperandKind::Move, stmt.location, reported);
+    }
+    if (stmt.rvalue.kind == RvalueKind::Ref) check_use(state, stmt.rvalue.place, false, stmt.location, reported);
+    if (!stmt.place.is_local()) check_use(state, stmt.place, false, stmt.location, reported);
+}
+
+void DropElaborator::check_uses(const State& state, const Terminator& term, std::vector<bool>& reported) {
+    if (term.kind == TerminatorKind::SwitchInt && term.discriminant.is_place()) {
+        check_use(state, term.discriminant.place, false, term.location, reported);
+    } else if (term.kind == TerminatorKind::Call) {
+        for (const auto& arg : term.args) {
+            if (arg.is_place()) check_use(state, arg.place, arg.kind == OperandKind::Move, term.location, reported);
+        }
+        if (!term.destination.is_local()) check_use(state, term.destination, false, term.location, reported);
+    }
+}
+
+void DropElaborator::check_use(const State& state, const Place& place, bool is_move, const SourceLocation& loc,
+                               std::vector<bool>& reported) {
+    LocalId local = place.local;
+    if (tracked_[local] && state.maybe_moved[local] && !func_->locals[local].name.empty()) {
+        if (!reported[local]) error(loc, "Use of moved value '" + func_->locals[local].name + "'");
+        reported[local] = true;
+        return;
+    }
+    if (is_move && !place.is_local() && module_->needs_drop(module_->place_type(*func_, place))) {
+        error(loc, "Cannot move out of '" + describe(place) +
+                   "': values with destructors can only be moved as a whole variable");
+    }
+}
+
+std::string DropElaborator::describe(const Place& place) const {
+    const LocalDecl& decl = func_->locals[place.local];
+    if (decl.name.empty()) return "temporary value";
+
+    std::string text = decl.name;
+    Type type = decl.type;
+    for (size_t i = 0; i < place.projection.size(); i++) {
+        const auto& elem = place.projection[i];
+        if (elem.kind == ProjectionKind::Deref) {
+            bool field_follows = i + 1 < place.projection.size() &&
+                                 place.projection[i + 1].kind == ProjectionKind::Field;
+            if (!field_follows) text = "*" + text;
+            type = type.pointee ? *type.pointee : Type::void_type();
+        } else {
+            const StructDef* def = module_->find_struct(type.struct_name);
+            if (!def || elem.field_index >= def->fields.size()) break;
+            text += "." + def->fields[elem.field_index].first;
+            type = def->fields[elem.field_index].second;
+        }
+    }
+    return text;
+}
+
+void DropElaborator::error(const SourceLocation& loc, const std::string& message) {
+    std::ostringstream oss;
+    oss << loc.filename << ":" << loc.line << ":" << loc.column << ": error: " << message;
+    errors_.push_back(oss.str());
+}
+
+} // namespace apex::mir
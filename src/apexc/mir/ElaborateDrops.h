@@ -0,0 +1,59 @@
+#pragma once
+
+#include "MIR.h"
+#include <string>
+#include <vector>
+
+namespace apex::mir {
+
+// Turns the builder's Drop terminators into destructor calls. A forward
+// maybe-initialized / maybe-uninitialized analysis decides each drop
+// statically where it can: a value that is definitely live is dropped
+// unconditionally (its drop glue is inlined: the `#[drop]` function, then
+// the fields in declaration order), one that was definitely moved out or
+// never initialized is not dropped at all. Only values moved on some paths
+// but not others get a runtime drop flag.
+//
+// Also rejects uses of values with destructors after they were moved, and
+// moves of such values out of anything but a whole variable (which would
+// leave a partially initialized value behind to drop).
+class DropElaborator {
+public:
+    bool run(Module& module);
+
+    const std::vector<std::string>& get_errors() const { return errors_; }
+    bool has_errors() const { return !errors_.empty(); }
+
+private:
+    struct State {
+        std::vector<bool> maybe_init;
+        std::vector<bool> maybe_uninit;
+        std::vector<bool> maybe_moved;
+    };
+
+    enum class DropKind { Dead, Static, Flagged };
+
+    Module* module_{nullptr};
+    Function* func_{nullptr};
+    std::vector<bool> tracked_;   // Locals whose type needs dropping
+    std::vector<std::string> errors_;
+
+    bool elaborate_function(Function& func);
+    State entry_state() const;
+    void transfer(State& state, const Statement& stmt) const;
+    void transfer(State& state, const Terminator& term) const;
+    void set(State& state, LocalId local, bool init, bool moved) const;
+
+    void check_uses(const State& state, const Statement& stmt, std::vector<bool>& reported);
+    void check_uses(const State& state, const Terminator& term, std::vector<bool>& reported);
+    void check_use(const State& state, const Place& place, bool is_move, const SourceLocation& loc,
+                   std::vector<bool>& reported);
+
+    void insert_flag_updates(const std::vector<std::optional<LocalId>>& flags);
+    BlockId emit_glue(BlockId block, const Place& place, const SourceLocation& loc);
+
+    std::string describe(const Place& place) const;
+    void error(const SourceLocation& loc, const std::string& message);
+};
+
+} // namespace apex::mir
@@ -0,0 +1,200 @@
+#include "Passes.h"
+#include "Analysis.h"
+#include <cstddef>
+
+namespace apex::mir {
+
+namespace {
+
+constexpr uint64_t MAX_PROMOTED_SIZE = 4096;     // Bytes per allocation
+constexpr uint64_t MAX_PROMOTED_FRAME = 16384;   // Bytes per function
+constexpr unsigned MALLOC_ALIGN = alignof(std::max_align_t);   // What malloc guarantees
+
+bool is_runtime_call(const Module& module, const Terminator& term, const char* name) {
+    if (term.kind != TerminatorKind::Call || term.callee != name) return false;
+    const Function* callee = module.find_function(name);
+    return callee && callee->is_extern;
+}
+
+bool is_whole_local(const Operand& op, const std::vector<bool>& holders) {
+    return op.is_place() && op.place.is_local() && holders[op.place.local];
+}
+
+// An allocation site: `dest = malloc(const size)` terminating `block`
+struct Allocation {
+    BlockId block;
+    LocalId dest;
+    uint64_t size;
+};
+
+// Finds the locals the allocation's pointer is copied into and checks that
+// it never leaves them: it may only be dereferenced, compared, copied or
+// cast between holders, and passed to `free`. Anything else (returning it,
+// storing it in memory, passing it to another call, borrowing it or a
+// field behind it) lets it escape. Returns the holders, or nothing.
+std::optional<std::vector<bool>> find_holders(const Module& module, const Function& func,
+                                              const Allocation& alloc, std::vector<BlockId>& frees) {
+    size_t num_locals = func.locals.size();
+    std::vector<bool> holders(num_locals, false);
+    holders[alloc.dest] = true;
+
+    auto is_copy = [&](const Statement& stmt) {
+        const Rvalue& rv = stmt.rvalue;
+        if (rv.kind != RvalueKind::Use && rv.kind != RvalueKind::Cast) return false;
+        if (rv.kind == RvalueKind::Cast && rv.type.kind != TypeKind::Ptr && rv.type.kind != TypeKind::Ref) {
+            return false;
+        }
+        return stmt.place.is_local() && is_whole_local(rv.operands[0], holders);
+    };
+
+    for (bool changed = true; changed;) {
+        changed = false;
+        for (const auto& block : func.blocks) {
+            for (const auto& stmt : block.statements) {
+                if (stmt.kind == StatementKind::Assign && is_copy(stmt) && !holders[stmt.place.local]) {
+                    holders[stmt.place.local] = true;
+                    changed = true;
+                }
+            }
+        }
+    }
+
+    if (holders[RETURN_LOCAL]) return std::nullopt;
+    for (LocalId local = 1; local <= func.arg_count; local++) {
+        if (holders[local]) return std::nullopt;
+    }
+
+    frees.clear();
+    for (BlockId bb = 0; bb < func.blocks.size(); bb++) {
+        const auto& block = func.blocks[bb];
+        for (const auto& stmt : block.statements) {
+            if (stmt.kind != StatementKind::Assign) continue;
+            const Rvalue& rv = stmt.rvalue;
+
+            // Every value a holder receives must be this allocation
+            if (stmt.place.is_local() && holders[stmt.place.local] && !is_copy(stmt)) return std::nullopt;
+
+            if (is_copy(stmt)) continue;
+            if (rv.kind == RvalueKind::Ref && holders[rv.place.local]) return std::nullopt;
+            bool comparison = rv.kind == RvalueKind::BinaryOp && (rv.bin_op == BinOp::Eq || rv.bin_op == BinOp::Ne);
+            for (const auto& op : rv.operands) {
+                if (is_whole_local(op, holders) && !comparison) return std::nullopt;
+            }
+        }
+
+        if (!block.terminator) continue;
+        const Terminator& term = *block.terminator;
+        switch (term.kind) {
+            case TerminatorKind::Call:
+                if (bb == alloc.block) break;
+                if (term.destination.is_local() && holders[term.destination.local]) return std::nullopt;
+                if (is_runtime_call(module, term, "free") && term.args.size() == 1 &&
+                    is_whole_local(term.args[0], holders)) {
+                    frees.push_back(bb);
+                    break;
+                }
+                for (const auto& arg : term.args) {
+                    if (is_whole_local(arg, holders)) return std::nullopt;
+                }
+                break;
+            case TerminatorKind::SwitchInt:
+                if (is_whole_local(term.discriminant, holders)) return std::nullopt;
+                break;
+            case TerminatorKind::Drop:
+                if (holders[term.place.local]) return std::nullopt;
+                break;
+            default:
+                break;
+        }
+    }
+    return holders;
+}
+
+// The stack slot is reused each time the allocation runs, so no pointer to
+// the previous object may still be live (e.g. carried around a loop)
+bool previous_object_dead(const Function& func, const Allocation& alloc, const std::vector<bool>& holders,
+                          const std::vector<LiveSet>& live_out) {
+    const auto& block = func.blocks[alloc.block];
+    LiveSet live = live_out[alloc.block];
+    live[alloc.dest] = false;
+    for (auto s = block.statements.rbegin(); s != block.statements.rend(); ++s) {
+        if (auto local = assigned_local(*s)) live[*local] = false;
+        for_each_use(*s, [&](LocalId local) { live[local] = true; });
+    }
+    for (LocalId local = 0; local < holders.size(); local++) {
+        if (holders[local] && live[local]) return false;
+    }
+    return true;
+}
+
+void make_goto(Terminator& term) {
+    Terminator jump;
+    jump.kind = TerminatorKind::Goto;
+    jump.location = term.location;
+    jump.target = term.target;
+    term = std::move(jump);
+}
+
+} // namespace
+
+bool promote_heap_allocations(const Module& module, Function& func) {
+    if (!module.find_function("malloc")) return false;
+
+    std::vector<Allocation> allocations;
+    for (BlockId bb = 0; bb < func.blocks.size(); bb++) {
+        const auto& term = func.blocks[bb].terminator;
+        if (!term || !is_runtime_call(module, *term, "malloc") || term->args.size() != 1) continue;
+        if (!term->destination.is_local() || term->args[0].kind != OperandKind::Constant) continue;
+
+        int64_t size = term->args[0].constant.as_int();
+        if (size <= 0 || static_cast<uint64_t>(size) > MAX_PROMOTED_SIZE) continue;
+        allocations.push_back({bb, term->destination.local, static_cast<uint64_t>(size)});
+    }
+    if (allocations.empty()) return false;
+
+    std::vector<LiveSet> live_out = compute_live_out(func);
+    uint64_t frame_bytes = 0;
+    bool changed = false;
+
+    for (const auto& alloc : allocations) {
+        std::vector<BlockId> frees;
+        auto holders = find_holders(module, func, alloc, frees);
+        if (!holders || !previous_object_dead(func, alloc, *holders, live_out)) continue;
+
+        // The slot is aligned like the memory malloc would have returned
+        uint64_t words = (alloc.size + 7) / 8;
+        if (frame_bytes + words * 8 > MAX_PROMOTED_FRAME) continue;
+        frame_bytes += words * 8;
+
+        Type slot_type = Type::array_type(Type::int_type(64, false), words);
+        LocalId slot = func.new_local(slot_type, "", true);
+        func.locals[slot].align = MALLOC_ALIGN;
+        LocalId addr = func.new_local(Type::ref_type(slot_type, true), "", false);
+
+        auto& block = func.blocks[alloc.block];
+        Terminator& call = *block.terminator;
+        Statement borrow;
+        borrow.kind = StatementKind::Assign;
+        borrow.location = call.location;
+        borrow.place = Place(addr);
+        borrow.rvalue = Rvalue::ref(Place(slot), true);
+        block.statements.push_back(std::move(borrow));
+
+        Statement cast;
+        cast.kind = StatementKind::Assign;
+        cast.location = call.location;
+        cast.place = Place(alloc.dest);
+        cast.rvalue = Rvalue::cast(Operand::move(Place(addr)), func.locals[alloc.dest].type);
+        block.statements.push_back(std::move(cast));
+        make_goto(call);
+
+        for (BlockId bb : frees) {
+            make_goto(*func.blocks[bb].terminator);
+        }
+        changed = true;
+        live_out = compute_live_out(func);
+    }
+    return changed;
+}
+
+} // namespace apex::mir
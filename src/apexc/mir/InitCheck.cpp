@@ -0,0 +1,152 @@
+#include "InitCheck.h"
+#include "Analysis.h"
+#include <sstream>
+
+namespace apex::mir {
+
+namespace {
+
+bool merge(std::vector<bool>& into, const std::vector<bool>& from) {
+    bool changed = false;
+    for (size_t i = 0; i < from.size(); i++) {
+        if (from[i] && !into[i]) {
+            into[i] = true;
+            changed = true;
+        }
+    }
+    return changed;
+}
+
+void set_init(std::vector<bool>& maybe_uninit, std::vector<bool>& maybe_init, LocalId local, bool init) {
+    maybe_uninit[local] = !init;
+    maybe_init[local] = init;
+}
+
+} // namespace
+
+bool InitChecker::check(const Module& module) {
+    for (const auto& func : module.functions) {
+        if (func->is_extern || func->blocks.empty()) continue;
+        check_function(*func);
+    }
+    return errors_.empty();
+}
+
+// Only user variables: parameters arrive initialized and the builder never
+// reads a temporary before writing it
+bool InitChecker::is_checked(LocalId local) const {
+    return local > func_->arg_count && !func_->locals[local].name.empty();
+}
+
+void InitChecker::transfer(State& state, const Statement& stmt) const {
+    switch (stmt.kind) {
+        case StatementKind::StorageLive:
+        case StatementKind::StorageDead:
+            set_init(state.maybe_uninit, state.maybe_init, stmt.local, false);
+            break;
+        case StatementKind::Assign:
+            if (stmt.place.is_local()) set_init(state.maybe_uninit, state.maybe_init, stmt.place.local, true);
+            break;
+        default:
+            break;
+    }
+}
+
+void InitChecker::transfer(State& state, const Terminator& term) const {
+    if (term.kind == TerminatorKind::Call && term.destination.is_local()) {
+        set_init(state.maybe_uninit, state.maybe_init, term.destination.local, true);
+    }
+}
+
+void InitChecker::check_function(const Function& func) {
+    func_ = &func;
+    size_t num_locals = func.locals.size();
+    reported_.assign(num_locals, false);
+
+    // Everything but the parameters starts out uninitialized
+    State bottom{std::vector<bool>(num_locals, false), std::vector<bool>(num_locals, false)};
+    std::vector<State> entry(func.blocks.size(), bottom);
+    entry[ENTRY_BLOCK].maybe_uninit.assign(num_locals, true);
+    for (LocalId local = 1; local <= func.arg_count; local++) {
+        set_init(entry[ENTRY_BLOCK].maybe_uninit, entry[ENTRY_BLOCK].maybe_init, local, true);
+    }
+
+    std::vector<BlockId> order = reverse_postorder(func);
+    for (bool changed = true; changed;) {
+        changed = false;
+        for (BlockId bb : order) {
+            State state = entry[bb];
+            for (const auto& stmt : func.blocks[bb].statements) transfer(state, stmt);
+            if (!func.blocks[bb].terminator) continue;
+            transfer(state, *func.blocks[bb].terminator);
+            for (BlockId succ : func.blocks[bb].terminator->successors()) {
+                changed |= merge(entry[succ].maybe_uninit, state.maybe_uninit);
+                changed |= merge(entry[succ].maybe_init, state.maybe_init);
+            }
+        }
+    }
+
+    for (BlockId bb : order) {
+        State state = entry[bb];
+        for (const auto& stmt : func.blocks[bb].statements) {
+            if (stmt.kind == StatementKind::Assign) {
+                for (const auto& op : stmt.rvalue.operands) {
+                    if (op.is_place()) check_read(state, op.place, stmt.location);
+                }
+                if (stmt.rvalue.kind == RvalueKind::Ref) check_read(state, stmt.rvalue.place, stmt.location);
+                check_write(state, stmt.place, stmt.location);
+            }
+            transfer(state, stmt);
+        }
+
+        if (!func.blocks[bb].terminator) continue;
+        const Terminator& term = *func.blocks[bb].terminator;
+        if (term.kind == TerminatorKind::SwitchInt && term.discriminant.is_place()) {
+            check_read(state, term.discriminant.place, term.location);
+        } else if (term.kind == TerminatorKind::Call) {
+            for (const auto& arg : term.args) {
+                if (arg.is_place()) check_read(state, arg.place, term.location);
+            }
+            check_write(state, term.destination, term.location);
+        }
+    }
+}
+
+void InitChecker::check_read(const State& state, const Place& place, const SourceLocation& loc) {
+    LocalId local = place.local;
+    if (!is_checked(local) || !state.maybe_uninit[local] || reported_[local]) return;
+    reported_[local] = true;
+    const char* kind = state.maybe_init[local] ? "possibly-uninitialized" : "uninitialized";
+    error(loc, std::string("Use of ") + kind + " variable '" + func_->locals[local].name + "'");
+}
+
+void InitChecker::check_write(const State& state, const Place& place, const SourceLocation& loc) {
+    LocalId local = place.local;
+    if (!is_checked(local) || reported_[local]) return;
+
+    if (!place.is_local()) {
+        // `*p = v` reads `p`; `s.f = v` needs the rest of `s` to exist already
+        if (has_deref(place)) {
+            check_read(state, place, loc);
+        } else if (state.maybe_uninit[local]) {
+            reported_[local] = true;
+            const char* kind = state.maybe_init[local] ? "possibly-uninitialized" : "uninitialized";
+            error(loc, std::string("Cannot assign to a field of ") + kind + " variable '" +
+                       func_->locals[local].name + "'");
+        }
+        return;
+    }
+
+    if (!func_->locals[local].is_mutable && state.maybe_init[local]) {
+        reported_[local] = true;
+        error(loc, "Cannot assign twice to immutable variable '" + func_->locals[local].name + "'");
+    }
+}
+
+void InitChecker::error(const SourceLocation& loc, const std::string& message) {
+    std::ostringstream oss;
+    oss << loc.filename << ":" << loc.line << ":" << loc.column << ": error: " << message;
+    errors_.push_back(oss.str());
+}
+
+} // namespace apex::mir
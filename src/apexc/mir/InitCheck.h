@@ -0,0 +1,44 @@
+#pragma once
+
+#include "MIR.h"
+#include <string>
+#include <vector>
+
+namespace apex::mir {
+
+// Flow-sensitive definite initialization. A forward dataflow tracks, per
+// local, whether it may be uninitialized and whether it may already hold a
+// value at each point. Reading, borrowing or partially writing a variable
+// that is uninitialized on some path into the access is an error, and so
+// is assigning an immutable `let x: T;` variable when an earlier
+// assignment may already have run. Moves don't de-initialize here; uses of
+// moved values with destructors are caught by drop elaboration.
+class InitChecker {
+public:
+    bool check(const Module& module);
+
+    const std::vector<std::string>& get_errors() const { return errors_; }
+    bool has_errors() const { return !errors_.empty(); }
+
+private:
+    struct State {
+        std::vector<bool> maybe_uninit;
+        std::vector<bool> maybe_init;
+    };
+
+    const Function* func_{nullptr};
+    std::vector<bool> reported_;
+    std::vector<std::string> errors_;
+
+    void check_function(const Function& func);
+    void transfer(State& state, const Statement& stmt) const;
+    void transfer(State& state, const Terminator& term) const;
+
+    void check_read(const State& state, const Place& place, const SourceLocation& loc);
+    void check_write(const State& state, const Place& place, const SourceLocation& loc);
+
+    bool is_checked(LocalId local) const;
+    void error(const SourceLocation& loc, const std::string& message);
+};
+
+} // namespace apex::mir
@@ -0,0 +1,165 @@
+#include "Passes.h"
+#include "Analysis.h"
+#include "CallGraph.h"
+
+namespace apex::mir {
+
+namespace {
+
+// Cost model, in MIR instructions
+constexpr int CALL_COST = 5;             // Argument setup, call, return
+constexpr int CONSTANT_ARG_BONUS = 2;    // Likely folded after inlining
+constexpr int HINT_MULTIPLIER = 3;       // #[inline]
+constexpr size_t CALLER_SIZE_LIMIT = 2000;
+
+int threshold_for(unsigned opt_level) {
+    switch (opt_level) {
+        case 0: return 0;    // Only #[inline(always)]
+        case 1: return 20;
+        case 2: return 40;
+        default: return 80;
+    }
+}
+
+int instruction_count(const Function& func) {
+    int count = 0;
+    for (const auto& block : func.blocks) {
+        for (const auto& stmt : block.statements) {
+            if (stmt.kind == StatementKind::Assign) count++;
+        }
+        if (!block.terminator) continue;
+        switch (block.terminator->kind) {
+            case TerminatorKind::Call: count += CALL_COST; break;
+            case TerminatorKind::SwitchInt: count += 1 + static_cast<int>(block.terminator->values.size()); break;
+            case TerminatorKind::Drop: count += 1; break;
+            default: break;
+        }
+    }
+    return count;
+}
+
+bool should_inline(const CallGraph& graph, size_t caller, size_t callee, const Terminator& call,
+                   unsigned opt_level, size_t caller_size) {
+    const Function& target = *graph.nodes[callee];
+    if (target.is_extern || target.blocks.empty()) return false;
+    if (target.inline_hint == InlineHint::Never) return false;
+
+    // Recursion guards: never inline within a cycle of the call graph, and
+    // never inline a recursive callee, since the spliced body would contain
+    // another inlinable call to it
+    if (graph.same_scc(caller, callee) || graph.is_recursive(callee)) return false;
+
+    if (target.inline_hint == InlineHint::Always) return true;
+    if (opt_level == 0 || caller_size > CALLER_SIZE_LIMIT) return false;
+
+    int cost = instruction_count(target) - CALL_COST;
+    for (const auto& arg : call.args) {
+        if (arg.kind == OperandKind::Constant) cost -= CONSTANT_ARG_BONUS;
+    }
+
+    int threshold = threshold_for(opt_level);
+    if (target.inline_hint == InlineHint::Hint) threshold *= HINT_MULTIPLIER;
+    return cost <= threshold;
+}
+
+// Splices a copy of `callee` in place of the call terminating `bb`
+void inline_call(Function& caller, BlockId bb, const Function& callee) {
+    Terminator call = std::move(*caller.blocks[bb].terminator);
+
+    LocalId local_base = static_cast<LocalId>(caller.locals.size());
+    for (const auto& decl : callee.locals) {
+        caller.locals.push_back(decl);
+        caller.locals.back().inlined = true;
+    }
+
+    // Parameters become plain locals initialized from the arguments
+    for (size_t i = 0; i < call.args.size(); i++) {
+        Statement init;
+        init.kind = StatementKind::Assign;
+        init.location = call.location;
+        init.place = Place(local_base + 1 + static_cast<LocalId>(i));
+        init.rvalue = Rvalue::use(std::move(call.args[i]));
+        caller.blocks[bb].statements.push_back(std::move(init));
+    }
+
+    BlockId block_base = static_cast<BlockId>(caller.blocks.size());
+    auto rename = [&](Place& place) { place.local += local_base; };
+    bool returns_value = !callee.return_type.is_void();
+
+    for (const auto& callee_block : callee.blocks) {
+        BasicBlock block = callee_block;
+        for (auto& stmt : block.statements) {
+            for_each_place(stmt, rename);
+            if (stmt.kind == StatementKind::StorageLive || stmt.kind == StatementKind::StorageDead) {
+                stmt.local += local_base;
+            }
+        }
+
+        if (block.terminator) {
+            Terminator& term = *block.terminator;
+            for_each_place(term, rename);
+            for (BlockId* succ : term.successors_mut()) {
+                *succ += block_base;
+            }
+
+            if (term.kind == TerminatorKind::Return) {
+                if (returns_value) {
+                    Place ret(local_base + RETURN_LOCAL);
+                    Statement store;
+                    store.kind = StatementKind::Assign;
+                    store.location = term.location;
+                    store.place = call.destination;
+                    store.rvalue = Rvalue::use(callee.return_type.kind == TypeKind::Struct
+                                                   ? Operand::move(ret) : Operand::copy(ret));
+                    block.statements.push_back(std::move(store));
+                }
+                Terminator jump;
+                jump.kind = TerminatorKind::Goto;
+                jump.location = term.location;
+                jump.target = call.target;
+                term = std::move(jump);
+            }
+        }
+        caller.blocks.push_back(std::move(block));
+    }
+
+    Terminator jump;
+    jump.kind = TerminatorKind::Goto;
+    jump.location = call.location;
+    jump.target = block_base + ENTRY_BLOCK;
+    caller.blocks[bb].terminator = std::move(jump);
+}
+
+} // namespace
+
+bool is_inline_candidate(const Function& func, unsigned opt_level) {
+    if (func.is_extern || func.blocks.empty() || func.inline_hint == InlineHint::Never) return false;
+    if (func.inline_hint == InlineHint::Always) return true;
+    if (opt_level == 0) return false;
+
+    int threshold = threshold_for(opt_level);
+    if (func.inline_hint == InlineHint::Hint) threshold *= HINT_MULTIPLIER;
+    return instruction_count(func) - CALL_COST <= threshold;
+}
+
+bool inline_calls(const CallGraph& graph, size_t caller, unsigned opt_level) {
+    Function& func = *graph.nodes[caller];
+    bool changed = false;
+
+    // Newly spliced blocks are visited too; the SCC guard keeps this finite
+    for (BlockId bb = 0; bb < func.blocks.size(); bb++) {
+        if (!func.blocks[bb].terminator || func.blocks[bb].terminator->kind != TerminatorKind::Call) continue;
+
+        auto callee = graph.find(func.blocks[bb].terminator->callee);
+        if (!callee) continue;
+
+        size_t caller_size = static_cast<size_t>(instruction_count(func));
+        if (!should_inline(graph, caller, *callee, *func.blocks[bb].terminator, opt_level, caller_size)) continue;
+
+        inline_call(func, bb, *graph.nodes[*callee]);
+        changed = true;
+    }
+    return changed;
+}
+
+} // namespace apex::mir
@@ -0,0 +1,557 @@
+#include "MIR.h"
+#include <sstream>
+
+namespace apex::mir {
+
+// Types
+
+Type Type::void_type() {
+    return Type();
+}
+
+Type Type::bool_type() {
+    Type t;
+    t.kind = TypeKind::Bool;
+    t.bits = 1;
+    return t;
+}
+
+Type Type::int_type(unsigned bits, bool is_signed) {
+    Type t;
+    t.kind = TypeKind::Int;
+    t.bits = bits;
+    t.is_signed = is_signed;
+    return t;
+}
+
+Type Type::float_type(unsigned bits) {
+    Type t;
+    t.kind = TypeKind::Float;
+    t.bits = bits;
+    t.is_signed = true;
+    return t;
+}
+
+Type Type::struct_type(std::string name) {
+    Type t;
+    t.kind = TypeKind::Struct;
+    t.struct_name = std::move(name);
+    return t;
+}
+
+Type Type::ref_type(Type pointee, bool is_mutable) {
+    Type t;
+    t.kind = TypeKind::Ref;
+    t.is_mutable = is_mutable;
+    t.pointee = std::make_shared<Type>(std::move(pointee));
+    return t;
+}
+
+Type Type::ptr_type(Type pointee, bool is_mutable) {
+    Type t = ref_type(std::move(pointee), is_mutable);
+    t.kind = TypeKind::Ptr;
+    return t;
+}
+
+Type Type::array_type(Type element, uint64_t length) {
+    Type t;
+    t.kind = TypeKind::Array;
+    t.pointee = std::make_shared<Type>(std::move(element));
+    t.length = length;
+    return t;
+}
+
+bool Type::operator==(const Type& other) const {
+    if (kind != other.kind) return false;
+    switch (kind) {
+        case TypeKind::Void:
+        case TypeKind::Bool:
+            return true;
+        case TypeKind::Int:
+        case TypeKind::Float:
+            return bits == other.bits && is_signed == other.is_signed;
+        case TypeKind::Struct:
+            return struct_name == other.struct_name;
+        case TypeKind::Ref:
+        case TypeKind::Ptr:
+            if (is_mutable != other.is_mutable) return false;
+            if (!pointee || !other.pointee) return pointee == other.pointee;
+            return *pointee == *other.pointee;
+        case TypeKind::Array:
+            return length == other.length && *pointee == *other.pointee;
+    }
+    return false;
+}
+
+std::string Type::to_string() const {
+    switch (kind) {
+        case TypeKind::Void: return "void";
+        case TypeKind::Bool: return "bool";
+        case TypeKind::Int: return (is_signed ? "i" : "u") + std::to_string(bits);
+        case TypeKind::Float: return "f" + std::to_string(bits);
+        case TypeKind::Struct: return struct_name;
+        case TypeKind::Ref:
+            return std::string(is_mutable ? "&mut " : "&") + (pointee ? pointee->to_string() : "?");
+        case TypeKind::Ptr:
+            return std::string(is_mutable ? "*mut " : "*") + (pointee ? pointee->to_string() : "?");
+        case TypeKind::Array:
+            return "[" + pointee->to_string() + "; " + std::to_string(length) + "]";
+    }
+    return "?";
+}
+
+// Places and operands
+
+Place Place::field(unsigned index) const {
+    Place p = *this;
+    p.projection.push_back({ProjectionKind::Field, index});
+    return p;
+}
+
+Place Place::deref() const {
+    Place p = *this;
+    p.projection.push_back({ProjectionKind::Deref, 0});
+    return p;
+}
+
+bool Place::operator==(const Place& other) const {
+    if (local != other.local || projection.size() != other.projection.size()) return false;
+    for (size_t i = 0; i < projection.size(); i++) {
+        if (projection[i].kind != other.projection[i].kind ||
+            projection[i].field_index != other.projection[i].field_index) {
+            return false;
+        }
+    }
+    return true;
+}
+
+int64_t Constant::as_int() const {
+    if (std::holds_alternative<int64_t>(value)) return std::get<int64_t>(value);
+    if (std::holds_alternative<bool>(value)) return std::get<bool>(value) ? 1 : 0;
+    return static_cast<int64_t>(std::get<double>(value));
+}
+
+Operand Operand::copy(Place place) {
+    Operand op;
+    op.kind = OperandKind::Copy;
+    op.place = std::move(place);
+    return op;
+}
+
+Operand Operand::move(Place place) {
+    Operand op;
+    op.kind = OperandKind::Move;
+    op.place = std::move(place);
+    return op;
+}
+
+Operand Operand::constant_int(Type type, int64_t value) {
+    Operand op;
+    op.constant.type = std::move(type);
+    op.constant.value = value;
+    return op;
+}
+
+Operand Operand::constant_float(Type type, double value) {
+    Operand op;
+    op.constant.type = std::move(type);
+    op.constant.value = value;
+    return op;
+}
+
+Operand Operand::constant_bool(bool value) {
+    Operand op;
+    op.constant.type = Type::bool_type();
+    op.constant.value = value;
+    return op;
+}
+
+// Rvalues
+
+Rvalue Rvalue::use(Operand op) {
+    Rvalue rv;
+    rv.kind = RvalueKind::Use;
+    rv.operands.push_back(std::move(op));
+    return rv;
+}
+
+Rvalue Rvalue::binary(BinOp op, Operand lhs, Operand rhs) {
+    Rvalue rv;
+    rv.kind = RvalueKind::BinaryOp;
+    rv.bin_op = op;
+    rv.operands.push_back(std::move(lhs));
+    rv.operands.push_back(std::move(rhs));
+    return rv;
+}
+
+Rvalue Rvalue::unary(UnOp op, Operand operand) {
+    Rvalue rv;
+    rv.kind = RvalueKind::UnaryOp;
+    rv.un_op = op;
+    rv.operands.push_back(std::move(operand));
+    return rv;
+}
+
+Rvalue Rvalue::ref(Place place, bool is_mutable) {
+    Rvalue rv;
+    rv.kind = RvalueKind::Ref;
+    rv.place = std::move(place);
+    rv.is_mutable = is_mutable;
+    return rv;
+}
+
+Rvalue Rvalue::aggregate(Type type, std::vector<Operand> fields) {
+    Rvalue rv;
+    rv.kind = RvalueKind::Aggregate;
+    rv.type = std::move(type);
+    rv.operands = std::move(fields);
+    return rv;
+}
+
+Rvalue Rvalue::cast(Operand operand, Type type) {
+    Rvalue rv;
+    rv.kind = RvalueKind::Cast;
+    rv.operands.push_back(std::move(operand));
+    rv.type = std::move(type);
+    return rv;
+}
+
+bool is_comparison(BinOp op) {
+    switch (op) {
+        case BinOp::Eq: case BinOp::Ne:
+        case BinOp::Lt: case BinOp::Le:
+        case BinOp::Gt: case BinOp::Ge:
+            return true;
+        default:
+            return false;
+    }
+}
+
+// Terminators
+
+std::vector<BlockId> Terminator::successors() const {
+    switch (kind) {
+        case TerminatorKind::Goto:
+        case TerminatorKind::Call:
+        case TerminatorKind::Drop:
+            return {target};
+        case TerminatorKind::SwitchInt:
+            return targets;
+        case TerminatorKind::Return:
+        case TerminatorKind::Unreachable:
+            return {};
+    }
+    return {};
+}
+
+std::vector<BlockId*> Terminator::successors_mut() {
+    std::vector<BlockId*> result;
+    switch (kind) {
+        case TerminatorKind::Goto:
+        case TerminatorKind::Call:
+        case TerminatorKind::Drop:
+            result.push_back(&target);
+            break;
+        case TerminatorKind::SwitchInt:
+            for (auto& t : targets) result.push_back(&t);
+            break;
+        default:
+            break;
+    }
+    return result;
+}
+
+// Functions and modules
+
+LocalId Function::new_local(Type type, std::string name, bool is_mutable, SourceLocation loc) {
+    LocalDecl decl;
+    decl.name = std::move(name);
+    decl.type = std::move(type);
+    decl.is_mutable = is_mutable;
+    decl.location = std::move(loc);
+    locals.push_back(std::move(decl));
+    return static_cast<LocalId>(locals.size() - 1);
+}
+
+BlockId Function::new_block() {
+    blocks.emplace_back();
+    return static_cast<BlockId>(blocks.size() - 1);
+}
+
+std::vector<std::vector<BlockId>> Function::predecessors() const {
+    std::vector<std::vector<BlockId>> preds(blocks.size());
+    for (BlockId bb = 0; bb < blocks.size(); bb++) {
+        if (!blocks[bb].terminator) continue;
+        for (BlockId succ : blocks[bb].terminator->successors()) {
+            preds[succ].push_back(bb);
+        }
+    }
+    return preds;
+}
+
+std::optional<unsigned> StructDef::field_index(const std::string& field) const {
+    for (unsigned i = 0; i < fields.size(); i++) {
+        if (fields[i].first == field) return i;
+    }
+    return std::nullopt;
+}
+
+const StructDef* Module::find_struct(const std::string& struct_name) const {
+    for (const auto& s : structs) {
+        if (s.name == struct_name) return &s;
+    }
+    return nullptr;
+}
+
+bool Module::needs_drop(const Type& type) const {
+    if (type.kind != TypeKind::Struct) return false;
+    const StructDef* def = find_struct(type.struct_name);
+    if (!def) return false;
+    if (!def->destructor.empty()) return true;
+    for (const auto& field : def->fields) {
+        if (needs_drop(field.second)) return true;
+    }
+    return false;
+}
+
+Function* Module::find_function(const std::string& func_name) const {
+    for (const auto& f : functions) {
+        if (f->name == func_name) return f.get();
+    }
+    return nullptr;
+}
+
+Type Module::place_type(const Function& func, const Place& place) const {
+    Type ty = func.locals[place.local].type;
+    for (const auto& elem : place.projection) {
+        if (elem.kind == ProjectionKind::Deref) {
+            ty = ty.pointee ? *ty.pointee : Type::void_type();
+        } else {
+            const StructDef* def = find_struct(ty.struct_name);
+            if (!def || elem.field_index >= def->fields.size()) return Type::void_type();
+            ty = def->fields[elem.field_index].second;
+        }
+    }
+    return ty;
+}
+
+Type Module::operand_type(const Function& func, const Operand& op) const {
+    if (op.kind == OperandKind::Constant) return op.constant.type;
+    return place_type(func, op.place);
+}
+
+Type Module::rvalue_type(const Function& func, const Rvalue& rv) const {
+    switch (rv.kind) {
+        case RvalueKind::Use:
+        case RvalueKind::UnaryOp:
+            return operand_type(func, rv.operands[0]);
+        case RvalueKind::BinaryOp:
+            if (is_comparison(rv.bin_op)) return Type::bool_type();
+            return operand_type(func, rv.operands[0]);
+        case RvalueKind::Ref:
+            return Type::ref_type(place_type(func, rv.place), rv.is_mutable);
+        case RvalueKind::Aggregate:
+        case RvalueKind::Cast:
+            return rv.type;
+    }
+    return Type::void_type();
+}
+
+// Pretty printing
+
+static const char* bin_op_name(BinOp op) {
+    switch (op) {
+        case BinOp::Add: return "Add";
+        case BinOp::Sub: return "Sub";
+        case BinOp::Mul: return "Mul";
+        case BinOp::Div: return "Div";
+        case BinOp::Rem: return "Rem";
+        case BinOp::BitAnd: return "BitAnd";
+        case BinOp::BitOr: return "BitOr";
+        case BinOp::BitXor: return "BitXor";
+        case BinOp::Shl: return "Shl";
+        case BinOp::Shr: return "Shr";
+        case BinOp::Eq: return "Eq";
+        case BinOp::Ne: return "Ne";
+        case BinOp::Lt: return "Lt";
+        case BinOp::Le: return "Le";
+        case BinOp::Gt: return "Gt";
+        case BinOp::Ge: return "Ge";
+    }
+    return "?";
+}
+
+std::string to_string(const Place& place) {
+    std::string s = "_" + std::to_string(place.local);
+    for (const auto& elem : place.projection) {
+        if (elem.kind == ProjectionKind::Deref) {
+            s = "(*" + s + ")";
+        } else {
+            s += "." + std::to_string(elem.field_index);
+        }
+    }
+    return s;
+}
+
+std::string to_string(const Operand& op) {
+    switch (op.kind) {
+        case OperandKind::Copy:
+            return to_string(op.place);
+        case OperandKind::Move:
+            return "move " + to_string(op.place);
+        case OperandKind::Constant: {
+            std::ostringstream oss;
+            oss << "const ";
+            if (std::holds_alternative<bool>(op.constant.value)) {
+                oss << (std::get<bool>(op.constant.value) ? "true" : "false");
+            } else if (std::holds_alternative<double>(op.constant.value)) {
+                oss << std::get<double>(op.constant.value) << "_" << op.constant.type.to_string();
+            } else {
+                oss << std::get<int64_t>(op.constant.value) << "_" << op.constant.type.to_string();
+            }
+            return oss.str();
+        }
+    }
+    return "?";
+}
+
+std::string to_string(const Rvalue& rv) {
+    switch (rv.kind) {
+        case RvalueKind::Use:
+            return to_string(rv.operands[0]);
+        case RvalueKind::BinaryOp:
+            return std::string(bin_op_name(rv.bin_op)) + (rv.no_overflow ? "Unchecked" : "") + "(" +
+                   to_string(rv.operands[0]) + ", " + to_string(rv.operands[1]) + ")";
+        case RvalueKind::UnaryOp:
+            return std::string(rv.un_op == UnOp::Neg ? "Neg" : "Not") + "(" +
+                   to_string(rv.operands[0]) + ")";
+        case RvalueKind::Ref:
+            return std::string(rv.is_mutable ? "&mut " : "&") + to_string(rv.place);
+        case RvalueKind::Aggregate: {
+            std::string s = rv.type.to_string() + " {";
+            for (size_t i = 0; i < rv.operands.size(); i++) {
+                s += (i ? ", " : " ") + to_string(rv.operands[i]);
+            }
+            return s + " }";
+        }
+        case RvalueKind::Cast:
+            return to_string(rv.operands[0]) + " as " + rv.type.to_string();
+    }
+    return "?";
+}
+
+static void print_terminator(const Terminator& term, std::ostream& os) {
+    switch (term.kind) {
+        case TerminatorKind::Goto:
+            os << "goto -> bb" << term.target;
+            break;
+        case TerminatorKind::SwitchInt:
+            os << "switchInt(" << to_string(term.discriminant) << ") -> [";
+            for (size_t i = 0; i < term.values.size(); i++) {
+                os << term.values[i] << ": bb" << term.targets[i] << ", ";
+            }
+            os << "otherwise: bb" << term.targets.back() << "]";
+            break;
+        case TerminatorKind::Return:
+            os << "return";
+            break;
+        case TerminatorKind::Unreachable:
+            os << "unreachable";
+            break;
+        case TerminatorKind::Call:
+            os << to_string(term.destination) << " = " << term.callee << "(";
+            for (size_t i = 0; i < term.args.size(); i++) {
+                os << (i ? ", " : "") << to_string(term.args[i]);
+            }
+            os << ") -> bb" << term.target;
+            break;
+        case TerminatorKind::Drop:
+            os << "drop(" << to_string(term.place) << ") -> bb" << term.target;
+            break;
+    }
+}
+
+static std::string effects_to_string(const Effects& effects) {
+    std::vector<std::string> facts;
+    if (effects.is_pure()) facts.push_back("readnone");
+    else if (!effects.writes_memory) facts.push_back("readonly");
+    if (effects.args_only && !effects.is_pure()) facts.push_back("argmemonly");
+    if (effects.will_return) facts.push_back("willreturn");
+    if (effects.no_unwind) facts.push_back("nounwind");
+
+    std::string text;
+    for (size_t i = 0; i < facts.size(); i++) text += (i ? ", " : "") + facts[i];
+    return text;
+}
+
+void print_function(const Function& func, std::ostream& os) {
+    os << (func.is_extern ? "extern fn " : "fn ") << func.name << "(";
+    for (size_t i = 1; i <= func.arg_count; i++) {
+        os << (i > 1 ? ", " : "") << "_" << i << ": " << func.locals[i].type.to_string();
+    }
+    os << ") -> " << func.return_type.to_string();
+    if (func.is_extern) {
+        os << ";\n";
+        return;
+    }
+    os << " {\n";
+    std::string effects = effects_to_string(func.effects);
+    if (!effects.empty()) os << "    // " << effects << "\n";
+    if (const auto& range = func.locals[RETURN_LOCAL].range) {
+        os << "    // returns [" << range->lo << ", " << range->hi << "]\n";
+    }
+    for (size_t i = func.arg_count + 1; i < func.locals.size(); i++) {
+        const auto& decl = func.locals[i];
+        os << "    let " << (decl.is_mutable ? "mut " : "") << "_" << i << ": "
+           << decl.type.to_string() << ";";
+        if (!decl.name.empty() || decl.range || decl.align) os << "  //";
+        if (!decl.name.empty()) os << " " << decl.name;
+        if (decl.range) os << " [" << decl.range->lo << ", " << decl.range->hi << "]";
+        if (decl.align) os << " align " << decl.align;
+        os << "\n";
+    }
+    for (BlockId bb = 0; bb < func.blocks.size(); bb++) {
+        const auto& block = func.blocks[bb];
+        os << "\n    bb" << bb << ": {\n";
+        for (const auto& stmt : block.statements) {
+            switch (stmt.kind) {
+                case StatementKind::Assign:
+                    os << "        " << to_string(stmt.place) << " = " << to_string(stmt.rvalue) << ";\n";
+                    break;
+                case StatementKind::StorageLive:
+                    os << "        StorageLive(_" << stmt.local << ");\n";
+                    break;
+                case StatementKind::StorageDead:
+                    os << "        StorageDead(_" << stmt.local << ");\n";
+                    break;
+                case StatementKind::Nop:
+                    break;
+            }
+        }
+        if (block.terminator) {
+            os << "        ";
+            print_terminator(*block.terminator, os);
+            os << ";\n";
+        }
+        os << "    }\n";
+    }
+    os << "}\n";
+}
+
+void print_module(const Module& module, std::ostream& os) {
+    for (const auto& s : module.structs) {
+        os << "struct " << s.name << " {";
+        for (size_t i = 0; i < s.fields.size(); i++) {
+            os << (i ? ", " : " ") << s.fields[i].first << ": " << s.fields[i].second.to_string();
+        }
+        os << " }";
+        if (!s.destructor.empty()) os << " // drop: " << s.destructor;
+        os << "\n";
+    }
+    for (const auto& func : module.functions) {
+        os << "\n";
+        print_function(*func, os);
+    }
+}
+
+} // namespace apex::mir
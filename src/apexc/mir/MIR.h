@@ -0,0 +1,309 @@
+#pragma once
+
+#include "../lexer/Token.h"
+#include <cstdint>
+#include <memory>
+#include <optional>
+#include <ostream>
+#include <string>
+#include <variant>
+#include <vector>
+
+namespace apex::mir {
+
+// Mid-level IR: a control-flow graph of basic blocks over typed locals.
+//
+// Every function owns a flat list of locals. Local 0 is the return place,
+// locals 1..=arg_count are the parameters, everything after that is a user
+// variable or a compiler temporary. Statements only ever write to places;
+// control flow lives exclusively in block terminators.
+
+using LocalId = uint32_t;
+using BlockId = uint32_t;
+
+constexpr LocalId RETURN_LOCAL = 0;
+constexpr BlockId ENTRY_BLOCK = 0;
+
+// Type system
+enum class TypeKind {
+    Void, Bool, Int, Float, Struct, Ref, Ptr, Array
+};
+
+struct Type {
+    TypeKind kind{TypeKind::Void};
+
+    // Int / Float
+    unsigned bits{0};
+    bool is_signed{false};
+
+    // Ref / Ptr (pointee), Array (element type)
+    bool is_mutable{false};
+    std::shared_ptr<Type> pointee;
+
+    // Array: fixed-size stack buffers introduced by optimizations
+    uint64_t length{0};
+
+    // Struct
+    std::string struct_name;
+
+    static Type void_type();
+    static Type bool_type();
+    static Type int_type(unsigned bits, bool is_signed);
+    static Type float_type(unsigned bits);
+    static Type struct_type(std::string name);
+    static Type ref_type(Type pointee, bool is_mutable);
+    static Type ptr_type(Type pointee, bool is_mutable);
+    static Type array_type(Type element, uint64_t length);
+
+    bool is_void() const { return kind == TypeKind::Void; }
+    bool is_integer() const { return kind == TypeKind::Int; }
+    bool is_scalar() const { return kind != TypeKind::Void && kind != TypeKind::Struct && kind != TypeKind::Array; }
+
+    bool operator==(const Type& other) const;
+    bool operator!=(const Type& other) const { return !(*this == other); }
+
+    std::string to_string() const;
+};
+
+// Inclusive bounds on the values of an integer
+struct ValueRange {
+    int64_t lo{0};
+    int64_t hi{0};
+};
+
+// Locals
+struct LocalDecl {
+    std::string name;       // Empty for compiler temporaries
+    Type type;
+    bool is_mutable{false};
+    SourceLocation location;
+    std::optional<ValueRange> range;   // Every value ever assigned, when narrower than the type
+    bool inlined{false};    // Copied in from a callee by the inliner
+    unsigned align{0};      // Minimum stack slot alignment in bytes; 0: the type's
+};
+
+// Places: a local followed by a chain of projections
+enum class ProjectionKind {
+    Deref, Field
+};
+
+struct ProjectionElem {
+    ProjectionKind kind;
+    unsigned field_index{0};
+};
+
+struct Place {
+    LocalId local{RETURN_LOCAL};
+    std::vector<ProjectionElem> projection;
+
+    Place() = default;
+    explicit Place(LocalId l) : local(l) {}
+
+    bool is_local() const { return projection.empty(); }
+    Place field(unsigned index) const;
+    Place deref() const;
+
+    bool operator==(const Place& other) const;
+};
+
+// Operands
+struct Constant {
+    Type type;
+    std::variant<int64_t, double, bool> value;
+
+    int64_t as_int() const;
+};
+
+enum class OperandKind {
+    Copy, Move, Constant
+};
+
+struct Operand {
+    OperandKind kind{OperandKind::Constant};
+    Place place;
+    Constant constant;
+
+    static Operand copy(Place place);
+    static Operand move(Place place);
+    static Operand constant_int(Type type, int64_t value);
+    static Operand constant_float(Type type, double value);
+    static Operand constant_bool(bool value);
+
+    bool is_place() const { return kind != OperandKind::Constant; }
+};
+
+// Rvalues
+enum class RvalueKind {
+    Use, BinaryOp, UnaryOp, Ref, Aggregate, Cast
+};
+
+enum class BinOp {
+    Add, Sub, Mul, Div, Rem,
+    BitAnd, BitOr, BitXor, Shl, Shr,
+    Eq, Ne, Lt, Le, Gt, Ge
+};
+
+enum class UnOp {
+    Neg, Not
+};
+
+struct Rvalue {
+    RvalueKind kind{RvalueKind::Use};
+
+    // Use: operands[0]; BinaryOp: operands[0] op operands[1]; UnaryOp: op operands[0]
+    // Aggregate: one operand per struct field, in declaration order
+    // Cast: operands[0] as type
+    std::vector<Operand> operands;
+    BinOp bin_op{BinOp::Add};
+    UnOp un_op{UnOp::Neg};
+    bool no_overflow{false};   // Add/Sub/Mul proven not to wrap (printed as AddUnchecked etc.)
+
+    // Ref: &place / &mut place
+    Place place;
+    bool is_mutable{false};
+
+    // Aggregate / Cast result type
+    Type type;
+
+    static Rvalue use(Operand op);
+    static Rvalue binary(BinOp op, Operand lhs, Operand rhs);
+    static Rvalue unary(UnOp op, Operand operand);
+    static Rvalue ref(Place place, bool is_mutable);
+    static Rvalue aggregate(Type type, std::vector<Operand> fields);
+    static Rvalue cast(Operand operand, Type type);
+};
+
+bool is_comparison(BinOp op);
+
+// Statements
+enum class StatementKind {
+    Assign, StorageLive, StorageDead, Nop
+};
+
+struct Statement {
+    StatementKind kind{StatementKind::Nop};
+    SourceLocation location;
+
+    // Assign
+    Place place;
+    Rvalue rvalue;
+
+    // StorageLive / StorageDead
+    LocalId local{RETURN_LOCAL};
+};
+
+// Terminators
+enum class TerminatorKind {
+    Goto, SwitchInt, Return, Unreachable, Call, Drop
+};
+
+struct Terminator {
+    TerminatorKind kind{TerminatorKind::Unreachable};
+    SourceLocation location;
+
+    // Goto / Call / Drop continuation
+    BlockId target{0};
+
+    // SwitchInt: jump to targets[i] when discriminant == values[i],
+    // otherwise to targets.back() (targets.size() == values.size() + 1)
+    Operand discriminant;
+    std::vector<int64_t> values;
+    std::vector<BlockId> targets;
+    bool source_branch{false};  // An if, loop condition, && / || or match, not compiler-made (coverage)
+
+    // Call: destination = callee(args)
+    std::string callee;
+    std::vector<Operand> args;
+    Place destination;
+
+    // Drop
+    Place place;
+
+    std::vector<BlockId> successors() const;
+    std::vector<BlockId*> successors_mut();
+};
+
+struct BasicBlock {
+    std::vector<Statement> statements;
+    std::optional<Terminator> terminator;
+};
+
+// Functions and modules
+enum class InlineHint {
+    None,       // Left to the inliner's cost model
+    Hint,       // #[inline]: inlined under a larger threshold
+    Always,     // #[inline(always)]
+    Never       // #[inline(never)] / #[noinline]
+};
+
+// What calling a function may do besides computing its result, inferred
+// bottom-up over the call graph. The defaults are what must be assumed of
+// a function nothing is known about (externs).
+struct Effects {
+    bool reads_memory{true};
+    bool writes_memory{true};
+    bool args_only{false};      // Memory is only reached through pointer arguments
+    bool will_return{false};    // Always returns: no loops, recursion or diverging callees
+    bool no_unwind{false};
+
+    bool is_pure() const { return !reads_memory && !writes_memory; }
+};
+
+struct Function {
+    std::string name;
+    SourceLocation location;
+    Type return_type;
+    size_t arg_count{0};
+    bool is_extern{false};    // Declaration only, no blocks
+    bool is_public{false};
+    bool is_exported{false};  // Defined inside an `extern` block, callable from C
+    bool is_destructor{false};
+    bool is_imported{false};  // Body from another module's .apxmod, for inlining; defined there
+    InlineHint inline_hint{InlineHint::None};
+    Effects effects;
+
+    std::vector<LocalDecl> locals;
+    std::vector<BasicBlock> blocks;
+
+    LocalId new_local(Type type, std::string name = "", bool is_mutable = false,
+                      SourceLocation loc = SourceLocation());
+    BlockId new_block();
+
+    bool is_arg(LocalId local) const { return local >= 1 && local <= arg_count; }
+    std::vector<std::vector<BlockId>> predecessors() const;
+};
+
+struct StructDef {
+    std::string name;
+    std::vector<std::pair<std::string, Type>> fields;
+    std::string destructor;   // `#[drop]` function, empty if none
+    SourceLocation location;
+
+    std::optional<unsigned> field_index(const std::string& field) const;
+};
+
+struct Module {
+    std::string name;
+    std::vector<StructDef> structs;
+    std::vector<std::unique_ptr<Function>> functions;
+
+    const StructDef* find_struct(const std::string& name) const;
+    Function* find_function(const std::string& name) const;
+
+    // Whether values of the type run a destructor, directly or in a field
+    bool needs_drop(const Type& type) const;
+
+    // Type of a place after applying its projections
+    Type place_type(const Function& func, const Place& place) const;
+    Type operand_type(const Function& func, const Operand& op) const;
+    Type rvalue_type(const Function& func, const Rvalue& rv) const;
+};
+
+// Pretty printing (--emit-mir)
+std::string to_string(const Place& place);
+std::string to_string(const Operand& op);
+std::string to_string(const Rvalue& rv);
+void print_function(const Function& func, std::ostream& os);
+void print_module(const Module& module, std::ostream& os);
+
+} // namespace apex::mir
@@ -0,0 +1,1360 @@
+#include "MIRBuilder.h"
+#include <sstream>
+
+namespace apex::mir {
+
+static bool is_assign_op(ast::BinaryOp op) {
+    switch (op) {
+        case ast::BinaryOp::Assign:
+        case ast::BinaryOp::AddAssign: case ast::BinaryOp::SubAssign:
+        case ast::BinaryOp::MulAssign: case ast::BinaryOp::DivAssign:
+        case ast::BinaryOp::ModAssign: case ast::BinaryOp::AndAssign:
+        case ast::BinaryOp::OrAssign: case ast::BinaryOp::XorAssign:
+        case ast::BinaryOp::ShlAssign: case ast::BinaryOp::ShrAssign:
+            return true;
+        default:
+            return false;
+    }
+}
+
+// Maps arithmetic, comparison and compound-assignment operators to MIR BinOps
+static std::optional<BinOp> to_bin_op(ast::BinaryOp op) {
+    switch (op) {
+        case ast::BinaryOp::Add: case ast::BinaryOp::AddAssign: return BinOp::Add;
+        case ast::BinaryOp::Sub: case ast::BinaryOp::SubAssign: return BinOp::Sub;
+        case ast::BinaryOp::Mul: case ast::BinaryOp::MulAssign: return BinOp::Mul;
+        case ast::BinaryOp::Div: case ast::BinaryOp::DivAssign: return BinOp::Div;
+        case ast::BinaryOp::Mod: case ast::BinaryOp::ModAssign: return BinOp::Rem;
+        case ast::BinaryOp::BitAnd: case ast::BinaryOp::AndAssign: return BinOp::BitAnd;
+        case ast::BinaryOp::BitOr: case ast::BinaryOp::OrAssign: return BinOp::BitOr;
+        case ast::BinaryOp::BitXor: case ast::BinaryOp::XorAssign: return BinOp::BitXor;
+        case ast::BinaryOp::Shl: case ast::BinaryOp::ShlAssign: return BinOp::Shl;
+        case ast::BinaryOp::Shr: case ast::BinaryOp::ShrAssign: return BinOp::Shr;
+        case ast::BinaryOp::Eq: return BinOp::Eq;
+        case ast::BinaryOp::Ne: return BinOp::Ne;
+        case ast::BinaryOp::Lt: return BinOp::Lt;
+        case ast::BinaryOp::Le: return BinOp::Le;
+        case ast::BinaryOp::Gt: return BinOp::Gt;
+        case ast::BinaryOp::Ge: return BinOp::Ge;
+        default: return std::nullopt;
+    }
+}
+
+// The conversions codegen knows how to emit for `as`
+static bool is_valid_cast(const Type& from, const Type& to) {
+    auto numeric = [](const Type& t) {
+        return t.kind == TypeKind::Int || t.kind == TypeKind::Bool || t.kind == TypeKind::Float;
+    };
+    auto pointer = [](const Type& t) { return t.kind == TypeKind::Ref || t.kind == TypeKind::Ptr; };
+    if (numeric(from) && numeric(to)) return true;
+    if (pointer(from) || pointer(to)) {
+        auto address = [&](const Type& t) { return pointer(t) || t.is_integer(); };
+        return address(from) && address(to);
+    }
+    return false;
+}
+
+// Arithmetic needs numbers, bitwise operators integers or bools, and
+// comparisons any scalar
+static bool is_valid_operand(BinOp op, const Type& type) {
+    switch (op) {
+        case BinOp::Add: case BinOp::Sub: case BinOp::Mul:
+        case BinOp::Div: case BinOp::Rem:
+            return type.is_integer() || type.kind == TypeKind::Float;
+        case BinOp::BitAnd: case BinOp::BitOr: case BinOp::BitXor:
+            return type.is_integer() || type.kind == TypeKind::Bool;
+        case BinOp::Shl: case BinOp::Shr:
+            return type.is_integer();
+        default:
+            return type.is_scalar();
+    }
+}
+
+// A `&mut T` may be used where a `&T` is expected
+static bool is_assignable(const Type& expected, const Type& actual) {
+    if (expected == actual) return true;
+    if (expected.kind != actual.kind || expected.kind != TypeKind::Ref) return false;
+    return !expected.is_mutable && expected.pointee && actual.pointee && *expected.pointee == *actual.pointee;
+}
+
+static std::optional<Type> primitive_type(const std::string& name) {
+    if (name == "void") return Type::void_type();
+    if (name == "bool") return Type::bool_type();
+    if (name == "i8") return Type::int_type(8, true);
+    if (name == "u8" || name == "byte") return Type::int_type(8, false);
+    if (name == "i16") return Type::int_type(16, true);
+    if (name == "u16") return Type::int_type(16, false);
+    if (name == "i32") return Type::int_type(32, true);
+    if (name == "u32" || name == "char") return Type::int_type(32, false);
+    if (name == "i64" || name == "isize") return Type::int_type(64, true); // Assume 64-bit
+    if (name == "u64" || name == "usize") return Type::int_type(64, false);
+    if (name == "i128") return Type::int_type(128, true);
+    if (name == "u128") return Type::int_type(128, false);
+    if (name == "f32") return Type::float_type(32);
+    if (name == "f64") return Type::float_type(64);
+    return std::nullopt;
+}
+
+MIRBuilder::MIRBuilder() = default;
+
+void MIRBuilder::error(const SourceLocation& loc, const std::string& message) {
+    std::ostringstream oss;
+    oss << loc.filename << ":" << loc.line << ":" << loc.column << ": error: " << message;
+    errors_.push_back(oss.str());
+}
+
+std::unique_ptr<Module> MIRBuilder::build(ast::Module* module) {
+    auto result = std::make_unique<Module>();
+    if (!module) return result;
+
+    result->name = module->name;
+    module_ = result.get();
+
+    // First pass: struct names, so fields and signatures can refer to any struct
+    for (auto& item : module->items) {
+        if (item->kind == ast::ItemKind::Struct) {
+            StructDef def;
+            def.name = item->name;
+            def.location = item->location;
+            module_->structs.push_back(std::move(def));
+        }
+    }
+
+    // Second pass: struct layouts and function signatures
+    size_t struct_idx = 0;
+    for (auto& item : module->items) {
+        if (item->kind == ast::ItemKind::Struct) {
+            auto& def = module_->structs[struct_idx++];
+            for (auto& field : item->struct_fields) {
+                def.fields.emplace_back(field.name, lower_type(field.type.get()));
+            }
+        } else if (item->kind == ast::ItemKind::Function) {
+            declare_function(item.get());
+        }
+    }
+
+    // Destructors: `#[drop] fn f(x: &mut S)` (shape checked by sema)
+    for (auto& item : module->items) {
+        if (item->kind != ast::ItemKind::Function || !item->find_attribute("drop")) continue;
+        Function* func = functions_[item->name];
+        const Type* param = func->arg_count == 1 ? &func->locals[1].type : nullptr;
+        bool found = false;
+        for (auto& def : module_->structs) {
+            if (param && param->pointee && param->pointee->kind == TypeKind::Struct &&
+                def.name == param->pointee->struct_name) {
+                def.destructor = item->name;
+                func->is_destructor = true;
+                found = true;
+            }
+        }
+        if (!found) error(item->location, "Destructor '" + item->name + "' must take '&mut' of a struct");
+    }
+
+    // Third pass: function bodies
+    for (auto& item : module->items) {
+        if (item->kind == ast::ItemKind::Function && item->body) {
+            lower_function(item.get());
+        }
+    }
+
+    module_ = nullptr;
+    return result;
+}
+
+Type MIRBuilder::lower_type(ast::Type* type) {
+    if (!type) return Type::void_type();
+
+    switch (type->kind) {
+        case ast::TypeKind::Primitive:
+        case ast::TypeKind::Named:
+            if (type->primitive_name) {
+                if (auto prim = primitive_type(*type->primitive_name)) return *prim;
+            }
+            if (!type->path_segments.empty()) {
+                const std::string& name = type->path_segments[0];
+                if (auto prim = primitive_type(name)) return *prim;
+                if (module_->find_struct(name)) return Type::struct_type(name);
+                error(type->location, "Unknown type '" + name + "'");
+            }
+            break;
+
+        case ast::TypeKind::Pointer:
+            return Type::ptr_type(lower_type(type->pointee_type.get()), type->is_mutable);
+
+        case ast::TypeKind::Reference:
+            return Type::ref_type(lower_type(type->pointee_type.get()), type->is_mutable);
+
+        case ast::TypeKind::Tuple:
+            if (type->tuple_types.empty()) return Type::void_type();
+            error(type->location, "Tuple types are not supported yet");
+            break;
+
+        default:
+            error(type->location, "Unsupported type");
+            break;
+    }
+
+    return Type::void_type();
+}
+
+void MIRBuilder::declare_function(ast::Item* item) {
+    if (functions_.count(item->name)) return;   // Redefinition is reported by sema
+
+    auto func = std::make_unique<Function>();
+    func->name = item->name;
+    func->location = item->location;
+    func->return_type = lower_type(item->return_type.get());
+    func->is_extern = !item->body;
+    func->is_public = item->visibility == ast::Visibility::Public;
+    func->is_exported = item->is_extern && item->body;
+
+    if (item->find_attribute("noinline")) {
+        func->inline_hint = InlineHint::Never;
+    } else if (const ast::Attribute* attr = item->find_attribute("inline")) {
+        if (attr->args.empty()) {
+            func->inline_hint = InlineHint::Hint;
+        } else {
+            func->inline_hint = attr->args[0] == "always" ? InlineHint::Always : InlineHint::Never;
+        }
+    }
+
+    func->new_local(func->return_type, "", true, item->location);
+    for (auto& param : item->params) {
+        func->new_local(lower_type(param.type.get()), param.name, param.is_mutable, param.location);
+    }
+    func->arg_count = item->params.size();
+
+    functions_[item->name] = func.get();
+    module_->functions.push_back(std::move(func));
+}
+
+void MIRBuilder::lower_function(ast::Item* item) {
+    func_ = functions_[item->name];
+    if (!func_ || !func_->blocks.empty()) return;
+
+    scopes_.clear();
+    loops_.clear();
+    return_block_.reset();
+    current_block_ = func_->new_block();
+
+    push_scope();
+    for (size_t i = 0; i < item->params.size(); i++) {
+        LocalId param = static_cast<LocalId>(i + 1);
+        scopes_.back().bindings[item->params[i].name] = param;
+        if (module_->needs_drop(func_->locals[param].type)) {
+            Cleanup drop{Cleanup::Kind::Drop, param};
+            scopes_.back().cleanups.push_back(std::move(drop));
+            scopes_.back().drop_count++;
+        }
+    }
+
+    if (func_->return_type.is_void()) {
+        lower_into(std::nullopt, item->body.get());
+    } else {
+        lower_into(Place(RETURN_LOCAL), item->body.get(), &func_->return_type);
+    }
+
+    pop_scope(item->body->location);
+
+    Terminator ret;
+    ret.kind = TerminatorKind::Return;
+    ret.location = item->body->location;
+    terminate(std::move(ret));
+
+    // Blocks left open after a diverging expression are unreachable
+    for (auto& block : func_->blocks) {
+        if (!block.terminator) {
+            Terminator unreachable;
+            unreachable.kind = TerminatorKind::Unreachable;
+            block.terminator = std::move(unreachable);
+        }
+    }
+
+    func_ = nullptr;
+}
+
+// Scopes
+
+void MIRBuilder::push_scope() {
+    scopes_.emplace_back();
+}
+
+void MIRBuilder::pop_scope(const SourceLocation& loc) {
+    size_t index = scopes_.size() - 1;
+    if (scopes_[index].drop_count == 0) {
+        const auto& locals = scopes_[index].locals;
+        for (auto it = locals.rbegin(); it != locals.rend(); ++it) {
+            push_storage(StatementKind::StorageDead, *it, loc);
+        }
+    } else {
+        BlockId next = func_->new_block();
+        exit_to(index, next, loc);
+        current_block_ = next;
+    }
+    finish_dispatch(scopes_[index], loc);
+    scopes_.pop_back();
+}
+
+void MIRBuilder::exit_scopes(size_t depth, const SourceLocation& loc) {
+    for (size_t i = scopes_.size(); i > depth; i--) {
+        const auto& locals = scopes_[i - 1].locals;
+        for (auto it = locals.rbegin(); it != locals.rend(); ++it) {
+            push_storage(StatementKind::StorageDead, *it, loc);
+        }
+    }
+}
+
+bool MIRBuilder::needs_cleanup(size_t depth) const {
+    for (size_t i = depth; i < scopes_.size(); i++) {
+        if (scopes_[i].drop_count > 0) return true;
+    }
+    return false;
+}
+
+// Leaves every scope from `depth` inwards and continues at `target`. Without
+// drops or defers this is just StorageDeads and a goto; otherwise each scope
+// records where to go after its cleanups and the exit enters the innermost
+// scope's landing chain, so every cleanup is emitted once however many
+// return/break/continue edges pass through it.
+void MIRBuilder::exit_to(size_t depth, BlockId target, const SourceLocation& loc) {
+    if (!needs_cleanup(depth)) {
+        exit_scopes(depth, loc);
+        goto_block(target, loc);
+        return;
+    }
+
+    BlockId dest = target;
+    for (size_t i = depth; i < scopes_.size(); i++) {
+        ScopeFrame& scope = scopes_[i];
+        size_t index = 0;
+        while (index < scope.exit_targets.size() && scope.exit_targets[index] != dest) index++;
+        if (index == scope.exit_targets.size()) scope.exit_targets.push_back(dest);
+        if (!scope.selector) scope.selector = new_temp(Type::int_type(32, false));
+        scope.selector_writes.emplace_back(current_block_, func_->blocks[current_block_].statements.size());
+        push_assign(Place(*scope.selector),
+                    Rvalue::use(Operand::constant_int(Type::int_type(32, false), static_cast<int64_t>(index))),
+                    loc);
+        dest = landing_block(i, scopes_[i].cleanups.size(), loc);
+    }
+    goto_block(dest, loc);
+}
+
+BlockId MIRBuilder::landing_block(size_t scope, size_t count, const SourceLocation& loc) {
+    auto found = scopes_[scope].landing.find(count);
+    if (found != scopes_[scope].landing.end()) return found->second;
+
+    BlockId saved = current_block_;
+    BlockId block = func_->new_block();
+    scopes_[scope].landing[count] = block;
+    current_block_ = block;
+
+    // StorageDeads are cheap enough to repeat; drops and defers are not
+    size_t k = count;
+    while (k > 0 && scopes_[scope].cleanups[k - 1].kind == Cleanup::Kind::StorageDead) {
+        push_storage(StatementKind::StorageDead, scopes_[scope].cleanups[k - 1].local, loc);
+        k--;
+    }
+    if (k == 0) {
+        goto_block(dispatch_block(scope), loc);
+    } else if (k < count) {
+        goto_block(landing_block(scope, k, loc), loc);
+    } else {
+        lower_cleanup(scope, k - 1, loc);
+    }
+
+    current_block_ = saved;
+    return block;
+}
+
+BlockId MIRBuilder::dispatch_block(size_t scope) {
+    if (!scopes_[scope].dispatch) scopes_[scope].dispatch = func_->new_block();
+    return *scopes_[scope].dispatch;
+}
+
+void MIRBuilder::lower_cleanup(size_t scope, size_t index, const SourceLocation& loc) {
+    BlockId next = landing_block(scope, index, loc);
+    Cleanup& cleanup = scopes_[scope].cleanups[index];
+
+    if (cleanup.kind == Cleanup::Kind::Drop) {
+        Terminator drop;
+        drop.kind = TerminatorKind::Drop;
+        drop.location = loc;
+        drop.place = Place(cleanup.local);
+        drop.target = next;
+        terminate(std::move(drop));
+        return;
+    }
+
+    // Lower the deferred code as if it stood at the `defer`: inner scopes and
+    // later shadowing bindings are hidden, and no enclosing loop is visible
+    ast::Expr* body = cleanup.body;
+    std::vector<ScopeFrame> inner(std::make_move_iterator(scopes_.begin() + scope + 1),
+                                  std::make_move_iterator(scopes_.end()));
+    scopes_.erase(scopes_.begin() + scope + 1, scopes_.end());
+    std::vector<LoopFrame> loops = std::move(loops_);
+    loops_.clear();
+    std::swap(scopes_[scope].bindings, scopes_[scope].cleanups[index].bindings);
+    defer_depth_++;
+
+    push_scope();
+    lower_into(std::nullopt, body);
+    pop_scope(body->location);
+    goto_block(next, loc);
+
+    defer_depth_--;
+    std::swap(scopes_[scope].bindings, scopes_[scope].cleanups[index].bindings);
+    loops_ = std::move(loops);
+    for (auto& frame : inner) scopes_.push_back(std::move(frame));
+}
+
+void MIRBuilder::finish_dispatch(ScopeFrame& scope, const SourceLocation& loc) {
+    if (!scope.dispatch) return;
+
+    BlockId saved = current_block_;
+    current_block_ = *scope.dispatch;
+    if (scope.exit_targets.size() == 1) {
+        // Only one destination: the selector is never read
+        for (auto it = scope.selector_writes.rbegin(); it != scope.selector_writes.rend(); ++it) {
+            auto& statements = func_->blocks[it->first].statements;
+            statements.erase(statements.begin() + static_cast<std::ptrdiff_t>(it->second));
+        }
+        goto_block(scope.exit_targets[0], loc);
+    } else {
+        Terminator term;
+        term.kind = TerminatorKind::SwitchInt;
+        term.location = loc;
+        term.discriminant = Operand::copy(Place(*scope.selector));
+        for (size_t i = 0; i < scope.exit_targets.size(); i++) {
+            if (i + 1 < scope.exit_targets.size()) term.values.push_back(static_cast<int64_t>(i));
+            term.targets.push_back(scope.exit_targets[i]);
+        }
+        terminate(std::move(term));
+    }
+    current_block_ = saved;
+}
+
+BlockId MIRBuilder::return_block(const SourceLocation& loc) {
+    if (!return_block_) {
+        return_block_ = func_->new_block();
+        Terminator ret;
+        ret.kind = TerminatorKind::Return;
+        ret.location = loc;
+        func_->blocks[*return_block_].terminator = std::move(ret);
+    }
+    return *return_block_;
+}
+
+LocalId MIRBuilder::declare_variable(const std::string& name, Type type, bool is_mutable,
+                                     const SourceLocation& loc) {
+    bool needs_drop = module_->needs_drop(type);
+    LocalId local = func_->new_local(std::move(type), name, is_mutable, loc);
+    push_storage(StatementKind::StorageLive, local, loc);
+
+    ScopeFrame& scope = scopes_.back();
+    scope.locals.push_back(local);
+    scope.cleanups.push_back({Cleanup::Kind::StorageDead, local});
+    if (needs_drop) {
+        scope.cleanups.push_back({Cleanup::Kind::Drop, local});
+        scope.drop_count++;
+    }
+    return local;
+}
+
+std::optional<LocalId> MIRBuilder::lookup(const std::string& name) const {
+    for (auto it = scopes_.rbegin(); it != scopes_.rend(); ++it) {
+        auto found = it->bindings.find(name);
+        if (found != it->bindings.end()) return found->second;
+    }
+    return std::nullopt;
+}
+
+// CFG construction
+
+void MIRBuilder::push_assign(Place place, Rvalue rvalue, const SourceLocation& loc) {
+    Statement stmt;
+    stmt.kind = StatementKind::Assign;
+    stmt.location = loc;
+    stmt.place = std::move(place);
+    stmt.rvalue = std::move(rvalue);
+    func_->blocks[current_block_].statements.push_back(std::move(stmt));
+}
+
+void MIRBuilder::push_storage(StatementKind kind, LocalId local, const SourceLocation& loc) {
+    Statement stmt;
+    stmt.kind = kind;
+    stmt.location = loc;
+    stmt.local = local;
+    func_->blocks[current_block_].statements.push_back(std::move(stmt));
+}
+
+void MIRBuilder::terminate(Terminator term) {
+    auto& block = func_->blocks[current_block_];
+    if (!block.terminator) {
+        block.terminator = std::move(term);
+    }
+}
+
+void MIRBuilder::goto_block(BlockId target, const SourceLocation& loc) {
+    Terminator term;
+    term.kind = TerminatorKind::Goto;
+    term.location = loc;
+    term.target = target;
+    terminate(std::move(term));
+}
+
+void MIRBuilder::switch_on_bool(Operand cond, BlockId if_true, BlockId if_false,
+                                const SourceLocation& loc) {
+    Terminator term;
+    term.kind = TerminatorKind::SwitchInt;
+    term.location = loc;
+    term.discriminant = std::move(cond);
+    term.values = {0};
+    term.targets = {if_false, if_true};
+    term.source_branch = true;
+    terminate(std::move(term));
+}
+
+void MIRBuilder::push_drop(Place place, const SourceLocation& loc) {
+    Terminator drop;
+    drop.kind = TerminatorKind::Drop;
+    drop.location = loc;
+    drop.place = std::move(place);
+    drop.target = func_->new_block();
+
+    BlockId next = drop.target;
+    terminate(std::move(drop));
+    current_block_ = next;
+}
+
+void MIRBuilder::start_dead_block() {
+    // Code following return/break/continue still gets lowered (it may contain
+    // errors worth reporting), but into a block with no predecessors.
+    current_block_ = func_->new_block();
+}
+
+LocalId MIRBuilder::new_temp(Type type) {
+    return func_->new_local(std::move(type));
+}
+
+// Type inference
+
+Type MIRBuilder::local_type(const std::string& name) const {
+    for (auto it = infer_scopes_.rbegin(); it != infer_scopes_.rend(); ++it) {
+        auto found = it->find(name);
+        if (found != it->end()) return found->second;
+    }
+    if (auto local = lookup(name)) {
+        return func_->locals[*local].type;
+    }
+    return Type::void_type();
+}
+
+Type MIRBuilder::infer_type(ast::Expr* expr, const Type* hint) {
+    if (!expr) return Type::void_type();
+
+    switch (expr->kind) {
+        case ast::ExprKind::Literal:
+            if (expr->literal_value) {
+                if (std::holds_alternative<bool>(*expr->literal_value)) {
+                    return Type::bool_type();
+                }
+                if (std::holds_alternative<double>(*expr->literal_value)) {
+                    if (hint && hint->kind == TypeKind::Float) return *hint;
+                    return Type::float_type(64);
+                }
+                if (std::holds_alternative<int64_t>(*expr->literal_value) ||
+                    std::holds_alternative<uint64_t>(*expr->literal_value)) {
+                    if (hint && (hint->is_integer() || hint->kind == TypeKind::Float)) return *hint;
+                    return Type::int_type(32, true);
+                }
+            }
+            return Type::void_type();
+
+        case ast::ExprKind::Identifier:
+            return expr->identifier ? local_type(*expr->identifier) : Type::void_type();
+
+        case ast::ExprKind::Binary: {
+            if (is_assign_op(expr->binary_op)) return Type::void_type();
+            auto op = to_bin_op(expr->binary_op);
+            if (!op || is_comparison(*op)) return Type::bool_type();   // &&, || and comparisons
+            if (expr->left && expr->left->kind == ast::ExprKind::Literal) {
+                return infer_type(expr->right.get(), hint);
+            }
+            return infer_type(expr->left.get(), hint);
+        }
+
+        case ast::ExprKind::Unary:
+            switch (expr->unary_op) {
+                case ast::UnaryOp::AddrOf:
+                case ast::UnaryOp::AddrOfMut:
+                    return Type::ref_type(infer_type(expr->operand.get()),
+                                          expr->unary_op == ast::UnaryOp::AddrOfMut);
+                case ast::UnaryOp::Deref: {
+                    Type inner = infer_type(expr->operand.get());
+                    return inner.pointee ? *inner.pointee : Type::void_type();
+                }
+                default:
+                    return infer_type(expr->operand.get(), hint);
+            }
+
+        case ast::ExprKind::Call:
+            if (expr->callee && expr->callee->identifier) {
+                auto it = functions_.find(*expr->callee->identifier);
+                if (it != functions_.end()) return it->second->return_type;
+            }
+            return Type::void_type();
+
+        case ast::ExprKind::FieldAccess: {
+            Type obj = infer_type(expr->object.get());
+            if (obj.kind == TypeKind::Ref || obj.kind == TypeKind::Ptr) {
+                obj = obj.pointee ? *obj.pointee : Type::void_type();
+            }
+            if (const StructDef* def = module_->find_struct(obj.struct_name)) {
+                if (auto idx = def->field_index(expr->field_name)) {
+                    return def->fields[*idx].second;
+                }
+            }
+            return Type::void_type();
+        }
+
+        case ast::ExprKind::Cast:
+            return lower_type(expr->target_type.get());
+
+        case ast::ExprKind::StructLiteral:
+            if (!expr->struct_path.empty() && module_->find_struct(expr->struct_path[0])) {
+                return Type::struct_type(expr->struct_path[0]);
+            }
+            return Type::void_type();
+
+        case ast::ExprKind::Block: {
+            if (!expr->block_expr) return Type::void_type();
+            infer_scopes_.emplace_back();
+            for (auto& stmt : expr->block_stmts) {
+                if (stmt->kind == ast::StmtKind::Let && stmt->let_pattern &&
+                    stmt->let_pattern->binding_name) {
+                    Type ty = stmt->let_type ? lower_type(stmt->let_type.get())
+                                             : infer_type(stmt->let_initializer.get());
+                    infer_scopes_.back()[*stmt->let_pattern->binding_name] = ty;
+                }
+            }
+            Type result = infer_type(expr->block_expr.get(), hint);
+            infer_scopes_.pop_back();
+            return result;
+        }
+
+        case ast::ExprKind::If: {
+            Type then_type = infer_type(expr->then_branch.get(), hint);
+            if (then_type.is_void() && expr->else_branch) {
+                return infer_type(expr->else_branch.get(), hint);
+            }
+            return then_type;
+        }
+
+        case ast::ExprKind::Match: {
+            Type scrutinee = infer_type(expr->match_expr.get());
+            for (auto& arm : expr->match_arms) {
+                infer_scopes_.emplace_back();
+                if (arm.pattern && arm.pattern->binding_name) {
+                    infer_scopes_.back()[*arm.pattern->binding_name] = scrutinee;
+                }
+                Type arm_type = infer_type(arm.body.get(), hint);
+                infer_scopes_.pop_back();
+                if (!arm_type.is_void()) return arm_type;
+            }
+            return Type::void_type();
+        }
+
+        default:
+            // Return, While, For, Break, Continue, unit tuples
+            return Type::void_type();
+    }
+}
+
+// Lowering
+
+void MIRBuilder::lower_stmt(ast::Stmt* stmt) {
+    if (!stmt) return;
+
+    switch (stmt->kind) {
+        case ast::StmtKind::Let: {
+            if (!stmt->let_pattern) return;
+
+            if (stmt->let_pattern->kind == ast::PatternKind::Wildcard) {
+                lower_into(std::nullopt, stmt->let_initializer.get());
+                return;
+            }
+            if (stmt->let_pattern->kind != ast::PatternKind::Identifier ||
+                !stmt->let_pattern->binding_name) {
+                error(stmt->location, "Unsupported pattern in let statement");
+                return;
+            }
+
+            Type type = stmt->let_type ? lower_type(stmt->let_type.get())
+                                       : infer_type(stmt->let_initializer.get());
+            const std::string& name = *stmt->let_pattern->binding_name;
+            LocalId local = declare_variable(name, type, stmt->let_pattern->is_mutable, stmt->location);
+
+            // The binding only comes into scope after its initializer (shadowing)
+            if (stmt->let_initializer) {
+                Type value_type = infer_type(stmt->let_initializer.get(), &type);
+                if (stmt->let_type && !value_type.is_void() && !is_assignable(type, value_type)) {
+                    error(stmt->location, "Cannot initialize '" + name + "' of type " + type.to_string() +
+                                              " with " + value_type.to_string());
+                }
+                lower_into(Place(local), stmt->let_initializer.get(), &type);
+            }
+            scopes_.back().bindings[name] = local;
+            break;
+        }
+        case ast::StmtKind::Expr: {
+            // A discarded value with a destructor is dropped right away
+            Type type = infer_type(stmt->expr.get());
+            if (module_->needs_drop(type)) {
+                LocalId tmp = new_temp(type);
+                lower_into(Place(tmp), stmt->expr.get(), &type);
+                push_drop(Place(tmp), stmt->location);
+            } else {
+                lower_into(std::nullopt, stmt->expr.get());
+            }
+            break;
+        }
+        case ast::StmtKind::Item:
+            // TODO: Nested items
+            break;
+        case ast::StmtKind::Defer: {
+            if (!stmt->defer_body) break;
+            ScopeFrame& scope = scopes_.back();
+            scope.cleanups.emplace_back(stmt->defer_body.get(), scope.bindings);
+            scope.drop_count++;
+            break;
+        }
+    }
+}
+
+Operand MIRBuilder::use_place(const Place& place) {
+    Type ty = module_->place_type(*func_, place);
+    if (ty.kind == TypeKind::Struct) {
+        return Operand::move(place);
+    }
+    return Operand::copy(place);
+}
+
+// A field of an rvalue lives in a temporary. With `temporaries`, those that
+// need dropping are added to it for the caller to drop once it has read the
+// field; otherwise (borrows, assignment targets) they are dropped when the
+// enclosing scope ends.
+std::optional<Place> MIRBuilder::lower_place(ast::Expr* expr, std::vector<LocalId>* temporaries) {
+    if (!expr) return std::nullopt;
+
+    switch (expr->kind) {
+        case ast::ExprKind::Identifier:
+            if (expr->identifier) {
+                if (auto local = lookup(*expr->identifier)) return Place(*local);
+            }
+            return std::nullopt;
+
+        case ast::ExprKind::FieldAccess: {
+            std::optional<Place> base = lower_place(expr->object.get(), temporaries);
+            if (!base) {
+                // Field of an rvalue: materialize the object first
+                Type obj_type = infer_type(expr->object.get());
+                LocalId tmp = new_temp(obj_type);
+                lower_into(Place(tmp), expr->object.get(), &obj_type);
+                base = Place(tmp);
+                if (module_->needs_drop(obj_type)) {
+                    if (temporaries) {
+                        temporaries->push_back(tmp);
+                    } else {
+                        scopes_.back().cleanups.emplace_back(Cleanup::Kind::Drop, tmp);
+                        scopes_.back().drop_count++;
+                    }
+                }
+            }
+            Type base_type = module_->place_type(*func_, *base);
+            if (base_type.kind == TypeKind::Ref || base_type.kind == TypeKind::Ptr) {
+                base = base->deref();
+                base_type = base_type.pointee ? *base_type.pointee : Type::void_type();
+            }
+            const StructDef* def = module_->find_struct(base_type.struct_name);
+            if (!def) {
+                error(expr->location, "Field access on non-struct value");
+                return std::nullopt;
+            }
+            auto idx = def->field_index(expr->field_name);
+            if (!idx) {
+                error(expr->location, "No field '" + expr->field_name + "' in struct '" + def->name + "'");
+                return std::nullopt;
+            }
+            return base->field(*idx);
+        }
+
+        case ast::ExprKind::Unary:
+            if (expr->unary_op == ast::UnaryOp::Deref) {
+                Operand ptr = lower_operand(expr->operand.get());
+                if (ptr.is_place()) return ptr.place.deref();
+                LocalId tmp = new_temp(ptr.constant.type);
+                push_assign(Place(tmp), Rvalue::use(ptr), expr->location);
+                return Place(tmp).deref();
+            }
+            return std::nullopt;
+
+        default:
+            return std::nullopt;
+    }
+}
+
+Operand MIRBuilder::lower_operand(ast::Expr* expr, const Type* hint) {
+    if (!expr) return Operand::constant_int(Type::int_type(32, true), 0);
+
+    if (expr->kind == ast::ExprKind::Literal && expr->literal_value) {
+        Type ty = infer_type(expr, hint);
+        const auto& value = *expr->literal_value;
+        if (std::holds_alternative<bool>(value)) return Operand::constant_bool(std::get<bool>(value));
+        if (std::holds_alternative<double>(value)) return Operand::constant_float(ty, std::get<double>(value));
+        if (std::holds_alternative<int64_t>(value)) {
+            if (ty.kind == TypeKind::Float) {
+                return Operand::constant_float(ty, static_cast<double>(std::get<int64_t>(value)));
+            }
+            return Operand::constant_int(ty, std::get<int64_t>(value));
+        }
+        if (std::holds_alternative<uint64_t>(value)) {
+            return Operand::constant_int(ty, static_cast<int64_t>(std::get<uint64_t>(value)));
+        }
+        error(expr->location, "Unsupported literal");
+        return Operand::constant_int(Type::int_type(32, true), 0);
+    }
+
+    if (expr->kind == ast::ExprKind::Identifier ||
+        expr->kind == ast::ExprKind::FieldAccess ||
+        (expr->kind == ast::ExprKind::Unary && expr->unary_op == ast::UnaryOp::Deref)) {
+        std::vector<LocalId> temporaries;
+        if (auto place = lower_place(expr, &temporaries)) {
+            if (temporaries.empty()) return use_place(*place);
+            // Copy the field out before the object it was read from is dropped
+            LocalId value = new_temp(module_->place_type(*func_, *place));
+            push_assign(Place(value), Rvalue::use(use_place(*place)), expr->location);
+            for (auto it = temporaries.rbegin(); it != temporaries.rend(); ++it) {
+                push_drop(Place(*it), expr->location);
+            }
+            return Operand::move(Place(value));
+        }
+        if (expr->kind == ast::ExprKind::Identifier) {
+            error(expr->location, "Undefined variable '" + expr->identifier.value_or("?") + "'");
+            return Operand::constant_int(Type::int_type(32, true), 0);
+        }
+    }
+
+    LocalId tmp = new_temp(infer_type(expr, hint));
+    lower_into(Place(tmp), expr, hint);
+    return Operand::move(Place(tmp));
+}
+
+void MIRBuilder::lower_into(const std::optional<Place>& dest, ast::Expr* expr, const Type* hint) {
+    if (!expr) return;
+
+    switch (expr->kind) {
+        case ast::ExprKind::Literal:
+        case ast::ExprKind::Identifier:
+        case ast::ExprKind::FieldAccess: {
+            Operand value = lower_operand(expr, hint);
+            if (dest) push_assign(*dest, Rvalue::use(std::move(value)), expr->location);
+            break;
+        }
+
+        case ast::ExprKind::Binary:
+            if (expr->binary_op == ast::BinaryOp::And || expr->binary_op == ast::BinaryOp::Or) {
+                lower_logical(dest, expr);
+            } else {
+                lower_binary(dest, expr, hint);
+            }
+            break;
+
+        case ast::ExprKind::Unary: {
+            switch (expr->unary_op) {
+                case ast::UnaryOp::AddrOf:
+                case ast::UnaryOp::AddrOfMut: {
+                    std::optional<Place> place = lower_place(expr->operand.get());
+                    if (!place) {
+                        // Borrow of a temporary
+                        Type ty = infer_type(expr->operand.get());
+                        LocalId tmp = new_temp(ty);
+                        lower_into(Place(tmp), expr->operand.get(), &ty);
+                        place = Place(tmp);
+                    }
+                    if (dest) {
+                        push_assign(*dest, Rvalue::ref(*place, expr->unary_op == ast::UnaryOp::AddrOfMut),
+                                    expr->location);
+                    }
+                    break;
+                }
+                case ast::UnaryOp::Deref: {
+                    Operand value = lower_operand(expr, hint);
+                    if (dest) push_assign(*dest, Rvalue::use(std::move(value)), expr->location);
+                    break;
+                }
+                default: {
+                    Operand operand = lower_operand(expr->operand.get(), hint);
+                    if (dest) {
+                        UnOp op = expr->unary_op == ast::UnaryOp::Neg ? UnOp::Neg : UnOp::Not;
+                        push_assign(*dest, Rvalue::unary(op, std::move(operand)), expr->location);
+                    }
+                    break;
+                }
+            }
+            break;
+        }
+
+        case ast::ExprKind::Call:
+            lower_call(dest, expr);
+            break;
+
+        case ast::ExprKind::Cast: {
+            Operand value = lower_operand(expr->cast_expr.get());
+            Type target = lower_type(expr->target_type.get());
+            Type source = module_->operand_type(*func_, value);
+            if (!source.is_void() && !target.is_void() && !is_valid_cast(source, target)) {
+                error(expr->location, "Invalid cast from " + source.to_string() + " to " + target.to_string());
+                break;
+            }
+            if (dest) push_assign(*dest, Rvalue::cast(std::move(value), target), expr->location);
+            break;
+        }
+
+        case ast::ExprKind::StructLiteral: {
+            const StructDef* def = expr->struct_path.empty() ? nullptr
+                                                             : module_->find_struct(expr->struct_path[0]);
+            if (!def) {
+                error(expr->location, "Unknown struct '" +
+                      (expr->struct_path.empty() ? std::string("?") : expr->struct_path[0]) + "'");
+                break;
+            }
+            std::vector<std::optional<Operand>> values(def->fields.size());
+            for (auto& init : expr->fields) {
+                auto idx = def->field_index(init.name);
+                if (!idx) {
+                    error(init.location, "No field '" + init.name + "' in struct '" + def->name + "'");
+                    continue;
+                }
+                values[*idx] = lower_operand(init.value.get(), &def->fields[*idx].second);
+            }
+            std::vector<Operand> operands;
+            for (size_t i = 0; i < values.size(); i++) {
+                if (!values[i]) {
+                    error(expr->location, "Missing field '" + def->fields[i].first +
+                          "' in initializer of '" + def->name + "'");
+                    return;
+                }
+                operands.push_back(std::move(*values[i]));
+            }
+            if (dest) {
+                push_assign(*dest, Rvalue::aggregate(Type::struct_type(def->name), std::move(operands)),
+                            expr->location);
+            }
+            break;
+        }
+
+        case ast::ExprKind::Block:
+            push_scope();
+            for (auto& stmt : expr->block_stmts) {
+                lower_stmt(stmt.get());
+            }
+            if (expr->block_expr) {
+                lower_into(dest, expr->block_expr.get(), hint);
+            }
+            pop_scope(expr->location);
+            break;
+
+        case ast::ExprKind::If:
+            lower_if(dest, expr, hint);
+            break;
+
+        case ast::ExprKind::Match:
+            lower_match(dest, expr, hint);
+            break;
+
+        case ast::ExprKind::While:
+            lower_while(expr);
+            break;
+
+        case ast::ExprKind::For:
+            lower_for(expr);
+            break;
+
+        case ast::ExprKind::Return: {
+            if (expr->return_value) {
+                if (func_->return_type.is_void()) {
+                    lower_into(std::nullopt, expr->return_value.get());
+                } else {
+                    lower_into(Place(RETURN_LOCAL), expr->return_value.get(), &func_->return_type);
+                }
+            }
+            if (needs_cleanup(0)) {
+                exit_to(0, return_block(expr->location), expr->location);
+            } else {
+                exit_scopes(0, expr->location);
+                Terminator ret;
+                ret.kind = TerminatorKind::Return;
+                ret.location = expr->location;
+                terminate(std::move(ret));
+            }
+            start_dead_block();
+            break;
+        }
+
+        case ast::ExprKind::Break:
+        case ast::ExprKind::Continue: {
+            bool is_break = expr->kind == ast::ExprKind::Break;
+            if (loops_.empty()) {
+                error(expr->location, std::string("'") + (is_break ? "break" : "continue") +
+                      (defer_depth_ > 0 ? "' cannot leave a 'defer' block" : "' outside of a loop"));
+                break;
+            }
+            const LoopFrame loop = loops_.back();
+            exit_to(loop.scope_depth, is_break ? loop.break_block : loop.continue_block, expr->location);
+            start_dead_block();
+            break;
+        }
+
+        case ast::ExprKind::Tuple:
+            if (!expr->tuple_elements.empty()) {
+                error(expr->location, "Tuple expressions are not supported yet");
+            }
+            break;
+
+        case ast::ExprKind::Index:
+            error(expr->location, "Index expressions are not supported yet");
+            break;
+
+        case ast::ExprKind::ArrayLiteral:
+            error(expr->location, "Array literals are not supported yet");
+            break;
+
+        case ast::ExprKind::Range:
+            error(expr->location, "Range expressions are only supported as for-loop iterators");
+            break;
+    }
+}
+
+void MIRBuilder::lower_binary(const std::optional<Place>& dest, ast::Expr* expr, const Type* hint) {
+    if (is_assign_op(expr->binary_op)) {
+        std::optional<Place> place = lower_place(expr->left.get());
+        if (!place) {
+            error(expr->location, "Invalid assignment target");
+            return;
+        }
+        Type place_type = module_->place_type(*func_, *place);
+        Operand value = lower_operand(expr->right.get(), &place_type);
+        Type value_type = module_->operand_type(*func_, value);
+        if (!value_type.is_void() && !is_assignable(place_type, value_type)) {
+            error(expr->location, "Cannot assign " + value_type.to_string() + " to " + place_type.to_string());
+            return;
+        }
+        if (expr->binary_op == ast::BinaryOp::Assign) {
+            // The old value is dropped once the new one has been computed
+            if (module_->needs_drop(place_type)) push_drop(*place, expr->location);
+            push_assign(*place, Rvalue::use(std::move(value)), expr->location);
+        } else {
+            if (!is_valid_operand(*to_bin_op(expr->binary_op), place_type)) {
+                error(expr->location, "Invalid operand type " + place_type.to_string() + " for compound assignment");
+                return;
+            }
+            push_assign(*place, Rvalue::binary(*to_bin_op(expr->binary_op), Operand::copy(*place),
+                                               std::move(value)), expr->location);
+        }
+        return;
+    }
+
+    auto op = to_bin_op(expr->binary_op);
+    if (!op) {
+        error(expr->location, "Unsupported binary operator");
+        return;
+    }
+
+    // Operands share one type; literals adopt the type of the other side
+    const Type* operand_hint = is_comparison(*op) ? nullptr : hint;
+    Type operand_type = infer_type(expr, operand_hint);
+    if (is_comparison(*op)) {
+        operand_type = (expr->left && expr->left->kind == ast::ExprKind::Literal)
+                           ? infer_type(expr->right.get())
+                           : infer_type(expr->left.get());
+    }
+    Operand lhs = lower_operand(expr->left.get(), &operand_type);
+    Operand rhs = lower_operand(expr->right.get(), &operand_type);
+    Type lhs_type = module_->operand_type(*func_, lhs);
+    Type rhs_type = module_->operand_type(*func_, rhs);
+    if (!lhs_type.is_void() && !rhs_type.is_void() &&
+        (lhs_type != rhs_type || !is_valid_operand(*op, lhs_type))) {
+        std::string types = lhs_type == rhs_type ? "type " + lhs_type.to_string()
+                                                 : "types " + lhs_type.to_string() + " and " + rhs_type.to_string();
+        error(expr->location, "Invalid operand " + types + " for binary operator");
+        return;
+    }
+    if (dest) {
+        push_assign(*dest, Rvalue::binary(*op, std::move(lhs), std::move(rhs)), expr->location);
+    }
+}
+
+void MIRBuilder::lower_logical(const std::optional<Place>& dest, ast::Expr* expr) {
+    // Short-circuit: `a && b` only evaluates b when a is true, `a || b` when a is false
+    bool is_and = expr->binary_op == ast::BinaryOp::And;
+    Type bool_type = Type::bool_type();
+    Operand lhs = lower_operand(expr->left.get(), &bool_type);
+
+    BlockId rhs_bb = func_->new_block();
+    BlockId short_bb = func_->new_block();
+    BlockId join_bb = func_->new_block();
+
+    if (is_and) {
+        switch_on_bool(std::move(lhs), rhs_bb, short_bb, expr->location);
+    } else {
+        switch_on_bool(std::move(lhs), short_bb, rhs_bb, expr->location);
+    }
+
+    current_block_ = short_bb;
+    if (dest) push_assign(*dest, Rvalue::use(Operand::constant_bool(!is_and)), expr->location);
+    goto_block(join_bb, expr->location);
+
+    current_block_ = rhs_bb;
+    lower_into(dest, expr->right.get(), &bool_type);
+    goto_block(join_bb, expr->location);
+
+    current_block_ = join_bb;
+}
+
+void MIRBuilder::lower_call(const std::optional<Place>& dest, ast::Expr* expr) {
+    if (!expr->callee || expr->callee->kind != ast::ExprKind::Identifier || !expr->callee->identifier) {
+        error(expr->location, "Only direct calls to named functions are supported");
+        return;
+    }
+
+    const std::string& name = *expr->callee->identifier;
+    auto it = functions_.find(name);
+    if (it == functions_.end()) {
+        error(expr->location, "Call to undefined function '" + name + "'");
+        return;
+    }
+    Function* callee = it->second;
+    if (callee->arg_count != expr->arguments.size()) {
+        error(expr->location, "Function '" + name + "' expects " + std::to_string(callee->arg_count) +
+              " arguments, got " + std::to_string(expr->arguments.size()));
+        return;
+    }
+
+    Terminator call;
+    call.kind = TerminatorKind::Call;
+    call.location = expr->location;
+    call.callee = name;
+    for (size_t i = 0; i < expr->arguments.size(); i++) {
+        const Type& param_type = callee->locals[i + 1].type;
+        call.args.push_back(lower_operand(expr->arguments[i].get(), &param_type));
+    }
+    call.destination = dest ? *dest : Place(new_temp(callee->return_type));
+    call.target = func_->new_block();
+
+    BlockId next = call.target;
+    terminate(std::move(call));
+    current_block_ = next;
+}
+
+void MIRBuilder::lower_if(const std::optional<Place>& dest, ast::Expr* expr, const Type* hint) {
+    Type bool_type = Type::bool_type();
+    Operand cond = lower_operand(expr->condition.get(), &bool_type);
+
+    BlockId then_bb = func_->new_block();
+    BlockId else_bb = func_->new_block();
+    BlockId join_bb = func_->new_block();
+    switch_on_bool(std::move(cond), then_bb, else_bb, expr->location);
+
+    current_block_ = then_bb;
+    lower_into(dest, expr->then_branch.get(), hint);
+    goto_block(join_bb, expr->location);
+
+    current_block_ = else_bb;
+    if (expr->else_branch) {
+        lower_into(dest, expr->else_branch.get(), hint);
+    }
+    goto_block(join_bb, expr->location);
+
+    current_block_ = join_bb;
+}
+
+void MIRBuilder::lower_match(const std::optional<Place>& dest, ast::Expr* expr, const Type* hint) {
+    Type scrutinee_type = infer_type(expr->match_expr.get());
+    LocalId scrutinee = new_temp(scrutinee_type);
+    lower_into(Place(scrutinee), expr->match_expr.get(), &scrutinee_type);
+
+    BlockId join_bb = func_->new_block();
+
+    // Consecutive literal arms share one SwitchInt; an irrefutable arm
+    // (wildcard or binding) ends the chain.
+    Terminator pending;
+    pending.kind = TerminatorKind::SwitchInt;
+    pending.location = expr->location;
+    pending.discriminant = Operand::copy(Place(scrutinee));
+    pending.source_branch = true;
+
+    auto flush_switch = [&](BlockId otherwise) {
+        if (pending.values.empty()) {
+            goto_block(otherwise, expr->location);
+        } else {
+            pending.targets.push_back(otherwise);
+            terminate(pending);
+        }
+        pending.values.clear();
+        pending.targets.clear();
+    };
+
+    BlockId test_bb = current_block_;
+    bool exhaustive = false;
+
+    for (auto& arm : expr->match_arms) {
+        if (!arm.pattern) continue;
+        BlockId arm_bb = func_->new_block();
+
+        switch (arm.pattern->kind) {
+            case ast::PatternKind::Literal: {
+                if (!arm.pattern->literal_value) break;
+                const auto& lit = *arm.pattern->literal_value;
+                int64_t value;
+                if (std::holds_alternative<int64_t>(lit)) {
+                    value = std::get<int64_t>(lit);
+                } else if (std::holds_alternative<uint64_t>(lit)) {
+                    value = static_cast<int64_t>(std::get<uint64_t>(lit));
+                } else if (std::holds_alternative<bool>(lit)) {
+                    value = std::get<bool>(lit) ? 1 : 0;
+                } else {
+                    error(arm.pattern->location, "Only integer and boolean literal patterns are supported");
+                    break;
+                }
+                bool duplicate = false;
+                for (int64_t v : pending.values) duplicate |= (v == value);
+                if (!duplicate) {
+                    pending.values.push_back(value);
+                    pending.targets.push_back(arm_bb);
+                }
+                break;
+            }
+            case ast::PatternKind::Wildcard:
+            case ast::PatternKind::Identifier:
+                current_block_ = test_bb;
+                flush_switch(arm_bb);
+                exhaustive = true;
+                break;
+            default:
+                error(arm.pattern->location, "Unsupported pattern in match arm");
+                break;
+        }
+
+        current_block_ = arm_bb;
+        push_scope();
+        if (arm.pattern->kind == ast::PatternKind::Identifier && arm.pattern->binding_name) {
+            LocalId binding = declare_variable(*arm.pattern->binding_name, scrutinee_type,
+                                               arm.pattern->is_mutable, arm.pattern->location);
+            push_assign(Place(binding), Rvalue::use(use_place(Place(scrutinee))), arm.pattern->location);
+            scopes_.back().bindings[*arm.pattern->binding_name] = binding;
+        }
+        lower_into(dest, arm.body.get(), hint);
+        pop_scope(arm.location);
+        goto_block(join_bb, arm.location);
+
+        if (exhaustive) break;   // Later arms are unreachable
+    }
+
+    if (!exhaustive) {
+        // `true` and `false` arms together cover a bool
+        BlockId otherwise = join_bb;
+        if (scrutinee_type.kind == TypeKind::Bool && pending.values.size() == 2) {
+            otherwise = pending.targets.back();
+            pending.values.pop_back();
+            pending.targets.pop_back();
+        }
+        current_block_ = test_bb;
+        flush_switch(otherwise);
+    }
+
+    current_block_ = join_bb;
+}
+
+void MIRBuilder::lower_while(ast::Expr* expr) {
+    BlockId header_bb = func_->new_block();
+    BlockId body_bb = func_->new_block();
+    BlockId exit_bb = func_->new_block();
+
+    goto_block(header_bb, expr->location);
+
+    current_block_ = header_bb;
+    Type bool_type = Type::bool_type();
+    Operand cond = lower_operand(expr->while_condition.get(), &bool_type);
+    switch_on_bool(std::move(cond), body_bb, exit_bb, expr->location);
+
+    current_block_ = body_bb;
+    loops_.push_back({header_bb, exit_bb, scopes_.size()});
+    lower_into(std::nullopt, expr->while_body.get());
+    loops_.pop_back();
+    goto_block(header_bb, expr->location);
+
+    current_block_ = exit_bb;
+}
+
+void MIRBuilder::lower_for(ast::Expr* expr) {
+    ast::Expr* range = expr->for_iterator.get();
+    if (!range || range->kind != ast::ExprKind::Range) {
+        error(expr->location, "For loops only support range iterators");
+        return;
+    }
+
+    // for i in start..end { body }  =>
+    //     i = start; end_tmp = end;
+    //   header: if i < end_tmp goto body else exit
+    //   body:   ...; goto step
+    //   step:   i = i + 1; goto header
+    Type counter_type = (range->range_start && range->range_start->kind == ast::ExprKind::Literal)
+                            ? infer_type(range->range_end.get())
+                            : infer_type(range->range_start.get());
+    if (!counter_type.is_integer()) counter_type = Type::int_type(32, true);
+
+    Operand start = lower_operand(range->range_start.get(), &counter_type);
+    Operand end = lower_operand(range->range_end.get(), &counter_type);
+    if (end.is_place()) {
+        LocalId end_tmp = new_temp(counter_type);
+        push_assign(Place(end_tmp), Rvalue::use(end), range->location);
+        end = Operand::copy(Place(end_tmp));
+    }
+
+    push_scope();
+    std::string name = (expr->for_pattern && expr->for_pattern->binding_name)
+                           ? *expr->for_pattern->binding_name : "";
+    // Immutable in the source, but the step block reassigns it
+    LocalId counter = declare_variable(name, counter_type, true, expr->location);
+    push_assign(Place(counter), Rvalue::use(start), expr->location);
+    if (!name.empty()) scopes_.back().bindings[name] = counter;
+
+    BlockId header_bb = func_->new_block();
+    BlockId body_bb = func_->new_block();
+    BlockId step_bb = func_->new_block();
+    BlockId exit_bb = func_->new_block();
+
+    goto_block(header_bb, expr->location);
+
+    current_block_ = header_bb;
+    LocalId cond = new_temp(Type::bool_type());
+    push_assign(Place(cond), Rvalue::binary(range->is_inclusive ? BinOp::Le : BinOp::Lt,
+                                            Operand::copy(Place(counter)), end), expr->location);
+    switch_on_bool(Operand::move(Place(cond)), body_bb, exit_bb, expr->location);
+
+    current_block_ = body_bb;
+    loops_.push_back({step_bb, exit_bb, scopes_.size()});
+    lower_into(std::nullopt, expr->for_body.get());
+    loops_.pop_back();
+    goto_block(step_bb, expr->location);
+
+    current_block_ = step_bb;
+    push_assign(Place(counter), Rvalue::binary(BinOp::Add, Operand::copy(Place(counter)),
+                                               Operand::constant_int(counter_type, 1)), expr->location);
+    goto_block(header_bb, expr->location);
+
+    current_block_ = exit_bb;
+    pop_scope(expr->location);
+}
+
+} // namespace apex::mir
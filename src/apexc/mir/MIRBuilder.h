@@ -0,0 +1,124 @@
+#pragma once
+
+#include "MIR.h"
+#include "../ast/AST.h"
+#include <memory>
+#include <optional>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace apex::mir {
+
+// Lowers the (semantically checked) AST into MIR. Expressions are flattened
+// into three-address assignments over typed locals, and all structured
+// control flow (if/match/loops/short-circuit operators) becomes explicit
+// basic blocks and terminators.
+class MIRBuilder {
+public:
+    MIRBuilder();
+
+    std::unique_ptr<Module> build(ast::Module* module);
+
+    const std::vector<std::string>& get_errors() const { return errors_; }
+    bool has_errors() const { return !errors_.empty(); }
+
+private:
+    // Work done when control leaves a scope, in registration order (run in reverse)
+    struct Cleanup {
+        enum class Kind { StorageDead, Drop, Defer } kind;
+        LocalId local{0};
+        ast::Expr* body{nullptr};                              // Defer
+        std::unordered_map<std::string, LocalId> bindings;     // Defer: names visible at the `defer`
+
+        Cleanup(Kind kind, LocalId local) : kind(kind), local(local) {}
+        Cleanup(ast::Expr* body, std::unordered_map<std::string, LocalId> bindings)
+            : kind(Kind::Defer), body(body), bindings(std::move(bindings)) {}
+    };
+
+    struct ScopeFrame {
+        std::unordered_map<std::string, LocalId> bindings;
+        std::vector<LocalId> locals;   // Declaration order, for StorageDead
+        std::vector<Cleanup> cleanups;
+        size_t drop_count{0};          // Drop and Defer cleanups
+
+        // Exits from scopes with drops or defers share one landing chain:
+        // landing[k] runs cleanups k-1..0 and ends in the dispatch block,
+        // which switches on the selector to wherever the exit was headed.
+        std::unordered_map<size_t, BlockId> landing;
+        std::optional<BlockId> dispatch;
+        std::vector<BlockId> exit_targets;
+        std::optional<LocalId> selector;
+        std::vector<std::pair<BlockId, size_t>> selector_writes;
+    };
+
+    struct LoopFrame {
+        BlockId continue_block;
+        BlockId break_block;
+        size_t scope_depth;
+    };
+
+    Module* module_{nullptr};
+    Function* func_{nullptr};
+    BlockId current_block_{ENTRY_BLOCK};
+    std::optional<BlockId> return_block_;
+    unsigned defer_depth_{0};
+    std::vector<ScopeFrame> scopes_;
+    std::vector<LoopFrame> loops_;
+    std::vector<std::unordered_map<std::string, Type>> infer_scopes_;
+    std::unordered_map<std::string, Function*> functions_;
+    std::vector<std::string> errors_;
+
+    void error(const SourceLocation& loc, const std::string& message);
+
+    // Declarations
+    Type lower_type(ast::Type* type);
+    void declare_function(ast::Item* item);
+    void lower_function(ast::Item* item);
+
+    // Scopes
+    void push_scope();
+    void pop_scope(const SourceLocation& loc);
+    void exit_scopes(size_t depth, const SourceLocation& loc);
+    bool needs_cleanup(size_t depth) const;
+    void exit_to(size_t depth, BlockId target, const SourceLocation& loc);
+    BlockId landing_block(size_t scope, size_t count, const SourceLocation& loc);
+    BlockId dispatch_block(size_t scope);
+    void lower_cleanup(size_t scope, size_t index, const SourceLocation& loc);
+    void finish_dispatch(ScopeFrame& scope, const SourceLocation& loc);
+    BlockId return_block(const SourceLocation& loc);
+    LocalId declare_variable(const std::string& name, Type type, bool is_mutable,
+                             const SourceLocation& loc);
+    std::optional<LocalId> lookup(const std::string& name) const;
+
+    // CFG construction
+    void push_assign(Place place, Rvalue rvalue, const SourceLocation& loc);
+    void push_storage(StatementKind kind, LocalId local, const SourceLocation& loc);
+    void terminate(Terminator term);
+    void goto_block(BlockId target, const SourceLocation& loc);
+    void switch_on_bool(Operand cond, BlockId if_true, BlockId if_false, const SourceLocation& loc);
+    void push_drop(Place place, const SourceLocation& loc);
+    void start_dead_block();
+    LocalId new_temp(Type type);
+
+    // Type inference
+    Type infer_type(ast::Expr* expr, const Type* hint = nullptr);
+    Type local_type(const std::string& name) const;
+
+    // Lowering
+    void lower_stmt(ast::Stmt* stmt);
+    void lower_into(const std::optional<Place>& dest, ast::Expr* expr, const Type* hint = nullptr);
+    Operand lower_operand(ast::Expr* expr, const Type* hint = nullptr);
+    std::optional<Place> lower_place(ast::Expr* expr, std::vector<LocalId>* temporaries = nullptr);
+    Operand use_place(const Place& place);
+
+    void lower_binary(const std::optional<Place>& dest, ast::Expr* expr, const Type* hint);
+    void lower_logical(const std::optional<Place>& dest, ast::Expr* expr);
+    void lower_call(const std::optional<Place>& dest, ast::Expr* expr);
+    void lower_if(const std::optional<Place>& dest, ast::Expr* expr, const Type* hint);
+    void lower_match(const std::optional<Place>& dest, ast::Expr* expr, const Type* hint);
+    void lower_while(ast::Expr* expr);
+    void lower_for(ast::Expr* expr);
+};
+
+} // namespace apex::mir
@@ -0,0 +1,55 @@
+#include "Passes.h"
+#include "../support/TimeTrace.h"
+
+namespace apex::mir {
+
+static bool run_scalar_passes(const Module& module, Function& func) {
+    bool changed = propagate_constants(module, func);
+    changed |= simplify_cfg(func);
+    changed |= propagate_copies(func);
+    changed |= eliminate_dead_stores(module, func);
+    changed |= remove_unused_locals(func);
+    changed |= simplify_cfg(func);
+    return changed;
+}
+
+void optimize_module(Module& module, unsigned opt_level) {
+    // One round is enough to clean up what MIR construction leaves behind;
+    // optimized builds iterate since each pass exposes work for the others.
+    unsigned max_rounds = opt_level == 0 ? 1 : 4;
+    auto run_rounds = [&](Function& func) {
+        for (unsigned round = 0; round < max_rounds; round++) {
+            if (!run_scalar_passes(module, func)) break;
+        }
+    };
+
+    // Nothing reachable only from dead code is worth optimizing
+    remove_unreachable_functions(module);
+
+    // Bottom-up over the call graph so callees are already simplified (and
+    // have had their own calls inlined) by the time their cost is measured
+    CallGraph graph = CallGraph::build(module);
+    for (const auto& scc : graph.sccs) {
+        for (size_t node : scc) {
+            Function& func = *graph.nodes[node];
+            if (func.is_extern || func.blocks.empty()) continue;
+            APEX_TIME_SCOPE_DETAIL("optimize_function", func.name);
+
+            simplify_cfg(func);
+            run_rounds(func);
+            bool changed = inline_calls(graph, node, opt_level);
+            if (opt_level > 0) changed |= promote_heap_allocations(module, func);
+            if (changed) {
+                simplify_cfg(func);
+                run_rounds(func);
+            }
+            if (analyze_ranges(module, func)) run_rounds(func);
+        }
+        infer_effects(module, graph, scc);
+    }
+
+    // Fully inlined private functions have no callers left
+    remove_unreachable_functions(module);
+}
+
+} // namespace apex::mir
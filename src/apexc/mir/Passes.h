@@ -0,0 +1,69 @@
+#pragma once
+
+#include "CallGraph.h"
+#include "MIR.h"
+
+namespace apex::mir {
+
+// MIR-to-MIR transformations. Each pass returns true if it changed the
+// function. They only rely on facts visible in MIR, are linear or close to
+// it in the size of the function, and run at every optimization level so
+// LLVM receives less IR even in debug builds.
+
+// Folds constant branches, threads jumps through empty blocks, merges
+// straight-line block chains and removes unreachable blocks.
+bool simplify_cfg(Function& func);
+
+// Sparse conditional constant propagation: tracks constant values of
+// non-borrowed scalar locals along executable edges only, folds
+// rvalues and replaces constant branches with gotos.
+bool propagate_constants(const Module& module, Function& func);
+
+// Replaces reads of `a` after `a = copy b` with reads of `b` while both
+// are unchanged, and forwards single-use temporaries into the statement
+// that moves them out (`_t = Add(x, 1); y = move _t` => `y = Add(x, 1)`).
+bool propagate_copies(Function& func);
+
+// Removes assignments to non-borrowed locals that are never read again,
+// and calls whose result is unused when the callee is known to have no
+// side effects (no memory writes, always returns, never unwinds).
+bool eliminate_dead_stores(const Module& module, Function& func);
+
+// Drops locals that are no longer mentioned and renumbers the rest.
+bool remove_unused_locals(Function& func);
+
+// Inlines direct calls from `caller` whose callee body fits the cost
+// threshold for `opt_level` (scaled up by #[inline]). #[inline(always)]
+// callees are inlined at every level, #[noinline] ones never, and calls
+// within one call-graph SCC are left alone so recursion can't expand.
+bool inline_calls(const CallGraph& graph, size_t caller, unsigned opt_level);
+
+// Whether calls to `func` would be inlined at `opt_level` by the cost model
+// alone (ignoring the caller's size and constant arguments). Picks the
+// bodies a module exports in its .apxmod for other modules to inline.
+bool is_inline_candidate(const Function& func, unsigned opt_level);
+
+// Escape analysis: rewrites `malloc(const n)` calls whose pointer never
+// leaves the function (only dereferenced, compared, copied between locals
+// and passed to `free`) into stack slots, and drops the matching `free`s.
+bool promote_heap_allocations(const Module& module, Function& func);
+
+// Interval analysis over non-borrowed integer locals: ranges are narrowed
+// along the branches that test them and widened at loop headers, then
+// narrowed again. Folds comparisons the ranges decide, marks Add/Sub/Mul
+// that can't wrap, and records each local's range (the return place's
+// being the function's return range, which callers pick up).
+bool analyze_ranges(const Module& module, Function& func);
+
+// Infers the Effects of one call-graph SCC's functions from their bodies
+// and their callees' (already inferred) effects.
+void infer_effects(const Module& module, const CallGraph& graph, const std::vector<size_t>& scc);
+
+// Deletes functions no root of the call graph (`main`, `pub` and exported
+// functions) can reach, including unused extern declarations.
+bool remove_unreachable_functions(Module& module);
+
+// Runs the default MIR pipeline over every function with a body.
+void optimize_module(Module& module, unsigned opt_level);
+
+} // namespace apex::mir
@@ -0,0 +1,518 @@
+#include "Passes.h"
+#include "Analysis.h"
+#include <algorithm>
+#include <climits>
+#include <unordered_map>
+
+namespace apex::mir {
+
+namespace {
+
+__extension__ typedef __int128 Wide;
+
+// Integers whose every value fits in an int64_t
+bool is_ranged_type(const Type& type) {
+    return type.kind == TypeKind::Int && type.bits > 0 && (type.is_signed ? type.bits <= 64 : type.bits < 64);
+}
+
+ValueRange type_bounds(const Type& type) {
+    if (type.is_signed) {
+        Wide half = Wide(1) << (type.bits - 1);
+        return {static_cast<int64_t>(-half), static_cast<int64_t>(half - 1)};
+    }
+    return {0, static_cast<int64_t>((Wide(1) << type.bits) - 1)};
+}
+
+bool operator==(const ValueRange& a, const ValueRange& b) { return a.lo == b.lo && a.hi == b.hi; }
+bool operator!=(const ValueRange& a, const ValueRange& b) { return !(a == b); }
+
+bool is_singleton(const ValueRange& r) { return r.lo == r.hi; }
+
+ValueRange hull(const ValueRange& a, const ValueRange& b) {
+    return {std::min(a.lo, b.lo), std::max(a.hi, b.hi)};
+}
+
+// [lo, hi] if it fits within `bounds`, i.e. the operation can't have wrapped
+std::optional<ValueRange> fit(Wide lo, Wide hi, const ValueRange& bounds) {
+    if (lo < bounds.lo || hi > bounds.hi) return std::nullopt;
+    return ValueRange{static_cast<int64_t>(lo), static_cast<int64_t>(hi)};
+}
+
+std::optional<ValueRange> fit_corners(std::initializer_list<Wide> values, const ValueRange& bounds) {
+    return fit(std::min(values), std::max(values), bounds);
+}
+
+// Smallest 2^k - 1 that is >= value (value >= 0)
+int64_t low_mask(int64_t value) {
+    uint64_t mask = 0;
+    while (mask < static_cast<uint64_t>(value)) mask = (mask << 1) | 1;
+    return static_cast<int64_t>(mask);
+}
+
+// Range of `a op b` for an integer operator, or nullopt if the result may
+// wrap around (or isn't bounded any better than the type)
+std::optional<ValueRange> eval_binary(BinOp op, const ValueRange& a, const ValueRange& b,
+                                      const ValueRange& bounds, unsigned bits) {
+    Wide al = a.lo, ah = a.hi, bl = b.lo, bh = b.hi;
+    switch (op) {
+        case BinOp::Add: return fit(al + bl, ah + bh, bounds);
+        case BinOp::Sub: return fit(al - bh, ah - bl, bounds);
+        case BinOp::Mul: return fit_corners({al * bl, al * bh, ah * bl, ah * bh}, bounds);
+        case BinOp::Div: {
+            // Dividing by zero is undefined, so only nonzero divisors count;
+            // on each side of zero the extremes are at the corners
+            std::vector<Wide> q;
+            auto corners = [&](Wide lo, Wide hi) { q.insert(q.end(), {al / lo, al / hi, ah / lo, ah / hi}); };
+            if (bl < 0) corners(bl, std::min<Wide>(bh, -1));
+            if (bh > 0) corners(std::max<Wide>(bl, 1), bh);
+            if (q.empty()) return std::nullopt;
+            return fit(*std::min_element(q.begin(), q.end()), *std::max_element(q.begin(), q.end()), bounds);
+        }
+        case BinOp::Rem: {
+            // |a % b| < |b| and the result takes the dividend's sign
+            Wide m = std::max(bl < 0 ? -bl : bl, bh < 0 ? -bh : bh);
+            if (m == 0) return std::nullopt;
+            return fit(al >= 0 ? 0 : std::max(al, 1 - m), ah <= 0 ? 0 : std::min(ah, m - 1), bounds);
+        }
+        case BinOp::BitAnd:
+            if (al >= 0 && bl >= 0) return fit(0, std::min(ah, bh), bounds);
+            if (al >= 0) return fit(0, ah, bounds);
+            if (bl >= 0) return fit(0, bh, bounds);
+            return std::nullopt;
+        case BinOp::BitOr:
+        case BinOp::BitXor:
+            if (al < 0 || bl < 0) return std::nullopt;
+            return fit(op == BinOp::BitOr ? std::max(al, bl) : 0, low_mask(std::max(a.hi, b.hi)), bounds);
+        case BinOp::Shl:
+            if (bl < 0 || bh >= bits) return std::nullopt;
+            return fit_corners({al << bl, al << bh, ah << bl, ah << bh}, bounds);
+        case BinOp::Shr:
+            if (bl < 0 || bh >= bits) return std::nullopt;
+            return fit_corners({al >> bl, al >> bh, ah >> bl, ah >> bh}, bounds);
+        default:
+            return std::nullopt;
+    }
+}
+
+// Outcome of `a op b` for every pair of values in the ranges, if it's the same
+std::optional<bool> decide(BinOp op, const ValueRange& a, const ValueRange& b) {
+    switch (op) {
+        case BinOp::Lt:
+            if (a.hi < b.lo) return true;
+            if (a.lo >= b.hi) return false;
+            return std::nullopt;
+        case BinOp::Le:
+            if (a.hi <= b.lo) return true;
+            if (a.lo > b.hi) return false;
+            return std::nullopt;
+        case BinOp::Gt: return decide(BinOp::Lt, b, a);
+        case BinOp::Ge: return decide(BinOp::Le, b, a);
+        case BinOp::Eq:
+            if (is_singleton(a) && a == b) return true;
+            if (a.hi < b.lo || b.hi < a.lo) return false;
+            return std::nullopt;
+        case BinOp::Ne:
+            if (auto eq = decide(BinOp::Eq, a, b)) return !*eq;
+            return std::nullopt;
+        default:
+            return std::nullopt;
+    }
+}
+
+BinOp negate(BinOp op) {
+    switch (op) {
+        case BinOp::Lt: return BinOp::Ge;
+        case BinOp::Le: return BinOp::Gt;
+        case BinOp::Gt: return BinOp::Le;
+        case BinOp::Ge: return BinOp::Lt;
+        case BinOp::Eq: return BinOp::Ne;
+        default: return BinOp::Eq;
+    }
+}
+
+// Narrows `a` and `b` to the values for which `a op b` holds. Returns false
+// if there are none.
+bool constrain(BinOp op, ValueRange& a, ValueRange& b) {
+    switch (op) {
+        case BinOp::Lt:
+            if (b.hi == INT64_MIN || a.lo == INT64_MAX) return false;
+            a.hi = std::min(a.hi, b.hi - 1);
+            b.lo = std::max(b.lo, a.lo + 1);
+            break;
+        case BinOp::Le:
+            a.hi = std::min(a.hi, b.hi);
+            b.lo = std::max(b.lo, a.lo);
+            break;
+        case BinOp::Gt: return constrain(BinOp::Lt, b, a);
+        case BinOp::Ge: return constrain(BinOp::Le, b, a);
+        case BinOp::Eq:
+            a = b = ValueRange{std::max(a.lo, b.lo), std::min(a.hi, b.hi)};
+            break;
+        case BinOp::Ne:
+            if (is_singleton(a) && is_singleton(b)) return a.lo != b.lo;
+            if (is_singleton(b)) {
+                if (a.lo == b.lo) a.lo++;
+                else if (a.hi == b.lo) a.hi--;
+            } else if (is_singleton(a)) {
+                if (b.lo == a.lo) b.lo++;
+                else if (b.hi == a.lo) b.hi--;
+            }
+            break;
+        default:
+            break;
+    }
+    return a.lo <= a.hi && b.lo <= b.hi;
+}
+
+class RangeAnalysis {
+public:
+    RangeAnalysis(const Module& module, Function& func) : module_(module), func_(func) {
+        std::vector<bool> address_taken = find_address_taken(func);
+        size_t num_locals = func.locals.size();
+        tracked_.assign(num_locals, false);
+        bounds_.resize(num_locals);
+        for (LocalId local = 0; local < num_locals; local++) {
+            const Type& type = func.locals[local].type;
+            if (!is_ranged_type(type)) continue;
+            tracked_[local] = !address_taken[local];
+            bounds_[local] = type_bounds(type);
+        }
+
+        // Return ranges of callees analyzed earlier (bottom-up)
+        for (const auto& block : func.blocks) {
+            if (!block.terminator || block.terminator->kind != TerminatorKind::Call) continue;
+            const std::string& callee = block.terminator->callee;
+            if (return_ranges_.count(callee)) continue;
+            const Function* target = module.find_function(callee);
+            return_ranges_[callee] = target && !target->locals.empty() ? target->locals[RETURN_LOCAL].range
+                                                                       : std::nullopt;
+        }
+    }
+
+    bool run() {
+        solve();
+        narrow();
+        return rewrite();
+    }
+
+private:
+    using State = std::vector<ValueRange>;
+
+    const Module& module_;
+    Function& func_;
+    std::vector<bool> tracked_;
+    std::vector<ValueRange> bounds_;
+    std::unordered_map<std::string, std::optional<ValueRange>> return_ranges_;
+    std::vector<BlockId> order_;
+    std::vector<bool> is_header_;
+    std::vector<std::optional<State>> entry_;
+
+    std::optional<ValueRange> eval_operand(const Operand& op, const State& state) const;
+    ValueRange eval(const Rvalue& rv, const ValueRange& bounds, const State& state) const;
+    ValueRange call_result(const Terminator& term, LocalId local) const;
+    State exit_state(BlockId bb) const;
+
+    const Rvalue* find_comparison(BlockId bb, LocalId disc) const;
+    bool refine(const Rvalue& cmp, bool holds, State& state) const;
+    std::vector<std::pair<BlockId, State>> successors(BlockId bb, const State& out) const;
+
+    bool merge(BlockId bb, const State& incoming);
+    void solve();
+    void narrow();
+    bool rewrite();
+};
+
+std::optional<ValueRange> RangeAnalysis::eval_operand(const Operand& op, const State& state) const {
+    if (op.kind == OperandKind::Constant) {
+        if (!is_ranged_type(op.constant.type)) return std::nullopt;
+        ValueRange bounds = type_bounds(op.constant.type);
+        int64_t value = op.constant.as_int();
+        if (value < bounds.lo || value > bounds.hi) return bounds;
+        return ValueRange{value, value};
+    }
+    if (op.place.is_local() && tracked_[op.place.local]) return state[op.place.local];
+    Type type = module_.operand_type(func_, op);
+    if (!is_ranged_type(type)) return std::nullopt;
+    return type_bounds(type);
+}
+
+// Range of the value an rvalue produces for a local with the given bounds
+ValueRange RangeAnalysis::eval(const Rvalue& rv, const ValueRange& bounds, const State& state) const {
+    switch (rv.kind) {
+        case RvalueKind::Use:
+            return eval_operand(rv.operands[0], state).value_or(bounds);
+        case RvalueKind::BinaryOp: {
+            auto a = eval_operand(rv.operands[0], state);
+            auto b = eval_operand(rv.operands[1], state);
+            if (!a || !b) return bounds;
+            unsigned bits = module_.operand_type(func_, rv.operands[0]).bits;
+            return eval_binary(rv.bin_op, *a, *b, bounds, bits).value_or(bounds);
+        }
+        case RvalueKind::UnaryOp: {
+            auto a = eval_operand(rv.operands[0], state);
+            if (!a) return bounds;
+            Wide lo = a->lo, hi = a->hi;
+            if (rv.un_op == UnOp::Neg) return fit(-hi, -lo, bounds).value_or(bounds);
+            if (bounds.lo < 0) return fit(-hi - 1, -lo - 1, bounds).value_or(bounds);
+            return fit(bounds.hi - hi, bounds.hi - lo, bounds).value_or(bounds);
+        }
+        case RvalueKind::Cast: {
+            Type from = module_.operand_type(func_, rv.operands[0]);
+            if (from.kind == TypeKind::Bool) return {0, 1};
+            auto a = eval_operand(rv.operands[0], state);
+            if (!a || a->lo < bounds.lo || a->hi > bounds.hi) return bounds;
+            return *a;
+        }
+        default:
+            return bounds;
+    }
+}
+
+ValueRange RangeAnalysis::call_result(const Terminator& term, LocalId local) const {
+    auto it = return_ranges_.find(term.callee);
+    if (it == return_ranges_.end() || !it->second) return bounds_[local];
+    return *it->second;
+}
+
+RangeAnalysis::State RangeAnalysis::exit_state(BlockId bb) const {
+    State state = *entry_[bb];
+    const auto& block = func_.blocks[bb];
+    for (const auto& stmt : block.statements) {
+        auto local = assigned_local(stmt);
+        if (local && tracked_[*local]) state[*local] = eval(stmt.rvalue, bounds_[*local], state);
+    }
+    if (block.terminator && block.terminator->kind == TerminatorKind::Call &&
+        block.terminator->destination.is_local() && tracked_[block.terminator->destination.local]) {
+        LocalId dest = block.terminator->destination.local;
+        state[dest] = call_result(*block.terminator, dest);
+    }
+    return state;
+}
+
+// The comparison computing a block's boolean discriminant, if it's in the
+// same block and its operands aren't changed between it and the branch
+const Rvalue* RangeAnalysis::find_comparison(BlockId bb, LocalId disc) const {
+    const auto& stmts = func_.blocks[bb].statements;
+    for (size_t i = stmts.size(); i-- > 0;) {
+        if (assigned_local(stmts[i]) != disc) continue;
+        const Rvalue& rv = stmts[i].rvalue;
+        if (rv.kind != RvalueKind::BinaryOp || !is_comparison(rv.bin_op)) return nullptr;
+        for (size_t j = i + 1; j < stmts.size(); j++) {
+            auto local = assigned_local(stmts[j]);
+            for (const auto& op : rv.operands) {
+                if (local && op.is_place() && op.place.local == *local) return nullptr;
+            }
+        }
+        return &rv;
+    }
+    return nullptr;
+}
+
+// Narrows the comparison's operands to the values for which its result is
+// `holds`; false if that can't happen
+bool RangeAnalysis::refine(const Rvalue& cmp, bool holds, State& state) const {
+    auto a = eval_operand(cmp.operands[0], state);
+    auto b = eval_operand(cmp.operands[1], state);
+    if (!a || !b) return true;
+    if (!constrain(holds ? cmp.bin_op : negate(cmp.bin_op), *a, *b)) return false;
+    for (size_t i = 0; i < 2; i++) {
+        const Operand& op = cmp.operands[i];
+        if (op.is_place() && op.place.is_local() && tracked_[op.place.local]) state[op.place.local] = i ? *b : *a;
+    }
+    return true;
+}
+
+// Feasible successors of a block with the state along each edge, narrowed
+// by what the block's branch tested
+std::vector<std::pair<BlockId, RangeAnalysis::State>> RangeAnalysis::successors(BlockId bb, const State& out) const {
+    const Terminator& term = *func_.blocks[bb].terminator;
+    std::vector<std::pair<BlockId, State>> result;
+    if (term.kind != TerminatorKind::SwitchInt || !term.discriminant.is_place() ||
+        !term.discriminant.place.is_local()) {
+        for (BlockId succ : term.successors()) result.push_back({succ, out});
+        return result;
+    }
+
+    LocalId disc = term.discriminant.place.local;
+    if (tracked_[disc]) {
+        // `match` on an integer: each arm sees its value, the default arm
+        // loses values it can prove were matched at the ends of the range
+        for (size_t i = 0; i < term.values.size(); i++) {
+            int64_t value = term.values[i];
+            if (value < out[disc].lo || value > out[disc].hi) continue;
+            State state = out;
+            state[disc] = {value, value};
+            result.push_back({term.targets[i], state});
+        }
+        State state = out;
+        ValueRange& rest = state[disc];
+        for (bool shrunk = true; shrunk && rest.lo <= rest.hi;) {
+            shrunk = false;
+            for (int64_t value : term.values) {
+                if (value == rest.lo) {
+                    if (rest.lo == rest.hi) return result;
+                    rest.lo++;
+                    shrunk = true;
+                } else if (value == rest.hi) {
+                    rest.hi--;
+                    shrunk = true;
+                }
+            }
+        }
+        result.push_back({term.targets.back(), state});
+        return result;
+    }
+
+    const Rvalue* cmp = find_comparison(bb, disc);
+    if (!cmp || term.values.size() != 1 || (term.values[0] != 0 && term.values[0] != 1)) {
+        for (BlockId succ : term.successors()) result.push_back({succ, out});
+        return result;
+    }
+    for (size_t i = 0; i < 2; i++) {
+        bool holds = (term.values[0] != 0) == (i == 0);
+        State state = out;
+        if (refine(*cmp, holds, state)) result.push_back({term.targets[i], state});
+    }
+    return result;
+}
+
+// Joins `incoming` into a block's entry state. Loop headers widen any bound
+// that moved straight to the type's limit so loops converge in a few passes.
+bool RangeAnalysis::merge(BlockId bb, const State& incoming) {
+    auto& current = entry_[bb];
+    if (!current) {
+        current = incoming;
+        return true;
+    }
+    bool changed = false;
+    for (LocalId local = 0; local < incoming.size(); local++) {
+        if (!tracked_[local]) continue;
+        ValueRange& range = (*current)[local];
+        ValueRange joined = hull(range, incoming[local]);
+        if (joined == range) continue;
+        if (is_header_[bb]) {
+            if (joined.lo < range.lo) joined.lo = bounds_[local].lo;
+            if (joined.hi > range.hi) joined.hi = bounds_[local].hi;
+        }
+        range = joined;
+        changed = true;
+    }
+    return changed;
+}
+
+void RangeAnalysis::solve() {
+    size_t num_blocks = func_.blocks.size();
+    order_ = reverse_postorder(func_);
+    std::vector<size_t> position(num_blocks, 0);
+    for (size_t i = 0; i < order_.size(); i++) position[order_[i]] = i;
+    is_header_.assign(num_blocks, false);
+    for (BlockId bb : order_) {
+        if (!func_.blocks[bb].terminator) continue;
+        for (BlockId succ : func_.blocks[bb].terminator->successors()) {
+            if (position[succ] <= position[bb]) is_header_[succ] = true;
+        }
+    }
+
+    // Parameters and uninitialized locals may hold anything
+    entry_.assign(num_blocks, std::nullopt);
+    entry_[ENTRY_BLOCK] = bounds_;
+
+    for (bool changed = true; changed;) {
+        changed = false;
+        for (BlockId bb : order_) {
+            if (!entry_[bb] || !func_.blocks[bb].terminator) continue;
+            for (const auto& [succ, state] : successors(bb, exit_state(bb))) {
+                changed |= merge(succ, state);
+            }
+        }
+    }
+}
+
+// Widening overshoots: a loop counter bounded by its exit test ends up
+// unbounded above at the header. Re-running the transfer functions from the
+// fixpoint without widening only ever shrinks the ranges, and two rounds
+// are enough to pull the exit bound back into the header.
+void RangeAnalysis::narrow() {
+    for (int round = 0; round < 2; round++) {
+        std::vector<std::optional<State>> next(func_.blocks.size());
+        next[ENTRY_BLOCK] = bounds_;
+        for (BlockId bb : order_) {
+            if (!entry_[bb] || !func_.blocks[bb].terminator) continue;
+            for (const auto& [succ, state] : successors(bb, exit_state(bb))) {
+                if (!next[succ]) {
+                    next[succ] = state;
+                    continue;
+                }
+                for (LocalId local = 0; local < state.size(); local++) {
+                    if (tracked_[local]) (*next[succ])[local] = hull((*next[succ])[local], state[local]);
+                }
+            }
+        }
+        entry_ = std::move(next);
+    }
+}
+
+bool RangeAnalysis::rewrite() {
+    bool changed = false;
+    size_t num_locals = func_.locals.size();
+
+    // Hull of every value each local is assigned; parameters also hold
+    // whatever the caller passed
+    std::vector<std::optional<ValueRange>> assigned(num_locals);
+    for (LocalId local = 1; local <= func_.arg_count; local++) assigned[local] = bounds_[local];
+    auto record = [&](LocalId local, const ValueRange& range) {
+        assigned[local] = assigned[local] ? hull(*assigned[local], range) : range;
+    };
+
+    for (BlockId bb = 0; bb < func_.blocks.size(); bb++) {
+        if (!entry_[bb]) continue;   // Never executed; simplify_cfg drops it
+        State state = *entry_[bb];
+        auto& block = func_.blocks[bb];
+
+        for (auto& stmt : block.statements) {
+            if (stmt.kind != StatementKind::Assign) continue;
+            Rvalue& rv = stmt.rvalue;
+            if (rv.kind == RvalueKind::BinaryOp) {
+                auto a = eval_operand(rv.operands[0], state);
+                auto b = eval_operand(rv.operands[1], state);
+                if (a && b && is_comparison(rv.bin_op)) {
+                    if (auto result = decide(rv.bin_op, *a, *b)) {
+                        rv = Rvalue::use(Operand::constant_bool(*result));
+                        changed = true;
+                    }
+                } else if (a && b && (rv.bin_op == BinOp::Add || rv.bin_op == BinOp::Sub || rv.bin_op == BinOp::Mul)) {
+                    Type type = module_.operand_type(func_, rv.operands[0]);
+                    rv.no_overflow = eval_binary(rv.bin_op, *a, *b, type_bounds(type), type.bits).has_value();
+                }
+            }
+
+            auto local = assigned_local(stmt);
+            if (local && tracked_[*local]) {
+                state[*local] = eval(rv, bounds_[*local], state);
+                record(*local, state[*local]);
+            }
+        }
+
+        if (block.terminator && block.terminator->kind == TerminatorKind::Call &&
+            block.terminator->destination.is_local() && tracked_[block.terminator->destination.local]) {
+            LocalId dest = block.terminator->destination.local;
+            record(dest, call_result(*block.terminator, dest));
+        }
+    }
+
+    for (LocalId local = 0; local < num_locals; local++) {
+        auto& range = func_.locals[local].range;
+        range.reset();
+        if (tracked_[local] && assigned[local] && *assigned[local] != bounds_[local]) range = assigned[local];
+    }
+    return changed;
+}
+
+} // namespace
+
+bool analyze_ranges(const Module& module, Function& func) {
+    if (func.blocks.empty()) return false;
+    return RangeAnalysis(module, func).run();
+}
+
+} // namespace apex::mir
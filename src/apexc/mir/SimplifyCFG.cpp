@@ -0,0 +1,157 @@
+#include "Passes.h"
+#include "Analysis.h"
+#include <algorithm>
+
+namespace apex::mir {
+
+// switchInt on a constant, or with every edge going to the same block, is a goto
+static bool simplify_branches(Function& func) {
+    bool changed = false;
+    for (auto& block : func.blocks) {
+        if (!block.terminator || block.terminator->kind != TerminatorKind::SwitchInt) continue;
+        Terminator& term = *block.terminator;
+
+        std::optional<BlockId> target;
+        if (term.discriminant.kind == OperandKind::Constant) {
+            int64_t value = term.discriminant.constant.as_int();
+            target = term.targets.back();
+            for (size_t i = 0; i < term.values.size(); i++) {
+                if (term.values[i] == value) {
+                    target = term.targets[i];
+                    break;
+                }
+            }
+        } else if (std::all_of(term.targets.begin(), term.targets.end(),
+                               [&](BlockId t) { return t == term.targets[0]; })) {
+            target = term.targets[0];
+        }
+
+        if (target) {
+            Terminator jump;
+            jump.kind = TerminatorKind::Goto;
+            jump.location = term.location;
+            jump.target = *target;
+            block.terminator = std::move(jump);
+            changed = true;
+        }
+    }
+    return changed;
+}
+
+// Redirects edges into `bbN: { goto -> bbM; }` straight to bbM
+static bool thread_empty_blocks(Function& func) {
+    std::vector<std::optional<BlockId>> forward(func.blocks.size());
+    for (BlockId bb = 0; bb < func.blocks.size(); bb++) {
+        const auto& block = func.blocks[bb];
+        if (block.statements.empty() && block.terminator &&
+            block.terminator->kind == TerminatorKind::Goto && block.terminator->target != bb) {
+            forward[bb] = block.terminator->target;
+        }
+    }
+
+    // Follow chains of empty blocks, stopping on cycles
+    auto resolve = [&](BlockId bb) {
+        BlockId current = bb;
+        for (size_t steps = 0; forward[current] && steps < func.blocks.size(); steps++) {
+            current = *forward[current];
+            if (current == bb) return bb;
+        }
+        return current;
+    };
+
+    bool changed = false;
+    for (auto& block : func.blocks) {
+        if (!block.terminator) continue;
+        for (BlockId* succ : block.terminator->successors_mut()) {
+            BlockId resolved = resolve(*succ);
+            if (resolved != *succ) {
+                *succ = resolved;
+                changed = true;
+            }
+        }
+    }
+    return changed;
+}
+
+// Appends a block to its only predecessor when that predecessor ends in a goto
+static bool merge_blocks(Function& func) {
+    auto preds = func.predecessors();
+    bool changed = false;
+
+    for (BlockId bb = 0; bb < func.blocks.size(); bb++) {
+        // Keep merging into bb while its goto target has no other predecessor
+        while (true) {
+            auto& block = func.blocks[bb];
+            if (!block.terminator || block.terminator->kind != TerminatorKind::Goto) break;
+            BlockId succ = block.terminator->target;
+            if (succ == bb || succ == ENTRY_BLOCK || preds[succ].size() != 1) break;
+
+            auto& next = func.blocks[succ];
+            block.statements.insert(block.statements.end(),
+                                    std::make_move_iterator(next.statements.begin()),
+                                    std::make_move_iterator(next.statements.end()));
+            block.terminator = std::move(next.terminator);
+            next.statements.clear();
+            next.terminator.reset();
+            preds[succ].clear();
+
+            if (block.terminator) {
+                for (BlockId s : block.terminator->successors()) {
+                    std::replace(preds[s].begin(), preds[s].end(), succ, bb);
+                }
+            }
+            changed = true;
+        }
+    }
+
+    if (changed) {
+        // Merged-away blocks are unreachable; give them a terminator until removed
+        for (auto& block : func.blocks) {
+            if (!block.terminator) {
+                Terminator unreachable;
+                unreachable.kind = TerminatorKind::Unreachable;
+                block.terminator = std::move(unreachable);
+            }
+        }
+    }
+    return changed;
+}
+
+static bool remove_unreachable_blocks(Function& func) {
+    std::vector<bool> reachable = reachable_blocks(func);
+    if (std::all_of(reachable.begin(), reachable.end(), [](bool r) { return r; })) return false;
+
+    std::vector<BlockId> remap(func.blocks.size(), 0);
+    std::vector<BasicBlock> kept;
+    for (BlockId bb = 0; bb < func.blocks.size(); bb++) {
+        if (reachable[bb]) {
+            remap[bb] = static_cast<BlockId>(kept.size());
+            kept.push_back(std::move(func.blocks[bb]));
+        }
+    }
+    for (auto& block : kept) {
+        if (!block.terminator) continue;
+        for (BlockId* succ : block.terminator->successors_mut()) {
+            *succ = remap[*succ];
+        }
+    }
+    func.blocks = std::move(kept);
+    return true;
+}
+
+bool simplify_cfg(Function& func) {
+    if (func.blocks.empty()) return false;
+
+    bool changed = false;
+    bool progress = true;
+    while (progress) {
+        progress = simplify_branches(func);
+        progress |= thread_empty_blocks(func);
+        progress |= merge_blocks(func);
+        changed |= progress;
+    }
+    changed |= remove_unreachable_blocks(func);
+    return changed;
+}
+
+} // namespace apex::mir
@@ -82,6 +82,7 @@ void Parser::synchronize() {
             case TokenType::KW_TRAIT:
             case TokenType::KW_LET:
             case TokenType::KW_RETURN:
+            case TokenType::KW_DEFER:
                 return;
             default:
                 break;
@@ -129,7 +130,51 @@ std::vector<std::string> Parser::parse_path() {
     return path;
 }
 
+std::vector<ast::Attribute> Parser::parse_attributes() {
+    std::vector<ast::Attribute> attributes;
+    
+    while (match({TokenType::HASH})) {
+        ast::Attribute attr;
+        attr.location = previous().location;
+        consume(TokenType::LBRACKET, "Expected '[' after '#'");
+        attr.name = consume(TokenType::IDENTIFIER, "Expected attribute name").lexeme;
+        
+        // Arguments are kept as source text: #[inline(always)], #[align(16)]
+        if (match({TokenType::LPAREN})) {
+            std::string arg;
+            int depth = 0;
+            while (!is_at_end() && !(depth == 0 && check(TokenType::RPAREN))) {
+                Token tok = advance();
+                if (tok.type == TokenType::LPAREN) depth++;
+                if (tok.type == TokenType::RPAREN) depth--;
+                if (depth == 0 && tok.type == TokenType::COMMA) {
+                    attr.args.push_back(arg);
+                    arg.clear();
+                } else {
+                    arg += tok.lexeme;
+                }
+            }
+            if (!arg.empty()) attr.args.push_back(arg);
+            consume(TokenType::RPAREN, "Expected ')' after attribute arguments");
+        }
+        
+        consume(TokenType::RBRACKET, "Expected ']' after attribute");
+        attributes.push_back(std::move(attr));
+    }
+    
+    return attributes;
+}
+
 std::unique_ptr<ast::Item> Parser::parse_item() {
+    auto attributes = parse_attributes();
+    auto item = parse_item_without_attributes();
+    if (item) {
+        item->attributes.insert(item->attributes.begin(), attributes.begin(), attributes.end());
+    }
+    return item;
+}
+
+std::unique_ptr<ast::Item> Parser::parse_item_without_attributes() {
     auto vis = parse_visibility();
     
     if (match({TokenType::KW_FN})) {
@@ -411,6 +456,10 @@ std::unique_ptr<ast::Stmt> Parser::parse_statement() {
         return parse_let_statement();
     }
     
+    if (match({TokenType::KW_DEFER})) {
+        return parse_defer_statement();
+    }
+    
     // Try to parse as expression
     auto expr = parse_expression();
     if (!expr) {
@@ -445,6 +494,20 @@ std::unique_ptr<ast::Stmt> Parser::parse_let_statement() {
     return stmt;
 }
 
+std::unique_ptr<ast::Stmt> Parser::parse_defer_statement() {
+    auto stmt = std::make_unique<ast::Stmt>(ast::StmtKind::Defer, previous().location);
+    
+    if (match({TokenType::LBRACE})) {
+        stmt->defer_body = parse_block_expr();
+        match({TokenType::SEMICOLON});
+    } else {
+        stmt->defer_body = parse_expression();
+        consume(TokenType::SEMICOLON, "Expected ';' after defer expression");
+    }
+    
+    return stmt;
+}
+
 // Expression parsing (precedence climbing)
 std::unique_ptr<ast::Expr> Parser::parse_expression() {
     return parse_assignment();
@@ -687,6 +750,7 @@ std::unique_ptr<ast::Expr> Parser::parse_factor() {
 std::unique_ptr<ast::Expr> Parser::parse_unary() {
     if (match({TokenType::MINUS, TokenType::NOT, TokenType::TILDE, TokenType::STAR, TokenType::AMP})) {
         Token op = previous();
+        bool is_mut_ref = op.type == TokenType::AMP && match({TokenType::KW_MUT});
         auto operand = parse_unary();
         
         auto unary = std::make_unique<ast::Expr>(ast::ExprKind::Unary, op.location);
@@ -696,11 +760,7 @@ std::unique_ptr<ast::Expr> Parser::parse_unary() {
             case TokenType::TILDE: unary->unary_op = ast::UnaryOp::BitNot; break;
             case TokenType::STAR: unary->unary_op = ast::UnaryOp::Deref; break;
             case TokenType::AMP:
-                if (match({TokenType::KW_MUT})) {
-                    unary->unary_op = ast::UnaryOp::AddrOfMut;
-                } else {
-                    unary->unary_op = ast::UnaryOp::AddrOf;
-                }
+                unary->unary_op = is_mut_ref ? ast::UnaryOp::AddrOfMut : ast::UnaryOp::AddrOf;
                 break;
             default: break;
         }
@@ -780,7 +840,8 @@ std::unique_ptr<ast::Expr> Parser::parse_primary_no_struct() {
     if (check(TokenType::IDENTIFIER)) {
         auto path = parse_path();
         auto ident = std::make_unique<ast::Expr>(ast::ExprKind::Identifier, previous().location);
-        ident->identifier = path[0];
+        ident->identifier = path.back();
+        if (path.size() > 1) ident->path = std::move(path);
         return ident;
     }
     
@@ -860,15 +921,16 @@ std::unique_ptr<ast::Expr> Parser::parse_primary() {
         // Check for struct literal
         // Only treat as struct literal if:
         // 1. Followed immediately by {, AND
-        // 2. The first identifier starts with uppercase (struct convention)
+        // 2. The struct name starts with uppercase (struct convention)
         // This avoids confusion with comparisons like "a < b {" where 'b' is lowercase
-        if (check(TokenType::LBRACE) && !path.empty() && !path[0].empty() && std::isupper(path[0][0])) {
+        if (check(TokenType::LBRACE) && !path.back().empty() && std::isupper(path.back()[0])) {
             return parse_struct_literal(std::move(path));
         }
         
-        // Simple identifier
+        // Identifier, possibly qualified by a module: m::f
         auto ident = std::make_unique<ast::Expr>(ast::ExprKind::Identifier, previous().location);
-        ident->identifier = path[0]; // TODO: Handle full path
+        ident->identifier = path.back();
+        if (path.size() > 1) ident->path = std::move(path);
         return ident;
     }
     
@@ -39,6 +39,7 @@ private:
     
     // Parsing functions
     std::unique_ptr<ast::Item> parse_item();
+    std::unique_ptr<ast::Item> parse_item_without_attributes();
     std::unique_ptr<ast::Item> parse_function(ast::Visibility vis);
     std::unique_ptr<ast::Item> parse_struct(ast::Visibility vis);
     std::unique_ptr<ast::Item> parse_enum(ast::Visibility vis);
@@ -56,6 +57,7 @@ private:
     
     std::unique_ptr<ast::Stmt> parse_statement();
     std::unique_ptr<ast::Stmt> parse_let_statement();
+    std::unique_ptr<ast::Stmt> parse_defer_statement();
     
     std::unique_ptr<ast::Expr> parse_expression();
     std::unique_ptr<ast::Expr> parse_assignment();
@@ -91,6 +93,7 @@ private:
     
     std::vector<std::string> parse_path();
     ast::Visibility parse_visibility();
+    std::vector<ast::Attribute> parse_attributes();
 };
 
 } // namespace apex
@@ -1,8 +1,27 @@
 #include "SemanticAnalyzer.h"
+#include "../support/TimeTrace.h"
 #include <sstream>
 
 namespace apex::sema {
 
+namespace {
+
+std::string join_path(std::vector<std::string>::const_iterator begin, std::vector<std::string>::const_iterator end) {
+    std::string result;
+    for (auto it = begin; it != end; ++it) {
+        if (!result.empty()) result += "::";
+        result += *it;
+    }
+    return result;
+}
+
+bool declares_name(const ast::Item& item) {
+    return item.kind == ast::ItemKind::Function || item.kind == ast::ItemKind::Struct ||
+           item.kind == ast::ItemKind::Enum;
+}
+
+} // namespace
+
 Symbol* Scope::lookup(const std::string& name) {
     auto it = symbols.find(name);
     if (it != symbols.end()) {
@@ -56,11 +75,30 @@ void SemanticAnalyzer::warning(const SourceLocation& loc, const std::string& mes
 bool SemanticAnalyzer::analyze(ast::Module* module) {
     if (!module) return false;
     
+    // Declarations from imported interfaces are only reachable through
+    // their module (m::name), but share one symbol namespace at link time
+    for (auto& item : module->items) {
+        if (!item->imported_from || !declares_name(*item)) continue;
+        if (item->visibility == ast::Visibility::Public) exports_[*item->imported_from].insert(item->name);
+        auto [it, inserted] = imported_names_.emplace(item->name, *item->imported_from);
+        if (!inserted && it->second != *item->imported_from) {
+            error(item->location, "'" + item->name + "' is defined in both module '" + it->second +
+                  "' and module '" + *item->imported_from + "'");
+        }
+    }
+    
+    for (auto& item : module->items) {
+        if (item->kind == ast::ItemKind::Import) analyze_import(item.get());
+    }
+    
     // First pass: collect top-level declarations
     for (auto& item : module->items) {
-        if (item->kind == ast::ItemKind::Function ||
-            item->kind == ast::ItemKind::Struct ||
-            item->kind == ast::ItemKind::Enum) {
+        if (!item->imported_from && declares_name(*item)) {
+            auto imported = imported_names_.find(item->name);
+            if (imported != imported_names_.end()) {
+                error(item->location, "'" + item->name + "' conflicts with an item of module '" +
+                      imported->second + "'");
+            }
             
             Symbol symbol;
             symbol.name = item->name;
@@ -77,15 +115,34 @@ bool SemanticAnalyzer::analyze(ast::Module* module) {
     
     // Second pass: analyze items
     for (auto& item : module->items) {
-        analyze_item(item.get());
+        if (!item->imported_from) analyze_item(item.get());
     }
     
     return !has_errors();
 }
 
+// `import a::b;` makes module a::b available as `b::name`, or under the
+// alias given with `as`
+void SemanticAnalyzer::analyze_import(ast::Item* import) {
+    std::string module = join_path(import->import_path.begin(), import->import_path.end());
+    if (!modules_.count(module)) {
+        error(import->location, "Unresolved import '" + module + "'" +
+              (modules_.empty() ? "; build programs with imports using 'apexc build'" : ""));
+        return;
+    }
+    const std::string& alias = import->import_alias ? *import->import_alias : import->import_path.back();
+    auto [it, inserted] = imports_.emplace(alias, module);
+    if (!inserted && it->second != module) {
+        error(import->location, "Cannot import '" + module + "' as '" + alias + "', which already names module '" +
+              it->second + "'");
+    }
+}
+
 void SemanticAnalyzer::analyze_item(ast::Item* item) {
     if (!item) return;
     
+    check_attributes(item);
+    
     switch (item->kind) {
         case ast::ItemKind::Function:
             analyze_function(item);
@@ -102,17 +159,87 @@ void SemanticAnalyzer::analyze_item(ast::Item* item) {
     }
 }
 
+void SemanticAnalyzer::check_attributes(ast::Item* item) {
+    bool is_function = item->kind == ast::ItemKind::Function;
+    
+    for (const auto& attr : item->attributes) {
+        if (attr.name == "inline") {
+            if (!is_function) {
+                error(attr.location, "'#[inline]' can only be applied to functions");
+            } else if (attr.args.size() > 1 ||
+                       (attr.args.size() == 1 && attr.args[0] != "always" && attr.args[0] != "never")) {
+                error(attr.location, "Expected '#[inline]', '#[inline(always)]' or '#[inline(never)]'");
+            }
+        } else if (attr.name == "noinline") {
+            if (!is_function) {
+                error(attr.location, "'#[noinline]' can only be applied to functions");
+            } else if (!attr.args.empty()) {
+                error(attr.location, "'#[noinline]' takes no arguments");
+            }
+        } else if (attr.name == "drop") {
+            check_destructor(item, attr);
+        } else {
+            warning(attr.location, "Unknown attribute '" + attr.name + "' ignored");
+        }
+    }
+    
+    const ast::Attribute* inline_attr = item->find_attribute("inline");
+    bool never = item->find_attribute("noinline") ||
+                 (inline_attr && inline_attr->args.size() == 1 && inline_attr->args[0] == "never");
+    if (never && inline_attr && !(inline_attr->args.size() == 1 && inline_attr->args[0] == "never")) {
+        error(item->location, "Conflicting inline attributes on '" + item->name + "'");
+    }
+}
+
+// `#[drop] fn name(self: &mut S)` declares the destructor of struct S
+void SemanticAnalyzer::check_destructor(ast::Item* item, const ast::Attribute& attr) {
+    if (item->kind != ast::ItemKind::Function || !item->body) {
+        error(attr.location, "'#[drop]' can only be applied to function definitions");
+        return;
+    }
+    if (!attr.args.empty()) {
+        error(attr.location, "'#[drop]' takes no arguments");
+        return;
+    }
+    
+    ast::Type* param = item->params.size() == 1 ? item->params[0].type.get() : nullptr;
+    ast::Type* pointee = param && param->kind == ast::TypeKind::Reference && param->is_mutable
+                             ? param->pointee_type.get() : nullptr;
+    if (!pointee || pointee->kind != ast::TypeKind::Named || pointee->path_segments.size() != 1) {
+        error(item->location, "Destructor '" + item->name + "' must take exactly one '&mut' struct parameter");
+        return;
+    }
+    ast::Type* ret = item->return_type.get();
+    bool returns_void = !ret || ret->primitive_name == "void" ||
+                        (ret->kind == ast::TypeKind::Tuple && ret->tuple_types.empty());
+    if (!returns_void) {
+        error(item->location, "Destructor '" + item->name + "' cannot return a value");
+        return;
+    }
+    
+    const std::string& struct_name = pointee->path_segments[0];
+    auto [it, inserted] = destructors_.emplace(struct_name, item->name);
+    if (!inserted) {
+        error(attr.location, "Struct '" + struct_name + "' already has destructor '" + it->second + "'");
+    }
+}
+
 void SemanticAnalyzer::analyze_function(ast::Item* func) {
+    APEX_TIME_SCOPE_DETAIL("analyze_function", func->name);
     push_scope();
     
+    check_type(func->return_type.get());
+    
     // Add parameters to scope
     for (auto& param : func->params) {
+        check_type(param.type.get());
         Symbol symbol;
         symbol.name = param.name;
         symbol.type = param.type.get();
-        symbol.is_mutable = false;
+        symbol.is_mutable = param.is_mutable;
         symbol.is_initialized = true;
         symbol.location = param.location;
+        set_reference_kind(symbol, param.type.get(), nullptr);
         
         if (!current_scope_->define(param.name, std::move(symbol))) {
             error(param.location, "Redefinition of parameter '" + param.name + "'");
@@ -128,6 +255,10 @@ void SemanticAnalyzer::analyze_function(ast::Item* func) {
 }
 
 void SemanticAnalyzer::analyze_struct(ast::Item* struct_item) {
+    for (auto& field : struct_item->struct_fields) {
+        check_type(field.type.get());
+    }
+    
     // TODO: Check for duplicate fields
     for (size_t i = 0; i < struct_item->struct_fields.size(); i++) {
         for (size_t j = i + 1; j < struct_item->struct_fields.size(); j++) {
@@ -156,6 +287,8 @@ void SemanticAnalyzer::analyze_stmt(ast::Stmt* stmt) {
     
     switch (stmt->kind) {
         case ast::StmtKind::Let:
+            check_type(stmt->let_type.get());
+            
             // Analyze initializer first
             if (stmt->let_initializer) {
                 analyze_expr(stmt->let_initializer.get());
@@ -176,6 +309,7 @@ void SemanticAnalyzer::analyze_stmt(ast::Stmt* stmt) {
                         symbol.is_mutable = stmt->let_pattern->is_mutable;
                         symbol.is_initialized = (stmt->let_initializer != nullptr);
                         symbol.location = stmt->location;
+                        set_reference_kind(symbol, stmt->let_type.get(), stmt->let_initializer.get());
                         
                         if (!current_scope_->define(name, std::move(symbol))) {
                             error(stmt->location, "Redefinition of '" + name + "'");
@@ -196,6 +330,11 @@ void SemanticAnalyzer::analyze_stmt(ast::Stmt* stmt) {
                 analyze_item(stmt->item.get());
             }
             break;
+        case ast::StmtKind::Defer:
+            defer_depth_++;
+            analyze_expr(stmt->defer_body.get());
+            defer_depth_--;
+            break;
     }
 }
 
@@ -208,7 +347,14 @@ void SemanticAnalyzer::analyze_expr(ast::Expr* expr) {
             break;
             
         case ast::ExprKind::Identifier:
-            if (expr->identifier) {
+            if (expr->identifier && !expr->path.empty()) {
+                // MIR refers to imported items by their bare name
+                if (resolve_path(expr->path, expr->location) && current_scope_->lookup(*expr->identifier)) {
+                    error(expr->location, "'" + join_path(expr->path.begin(), expr->path.end()) +
+                          "' is shadowed by local '" + *expr->identifier + "'");
+                }
+                expr->path.clear();
+            } else if (expr->identifier) {
                 resolve_name(*expr->identifier, expr->location);
             }
             break;
@@ -221,19 +367,7 @@ void SemanticAnalyzer::analyze_expr(ast::Expr* expr) {
                 expr->binary_op == ast::BinaryOp::MulAssign ||
                 expr->binary_op == ast::BinaryOp::DivAssign ||
                 expr->binary_op == ast::BinaryOp::ModAssign) {
-                // For assignment, left side must be an lvalue (identifier)
-                // We don't need to analyze the left side as an expr, just verify it's an identifier
-                if (expr->left && expr->left->kind == ast::ExprKind::Identifier) {
-                    // Verify the variable exists and is mutable
-                    if (expr->left->identifier) {
-                        const std::string& var_name = *expr->left->identifier;
-                        Symbol* sym = current_scope_->lookup(var_name);
-                        if (sym && !sym->is_mutable) {
-                            // Error: cannot assign to immutable variable
-                            // For now, just continue
-                        }
-                    }
-                }
+                check_mutable_place(expr->left.get(), MutableUse::Assign);
                 // Analyze the right side normally
                 analyze_expr(expr->right.get());
             } else {
@@ -246,6 +380,9 @@ void SemanticAnalyzer::analyze_expr(ast::Expr* expr) {
             
         case ast::ExprKind::Unary:
             analyze_expr(expr->operand.get());
+            if (expr->unary_op == ast::UnaryOp::AddrOfMut) {
+                check_mutable_place(expr->operand.get(), MutableUse::Borrow);
+            }
             break;
             
         case ast::ExprKind::Call:
@@ -267,9 +404,17 @@ void SemanticAnalyzer::analyze_expr(ast::Expr* expr) {
             
         case ast::ExprKind::Cast:
             analyze_expr(expr->cast_expr.get());
+            check_type(expr->target_type.get());
             // TODO: Check if cast is valid
             break;
             
+        case ast::ExprKind::StructLiteral:
+            resolve_type_name(expr->struct_path, expr->location, "struct");
+            for (auto& field : expr->fields) {
+                analyze_expr(field.value.get());
+            }
+            break;
+            
         case ast::ExprKind::Block:
             push_scope();
             for (auto& stmt : expr->block_stmts) {
@@ -331,6 +476,9 @@ void SemanticAnalyzer::analyze_expr(ast::Expr* expr) {
             break;
             
         case ast::ExprKind::Return:
+            if (defer_depth_ > 0) {
+                error(expr->location, "Cannot return from inside a 'defer' block");
+            }
             if (expr->return_value) {
                 analyze_expr(expr->return_value.get());
             }
@@ -391,13 +539,160 @@ bool SemanticAnalyzer::types_compatible(ast::Type* /* t1 */, ast::Type* /* t2 */
     return true;
 }
 
+void SemanticAnalyzer::set_reference_kind(Symbol& symbol, ast::Type* type, ast::Expr* init) {
+    if (type) {
+        symbol.is_reference = type->kind == ast::TypeKind::Reference || type->kind == ast::TypeKind::Pointer;
+        symbol.is_mutable_reference = symbol.is_reference && type->is_mutable;
+    } else if (init && init->kind == ast::ExprKind::Unary &&
+               (init->unary_op == ast::UnaryOp::AddrOf || init->unary_op == ast::UnaryOp::AddrOfMut)) {
+        symbol.is_reference = true;
+        symbol.is_mutable_reference = init->unary_op == ast::UnaryOp::AddrOfMut;
+    } else if (init) {
+        symbol.reference_known = false;
+    }
+}
+
+// Walks a place expression down to the binding it is rooted at. Writes
+// directly into a binding need `mut`; writes through a reference or pointer
+// (explicit `*r`, or a field access that auto-derefs) need `&mut`/`*mut`.
+void SemanticAnalyzer::check_mutable_place(ast::Expr* place, MutableUse use) {
+    const char* action = use == MutableUse::Assign ? "assign to" : "borrow";
+    const char* suffix = use == MutableUse::Assign ? "" : " as mutable";
+    bool projected = false;
+    
+    while (place) {
+        switch (place->kind) {
+            case ast::ExprKind::FieldAccess:
+                place = place->object.get();
+                projected = true;
+                continue;
+                
+            case ast::ExprKind::Index:
+                if (use == MutableUse::Assign) {
+                    analyze_expr(place->index_expr.get());
+                }
+                place = place->indexed_expr.get();
+                projected = true;
+                continue;
+                
+            case ast::ExprKind::Unary:
+                if (place->unary_op == ast::UnaryOp::Deref) {
+                    if (use == MutableUse::Assign) {
+                        analyze_expr(place->operand.get());
+                    }
+                    ast::Expr* pointer = place->operand.get();
+                    if (pointer->kind != ast::ExprKind::Identifier || !pointer->identifier) return;
+                    Symbol* sym = current_scope_->lookup(*pointer->identifier);
+                    if (sym && sym->is_reference && !sym->is_mutable_reference) {
+                        error(place->location, std::string("Cannot ") + action + " '*" + sym->name +
+                              "'" + suffix + ", as '" + sym->name + "' is not a mutable reference");
+                    }
+                    return;
+                }
+                break;
+                
+            case ast::ExprKind::Identifier: {
+                if (!place->identifier) return;
+                // Borrow operands were already resolved by analyze_expr
+                Symbol* sym = use == MutableUse::Assign ? resolve_name(*place->identifier, place->location)
+                                                        : current_scope_->lookup(*place->identifier);
+                if (!sym) return;
+                
+                if (projected && sym->is_reference) {
+                    if (!sym->is_mutable_reference) {
+                        error(place->location, std::string("Cannot ") + action + " data behind '" + sym->name +
+                              "'" + suffix + ", as it is not a mutable reference");
+                    }
+                } else if (projected && !sym->reference_known) {
+                    // BorrowChecker, with the binding's type (check_projected_write)
+                } else if (!sym->is_mutable && (use == MutableUse::Borrow || sym->is_initialized || projected)) {
+                    // A `let x: T;` declaration may be assigned once on each path; the
+                    // flow-sensitive part is checked on MIR (InitChecker)
+                    error(place->location, std::string("Cannot ") + action + " immutable variable '" + sym->name +
+                          "'" + suffix);
+                }
+                return;
+            }
+                
+            default:
+                break;
+        }
+        
+        if (use == MutableUse::Assign) {
+            error(place->location, "Invalid left-hand side of assignment");
+        }
+        return;
+    }
+}
+
 Symbol* SemanticAnalyzer::resolve_name(const std::string& name, const SourceLocation& loc) {
     Symbol* symbol = current_scope_->lookup(name);
     if (!symbol) {
-        error(loc, "Undefined identifier '" + name + "'");
+        error(loc, "Undefined identifier '" + name + "'" + suggest_import(name));
         return nullptr;
     }
     return symbol;
 }
 
+// `m::name` must name a public item of a module imported as `m` (or by its
+// full path)
+bool SemanticAnalyzer::resolve_path(const std::vector<std::string>& path, const SourceLocation& loc) {
+    std::string qualifier = join_path(path.begin(), path.end() - 1);
+    std::string module;
+    auto alias = imports_.find(qualifier);
+    if (alias != imports_.end()) {
+        module = alias->second;
+    } else {
+        for (const auto& [name, imported] : imports_) {
+            if (imported == qualifier) module = imported;
+        }
+    }
+    if (module.empty()) {
+        error(loc, "Unknown module '" + qualifier + "'");
+        return false;
+    }
+    if (!exports_[module].count(path.back())) {
+        error(loc, "Module '" + module + "' has no public item '" + path.back() + "'");
+        return false;
+    }
+    return true;
+}
+
+// Struct names in types and literals. Qualified names are checked and
+// reduced to the bare name; unqualified ones must not reach into another
+// module.
+void SemanticAnalyzer::resolve_type_name(std::vector<std::string>& path, const SourceLocation& loc,
+                                         const char* what) {
+    if (path.size() > 1) {
+        if (resolve_path(path, loc)) path = {path.back()};
+    } else if (path.size() == 1 && imported_names_.count(path[0]) && !current_scope_->lookup(path[0])) {
+        error(loc, std::string("Unknown ") + what + " '" + path[0] + "'" + suggest_import(path[0]));
+    }
+}
+
+void SemanticAnalyzer::check_type(ast::Type* type) {
+    if (!type) return;
+    
+    if (type->kind == ast::TypeKind::Named) {
+        resolve_type_name(type->path_segments, type->location, "type");
+    }
+    check_type(type->pointee_type.get());
+    check_type(type->element_type.get());
+    check_type(type->return_type.get());
+    for (auto& elem : type->tuple_types) check_type(elem.get());
+    for (auto& param : type->param_types) check_type(param.get());
+}
+
+// Points at the qualified spelling of an item from an imported module
+std::string SemanticAnalyzer::suggest_import(const std::string& name) const {
+    auto imported = imported_names_.find(name);
+    if (imported == imported_names_.end()) return "";
+    for (const auto& [alias, module] : imports_) {
+        if (module == imported->second && exports_.count(module) && exports_.at(module).count(name)) {
+            return "; did you mean '" + alias + "::" + name + "'?";
+        }
+    }
+    return "; it is defined in module '" + imported->second + "'";
+}
+
 } // namespace apex::sema
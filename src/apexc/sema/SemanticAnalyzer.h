@@ -2,6 +2,7 @@
 
 #include "../ast/AST.h"
 #include <unordered_map>
+#include <unordered_set>
 #include <vector>
 #include <string>
 #include <memory>
@@ -14,6 +15,13 @@ struct Symbol {
     bool is_mutable;
     bool is_initialized;
     SourceLocation location;
+    
+    // Reference/pointer bindings, declared or inferred from `&`/`&mut`.
+    // Without either, whether the binding is a reference isn't known here
+    // and writes through its fields are left to the MIR borrow checker.
+    bool is_reference{false};
+    bool is_mutable_reference{false};
+    bool reference_known{true};
 };
 
 struct Scope {
@@ -30,6 +38,10 @@ public:
     
     bool analyze(ast::Module* module);
     
+    // Declares that the interface of module `name` (items marked with
+    // `imported_from`) has been added to the module about to be analyzed
+    void add_module(const std::string& name) { modules_.insert(name); }
+    
     const std::vector<std::string>& get_errors() const { return errors_; }
     const std::vector<std::string>& get_warnings() const { return warnings_; }
     bool has_errors() const { return !errors_.empty(); }
@@ -39,6 +51,14 @@ private:
     std::vector<std::unique_ptr<Scope>> scopes_;
     std::vector<std::string> errors_;
     std::vector<std::string> warnings_;
+    std::unordered_map<std::string, std::string> destructors_;   // Struct name -> #[drop] function
+    unsigned defer_depth_{0};
+    
+    // Modules
+    std::unordered_set<std::string> modules_;
+    std::unordered_map<std::string, std::string> imports_;                          // Alias -> module
+    std::unordered_map<std::string, std::unordered_set<std::string>> exports_;      // Module -> public items
+    std::unordered_map<std::string, std::string> imported_names_;                   // Item -> module
     
     // Scope management
     void push_scope();
@@ -50,6 +70,9 @@ private:
     
     // Analysis functions
     void analyze_item(ast::Item* item);
+    void analyze_import(ast::Item* import);
+    void check_attributes(ast::Item* item);
+    void check_destructor(ast::Item* item, const ast::Attribute& attr);
     void analyze_function(ast::Item* func);
     void analyze_struct(ast::Item* struct_item);
     void analyze_enum(ast::Item* enum_item);
@@ -58,12 +81,21 @@ private:
     void analyze_expr(ast::Expr* expr);
     void analyze_pattern(ast::Pattern* pattern);
     
+    // Mutability: `place` is about to be assigned to or borrowed as `&mut`
+    enum class MutableUse { Assign, Borrow };
+    void check_mutable_place(ast::Expr* place, MutableUse use);
+    void set_reference_kind(Symbol& symbol, ast::Type* type, ast::Expr* init);
+    
     // Type checking
     ast::Type* infer_expr_type(ast::Expr* expr);
     bool types_compatible(ast::Type* t1, ast::Type* t2);
     
     // Name resolution
     Symbol* resolve_name(const std::string& name, const SourceLocation& loc);
+    bool resolve_path(const std::vector<std::string>& path, const SourceLocation& loc);
+    void resolve_type_name(std::vector<std::string>& path, const SourceLocation& loc, const char* what);
+    void check_type(ast::Type* type);
+    std::string suggest_import(const std::string& name) const;
 };
 
 } // namespace apex::sema
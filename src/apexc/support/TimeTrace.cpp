@@ -0,0 +1,155 @@
+#include "TimeTrace.h"
+#include <chrono>
+#include <cstdio>
+#include <fstream>
+#include <memory>
+#include <mutex>
+#include <sstream>
+#include <vector>
+
+namespace apex::trace {
+
+namespace detail {
+std::atomic<bool> enabled{false};
+}
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+struct Event {
+    std::string name;
+    std::string detail;
+    Clock::time_point start;
+    Clock::duration duration{};
+};
+
+// Each thread appends to its own buffer without locking; the buffers belong
+// to the trace so they outlive pool workers. The first thread to record
+// (the one that called start()) is shown as the main thread.
+struct ThreadBuffer {
+    unsigned tid;
+    std::vector<Event> events;
+    std::vector<size_t> open;           // Indices of unfinished events, innermost last
+};
+
+struct Trace {
+    std::mutex mutex;
+    std::atomic<unsigned> generation{0};    // Bumped by start() and finish(); older thread_local buffers are gone
+    Clock::time_point origin;
+    Clock::duration granularity{};
+    std::vector<std::unique_ptr<ThreadBuffer>> buffers;
+};
+
+// Leaked on purpose, like the other process-wide state: worker threads may
+// still be unwinding during static destruction
+Trace& trace() {
+    static auto* instance = new Trace;
+    return *instance;
+}
+
+ThreadBuffer& thread_buffer() {
+    thread_local ThreadBuffer* buffer = nullptr;
+    thread_local unsigned generation = 0;
+    Trace& t = trace();
+    unsigned current = t.generation.load(std::memory_order_acquire);
+    if (buffer && generation == current) return *buffer;
+
+    std::lock_guard<std::mutex> lock(t.mutex);
+    t.buffers.push_back(std::make_unique<ThreadBuffer>());
+    buffer = t.buffers.back().get();
+    buffer->tid = static_cast<unsigned>(t.buffers.size());
+    generation = current;
+    return *buffer;
+}
+
+std::string json_string(const std::string& text) {
+    std::string escaped = "\"";
+    for (char c : text) {
+        if (c == '"' || c == '\\') {
+            escaped += '\\';
+            escaped += c;
+        } else if (static_cast<unsigned char>(c) < 0x20) {
+            char buffer[8];
+            std::snprintf(buffer, sizeof(buffer), "\\u%04x", c);
+            escaped += buffer;
+        } else {
+            escaped += c;
+        }
+    }
+    return escaped + "\"";
+}
+
+long long micros(Clock::duration duration) {
+    return std::chrono::duration_cast<std::chrono::microseconds>(duration).count();
+}
+
+} // namespace
+
+void start(unsigned granularity_us) {
+    Trace& t = trace();
+    {
+        std::lock_guard<std::mutex> lock(t.mutex);
+        t.generation++;
+        t.buffers.clear();
+        t.granularity = std::chrono::microseconds(granularity_us);
+        t.origin = Clock::now();
+    }
+    thread_buffer();
+    detail::enabled.store(true, std::memory_order_relaxed);
+}
+
+void begin(const char* name, std::string detail) {
+    begin(std::string(name), std::move(detail));
+}
+
+void begin(std::string name, std::string detail) {
+    ThreadBuffer& buffer = thread_buffer();
+    buffer.open.push_back(buffer.events.size());
+    buffer.events.push_back({std::move(name), std::move(detail), Clock::now()});
+}
+
+void end() {
+    ThreadBuffer& buffer = thread_buffer();
+    if (buffer.open.empty()) return;
+    Event& event = buffer.events[buffer.open.back()];
+    event.duration = Clock::now() - event.start;
+    buffer.open.pop_back();
+}
+
+bool finish(const std::string& path, std::string& error) {
+    detail::enabled.store(false, std::memory_order_relaxed);
+    Trace& t = trace();
+    std::lock_guard<std::mutex> lock(t.mutex);
+
+    // Complete ("X") events; a viewer nests them by time per thread
+    std::ostringstream json;
+    json << "{\"traceEvents\": [\n"
+         << "{\"ph\": \"M\", \"pid\": 1, \"tid\": 0, \"name\": \"process_name\", \"args\": {\"name\": \"apexc\"}}";
+    for (const auto& buffer : t.buffers) {
+        json << ",\n{\"ph\": \"M\", \"pid\": 1, \"tid\": " << buffer->tid
+             << ", \"name\": \"thread_name\", \"args\": {\"name\": "
+             << json_string(buffer->tid == 1 ? "main" : "worker " + std::to_string(buffer->tid - 1)) << "}}";
+        for (const auto& event : buffer->events) {
+            if (event.duration < t.granularity) continue;
+            json << ",\n{\"ph\": \"X\", \"pid\": 1, \"tid\": " << buffer->tid << ", \"ts\": "
+                 << micros(event.start - t.origin) << ", \"dur\": " << micros(event.duration)
+                 << ", \"name\": " << json_string(event.name);
+            if (!event.detail.empty()) json << ", \"args\": {\"detail\": " << json_string(event.detail) << "}";
+            json << "}";
+        }
+    }
+    json << "\n], \"displayTimeUnit\": \"ms\"}\n";
+    t.buffers.clear();
+    t.generation++;
+
+    std::ofstream out(path);
+    out << json.str();
+    if (!out) {
+        error = "Failed to write trace file: " + path;
+        return false;
+    }
+    return true;
+}
+
+} // namespace apex::trace
@@ -0,0 +1,80 @@
+#pragma once
+
+#include <atomic>
+#include <string>
+#include <utility>
+
+#ifndef APEX_TIME_TRACE
+#define APEX_TIME_TRACE 0
+#endif
+
+namespace apex::trace {
+
+// -ftime-trace: nested spans recorded per thread and written as Chrome
+// trace-event JSON (chrome://tracing, ui.perfetto.dev). Recording is off
+// until start(), and a scope costs one relaxed load while it is. Configuring
+// with -DAPEX_TIME_TRACE=OFF compiles the scopes out altogether.
+
+namespace detail {
+extern std::atomic<bool> enabled;
+}
+
+inline bool enabled() { return detail::enabled.load(std::memory_order_relaxed); }
+
+// Starts recording on every thread. Spans shorter than `granularity_us` are
+// dropped when the trace is written.
+void start(unsigned granularity_us);
+
+// Opens and closes a span on the calling thread. Spans close in reverse order.
+void begin(const char* name, std::string detail = {});
+void begin(std::string name, std::string detail);
+void end();
+
+// Writes everything recorded since start() and stops recording. Threads that
+// recorded must be done by then (pool workers joined). False, with `error`
+// set, if the file can't be written.
+bool finish(const std::string& path, std::string& error);
+
+// One span for the enclosing scope, if recording. `detail` is a callable
+// returning the span's detail string, only called when recording.
+class Scope {
+public:
+    explicit Scope(const char* name) {
+        if (enabled()) {
+            begin(name);
+            active_ = true;
+        }
+    }
+
+    template <typename Detail>
+    Scope(const char* name, Detail&& detail) {
+        if (enabled()) {
+            begin(name, std::forward<Detail>(detail)());
+            active_ = true;
+        }
+    }
+
+    ~Scope() {
+        if (active_) end();
+    }
+
+    Scope(const Scope&) = delete;
+    Scope& operator=(const Scope&) = delete;
+
+private:
+    bool active_{false};
+};
+
+} // namespace apex::trace
+
+#define APEX_TRACE_CONCAT_IMPL(a, b) a##b
+#define APEX_TRACE_CONCAT(a, b) APEX_TRACE_CONCAT_IMPL(a, b)
+
+#if APEX_TIME_TRACE
+#define APEX_TIME_SCOPE(name) ::apex::trace::Scope APEX_TRACE_CONCAT(apex_time_scope_, __LINE__)(name)
+#define APEX_TIME_SCOPE_DETAIL(name, detail)                                                                    \
+    ::apex::trace::Scope APEX_TRACE_CONCAT(apex_time_scope_, __LINE__)(name, [&] { return std::string(detail); })
+#else
+#define APEX_TIME_SCOPE(name) static_cast<void>(0)
+#define APEX_TIME_SCOPE_DETAIL(name, detail) static_cast<void>(0)
+#endif
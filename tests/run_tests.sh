@@ -5,8 +5,8 @@
 
 set -e
 
-APEXC="$(cd "$(dirname "$0")/.." && pwd)/build/src/apexc/apexc"
-TESTS_DIR="$(dirname "$0")"
+APEXC="${APEXC:-$(cd "$(dirname "$0")/.." && pwd)/build/src/apexc/apexc}"
+TESTS_DIR="$(cd "$(dirname "$0")" && pwd)"
 FAILED=0
 PASSED=0
 SKIPPED=0
@@ -125,6 +125,284 @@ for test_file in $TESTS_DIR/*.apx; do
     fi
 done
 
+# Command-line checks: each runs apexc (or what it built) and compares the
+# exit status
+WORK_DIR=$(mktemp -d)
+trap 'rm -rf "$WORK_DIR"' EXIT
+
+run_check() {
+    local name=$1
+    local expected=$2
+    shift 2
+    set +e
+    "$@" > "$WORK_DIR/check_output.txt" 2>&1
+    local actual=$?
+    set -e
+    if [ "$actual" -eq "$expected" ]; then
+        echo -e "${GREEN}✓ PASS${NC} $name (exit code: $actual)"
+        PASSED=$((PASSED + 1))
+    else
+        echo -e "${RED}✗ FAIL${NC} $name (expected: $expected, got: $actual)"
+        if [ ! -z "$VERBOSE" ]; then
+            cat "$WORK_DIR/check_output.txt"
+        fi
+        FAILED=$((FAILED + 1))
+    fi
+}
+
+echo ""
+echo "Command-line checks"
+cp "$TESTS_DIR/for_basic.apx" "$WORK_DIR/"
+cd "$WORK_DIR"
+
+run_check "help" 0 "$APEXC" --help
+run_check "bad sanitizer" 1 "$APEXC" -fsanitize=memory for_basic.apx
+run_check "incompatible sanitizers" 1 "$APEXC" -fsanitize=address,thread for_basic.apx
+run_check "unknown option" 1 "$APEXC" --no-such-option for_basic.apx
+run_check "bad job count" 1 "$APEXC" -j0 for_basic.apx
+run_check "bad time trace granularity" 1 "$APEXC" -ftime-trace-granularity=x for_basic.apx
+run_check "bad xray threshold" 1 "$APEXC" -fxray-instruction-threshold=x for_basic.apx
+
+# `readonly` on `&` parameters relies on these being rejected
+cat > shared_cast.apx <<'EOF'
+struct P { x: i32 }
+fn poke(p: &P) -> i32 { let q = p as *mut P; q.x = 5; p.x }
+fn main() -> i32 { let n: P = P { x: 1 }; poke(&n) }
+EOF
+run_check "write through '&' cast to '*mut'" 1 "$APEXC" shared_cast.apx
+cat > raw_alias.apx <<'EOF'
+extern { fn malloc(size: u64) -> *mut u8; }
+struct P { x: i32 }
+fn both(a: &mut P, b: &mut P) -> i32 { a.x = 1; b.x = 2; a.x }
+fn main() -> i32 {
+    let p: *mut P = malloc(8) as *mut P;
+    let q: *mut P = p;
+    both(&mut *p, &mut *q)
+}
+EOF
+run_check "'&mut' aliases through raw pointers" 1 "$APEXC" raw_alias.apx
+
+# Module builds: `import util::math` finds util/math.apx, which is compiled
+# before main and linked in
+mkdir -p modules/util
+cat > modules/main.apx <<'EOF'
+import util::math;
+
+fn main() -> i32 {
+    math::square(7)
+}
+EOF
+cat > modules/util/math.apx <<'EOF'
+pub fn square(x: i32) -> i32 {
+    x * x
+}
+EOF
+run_check "module build" 0 "$APEXC" build -j 2 --build-dir modules/out modules/main.apx
+run_check "module build runs" 49 modules/out/main
+
+# A module whose source is unchanged keeps its object and .apxmod, and
+# importers compile against the .apxmod; a damaged one is rebuilt
+sed -i 's/square(7)/square(6)/' modules/main.apx
+run_check "unchanged module is reused" 0 sh -c \
+    '"$0" build -v --build-dir modules/out modules/main.apx | grep "util::math is up to date" > /dev/null' "$APEXC"
+run_check "importer built against .apxmod runs" 36 modules/out/main
+head -c 40 modules/out/util.math.apxmod > modules/truncated.apxmod
+mv modules/truncated.apxmod modules/out/util.math.apxmod
+sed -i 's/square(6)/square(5)/' modules/main.apx
+run_check "damaged .apxmod is rebuilt" 0 sh -c \
+    '"$0" build -v --build-dir modules/out modules/main.apx | grep "Compiling util::math" > /dev/null' "$APEXC"
+run_check "rebuilt module runs" 25 modules/out/main
+
+# Batch compiles: each input gets its own object, and one failing file
+# doesn't stop the others
+mkdir -p batch
+cp for_basic.apx batch/good_a.apx
+cp for_basic.apx batch/good_b.apx
+printf 'fn main() -> i32 { undefined_name }\n' > batch/broken.apx
+run_check "batch compile" 0 "$APEXC" -j 2 batch/good_a.apx batch/good_b.apx
+run_check "batch compile wrote each object" 0 test -f batch/good_a.o -a -f batch/good_b.o
+rm batch/good_a.o batch/good_b.o
+run_check "batch compile with a broken file" 1 "$APEXC" -j 2 batch/good_a.apx batch/broken.apx batch/good_b.apx
+run_check "batch compile kept going" 0 test -f batch/good_a.o -a -f batch/good_b.o
+
+# Batch compiles print each file's diagnostics together, in input order, code
+# generation errors included (the outputs here can't be opened)
+for name in batch_a batch_b batch_c; do
+    cp for_basic.apx $name.apx
+    mkdir -p $name.o
+done
+run_check "batch diagnostics in input order" 0 sh -c \
+    '"$0" -j 3 batch_a.apx batch_b.apx batch_c.apx 2>&1 | grep "^Could not open" | cut -d" " -f4 | tr -d "\n" | grep -qx "batch_a.o:batch_b.o:batch_c.o:"' "$APEXC"
+
+# Compiler server: objects with debug info record the working directory, so
+# the same file in two checkouts must not share a cached object
+"$APEXC" --server "$WORK_DIR/apexc.sock" > "$WORK_DIR/server.log" 2>&1 &
+SERVER_PID=$!
+for i in $(seq 50); do
+    grep -q "Listening" "$WORK_DIR/server.log" && break
+    sleep 0.1
+done
+mkdir -p checkout_a checkout_b
+cp for_basic.apx checkout_a/
+cp for_basic.apx checkout_b/
+for dir in checkout_a checkout_b; do
+    run_check "server compile in $dir" 0 env APEXC_SERVER="$WORK_DIR/apexc.sock" \
+        sh -c 'cd "$1" && "$0" -g --emit-llvm for_basic.apx -o for_basic.ll' "$APEXC" "$dir"
+done
+run_check "server cache keeps checkouts apart" 0 grep -q "directory: \"$(pwd -P)/checkout_b\"" checkout_b/for_basic.ll
+printf 'fn main() -> i32 { undefined_name }\n' > server_error.apx
+run_check "server forwards errors" 0 env APEXC_SERVER="$WORK_DIR/apexc.sock" sh -c \
+    '"$0" server_error.apx 2>&1 | grep "Undefined identifier" > /dev/null' "$APEXC"
+run_check "server compile error exits 1" 1 env APEXC_SERVER="$WORK_DIR/apexc.sock" "$APEXC" server_error.apx
+kill $SERVER_PID
+wait $SERVER_PID 2> /dev/null || true
+
+# `apexc test` runs each test in its own process, so a crashing test is
+# reported as a failure instead of taking the runner down
+mkdir -p unit
+cp for_basic.apx unit/
+run_check "apexc test" 0 "$APEXC" test -j 2 unit
+cat > unit/null_store.apx <<'EOF'
+// Expected: 0
+fn main() -> i32 {
+    let p: *mut i32 = 0 as *mut i32;
+    *p = 1;
+    0
+}
+EOF
+run_check "apexc test with a crashing test" 1 "$APEXC" test --format=junit -o unit/report.xml unit
+run_check "apexc test reports the crash" 0 grep -q '<failure type="crash"' unit/report.xml
+run_check "apexc test still runs the rest" 0 grep -q '<testcase name="for_basic"' unit/report.xml
+
+# Compile reports go to stderr, next to a normal compile
+run_check "time report" 0 sh -c \
+    '"$0" -ftime-report for_basic.apx -o report.o 2>&1 | grep "^  codegen " > /dev/null' "$APEXC"
+run_check "time report compile still writes the object" 0 test -f report.o
+run_check "time report as JSON" 0 sh -c \
+    '"$0" -ftime-report=json for_basic.apx -o report.o 2>&1 | grep "\"name\": \"codegen\"" > /dev/null' "$APEXC"
+run_check "memory report" 0 sh -c \
+    '"$0" -fmem-report for_basic.apx -o report.o 2>&1 | grep "Peak RSS" > /dev/null' "$APEXC"
+
+# Chrome traces: one complete ("X") event per phase, for compiles and for
+# builds, which add a track per worker
+run_check "time trace" 0 "$APEXC" -ftime-trace=trace.json for_basic.apx -o trace.o
+run_check "time trace has the phases" 0 grep -q '"ph": "X", .*"name": "codegen"' trace.json
+run_check "time trace is closed" 0 grep -q '^], "displayTimeUnit"' trace.json
+run_check "time trace granularity" 0 "$APEXC" -ftime-trace=coarse.json -ftime-trace-granularity=100000000 \
+    for_basic.apx -o trace.o
+run_check "time trace granularity drops short spans" 1 grep -q '"ph": "X"' coarse.json
+run_check "build time trace" 0 "$APEXC" build -c -j 2 -ftime-trace=build.json --build-dir trace_build modules/main.apx
+run_check "build time trace has worker tracks" 0 grep -q '"thread_name", "args": {"name": "worker 1"}' build.json
+
+# Optimization remarks point at the source they're about
+cat > remarks.apx <<'EOF'
+#[noinline]
+fn add(a: i32, b: i32) -> i32 {
+    a + b
+}
+
+fn main() -> i32 {
+    let mut total = 0;
+    for i in 0..10 {
+        total = add(total, i);
+    }
+    total
+}
+EOF
+run_check "remarks for done optimizations" 0 sh -c \
+    '"$0" -O2 -Rpass=loop-unroll remarks.apx -o remarks.o 2>&1 | grep "^remarks.apx:8:.*remark: .*unrolled" > /dev/null' "$APEXC"
+run_check "remarks for missed optimizations" 0 sh -c \
+    '"$0" -O2 -Rpass-missed=inline remarks.apx -o remarks.o 2>&1 | grep "^remarks.apx:9:.*not inlined" > /dev/null' "$APEXC"
+run_check "remarks filtered by pass" 1 sh -c \
+    '"$0" -O2 -Rpass=no-such-pass remarks.apx -o remarks.o 2>&1 | grep "remark:" > /dev/null' "$APEXC"
+run_check "optimization record" 0 "$APEXC" -O2 -foptimization-record-file=remarks.yaml remarks.apx -o remarks.o
+run_check "optimization record has the missed inline" 0 grep -q "^Name: *NeverInline" remarks.yaml
+
+# Debug info: variables are described at -O2 too, and
+# -gline-tables-only leaves them out
+run_check "debug info" 0 "$APEXC" -g --emit-llvm remarks.apx -o debug.ll
+run_check "debug info describes functions" 0 grep -q 'DISubprogram(name: "add"' debug.ll
+run_check "debug info describes variables" 0 grep -q 'DILocalVariable(name: "total"' debug.ll
+run_check "optimized debug info" 0 "$APEXC" -O2 -g --emit-llvm remarks.apx -o debug_opt.ll
+run_check "optimized debug info keeps variables" 0 grep -q 'DILocalVariable(name: "total"' debug_opt.ll
+run_check "line tables only" 0 "$APEXC" -gline-tables-only --emit-llvm remarks.apx -o lines.ll
+run_check "line tables only has no variables" 1 grep -q 'DILocalVariable' lines.ll
+
+# Profiling: libapex_profile counts the calls the entry/exit hooks see
+run_check "frame pointers" 0 "$APEXC" -fno-omit-frame-pointer --emit-llvm remarks.apx -o frame.ll
+run_check "frame pointers are kept" 0 grep -q '"frame-pointer"="all"' frame.ll
+run_check "instrumented build" 0 "$APEXC" build -finstrument-functions --build-dir profile_build remarks.apx
+run_check "instrumented program runs" 45 env APEX_PROFILE=profile.txt profile_build/remarks
+run_check "profile counts calls" 0 grep -Eq ' 10 +[0-9]+  add \(remarks.apx:2\)$' profile.txt
+
+# XRay: sleds go to functions over the instruction threshold or with a loop,
+# and are only patched when APEX_XRAY asks for a trace (x86-64 Linux only)
+if [ "$(uname -m)" = "x86_64" ]; then
+    run_check "xray build" 0 "$APEXC" build -fxray-instrument -fxray-instruction-threshold=1 \
+        --build-dir xray_build remarks.apx
+    run_check "xray program runs untraced" 45 xray_build/remarks
+    run_check "untraced run writes no trace" 1 test -e apex-xray.json
+    run_check "xray program runs traced" 45 env APEX_XRAY=on APEX_XRAY_FILE=xray.json xray_build/remarks
+    run_check "xray traces every call" 0 test "$(grep -c '"name":"add"' xray.json)" -eq 10
+    run_check "xray build with default threshold" 0 "$APEXC" build -fxray-instrument \
+        --build-dir xray_default remarks.apx
+    run_check "xray default threshold program runs traced" 45 \
+        env APEX_XRAY=on APEX_XRAY_FILE=xray_default.json xray_default/remarks
+    run_check "default threshold instruments loops only" 0 sh -c \
+        'grep -q "\"name\":\"main\"" xray_default.json && ! grep -q "\"name\":\"add\"" xray_default.json'
+fi
+
+# Coverage: each run appends its counters to the profile, and `cov report`
+# adds them up per line and branch
+run_check "coverage build" 0 "$APEXC" build -fcoverage --build-dir coverage_build remarks.apx
+run_check "coverage program runs" 45 env APEX_COVERAGE_FILE=coverage.raw coverage_build/remarks
+run_check "coverage report" 0 sh -c \
+    '"$0" cov report --show-lines coverage_build/remarks coverage.raw | grep "Branch (8:8): true 10, false 1" > /dev/null' \
+    "$APEXC"
+run_check "coverage program runs again" 45 env APEX_COVERAGE_FILE=coverage.raw coverage_build/remarks
+run_check "coverage report adds up runs" 0 sh -c \
+    '"$0" cov report --format=lcov coverage_build/remarks coverage.raw | grep "^DA:2,20$" > /dev/null' "$APEXC"
+run_check "coverage report needs a profile" 1 "$APEXC" cov report coverage_build/remarks missing.raw
+
+# Sanitizers: apexc instruments, and the C compiler links the runtimes
+cat > use_after_free.apx <<'EOF'
+extern { fn malloc(size: u64) -> *mut u8; }
+extern { fn free(ptr: *mut u8); }
+
+struct P { x: i32, y: i32 }
+
+fn main() -> i32 {
+    let p: *mut P = malloc(8) as *mut P;
+    p.x = 1;
+    free(p as *mut u8);
+    p.x
+}
+EOF
+cat > divide_by_zero.apx <<'EOF'
+fn divide(a: i32, b: i32) -> i32 {
+    a / b
+}
+
+fn main() -> i32 {
+    divide(7, 0)
+}
+EOF
+run_check "thread sanitizer instruments accesses" 0 sh -c \
+    '"$0" -fsanitize=thread --emit-llvm use_after_free.apx -o - | grep "call void @__tsan_write4" > /dev/null' "$APEXC"
+if echo 'int main(void) { return 0; }' | "${CC:-cc}" -fsanitize=address,undefined -x c - -o sanitizer_probe 2> /dev/null; then
+    run_check "address sanitizer build" 0 "$APEXC" build -fsanitize=address -g --build-dir asan_build use_after_free.apx
+    run_check "address sanitizer catches use after free" 0 sh -c \
+        'asan_build/use_after_free 2>&1 | grep "ERROR: AddressSanitizer: heap-use-after-free" > /dev/null'
+    run_check "undefined sanitizer build" 0 "$APEXC" build -fsanitize=undefined --build-dir ubsan_build divide_by_zero.apx
+    run_check "undefined sanitizer catches division by zero" 0 sh -c \
+        'ubsan_build/divide_by_zero 2>&1 | grep "divide_by_zero.apx:2:.*runtime error: division by zero" > /dev/null'
+else
+    echo -e "${YELLOW}⊘ SKIP${NC} sanitizer runs (${CC:-cc} can't link the sanitizer runtimes)"
+    SKIPPED=$((SKIPPED + 1))
+fi
+
+cd - > /dev/null
+
 # Summary
 echo ""
 echo "======================================"